@@ -0,0 +1,138 @@
+// Copyright (c) 2018 Kenton Varda and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// Measures the cost of calling a capability that points at a local object, compared to a plain
+// virtual call doing the same work.
+//
+//     local-call [iterations]
+
+#include "local-call.capnp.h"
+#include <capnp/capability.h>
+#include <kj/async.h>
+#include <kj/time.h>
+#include <kj/vector.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace capnp {
+namespace benchmark {
+namespace {
+
+class VirtualAdder {
+public:
+  virtual int32_t add(int32_t a, int32_t b) = 0;
+};
+
+class VirtualAdderImpl final: public VirtualAdder {
+public:
+  int32_t add(int32_t a, int32_t b) override { return a + b; }
+};
+
+class AdderImpl final: public capnp::Adder::Server {
+protected:
+  kj::Promise<void> add(AddContext context) override {
+    auto params = context.getParams();
+    context.getResults().setSum(params.getA() + params.getB());
+    return kj::READY_NOW;
+  }
+};
+
+VirtualAdder* volatile virtualAdder = nullptr;
+// Volatile so that the compiler can't devirtualize the calls.
+
+template <typename Func>
+void report(const char* name, uint64_t iterations, Func&& func) {
+  auto& clock = kj::systemPreciseMonotonicClock();
+  auto start = clock.now();
+  int32_t result = func();
+  auto elapsed = clock.now() - start;
+  printf("%-24s %10.1f ns/call  (checksum %d)\n", name,
+         double(elapsed / kj::NANOSECONDS) / iterations, result);
+}
+
+void run(uint64_t iterations) {
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+
+  VirtualAdderImpl virtualImpl;
+  virtualAdder = &virtualImpl;
+  capnp::Adder::Client client = kj::heap<AdderImpl>();
+
+  report("virtual call", iterations, [&]() {
+    int32_t sum = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+      sum = virtualAdder->add(sum, 1);
+    }
+    return sum;
+  });
+
+  report("send()", iterations, [&]() {
+    int32_t sum = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+      auto request = client.addRequest();
+      request.setA(sum);
+      request.setB(1);
+      sum = request.send().wait(waitScope).getSum();
+    }
+    return sum;
+  });
+
+  report("sendDirect()", iterations, [&]() {
+    int32_t sum = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+      auto request = client.addRequest();
+      request.setA(sum);
+      request.setB(1);
+      sum = request.sendDirect().wait(waitScope).getSum();
+    }
+    return sum;
+  });
+
+  const uint64_t BATCH = 64;
+  report("sendDirect(), batched", iterations, [&]() {
+    // Many calls outstanding at once, as when fanning out. Wait for them as a group.
+    int32_t sum = 0;
+    kj::Vector<RemotePromise<capnp::Adder::AddResults>> promises(BATCH);
+    for (uint64_t i = 0; i < iterations; i += BATCH) {
+      for (uint64_t j = 0; j < BATCH; j++) {
+        auto request = client.addRequest();
+        request.setA(j);
+        request.setB(1);
+        promises.add(request.sendDirect());
+      }
+      for (auto& promise: promises) {
+        sum += promise.wait(waitScope).getSum();
+      }
+      promises.clear();
+    }
+    return sum;
+  });
+}
+
+}  // namespace
+}  // namespace benchmark
+}  // namespace capnp
+
+int main(int argc, char* argv[]) {
+  uint64_t iterations = argc > 1 ? strtoull(argv[1], nullptr, 0) : 1000000;
+  capnp::benchmark::run(iterations);
+  return 0;
+}
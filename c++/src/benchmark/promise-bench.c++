@@ -0,0 +1,139 @@
+// Copyright (c) 2018 Kenton Varda and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// Microbenchmarks of the KJ promise machinery on its own, without any I/O.
+//
+//     promise-bench [iterations]
+//
+// For each workload, reports promise links (then(), attach(), evalLater(), ...) per second and the
+// number of `operator new` calls per link.
+
+#include <kj/async.h>
+#include <kj/time.h>
+#include <kj/vector.h>
+#include <atomic>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace {
+
+std::atomic<uint64_t> allocationCount(0);
+
+}  // namespace
+
+void* operator new(size_t size) {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  void* result = malloc(size);
+  if (result == nullptr) throw std::bad_alloc();
+  return result;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* pointer) noexcept { free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { free(pointer); }
+void operator delete[](void* pointer) noexcept { free(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { free(pointer); }
+// The array forms are replaced as well so that every allocation is paired with a deallocation
+// defined here; otherwise GCC 12 may report -Wmismatched-new-delete.
+
+namespace kj {
+namespace benchmark {
+namespace {
+
+const uint CHAIN_LENGTH = 16;
+
+template <typename Func>
+void measure(const char* workload, uint64_t iterations, uint linksPerIteration, Func&& func) {
+  // Warm up first, so that the free lists are populated as they would be in a long-running server.
+  for (uint i = 0; i < 1000; i++) func();
+
+  auto& clock = systemPreciseMonotonicClock();
+  uint64_t allocationsBefore = allocationCount.load(std::memory_order_relaxed);
+  auto start = clock.now();
+  for (uint64_t i = 0; i < iterations; i++) func();
+  auto elapsed = clock.now() - start;
+  uint64_t allocations = allocationCount.load(std::memory_order_relaxed) - allocationsBefore;
+
+  double links = double(iterations) * linksPerIteration;
+  double seconds = double(elapsed / NANOSECONDS) / 1e9;
+  printf("%-20s %12.0f links/s  %6.2f allocs/link\n",
+         workload, links / seconds, allocations / links);
+  fflush(stdout);
+}
+
+void run(uint64_t iterations) {
+  EventLoop loop;
+  WaitScope waitScope(loop);
+
+  measure("then-chain", iterations, CHAIN_LENGTH + 1, [&]() {
+    Promise<uint> promise = evalLater([]() { return 0u; });
+    for (uint i = 0; i < CHAIN_LENGTH; i++) {
+      promise = promise.then([](uint n) { return n + 1; });
+    }
+    promise.wait(waitScope);
+  });
+
+  measure("promise-chain", iterations, CHAIN_LENGTH + 1, [&]() {
+    // Each continuation returns a promise, so every link also gets a ChainPromiseNode.
+    Promise<uint> promise = evalLater([]() { return 0u; });
+    for (uint i = 0; i < CHAIN_LENGTH; i++) {
+      promise = promise.then([](uint n) { return evalLater([n]() { return n + 1; }); });
+    }
+    promise.wait(waitScope);
+  });
+
+  measure("attach", iterations, CHAIN_LENGTH + 1, [&]() {
+    Promise<void> promise = evalLater([]() {});
+    for (uint i = 0; i < CHAIN_LENGTH; i++) {
+      promise = promise.attach(uint(i));
+    }
+    promise.wait(waitScope);
+  });
+
+  measure("fork", iterations, CHAIN_LENGTH + 1, [&]() {
+    auto forked = evalLater([]() { return 1u; }).fork();
+    Vector<Promise<uint>> branches(CHAIN_LENGTH);
+    for (uint i = 0; i < CHAIN_LENGTH; i++) {
+      branches.add(forked.addBranch());
+    }
+    joinPromises(branches.releaseAsArray()).wait(waitScope);
+  });
+
+  measure("out-of-order", iterations, CHAIN_LENGTH * 2, [&]() {
+    // Build independent chains and drop them in an order unrelated to creation.
+    Vector<Promise<void>> promises(CHAIN_LENGTH);
+    for (uint i = 0; i < CHAIN_LENGTH; i++) {
+      promises.add(evalLater([]() {}).then([]() {}));
+    }
+    for (uint i = 0; i < CHAIN_LENGTH; i += 2) promises[i] = nullptr;
+    for (uint i = 1; i < CHAIN_LENGTH; i += 2) promises[i] = nullptr;
+  });
+}
+
+}  // namespace
+}  // namespace benchmark
+}  // namespace kj
+
+int main(int argc, char* argv[]) {
+  uint64_t iterations = argc > 1 ? strtoull(argv[1], nullptr, 0) : 100000;
+  kj::benchmark::run(iterations);
+  return 0;
+}
@@ -0,0 +1,461 @@
+// Copyright (c) 2018 Kenton Varda and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// End-to-end RPC benchmarks. A server thread hosts a `BenchService`, which the main thread (or,
+// for the fan-in workload, several client threads) calls over a socketpair, loopback TCP, or an
+// in-process pipe (see `rpc-in-process.h`).
+//
+//     rpc-bench [iterations [socketpair|tcp|in-process]]
+//
+// For each workload, reports calls per second, the median and 99th percentile call latency, and
+// the number of `operator new` calls per RPC, counted in both threads. (Message segments, which
+// are allocated with calloc(), are not included.)
+
+#include "rpc-bench.capnp.h"
+#include <capnp/rpc-twoparty.h>
+#include <capnp/rpc-in-process.h>
+#include <kj/async-io.h>
+#include <kj/debug.h>
+#include <kj/mutex.h>
+#include <kj/thread.h>
+#include <kj/time.h>
+#include <kj/vector.h>
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+namespace {
+
+std::atomic<uint64_t> allocationCount(0);
+
+}  // namespace
+
+void* operator new(size_t size) {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  void* result = malloc(size);
+  if (result == nullptr) throw std::bad_alloc();
+  return result;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* pointer) noexcept { free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { free(pointer); }
+void operator delete[](void* pointer) noexcept { free(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { free(pointer); }
+// The array forms are replaced as well so that every allocation is paired with a deallocation
+// defined here; otherwise GCC 12 may report -Wmismatched-new-delete.
+
+namespace capnp {
+namespace benchmark {
+namespace {
+
+const uint PIPELINE_DEPTH = 8;
+const size_t LARGE_PAYLOAD_SIZE = 1 << 20;
+const uint FAN_IN_CLIENTS = 8;
+
+class BenchServiceImpl final: public capnp::BenchService::Server {
+protected:
+  kj::Promise<void> echo(EchoContext context) override {
+    auto data = context.getParams().getData();
+    context.getResults(MessageSize { data.size() / sizeof(word) + 4, 0 }).setData(data);
+    return kj::READY_NOW;
+  }
+
+  kj::Promise<void> next(NextContext context) override {
+    context.getResults().setService(kj::heap<BenchServiceImpl>());
+    return kj::READY_NOW;
+  }
+
+  kj::Promise<void> exchange(ExchangeContext context) override {
+    context.releaseParams();
+    context.getResults().setService(kj::heap<BenchServiceImpl>());
+    return kj::READY_NOW;
+  }
+};
+
+enum class Transport {
+  SOCKETPAIR,
+  TCP,
+  IN_PROCESS
+};
+
+const char* const TRANSPORT_NAMES[] = { "socketpair", "tcp", "in-process" };
+
+class ClientConnection {
+public:
+  virtual ~ClientConnection() noexcept(false) {}
+  virtual capnp::BenchService::Client bootstrap() = 0;
+};
+
+class StreamConnection final: public ClientConnection {
+public:
+  explicit StreamConnection(kj::Own<kj::AsyncIoStream> streamParam)
+      : stream(kj::mv(streamParam)), client(*stream) {}
+
+  capnp::BenchService::Client bootstrap() override {
+    return client.bootstrap().castAs<capnp::BenchService>();
+  }
+
+private:
+  kj::Own<kj::AsyncIoStream> stream;
+  TwoPartyClient client;
+};
+
+class InProcessConnection final: public ClientConnection {
+public:
+  explicit InProcessConnection(const InProcessPipe& pipe)
+      : network(pipe, rpc::twoparty::Side::CLIENT), rpcSystem(makeRpcClient(network)) {}
+
+  capnp::BenchService::Client bootstrap() override {
+    MallocMessageBuilder message(4);
+    auto vatId = message.initRoot<rpc::twoparty::VatId>();
+    vatId.setSide(rpc::twoparty::Side::SERVER);
+    return rpcSystem.bootstrap(vatId).castAs<capnp::BenchService>();
+  }
+
+private:
+  InProcessVatNetwork network;
+  RpcSystem<rpc::twoparty::VatId> rpcSystem;
+};
+
+class BenchServer {
+  // Runs a `BenchService` on a thread of its own, accepting connections over any transport.
+
+public:
+  BenchServer(): thread([this]() { run(); }) {
+    state.when([](const State& s) { return s.executor != nullptr; }, [](State&) {});
+  }
+
+  ~BenchServer() noexcept(false) {
+    executor().post([this]() { stop->fulfill(); });
+  }
+
+  kj::Own<ClientConnection> connect(Transport transport, kj::AsyncIoContext& io) const {
+    // Open a connection from the calling thread. Thread-safe.
+
+    switch (transport) {
+      case Transport::SOCKETPAIR: {
+        int fds[2];
+        KJ_SYSCALL(socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+        int serverFd = fds[1];
+        executor().post([this,serverFd]() {
+          server->accept(lowLevelProvider->wrapSocketFd(
+              serverFd, kj::LowLevelAsyncIoProvider::TAKE_OWNERSHIP));
+        });
+        return kj::heap<StreamConnection>(io.lowLevelProvider->wrapSocketFd(
+            fds[0], kj::LowLevelAsyncIoProvider::TAKE_OWNERSHIP));
+      }
+
+      case Transport::TCP: {
+        uint port = state.lockShared()->port;
+        auto address = io.provider->getNetwork().parseAddress("127.0.0.1", port)
+            .wait(io.waitScope);
+        return kj::heap<StreamConnection>(address->connect().wait(io.waitScope));
+      }
+
+      case Transport::IN_PROCESS: {
+        auto pipe = newInProcessPipe();
+        executor().post([this,pipe = kj::atomicAddRef(*pipe)]() {
+          inProcessServers.add(kj::heap<InProcessServer>(*pipe, *bootstrapCap));
+        });
+        return kj::heap<InProcessConnection>(*pipe);
+      }
+    }
+    KJ_UNREACHABLE;
+  }
+
+private:
+  struct State {
+    kj::Maybe<kj::Own<const kj::Executor>> executor;
+    uint port = 0;
+  };
+  kj::MutexGuarded<State> state;
+
+  struct InProcessServer {
+    InProcessVatNetwork network;
+    RpcSystem<rpc::twoparty::VatId> rpcSystem;
+
+    InProcessServer(const InProcessPipe& pipe, Capability::Client bootstrap)
+        : network(pipe, rpc::twoparty::Side::SERVER),
+          rpcSystem(makeRpcServer(network, kj::mv(bootstrap))) {}
+  };
+
+  // Only accessed from the server thread.
+  mutable TwoPartyServer* server = nullptr;
+  mutable kj::LowLevelAsyncIoProvider* lowLevelProvider = nullptr;
+  mutable Capability::Client* bootstrapCap = nullptr;
+  mutable kj::Vector<kj::Own<InProcessServer>> inProcessServers;
+  kj::Own<kj::PromiseFulfiller<void>> stop;
+
+  kj::Thread thread;
+  // Last, so that the thread is joined before anything else is destroyed.
+
+  const kj::Executor& executor() const {
+    return *KJ_ASSERT_NONNULL(state.lockShared()->executor);
+  }
+
+  void run() {
+    auto io = kj::setupAsyncIo();
+    Capability::Client bootstrap = kj::heap<BenchServiceImpl>();
+    TwoPartyServer twoPartyServer(bootstrap);
+    server = &twoPartyServer;
+    lowLevelProvider = io.lowLevelProvider.get();
+    bootstrapCap = &bootstrap;
+
+    auto address = io.provider->getNetwork().parseAddress("127.0.0.1").wait(io.waitScope);
+    auto listener = address->listen();
+    auto listenPromise = twoPartyServer.listen(*listener)
+        .eagerlyEvaluate([](kj::Exception&& e) { KJ_LOG(ERROR, e); });
+
+    auto paf = kj::newPromiseAndFulfiller<void>();
+    stop = kj::mv(paf.fulfiller);
+    {
+      auto lock = state.lockExclusive();
+      lock->port = listener->getPort();
+      lock->executor = kj::getCurrentThreadExecutor();
+    }
+
+    paf.promise.wait(io.waitScope);
+    inProcessServers.clear();
+  }
+};
+
+// =======================================================================================
+
+struct Result {
+  uint64_t calls = 0;
+  kj::Duration elapsed = 0 * kj::NANOSECONDS;
+  kj::Vector<kj::Duration> latencies;
+  uint64_t allocations = 0;
+  uint64_t bytes = 0;
+  // Payload bytes transferred in each direction, if relevant.
+};
+
+class Measurement {
+public:
+  Measurement(): startAllocations(allocationCount), start(clock.now()) {}
+
+  void finish(Result& result) {
+    result.elapsed = clock.now() - start;
+    result.allocations = allocationCount - startAllocations;
+  }
+
+private:
+  const kj::MonotonicClock& clock = kj::systemPreciseMonotonicClock();
+  uint64_t startAllocations;
+  kj::TimePoint start;
+};
+
+template <typename Func>
+void timeCalls(Result& result, uint64_t count, Func&& func) {
+  // Invoke `func()` `count` times, recording how long each takes.
+
+  auto& clock = kj::systemPreciseMonotonicClock();
+  for (uint64_t i = 0; i < count; i++) {
+    auto start = clock.now();
+    func();
+    result.latencies.add(clock.now() - start);
+  }
+  result.calls += count;
+}
+
+void report(Transport transport, const char* workload, Result& result) {
+  std::sort(result.latencies.begin(), result.latencies.end());
+  auto percentile = [&](uint p) {
+    auto& latencies = result.latencies;
+    if (latencies.size() == 0) return 0.0;
+    return double(latencies[(latencies.size() - 1) * p / 100] / kj::NANOSECONDS) / 1000;
+  };
+
+  double seconds = double(result.elapsed / kj::NANOSECONDS) / 1e9;
+  printf("%-11s %-20s %10.0f calls/s  p50 %9.1f us  p99 %9.1f us  %6.1f allocs/call",
+         TRANSPORT_NAMES[static_cast<uint>(transport)], workload,
+         result.calls / seconds, percentile(50), percentile(99),
+         double(result.allocations) / result.calls);
+  if (result.bytes > 0) {
+    printf("  %8.1f MB/s", result.bytes / seconds / 1e6);
+  }
+  printf("\n");
+  fflush(stdout);
+}
+
+void echoCall(capnp::BenchService::Client& service, kj::ArrayPtr<const byte> data,
+              kj::WaitScope& waitScope) {
+  auto request = service.echoRequest(MessageSize { data.size() / sizeof(word) + 4, 0 });
+  request.setData(data);
+  auto response = request.send().wait(waitScope);
+  KJ_ASSERT(response.getData().size() == data.size());
+}
+
+void runTransport(const BenchServer& server, Transport transport, uint64_t iterations) {
+  auto io = kj::setupAsyncIo();
+  auto connection = server.connect(transport, io);
+  auto service = connection->bootstrap();
+  service.whenResolved().wait(io.waitScope);
+
+  {
+    // Warm up, and make sure that the server thread has allocated its connection state.
+    byte small[8] = {};
+    for (uint i = 0; i < 100; i++) echoCall(service, small, io.waitScope);
+  }
+
+  {
+    Result result;
+    Measurement measurement;
+    timeCalls(result, iterations, [&]() {
+      echoCall(service, nullptr, io.waitScope);
+    });
+    measurement.finish(result);
+    report(transport, "echo", result);
+  }
+
+  {
+    // A chain of calls, each on the capability returned by the previous one, sent without waiting
+    // for any of them to return. Counts one call per chain.
+    Result result;
+    Measurement measurement;
+    timeCalls(result, kj::max(iterations / PIPELINE_DEPTH, uint64_t(1)), [&]() {
+      capnp::BenchService::Client cap = service;
+      for (uint i = 0; i < PIPELINE_DEPTH; i++) {
+        cap = cap.nextRequest().send().getService();
+      }
+      cap.echoRequest().send().wait(io.waitScope);
+    });
+    measurement.finish(result);
+    report(transport, kj::str("pipeline depth ", PIPELINE_DEPTH).cStr(), result);
+  }
+
+  {
+    // Each call exports a capability to the server and imports one from it; both are released
+    // right after.
+    Result result;
+    Measurement measurement;
+    timeCalls(result, iterations, [&]() {
+      auto request = service.exchangeRequest();
+      request.setService(kj::heap<BenchServiceImpl>());
+      request.send().wait(io.waitScope).getService();
+    });
+    measurement.finish(result);
+    report(transport, "cap exchange", result);
+  }
+
+  {
+    auto payload = kj::heapArray<byte>(LARGE_PAYLOAD_SIZE);
+    memset(payload.begin(), 'x', payload.size());
+
+    Result result;
+    Measurement measurement;
+    uint64_t count = kj::max(iterations / 1000, uint64_t(10));
+    timeCalls(result, count, [&]() {
+      echoCall(service, payload, io.waitScope);
+    });
+    result.bytes = count * payload.size();
+    measurement.finish(result);
+    report(transport, "echo 1 MiB", result);
+  }
+
+  {
+    // Several threads, each with its own connection, calling the same server at once.
+    struct Shared {
+      bool go = false;
+      uint ready = 0;
+      kj::Vector<kj::Duration> latencies;
+    };
+    kj::MutexGuarded<Shared> shared;
+    uint64_t perClient = kj::max(iterations / FAN_IN_CLIENTS, uint64_t(1));
+
+    Result result;
+    kj::Maybe<Measurement> measurement;
+    {
+      kj::Vector<kj::Own<kj::Thread>> threads(FAN_IN_CLIENTS);
+      for (uint i = 0; i < FAN_IN_CLIENTS; i++) {
+        threads.add(kj::heap<kj::Thread>([&]() {
+          auto io = kj::setupAsyncIo();
+          auto connection = server.connect(transport, io);
+          auto service = connection->bootstrap();
+          echoCall(service, nullptr, io.waitScope);
+
+          ++shared.lockExclusive()->ready;
+          shared.when([](const Shared& s) { return s.go; }, [](Shared&) {});
+
+          Result local;
+          timeCalls(local, perClient, [&]() {
+            echoCall(service, nullptr, io.waitScope);
+          });
+
+          auto lock = shared.lockExclusive();
+          lock->latencies.addAll(local.latencies);
+        }));
+      }
+
+      shared.when([](const Shared& s) { return s.ready == FAN_IN_CLIENTS; }, [&](Shared& s) {
+        measurement.emplace();
+        s.go = true;
+      });
+    }
+
+    KJ_ASSERT_NONNULL(measurement).finish(result);
+    result.calls = perClient * FAN_IN_CLIENTS;
+    result.latencies = kj::mv(shared.lockExclusive()->latencies);
+    report(transport, kj::str("fan-in x", FAN_IN_CLIENTS).cStr(), result);
+  }
+}
+
+void run(uint64_t iterations, kj::Maybe<Transport> only) {
+  BenchServer server;
+
+  for (auto transport: { Transport::SOCKETPAIR, Transport::TCP, Transport::IN_PROCESS }) {
+    KJ_IF_MAYBE(o, only) {
+      if (*o != transport) continue;
+    }
+    runTransport(server, transport, iterations);
+  }
+}
+
+}  // namespace
+}  // namespace benchmark
+}  // namespace capnp
+
+int main(int argc, char* argv[]) {
+  using capnp::benchmark::Transport;
+  using capnp::benchmark::TRANSPORT_NAMES;
+
+  uint64_t iterations = argc > 1 ? strtoull(argv[1], nullptr, 0) : 100000;
+
+  kj::Maybe<Transport> only;
+  if (argc > 2) {
+    for (auto transport: { Transport::SOCKETPAIR, Transport::TCP, Transport::IN_PROCESS }) {
+      if (strcmp(argv[2], TRANSPORT_NAMES[static_cast<uint>(transport)]) == 0) {
+        only = transport;
+      }
+    }
+    if (only == nullptr) {
+      fprintf(stderr, "usage: %s [iterations [socketpair|tcp|in-process]]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  capnp::benchmark::run(iterations, only);
+  return 0;
+}
@@ -156,7 +156,7 @@ BuilderArena::BuilderArena(MessageBuilder* message,
     segmentWithSpace = builders.back();
 
     this->moreSegments = kj::heap<MultiSegmentState>(
-        MultiSegmentState { kj::mv(builders), kj::mv(forOutput) });
+        MultiSegmentState { kj::mv(builders), kj::mv(forOutput), {} });
 
   } else {
     segmentWithSpace = &segment0;
@@ -222,6 +222,13 @@ SegmentBuilder* BuilderArena::addExternalSegment(kj::ArrayPtr<const word> conten
   return addSegmentInternal(content);
 }
 
+SegmentBuilder* BuilderArena::addExternalSegment(kj::ArrayPtr<const word> content,
+                                                 kj::Array<const byte>&& owner) {
+  auto result = addSegmentInternal(content);
+  KJ_ASSERT_NONNULL(moreSegments)->ownedExternalData.add(kj::mv(owner));
+  return result;
+}
+
 template <typename T>
 SegmentBuilder* BuilderArena::addSegmentInternal(kj::ArrayPtr<T> content) {
   // This check should never fail in practice, since you can't get an Orphanage without allocating
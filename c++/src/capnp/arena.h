@@ -313,6 +313,11 @@ public:
   // from disk (until the message itself is written out).  `Orphanage` provides the public API for
   // this feature.
 
+  SegmentBuilder* addExternalSegment(kj::ArrayPtr<const word> content,
+                                     kj::Array<const byte>&& owner);
+  // Like above, but the arena takes ownership of `owner` (which holds `content`) and keeps it
+  // alive until the arena itself is destroyed.
+
   // implements Arena ------------------------------------------------
   SegmentReader* tryGetSegment(SegmentId id) override;
   void reportReadLimitReached() override;
@@ -341,6 +346,7 @@ private:
   struct MultiSegmentState {
     kj::Vector<kj::Own<SegmentBuilder>> builders;
     kj::Vector<kj::ArrayPtr<const word>> forOutput;
+    kj::Vector<kj::Array<const byte>> ownedExternalData;
   };
   kj::Maybe<kj::Own<MultiSegmentState>> moreSegments;
 
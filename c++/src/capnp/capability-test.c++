@@ -1080,6 +1080,187 @@ KJ_TEST("Promise<RemotePromise<T>> automatically reduces to RemotePromise<T> wit
   EXPECT_EQ(1, chainedCallCount);
 }
 
+KJ_TEST("sendDirect() dispatches local calls immediately") {
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+
+  int callCount = 0;
+  test::TestInterface::Client client(kj::heap<TestInterfaceImpl>(callCount));
+
+  auto request = client.fooRequest();
+  request.setI(123);
+  request.setJ(true);
+  auto promise = request.sendDirect();
+  KJ_EXPECT(callCount == 1);
+  KJ_EXPECT(promise.wait(waitScope).getX() == "foo");
+
+  // Pipelining works as usual.
+  int chainedCallCount = 0;
+  test::TestPipeline::Client pipelineClient(kj::heap<TestPipelineImpl>(callCount));
+  auto capRequest = pipelineClient.getCapRequest();
+  capRequest.setN(234);
+  capRequest.setInCap(test::TestInterface::Client(kj::heap<TestInterfaceImpl>(chainedCallCount)));
+  auto capPromise = capRequest.sendDirect();
+  auto pipelineRequest = capPromise.getOutBox().getCap().fooRequest();
+  pipelineRequest.setI(321);
+  KJ_EXPECT(pipelineRequest.sendDirect().wait(waitScope).getX() == "bar");
+  KJ_EXPECT(callCount == 3);
+  KJ_EXPECT(chainedCallCount == 1);
+
+  // Exceptions thrown synchronously by the callee are delivered through the promise.
+  KJ_EXPECT_THROW(UNIMPLEMENTED, client.barRequest().sendDirect().wait(waitScope));
+
+  // A promise capability still waits for the event loop.
+  auto paf = kj::newPromiseAndFulfiller<test::TestInterface::Client>();
+  test::TestInterface::Client promiseClient(kj::mv(paf.promise));
+  paf.fulfiller->fulfill(kj::cp(client));
+  auto request2 = promiseClient.fooRequest();
+  request2.setI(123);
+  request2.setJ(true);
+  auto promise2 = request2.sendDirect();
+  KJ_EXPECT(callCount == 3);
+  KJ_EXPECT(promise2.wait(waitScope).getX() == "foo");
+  KJ_EXPECT(callCount == 4);
+}
+
+KJ_TEST("DynamicCapability sendDirect() dispatches local calls immediately") {
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+
+  int callCount = 0;
+  DynamicCapability::Client client =
+      test::TestInterface::Client(kj::heap<TestInterfaceImpl>(callCount));
+
+  auto request = client.newRequest("foo");
+  request.set("i", 123);
+  request.set("j", true);
+  auto promise = request.sendDirect();
+  KJ_EXPECT(callCount == 1);
+  KJ_EXPECT(promise.wait(waitScope).get("x").as<Text>() == "foo");
+}
+
+KJ_TEST("local calls recycle message space") {
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+
+  int callCount = 0;
+  test::TestMoreStuff::Client client(kj::heap<TestMoreStuffImpl>(callCount, callCount));
+
+  // Interleave small and large messages, holding several responses at once, to make sure reused
+  // segments come back zeroed.
+  for (uint round = 0; round < 3; round++) {
+    kj::Vector<Response<test::TestCallOrder::GetCallSequenceResults>> responses;
+    for (uint i = 0; i < 8; i++) {
+      auto request = client.getCallSequenceRequest();
+      request.setExpected(callCount);
+      responses.add(request.send().wait(waitScope));
+    }
+    for (auto& response: responses) {
+      KJ_EXPECT(response.getN() < callCount);
+    }
+
+    auto request = client.methodWithDefaultsRequest();
+    memset(request.initA(10000).begin(), 'x', 10000);
+    KJ_EXPECT_THROW(UNIMPLEMENTED, request.send().wait(waitScope));
+
+    auto request2 = client.getCallSequenceRequest();
+    KJ_EXPECT(request2.getExpected() == 0);
+  }
+}
+
+class TestBlockingImpl final: public test::TestInterface::Server {
+  // foo() calls don't complete until released.
+
+public:
+  kj::Vector<kj::Own<kj::PromiseFulfiller<void>>> blocked;
+
+  kj::Promise<void> foo(FooContext context) override {
+    auto paf = kj::newPromiseAndFulfiller<void>();
+    blocked.add(kj::mv(paf.fulfiller));
+    return paf.promise.then([context]() mutable {
+      context.getResults().setX(kj::str(context.getParams().getI()));
+    });
+  }
+
+  void releaseFirst() {
+    blocked.front()->fulfill();
+    blocked = KJ_MAP(f, blocked.slice(1, blocked.size())) { return kj::mv(f); };
+  }
+};
+
+KJ_TEST("ConcurrencyLimiter queues and rejects calls") {
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+
+  auto server = kj::heap<TestBlockingImpl>();
+  auto& serverRef = *server;
+  ConcurrencyLimiter limiter({ 2, 1 });
+  test::TestInterface::Client client = limiter.wrap(kj::mv(server));
+
+  auto call = [&](uint i) {
+    auto request = client.fooRequest();
+    request.setI(i);
+    return request.send();
+  };
+
+  auto promise1 = call(1);
+  auto promise2 = call(2);
+  auto promise3 = call(3);
+  auto promise4 = call(4);
+  kj::evalLater([]() {}).wait(waitScope);
+
+  // Two calls run, one waits, one is turned away.
+  KJ_EXPECT(serverRef.blocked.size() == 2);
+  KJ_EXPECT_THROW(OVERLOADED, promise4.wait(waitScope));
+  auto stats = limiter.getStats();
+  KJ_EXPECT(stats.running == 2);
+  KJ_EXPECT(stats.queued == 1);
+  KJ_EXPECT(stats.admitted == 2);
+  KJ_EXPECT(stats.delayed == 1);
+  KJ_EXPECT(stats.rejected == 1);
+
+  // Finishing a call lets the waiting one in.
+  serverRef.releaseFirst();
+  KJ_EXPECT(promise1.wait(waitScope).getX() == "1");
+  kj::evalLater([]() {}).wait(waitScope);
+  KJ_EXPECT(serverRef.blocked.size() == 2);
+  KJ_EXPECT(limiter.getStats().queued == 0);
+
+  serverRef.releaseFirst();
+  serverRef.releaseFirst();
+  KJ_EXPECT(promise2.wait(waitScope).getX() == "2");
+  KJ_EXPECT(promise3.wait(waitScope).getX() == "3");
+  KJ_EXPECT(limiter.getStats().running == 0);
+  KJ_EXPECT(limiter.getStats().admitted == 3);
+}
+
+KJ_TEST("ConcurrencyLimiter per-method limits") {
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+
+  auto server = kj::heap<TestBlockingImpl>();
+  auto& serverRef = *server;
+  ConcurrencyLimiter limiter({ 10, 10 });
+  uint64_t interfaceId = typeId<test::TestInterface>();
+  limiter.setMethodLimit(interfaceId, 0, { 1, 0 });
+  test::TestInterface::Client client = limiter.wrap(kj::mv(server));
+
+  auto request1 = client.fooRequest();
+  auto promise1 = request1.send();
+  auto request2 = client.fooRequest();
+  auto promise2 = request2.send();
+  KJ_EXPECT_THROW(OVERLOADED, promise2.wait(waitScope));
+
+  // Other methods are counted against the shared limit.
+  KJ_EXPECT_THROW(UNIMPLEMENTED, client.barRequest().send().wait(waitScope));
+  KJ_EXPECT(limiter.getStats().admitted == 1);
+  KJ_EXPECT(limiter.getStats(interfaceId, 0).admitted == 1);
+  KJ_EXPECT(limiter.getStats(interfaceId, 0).rejected == 1);
+
+  serverRef.releaseFirst();
+  promise1.wait(waitScope);
+}
+
 }  // namespace
 }  // namespace _
 }  // namespace capnp
@@ -27,6 +27,7 @@
 #include <kj/refcount.h>
 #include <kj/debug.h>
 #include <kj/vector.h>
+#include <list>
 #include <map>
 #include "generated-header-support.h"
 
@@ -98,6 +99,18 @@ kj::Promise<void> ClientHook::whenResolved() {
   }
 }
 
+kj::Promise<kj::Maybe<int>> Capability::Client::getFd() {
+  KJ_IF_MAYBE(fd, hook->getFd()) {
+    return kj::Maybe<int>(*fd);
+  } else KJ_IF_MAYBE(promise, hook->whenMoreResolved()) {
+    return promise->then([](kj::Own<ClientHook>&& resolution) {
+      return Capability::Client(kj::mv(resolution)).getFd();
+    });
+  } else {
+    return kj::Maybe<int>(nullptr);
+  }
+}
+
 // =======================================================================================
 
 static inline uint firstSegmentSize(kj::Maybe<MessageSize> sizeHint) {
@@ -108,35 +121,124 @@ static inline uint firstSegmentSize(kj::Maybe<MessageSize> sizeHint) {
   }
 }
 
+class LocalMessagePool final: public kj::Refcounted {
+  // Recycles the first segments of the call and result messages of a LocalClient, so that a
+  // steady stream of calls with modestly-sized messages doesn't keep allocating message space.
+
+public:
+  static constexpr uint SEGMENT_WORDS = 256;
+  static constexpr uint MAX_FREE_SEGMENTS = 4;
+
+  kj::Array<word> take() {
+    if (freeSegments.empty()) {
+      auto result = kj::heapArray<word>(SEGMENT_WORDS);
+      memset(result.asBytes().begin(), 0, result.asBytes().size());
+      return result;
+    } else {
+      auto result = kj::mv(freeSegments.back());
+      freeSegments.removeLast();
+      return result;
+    }
+  }
+
+  void recycle(kj::Array<word>&& segment) {
+    // `segment` must be zeroed, as MallocMessageBuilder leaves it.
+    if (freeSegments.size() < MAX_FREE_SEGMENTS) {
+      freeSegments.add(kj::mv(segment));
+    }
+  }
+
+private:
+  kj::Vector<kj::Array<word>> freeSegments;
+};
+
+class LocalMessage {
+  // The message holding a local call's params or results. If a pool is given and the message is
+  // not expected to be large, its first segment is borrowed from the pool.
+
+public:
+  LocalMessage(kj::Maybe<MessageSize> sizeHint, kj::Maybe<LocalMessagePool&> poolParam) {
+    KJ_IF_MAYBE(p, poolParam) {
+      bool small = true;
+      KJ_IF_MAYBE(s, sizeHint) {
+        small = s->wordCount <= LocalMessagePool::SEGMENT_WORDS;
+      }
+      if (small) {
+        pool = kj::addRef(*p);
+        segment = p->take();
+        kj::ctor(builder, segment);
+        return;
+      }
+    }
+
+    kj::ctor(builder, firstSegmentSize(sizeHint));
+  }
+
+  ~LocalMessage() noexcept(false) {
+    release();
+  }
+
+  KJ_DISALLOW_COPY(LocalMessage);
+
+  kj::Maybe<MallocMessageBuilder&> get() {
+    if (released) {
+      return nullptr;
+    } else {
+      return builder;
+    }
+  }
+
+  void release() {
+    // Free the message early.
+
+    if (!released) {
+      released = true;
+      kj::dtor(builder);  // Zeroes the part of `segment` that was used.
+      KJ_IF_MAYBE(p, pool) {
+        p->get()->recycle(kj::mv(segment));
+      }
+    }
+  }
+
+private:
+  bool released = false;
+  kj::Maybe<kj::Own<LocalMessagePool>> pool;
+  kj::Array<word> segment;
+
+  union {
+    MallocMessageBuilder builder;
+    // Constructed in our constructor, destroyed by release().
+  };
+};
+
 class LocalResponse final: public ResponseHook, public kj::Refcounted {
 public:
-  LocalResponse(kj::Maybe<MessageSize> sizeHint)
-      : message(firstSegmentSize(sizeHint)) {}
+  LocalResponse(kj::Maybe<MessageSize> sizeHint, kj::Maybe<LocalMessagePool&> pool)
+      : message(sizeHint, pool) {}
 
-  MallocMessageBuilder message;
+  LocalMessage message;
 };
 
 class LocalCallContext final: public CallContextHook, public kj::Refcounted {
 public:
-  LocalCallContext(kj::Own<MallocMessageBuilder>&& request, kj::Own<ClientHook> clientRef,
-                   kj::Own<kj::PromiseFulfiller<void>> cancelAllowedFulfiller)
-      : request(kj::mv(request)), clientRef(kj::mv(clientRef)),
-        cancelAllowedFulfiller(kj::mv(cancelAllowedFulfiller)) {}
+  LocalCallContext(kj::Maybe<MessageSize> sizeHint, kj::Maybe<LocalMessagePool&> pool,
+                   kj::Own<ClientHook> clientRef)
+      : pool(pool), request(sizeHint, pool), clientRef(kj::mv(clientRef)) {}
 
   AnyPointer::Reader getParams() override {
-    KJ_IF_MAYBE(r, request) {
-      return r->get()->getRoot<AnyPointer>();
+    KJ_IF_MAYBE(r, request.get()) {
+      return r->getRoot<AnyPointer>();
     } else {
       KJ_FAIL_REQUIRE("Can't call getParams() after releaseParams().");
     }
   }
   void releaseParams() override {
-    request = nullptr;
+    request.release();
   }
   AnyPointer::Builder getResults(kj::Maybe<MessageSize> sizeHint) override {
     if (response == nullptr) {
-      auto localResponse = kj::refcounted<LocalResponse>(sizeHint);
-      responseBuilder = localResponse->message.getRoot<AnyPointer>();
+      auto localResponse = kj::refcounted<LocalResponse>(sizeHint, pool);
+      responseBuilder = KJ_ASSERT_NONNULL(localResponse->message.get()).getRoot<AnyPointer>();
       response = Response<AnyPointer>(responseBuilder.asReader(), kj::mv(localResponse));
     }
     return responseBuilder;
@@ -151,6 +253,9 @@ public:
   ClientHook::VoidPromiseAndPipeline directTailCall(kj::Own<RequestHook>&& request) override {
     KJ_REQUIRE(response == nullptr, "Can't call tailCall() after initializing the results struct.");
 
+    KJ_IF_MAYBE(d, deadline) {
+      request->setDeadline(*d);
+    }
     auto promise = request->send();
 
     auto voidPromise = promise.then([this](Response<AnyPointer>&& tailResponse) {
@@ -170,68 +275,62 @@ public:
   kj::Own<CallContextHook> addRef() override {
     return kj::addRef(*this);
   }
+  kj::Maybe<kj::TimePoint> getDeadline() override {
+    return deadline;
+  }
+
+  kj::Maybe<LocalMessagePool&> pool;
+  // Owned by the LocalClient that `clientRef` points to, if any.
 
-  kj::Maybe<kj::Own<MallocMessageBuilder>> request;
+  LocalMessage request;
   kj::Maybe<Response<AnyPointer>> response;
   AnyPointer::Builder responseBuilder = nullptr;  // only valid if `response` is non-null
   kj::Own<ClientHook> clientRef;
   kj::Maybe<kj::Own<kj::PromiseFulfiller<AnyPointer::Pipeline>>> tailCallPipelineFulfiller;
   kj::Own<kj::PromiseFulfiller<void>> cancelAllowedFulfiller;
+  kj::Maybe<kj::TimePoint> deadline;
 };
 
+class LocalClient;
+
 class LocalRequest final: public RequestHook {
 public:
   inline LocalRequest(uint64_t interfaceId, uint16_t methodId,
                       kj::Maybe<MessageSize> sizeHint, kj::Own<ClientHook> client)
-      : message(kj::heap<MallocMessageBuilder>(firstSegmentSize(sizeHint))),
+      : context(kj::refcounted<LocalCallContext>(sizeHint, nullptr, client->addRef())),
         interfaceId(interfaceId), methodId(methodId), client(kj::mv(client)) {}
+  LocalRequest(uint64_t interfaceId, uint16_t methodId,
+               kj::Maybe<MessageSize> sizeHint, LocalClient& client);
+  // Request directly to a local object, which can be dispatched without an event loop turn.
 
-  RemotePromise<AnyPointer> send() override {
-    KJ_REQUIRE(message.get() != nullptr, "Already called send() on this request.");
-
-    // For the lambda capture.
-    uint64_t interfaceId = this->interfaceId;
-    uint16_t methodId = this->methodId;
-
-    auto cancelPaf = kj::newPromiseAndFulfiller<void>();
-
-    auto context = kj::refcounted<LocalCallContext>(
-        kj::mv(message), client->addRef(), kj::mv(cancelPaf.fulfiller));
-    auto promiseAndPipeline = client->call(interfaceId, methodId, kj::addRef(*context));
-
-    // We have to make sure the call is not canceled unless permitted.  We need to fork the promise
-    // so that if the client drops their copy, the promise isn't necessarily canceled.
-    auto forked = promiseAndPipeline.promise.fork();
+  AnyPointer::Builder getParams() {
+    return KJ_ASSERT_NONNULL(context->request.get()).getRoot<AnyPointer>();
+  }
 
-    // We daemonize one branch, but only after joining it with the promise that fires if
-    // cancellation is allowed.
-    forked.addBranch()
-        .attach(kj::addRef(*context))
-        .exclusiveJoin(kj::mv(cancelPaf.promise))
-        .detach([](kj::Exception&&) {});  // ignore exceptions
+  RemotePromise<AnyPointer> send() override {
+    return sendImpl(false);
+  }
 
-    // Now the other branch returns the response from the context.
-    auto promise = forked.addBranch().then(kj::mvCapture(context,
-        [](kj::Own<LocalCallContext>&& context) {
-      context->getResults(MessageSize { 0, 0 });  // force response allocation
-      return kj::mv(KJ_ASSERT_NONNULL(context->response));
-    }));
+  RemotePromise<AnyPointer> sendDirect() override {
+    return sendImpl(localTarget != nullptr);
+  }
 
-    // We return the other branch.
-    return RemotePromise<AnyPointer>(
-        kj::mv(promise), AnyPointer::Pipeline(kj::mv(promiseAndPipeline.pipeline)));
+  void setDeadline(kj::TimePoint deadline) override {
+    context->deadline = deadline;
   }
 
   const void* getBrand() override {
     return nullptr;
   }
 
-  kj::Own<MallocMessageBuilder> message;
-
 private:
+  kj::Own<LocalCallContext> context;
   uint64_t interfaceId;
   uint16_t methodId;
   kj::Own<ClientHook> client;
+  kj::Maybe<LocalClient&> localTarget;
+
+  RemotePromise<AnyPointer> sendImpl(bool direct);
 };
 
 // =======================================================================================
@@ -277,6 +376,45 @@ private:
   // Represents the operation which will set `redirect` when possible.
 };
 
+struct CallResultHolder: public kj::Refcounted {
+  // Essentially acts as a refcounted \VoidPromiseAndPipeline, so that we can create a promise
+  // for it and fork that promise.
+
+  ClientHook::VoidPromiseAndPipeline content;
+  // One branch of the fork will use content.promise, the other branch will use
+  // content.pipeline.  Neither branch will touch the other's piece.
+
+  inline CallResultHolder(ClientHook::VoidPromiseAndPipeline&& content)
+      : content(kj::mv(content)) {}
+
+  kj::Own<CallResultHolder> addRef() { return kj::addRef(*this); }
+};
+
+static ClientHook::VoidPromiseAndPipeline splitDeferredCall(
+    kj::Promise<kj::Own<CallResultHolder>>&& callResult) {
+  // Given a promise for the result of initiating a call later on, returns a promise for the
+  // call's completion and a pipeline which queues pipelined calls until the call is initiated.
+
+  kj::ForkedPromise<kj::Own<CallResultHolder>> callResultPromise = callResult.fork();
+
+  // Create a promise that extracts the pipeline from the call initiation, and construct our
+  // QueuedPipeline to chain to it.
+  auto pipelinePromise = callResultPromise.addBranch().then(
+      [](kj::Own<CallResultHolder>&& callResult){
+        return kj::mv(callResult->content.pipeline);
+      });
+  auto pipeline = kj::refcounted<QueuedPipeline>(kj::mv(pipelinePromise));
+
+  // Create a promise that simply chains to the void promise produced by the call initiation.
+  auto completionPromise = callResultPromise.addBranch().then(
+      [](kj::Own<CallResultHolder>&& callResult){
+        return kj::mv(callResult->content.promise);
+      });
+
+  // OK, now we can actually return our thing.
+  return ClientHook::VoidPromiseAndPipeline { kj::mv(completionPromise), kj::mv(pipeline) };
+}
+
 class QueuedClient final: public ClientHook, public kj::Refcounted {
   // A ClientHook which simply queues calls while waiting for a ClientHook to which to forward
   // them.
@@ -296,7 +434,7 @@ public:
       uint64_t interfaceId, uint16_t methodId, kj::Maybe<MessageSize> sizeHint) override {
     auto hook = kj::heap<LocalRequest>(
         interfaceId, methodId, sizeHint, kj::addRef(*this));
-    auto root = hook->message->getRoot<AnyPointer>();
+    auto root = hook->getParams();
     return Request<AnyPointer, AnyPointer>(root, kj::mv(hook));
   }
 
@@ -315,43 +453,12 @@ public:
     // TODO(perf):  Too much reference counting?  Can we do better?  Maybe a way to fork
     //   Promise<Tuple<T, U>> into Tuple<Promise<T>, Promise<U>>?
 
-    struct CallResultHolder: public kj::Refcounted {
-      // Essentially acts as a refcounted \VoidPromiseAndPipeline, so that we can create a promise
-      // for it and fork that promise.
-
-      VoidPromiseAndPipeline content;
-      // One branch of the fork will use content.promise, the other branch will use
-      // content.pipeline.  Neither branch will touch the other's piece.
-
-      inline CallResultHolder(VoidPromiseAndPipeline&& content): content(kj::mv(content)) {}
-
-      kj::Own<CallResultHolder> addRef() { return kj::addRef(*this); }
-    };
-
     // Create a promise for the call initiation.
-    kj::ForkedPromise<kj::Own<CallResultHolder>> callResultPromise =
-        promiseForCallForwarding.addBranch().then(kj::mvCapture(context,
+    return splitDeferredCall(promiseForCallForwarding.addBranch().then(kj::mvCapture(context,
         [=](kj::Own<CallContextHook>&& context, kj::Own<ClientHook>&& client){
           return kj::refcounted<CallResultHolder>(
               client->call(interfaceId, methodId, kj::mv(context)));
-        })).fork();
-
-    // Create a promise that extracts the pipeline from the call initiation, and construct our
-    // QueuedPipeline to chain to it.
-    auto pipelinePromise = callResultPromise.addBranch().then(
-        [](kj::Own<CallResultHolder>&& callResult){
-          return kj::mv(callResult->content.pipeline);
-        });
-    auto pipeline = kj::refcounted<QueuedPipeline>(kj::mv(pipelinePromise));
-
-    // Create a promise that simply chains to the void promise produced by the call initiation.
-    auto completionPromise = callResultPromise.addBranch().then(
-        [](kj::Own<CallResultHolder>&& callResult){
-          return kj::mv(callResult->content.promise);
-        });
-
-    // OK, now we can actually return our thing.
-    return VoidPromiseAndPipeline { kj::mv(completionPromise), kj::mv(pipeline) };
+        })));
   }
 
   kj::Maybe<ClientHook&> getResolved() override {
@@ -455,28 +562,36 @@ public:
 
   Request<AnyPointer, AnyPointer> newCall(
       uint64_t interfaceId, uint16_t methodId, kj::Maybe<MessageSize> sizeHint) override {
-    auto hook = kj::heap<LocalRequest>(
-        interfaceId, methodId, sizeHint, kj::addRef(*this));
-    auto root = hook->message->getRoot<AnyPointer>();
+    auto hook = kj::heap<LocalRequest>(interfaceId, methodId, sizeHint, *this);
+    auto root = hook->getParams();
     return Request<AnyPointer, AnyPointer>(root, kj::mv(hook));
   }
 
   VoidPromiseAndPipeline call(uint64_t interfaceId, uint16_t methodId,
                               kj::Own<CallContextHook>&& context) override {
+    return callInternal(interfaceId, methodId, kj::mv(context), false);
+  }
+
+  VoidPromiseAndPipeline callInternal(uint64_t interfaceId, uint16_t methodId,
+                                      kj::Own<CallContextHook>&& context, bool direct) {
     auto contextPtr = context.get();
 
     // We don't want to actually dispatch the call synchronously, because we don't want the callee
     // to have any side effects before the promise is returned to the caller.  This helps avoid
     // race conditions.
     //
-    // So, we do an evalLater() here.
+    // So, we do an evalLater() here, unless the caller used sendDirect() to say it's prepared
+    // for that.
     //
     // Note also that QueuedClient depends on this evalLater() to ensure that pipelined calls don't
-    // complete before 'whenMoreResolved()' promises resolve.
-    auto promise = kj::evalLater([this,interfaceId,methodId,contextPtr]() {
+    // complete before 'whenMoreResolved()' promises resolve. (QueuedClient never calls us with
+    // `direct` set.)
+    auto dispatch = [this,interfaceId,methodId,contextPtr]() {
       return server->dispatchCall(interfaceId, methodId,
                                   CallContext<AnyPointer, AnyPointer>(*contextPtr));
-    }).attach(kj::addRef(*this));
+    };
+    auto promise = (direct ? kj::evalNow(kj::mv(dispatch)) : kj::evalLater(kj::mv(dispatch)))
+        .attach(kj::addRef(*this));
 
     // We have to fork this promise for the pipeline to receive a copy of the answer.
     auto forked = promise.fork();
@@ -524,12 +639,65 @@ public:
     }
   }
 
+  kj::Maybe<int> getFd() override {
+    return server->getFd();
+  }
+
+  LocalMessagePool& getMessagePool() {
+    if (messagePool.get() == nullptr) {
+      messagePool = kj::refcounted<LocalMessagePool>();
+    }
+    return *messagePool;
+  }
+
 private:
   kj::Own<Capability::Server> server;
   _::CapabilityServerSetBase* capServerSet = nullptr;
   void* ptr = nullptr;
+  kj::Own<LocalMessagePool> messagePool;  // Created on first call.
 };
 
+LocalRequest::LocalRequest(uint64_t interfaceId, uint16_t methodId,
+                           kj::Maybe<MessageSize> sizeHint, LocalClient& client)
+    : context(kj::refcounted<LocalCallContext>(
+          sizeHint, client.getMessagePool(), client.addRef())),
+      interfaceId(interfaceId), methodId(methodId), client(client.addRef()),
+      localTarget(client) {}
+
+RemotePromise<AnyPointer> LocalRequest::sendImpl(bool direct) {
+  KJ_REQUIRE(context.get() != nullptr, "Already called send() on this request.");
+
+  auto cancelPaf = kj::newPromiseAndFulfiller<void>();
+  context->cancelAllowedFulfiller = kj::mv(cancelPaf.fulfiller);
+
+  auto promiseAndPipeline = direct
+      ? KJ_ASSERT_NONNULL(localTarget).callInternal(
+            interfaceId, methodId, kj::addRef(*context), true)
+      : client->call(interfaceId, methodId, kj::addRef(*context));
+
+  // We have to make sure the call is not canceled unless permitted.  We need to fork the promise
+  // so that if the client drops their copy, the promise isn't necessarily canceled.
+  auto forked = promiseAndPipeline.promise.fork();
+
+  // We daemonize one branch, but only after joining it with the promise that fires if
+  // cancellation is allowed.
+  forked.addBranch()
+      .attach(kj::addRef(*context))
+      .exclusiveJoin(kj::mv(cancelPaf.promise))
+      .detach([](kj::Exception&&) {});  // ignore exceptions
+
+  // Now the other branch returns the response from the context.
+  auto promise = forked.addBranch().then(kj::mvCapture(context,
+      [](kj::Own<LocalCallContext>&& context) {
+    context->getResults(MessageSize { 0, 0 });  // force response allocation
+    return kj::mv(KJ_ASSERT_NONNULL(context->response));
+  }));
+
+  // We return the other branch.
+  return RemotePromise<AnyPointer>(
+      kj::mv(promise), AnyPointer::Pipeline(kj::mv(promiseAndPipeline.pipeline)));
+}
+
 kj::Own<ClientHook> Capability::Client::makeLocalClient(kj::Own<Capability::Server>&& server) {
   return kj::refcounted<LocalClient>(kj::mv(server));
 }
@@ -655,6 +823,205 @@ Request<AnyPointer, AnyPointer> newBrokenRequest(
 
 // =======================================================================================
 
+class ConcurrencyLimiter::Impl final: public kj::Refcounted {
+public:
+  class Waiter;
+
+  struct Bucket {
+    Limit limit;
+    uint running = 0;
+
+    std::list<Waiter*> waiters;
+    // Calls waiting to run, in arrival order.
+
+    uint64_t admitted = 0;
+    uint64_t delayed = 0;
+    uint64_t rejected = 0;
+
+    explicit Bucket(Limit limit): limit(limit) {}
+  };
+
+  class Slot {
+    // Permission to run one call, held until the call completes.
+
+  public:
+    Slot(Impl& impl, Bucket& bucket): impl(kj::addRef(impl)), bucket(bucket) {
+      ++bucket.running;
+      ++bucket.admitted;
+    }
+    ~Slot() noexcept(false) {
+      --bucket.running;
+      impl->admitWaiters(bucket);
+    }
+    KJ_DISALLOW_COPY(Slot);
+
+  private:
+    kj::Own<Impl> impl;
+    Bucket& bucket;
+  };
+
+  class Waiter {
+    // Adapter for a promise which resolves to a Slot once the call reaches the front of the queue.
+    // If the promise is canceled first, the call leaves the queue.
+
+  public:
+    Waiter(kj::PromiseFulfiller<kj::Own<Slot>>& fulfiller, Impl& impl, Bucket& bucket)
+        : fulfiller(fulfiller), impl(kj::addRef(impl)), bucket(bucket),
+          position(bucket.waiters.insert(bucket.waiters.end(), this)) {}
+    ~Waiter() noexcept(false) {
+      if (queued) bucket.waiters.erase(position);
+    }
+    KJ_DISALLOW_COPY(Waiter);
+
+    void admit() {
+      // Our entry has already been removed from the queue.
+      queued = false;
+      fulfiller.fulfill(kj::heap<Slot>(*impl, bucket));
+    }
+
+  private:
+    kj::PromiseFulfiller<kj::Own<Slot>>& fulfiller;
+    kj::Own<Impl> impl;
+    Bucket& bucket;
+    std::list<Waiter*>::iterator position;
+    bool queued = true;
+  };
+
+  explicit Impl(Limit limit): shared(limit) {}
+
+  const Bucket& getShared() const { return shared; }
+
+  Bucket& getBucket(uint64_t interfaceId, uint16_t methodId) {
+    auto iter = methods.find(std::make_pair(interfaceId, methodId));
+    return iter == methods.end() ? shared : iter->second;
+  }
+
+  const Bucket& getBucket(uint64_t interfaceId, uint16_t methodId) const {
+    auto iter = methods.find(std::make_pair(interfaceId, methodId));
+    return iter == methods.end() ? shared : iter->second;
+  }
+
+  void setMethodLimit(uint64_t interfaceId, uint16_t methodId, Limit limit) {
+    auto key = std::make_pair(interfaceId, methodId);
+    auto iter = methods.find(key);
+    if (iter == methods.end()) {
+      methods.insert(std::make_pair(key, Bucket(limit)));
+    } else {
+      iter->second.limit = limit;
+      admitWaiters(iter->second);
+    }
+  }
+
+  ClientHook::VoidPromiseAndPipeline call(ClientHook& inner, uint64_t interfaceId,
+                                          uint16_t methodId, kj::Own<CallContextHook>&& context) {
+    auto& bucket = getBucket(interfaceId, methodId);
+
+    if (bucket.running < bucket.limit.maxConcurrent && bucket.waiters.empty()) {
+      auto slot = kj::heap<Slot>(*this, bucket);
+      auto result = inner.call(interfaceId, methodId, kj::mv(context));
+      result.promise = result.promise.attach(kj::mv(slot));
+      return result;
+    } else if (bucket.waiters.size() < bucket.limit.maxQueued) {
+      ++bucket.delayed;
+      return splitDeferredCall(kj::newAdaptedPromise<kj::Own<Slot>, Waiter>(*this, bucket)
+          .then(kj::mvCapture(context, [&inner,interfaceId,methodId](
+              kj::Own<CallContextHook>&& context, kj::Own<Slot>&& slot) {
+        auto result = inner.call(interfaceId, methodId, kj::mv(context));
+        result.promise = result.promise.attach(kj::mv(slot));
+        return kj::refcounted<CallResultHolder>(kj::mv(result));
+      })).attach(inner.addRef()));
+    } else {
+      // Don't hold on to the params, which may be large, while the caller gets around to
+      // collecting the exception.
+      ++bucket.rejected;
+      context->releaseParams();
+      auto exception = KJ_EXCEPTION(OVERLOADED, "too many calls in progress on capability",
+                                    interfaceId, methodId);
+      return { kj::cp(exception), newBrokenPipeline(kj::mv(exception)) };
+    }
+  }
+
+  void admitWaiters(Bucket& bucket) {
+    while (bucket.running < bucket.limit.maxConcurrent && !bucket.waiters.empty()) {
+      auto waiter = bucket.waiters.front();
+      bucket.waiters.pop_front();
+      waiter->admit();
+    }
+  }
+
+  static Stats getStats(const Bucket& bucket) {
+    return {
+      bucket.running, static_cast<uint>(bucket.waiters.size()),
+      bucket.admitted, bucket.delayed, bucket.rejected
+    };
+  }
+
+private:
+  Bucket shared;
+  std::map<std::pair<uint64_t, uint16_t>, Bucket> methods;
+};
+
+class ConcurrencyLimiter::LimitedClient final: public ClientHook, public kj::Refcounted {
+public:
+  LimitedClient(kj::Own<ClientHook> inner, Impl& limiter)
+      : inner(kj::mv(inner)), limiter(kj::addRef(limiter)) {}
+
+  Request<AnyPointer, AnyPointer> newCall(
+      uint64_t interfaceId, uint16_t methodId, kj::Maybe<MessageSize> sizeHint) override {
+    auto hook = kj::heap<LocalRequest>(interfaceId, methodId, sizeHint, kj::addRef(*this));
+    auto root = hook->getParams();
+    return Request<AnyPointer, AnyPointer>(root, kj::mv(hook));
+  }
+
+  VoidPromiseAndPipeline call(uint64_t interfaceId, uint16_t methodId,
+                              kj::Own<CallContextHook>&& context) override {
+    return limiter->call(*inner, interfaceId, methodId, kj::mv(context));
+  }
+
+  kj::Maybe<ClientHook&> getResolved() override {
+    // Never reveal `inner`, or callers would bypass the limit.
+    return nullptr;
+  }
+
+  kj::Maybe<kj::Promise<kj::Own<ClientHook>>> whenMoreResolved() override {
+    return nullptr;
+  }
+
+  kj::Own<ClientHook> addRef() override {
+    return kj::addRef(*this);
+  }
+
+  const void* getBrand() override {
+    return nullptr;
+  }
+
+private:
+  kj::Own<ClientHook> inner;
+  kj::Own<Impl> limiter;
+};
+
+ConcurrencyLimiter::ConcurrencyLimiter(Limit limit): impl(kj::refcounted<Impl>(limit)) {}
+ConcurrencyLimiter::~ConcurrencyLimiter() noexcept(false) {}
+
+void ConcurrencyLimiter::setMethodLimit(uint64_t interfaceId, uint16_t methodId, Limit limit) {
+  impl->setMethodLimit(interfaceId, methodId, limit);
+}
+
+Capability::Client ConcurrencyLimiter::wrap(Capability::Client cap) {
+  return Capability::Client(kj::refcounted<LimitedClient>(ClientHook::from(kj::mv(cap)), *impl));
+}
+
+ConcurrencyLimiter::Stats ConcurrencyLimiter::getStats() const {
+  return Impl::getStats(impl->getShared());
+}
+
+ConcurrencyLimiter::Stats ConcurrencyLimiter::getStats(
+    uint64_t interfaceId, uint16_t methodId) const {
+  return Impl::getStats(kj::implicitCast<const Impl&>(*impl).getBucket(interfaceId, methodId));
+}
+
+// =======================================================================================
+
 ReaderCapabilityTable::ReaderCapabilityTable(
     kj::Array<kj::Maybe<kj::Own<ClientHook>>> table)
     : table(kj::mv(table)) {
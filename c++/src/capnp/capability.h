@@ -30,6 +30,7 @@
 #endif
 
 #include <kj/async.h>
+#include <kj/time.h>
 #include <kj/vector.h>
 #include "raw-schema.h"
 #include "any.h"
@@ -115,9 +116,25 @@ public:
   RemotePromise<Results> send() KJ_WARN_UNUSED_RESULT;
   // Send the call and return a promise for the results.
 
+  RemotePromise<Results> sendDirect() KJ_WARN_UNUSED_RESULT;
+  // Like send(), but if the capability points directly at a local object, start executing the
+  // call immediately, before sendDirect() returns, instead of in a later turn of the event loop.
+  // This makes local calls considerably cheaper, but means the callee may run -- and possibly call
+  // back into the caller -- while the caller is still in the middle of whatever it's doing. Use
+  // it only where that is known to be safe. For any other capability, same as send().
+
+  void setDeadline(kj::TimePoint deadline);
+  // Tells the callee that the caller won't wait for the result past `deadline`, a time as measured
+  // by the `kj::Timer` given to `RpcSystem::setTimer()`. The RPC system sends the remaining time
+  // along with the call, and the callee sees it as `CallContext::getDeadline()`; if the callee's
+  // RpcSystem has a timer too, the call is canceled when the deadline passes. This doesn't time
+  // out the call on the caller's side -- use `kj::Timer::timeoutAt()` for that.
+
 private:
   kj::Own<RequestHook> hook;
 
+  RemotePromise<Results> typed(RemotePromise<AnyPointer>&& typelessPromise);
+
   friend class Capability::Client;
   friend struct DynamicCapability;
   template <typename, typename>
@@ -134,6 +151,13 @@ public:
   inline Response(typename Results::Reader reader, kj::Own<ResponseHook>&& hook)
       : Results::Reader(reader), hook(kj::mv(hook)) {}
 
+  kj::Maybe<kj::Array<const byte>> shareData(Data::Reader data);
+  // If `data` -- a blob somewhere within these results -- was received into a buffer of its own,
+  // returns an array referencing it which remains valid after the Response is destroyed.  This
+  // lets the caller keep a large blob without copying it and without holding on to the rest of
+  // the message.  Returns null otherwise (e.g. for small blobs, or calls which never left the
+  // process), in which case the caller must copy the data if it needs it longer.
+
 private:
   kj::Own<ResponseHook> hook;
 
@@ -200,6 +224,13 @@ public:
   // where no calls are being made.  There is no reason to wait for this before making calls; if
   // the capability does not resolve, the call results will propagate the error.
 
+  kj::Promise<kj::Maybe<int>> getFd();
+  // Waits for the capability to settle, then returns the file descriptor backing it, if any. A
+  // local capability reports whatever its Server's getFd() returns; a capability received over a
+  // connection that supports FD passing (see TwoPartyVatNetwork) reports the descriptor that
+  // arrived with it. The descriptor remains owned by the capability -- dup() it if you need it to
+  // outlive the Client.
+
   Request<AnyPointer, AnyPointer> typelessRequest(
       uint64_t interfaceId, uint16_t methodId,
       kj::Maybe<MessageSize> sizeHint);
@@ -310,6 +341,16 @@ public:
   // excessively complicated for the framework to avoid notififying of cancellation as long as
   // pipelined calls still exist.
 
+  kj::Maybe<kj::TimePoint> getDeadline();
+  // If the caller set a deadline on the call (see `Request::setDeadline()`), returns it, in terms
+  // of this vat's `kj::Timer`. Pass it on to calls made on the caller's behalf so that they, too,
+  // give up when nobody is waiting for them anymore. Tail calls and calls forwarded across RPC
+  // connections inherit it automatically.
+  //
+  // If the RpcSystem has a timer, then once the deadline passes the caller receives an OVERLOADED
+  // exception and the call is canceled as if the caller had canceled it -- that is, only once
+  // `allowCancellation()` has been called.
+
 private:
   CallContextHook* hook;
 
@@ -331,6 +372,13 @@ public:
   // is no longer needed.  `context` may be used to allocate the output struct and deal with
   // cancellation.
 
+  virtual kj::Maybe<int> getFd() { return nullptr; }
+  // If this capability is backed by a file descriptor (e.g. an open file or a shared memory
+  // segment), return it. When the capability is passed over an RPC connection that supports FD
+  // passing, the descriptor is sent along with it, so that the receiver can access the underlying
+  // resource directly rather than only through calls. The server retains ownership and must keep
+  // the descriptor open for as long as the server exists.
+
   // TODO(someday):  Method which can optionally be overridden to implement Join when the object is
   //   a proxy.
 
@@ -458,6 +506,81 @@ public:
   // accepts an lvalue input).
 };
 
+// =======================================================================================
+// Concurrency limits
+
+class ConcurrencyLimiter {
+  // Bounds the number of calls running at once on the capabilities it wraps, so that a burst of
+  // calls to a busy object queues up in front of it, or fails fast, rather than piling up inside
+  // it. A call counts as running from when it is delivered to the wrapped capability until it
+  // returns (or is canceled).
+  //
+  // Calls beyond the limit wait in a FIFO queue. Once the queue is full as well, further calls
+  // fail immediately with an OVERLOADED exception; their parameters are released without the
+  // object ever seeing them. Over RPC, the caller receives that exception as the call's result
+  // and may back off or go elsewhere.
+  //
+  // All capabilities wrapped by the same limiter share its limit, except that individual methods
+  // can be given limits of their own with setMethodLimit().
+  //
+  //     ConcurrencyLimiter limiter({ 16, 256 });
+  //     auto cap = limiter.wrap(kj::heap<MyInterfaceImpl>());
+
+public:
+  struct Limit {
+    uint maxConcurrent;
+    // Number of calls which may run at once.
+
+    uint maxQueued;
+    // Number of further calls which may wait for a running call to finish.
+  };
+
+  struct Stats {
+    uint running;
+    uint queued;
+    // Calls currently running, and currently waiting to run.
+
+    uint64_t admitted;
+    // Calls started so far, including those which had to wait.
+
+    uint64_t delayed;
+    // Calls which had to wait before running.
+
+    uint64_t rejected;
+    // Calls which failed with OVERLOADED because the queue was full.
+  };
+
+  explicit ConcurrencyLimiter(Limit limit);
+  ~ConcurrencyLimiter() noexcept(false);
+  KJ_DISALLOW_COPY(ConcurrencyLimiter);
+
+  void setMethodLimit(uint64_t interfaceId, uint16_t methodId, Limit limit);
+  // Count calls to the given method against a limit of their own rather than the shared one.
+  // Calls already running or queued are not affected.
+
+  Capability::Client wrap(Capability::Client cap);
+  // Returns a capability which forwards calls to `cap`, subject to the limits. The wrapper keeps
+  // the limiter's state alive, so the ConcurrencyLimiter object itself may be destroyed first.
+
+  template <typename ClientType>
+  ClientType wrap(ClientType cap);
+  template <typename ServerType>
+  typename ServerType::Serves::Client wrap(kj::Own<ServerType> server);
+  // Convenience templates which return the appropriate interface type.
+
+  Stats getStats() const;
+  // Statistics for the shared limit.
+
+  Stats getStats(uint64_t interfaceId, uint16_t methodId) const;
+  // Statistics for the given method's own limit, or for the shared limit if it has none.
+
+private:
+  class Impl;
+  class LimitedClient;
+
+  kj::Own<Impl> impl;
+};
+
 // =======================================================================================
 // Hook interfaces which must be implemented by the RPC system.  Applications never call these
 // directly; the RPC system implements them and the types defined earlier in this file wrap them.
@@ -469,6 +592,12 @@ public:
   virtual RemotePromise<AnyPointer> send() = 0;
   // Send the call and return a promise for the result.
 
+  virtual RemotePromise<AnyPointer> sendDirect() { return send(); }
+  // Implements Request::sendDirect(). Only local objects do anything different.
+
+  virtual void setDeadline(kj::TimePoint deadline) {}
+  // Implements Request::setDeadline(). The default implementation ignores the deadline.
+
   virtual const void* getBrand() = 0;
   // Returns a void* that identifies who made this request.  This can be used by an RPC adapter to
   // discover when tail call is going to be sent over its own connection and therefore can be
@@ -483,13 +612,16 @@ public:
 class ResponseHook {
   // Hook interface implemented by RPC system representing a response.
   //
-  // At present this class has no methods.  It exists only for garbage collection -- when the
-  // ResponseHook is destroyed, the results can be freed.
+  // Mostly this class exists for garbage collection -- when the ResponseHook is destroyed, the
+  // results can be freed.
 
 public:
   virtual ~ResponseHook() noexcept(false);
   // Just here to make sure the type is dynamic.
 
+  virtual kj::Maybe<kj::Array<const byte>> shareData(Data::Reader data) { return nullptr; }
+  // Implements Response::shareData().
+
   template <typename T>
   inline static kj::Own<ResponseHook> from(Response<T>&& response) {
     return kj::mv(response.hook);
@@ -543,6 +675,10 @@ public:
   kj::Promise<void> whenResolved();
   // Repeatedly calls whenMoreResolved() until it returns nullptr.
 
+  virtual kj::Maybe<int> getFd() { return nullptr; }
+  // Returns the file descriptor backing this capability, if it is settled and has one. Promise
+  // clients return nullptr; use Capability::Client::getFd() to wait for resolution.
+
   virtual kj::Own<ClientHook> addRef() = 0;
   // Return a new reference to the same capability.
 
@@ -587,6 +723,8 @@ public:
   // promise fulfiller for onTailCall() with the returned pipeline.
 
   virtual kj::Own<CallContextHook> addRef() = 0;
+
+  virtual kj::Maybe<kj::TimePoint> getDeadline() { return nullptr; }
 };
 
 kj::Own<ClientHook> newLocalPromiseClient(kj::Promise<kj::Own<ClientHook>>&& promise);
@@ -761,7 +899,24 @@ template <typename Params, typename Results>
 RemotePromise<Results> Request<Params, Results>::send() {
   auto typelessPromise = hook->send();
   hook = nullptr;  // prevent reuse
+  return typed(kj::mv(typelessPromise));
+}
+
+template <typename Params, typename Results>
+RemotePromise<Results> Request<Params, Results>::sendDirect() {
+  auto typelessPromise = hook->sendDirect();
+  hook = nullptr;  // prevent reuse
+  return typed(kj::mv(typelessPromise));
+}
+
+template <typename Params, typename Results>
+inline void Request<Params, Results>::setDeadline(kj::TimePoint deadline) {
+  hook->setDeadline(deadline);
+}
 
+template <typename Params, typename Results>
+RemotePromise<Results> Request<Params, Results>::typed(
+    RemotePromise<AnyPointer>&& typelessPromise) {
   // Convert the Promise to return the correct response type.
   // Explicitly upcast to kj::Promise to make clear that calling .then() doesn't invalidate the
   // Pipeline part of the RemotePromise.
@@ -777,6 +932,11 @@ RemotePromise<Results> Request<Params, Results>::send() {
   return RemotePromise<Results>(kj::mv(typedPromise), kj::mv(typedPipeline));
 }
 
+template <typename Results>
+inline kj::Maybe<kj::Array<const byte>> Response<Results>::shareData(Data::Reader data) {
+  return hook->shareData(data);
+}
+
 inline Capability::Client::Client(kj::Own<ClientHook>&& hook): hook(kj::mv(hook)) {}
 template <typename T, typename>
 inline Capability::Client::Client(kj::Own<T>&& server)
@@ -853,6 +1013,10 @@ template <typename Params, typename Results>
 inline void CallContext<Params, Results>::allowCancellation() {
   hook->allowCancellation();
 }
+template <typename Params, typename Results>
+inline kj::Maybe<kj::TimePoint> CallContext<Params, Results>::getDeadline() {
+  return hook->getDeadline();
+}
 
 template <typename Params, typename Results>
 CallContext<Params, Results> Capability::Server::internalGetTypedContext(
@@ -895,6 +1059,16 @@ kj::Promise<kj::Maybe<typename T::Server&>> CapabilityServerSet<T>::getLocalServ
   });
 }
 
+template <typename ClientType>
+ClientType ConcurrencyLimiter::wrap(ClientType cap) {
+  return wrap(Capability::Client(kj::mv(cap))).template castAs<typename ClientType::Calls>();
+}
+
+template <typename ServerType>
+typename ServerType::Serves::Client ConcurrencyLimiter::wrap(kj::Own<ServerType> server) {
+  return wrap(Capability::Client(kj::mv(server))).template castAs<typename ServerType::Serves>();
+}
+
 template <typename T>
 struct Orphanage::GetInnerReader<T, Kind::INTERFACE> {
   static inline kj::Own<ClientHook> apply(typename T::Client t) {
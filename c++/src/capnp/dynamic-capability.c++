@@ -71,7 +71,15 @@ kj::Promise<void> DynamicCapability::Server::dispatchCall(
 }
 
 RemotePromise<DynamicStruct> Request<DynamicStruct, DynamicStruct>::send() {
-  auto typelessPromise = hook->send();
+  return typed(hook->send());
+}
+
+RemotePromise<DynamicStruct> Request<DynamicStruct, DynamicStruct>::sendDirect() {
+  return typed(hook->sendDirect());
+}
+
+RemotePromise<DynamicStruct> Request<DynamicStruct, DynamicStruct>::typed(
+    RemotePromise<AnyPointer>&& typelessPromise) {
   auto resultSchemaCopy = resultSchema;
 
   // Convert the Promise to return the correct response type.
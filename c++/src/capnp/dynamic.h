@@ -552,10 +552,16 @@ public:
   RemotePromise<DynamicStruct> send();
   // Send the call and return a promise for the results.
 
+  RemotePromise<DynamicStruct> sendDirect();
+  // Like send(), but dispatches calls to local objects immediately. See
+  // `Request<Params, Results>::sendDirect()` in capability.h.
+
 private:
   kj::Own<RequestHook> hook;
   StructSchema resultSchema;
 
+  RemotePromise<DynamicStruct> typed(RemotePromise<AnyPointer>&& typelessPromise);
+
   friend class Capability::Client;
   friend struct DynamicCapability;
   template <typename, typename>
@@ -3483,7 +3483,7 @@ OrphanBuilder OrphanBuilder::concat(
 OrphanBuilder OrphanBuilder::referenceExternalData(BuilderArena* arena, Data::Reader data) {
   // TODO(someday): We now allow unaligned segments on architectures thata support it. We could
   //   consider relaxing this check as well?
-  KJ_REQUIRE(reinterpret_cast<uintptr_t>(data.begin()) % sizeof(void*) == 0,
+  KJ_REQUIRE(reinterpret_cast<uintptr_t>(data.begin()) % sizeof(word) == 0,
              "Cannot referenceExternalData() that is not aligned.");
 
   auto checkedSize = assertMaxBits<BLOB_SIZE_BITS>(bounded(data.size()));
@@ -3506,6 +3506,30 @@ OrphanBuilder OrphanBuilder::referenceExternalData(BuilderArena* arena, Data::Re
   return result;
 }
 
+OrphanBuilder OrphanBuilder::referenceExternalData(
+    BuilderArena* arena, CapTableBuilder* capTable, kj::Array<const byte>&& data) {
+  if (reinterpret_cast<uintptr_t>(data.begin()) % sizeof(word) != 0 ||
+      data.size() % sizeof(word) != 0) {
+    // We can't reference this in place: it's misaligned, or the last word would extend past the
+    // end of the allocation.
+    return copy(arena, capTable, Data::Reader(data));
+  }
+
+  auto checkedSize = assertMaxBits<BLOB_SIZE_BITS>(bounded(data.size()));
+  auto wordCount = WireHelpers::roundBytesUpToWords(checkedSize * BYTES);
+  kj::ArrayPtr<const word> words(reinterpret_cast<const word*>(data.begin()),
+                                 unbound(wordCount / WORDS));
+
+  OrphanBuilder result;
+  result.tagAsPtr()->setKindForOrphan(WirePointer::LIST);
+  result.tagAsPtr()->listRef.set(ElementSize::BYTE, checkedSize * ELEMENTS);
+  result.segment = arena->addExternalSegment(words, kj::mv(data));
+  result.capTable = nullptr;
+  result.location = const_cast<word*>(words.begin());
+
+  return result;
+}
+
 StructBuilder OrphanBuilder::asStruct(StructSize size) {
   KJ_DASSERT(tagAsPtr()->isNull() == (location == nullptr));
 
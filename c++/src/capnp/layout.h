@@ -881,6 +881,8 @@ public:
                               kj::ArrayPtr<const ListReader> lists);
 
   static OrphanBuilder referenceExternalData(BuilderArena* arena, Data::Reader data);
+  static OrphanBuilder referenceExternalData(BuilderArena* arena, CapTableBuilder* capTable,
+                                             kj::Array<const byte>&& data);
 
   OrphanBuilder& operator=(const OrphanBuilder& other) = delete;
   inline OrphanBuilder& operator=(OrphanBuilder&& other);
@@ -233,6 +233,61 @@ KJ_TEST("call local promise pointing into membrane that eventually resolves to o
   }, "outside", "outside", "outside", "outbound");
 }
 
+KJ_TEST("capability crossing membrane repeatedly reuses its wrapper") {
+  TestEnv env;
+  Thing::Client thing = kj::heap<ThingImpl>("inside");
+
+  auto hookOf = [](Thing::Client cap) { return ClientHook::from(kj::mv(cap)); };
+  auto wrapped = hookOf(membrane(thing, env.policy->addRef()));
+  KJ_EXPECT(hookOf(membrane(thing, env.policy->addRef())).get() == wrapped.get());
+
+  // The reverse direction and other policies have their own wrappers.
+  KJ_EXPECT(hookOf(reverseMembrane(thing, env.policy->addRef())).get() != wrapped.get());
+  KJ_EXPECT(hookOf(membrane(thing, kj::refcounted<MembranePolicyImpl>())).get() != wrapped.get());
+
+  // Passing the wrapper back in still unwraps it.
+  KJ_EXPECT(hookOf(reverseMembrane(Thing::Client(wrapped->addRef()), env.policy->addRef())).get()
+            == hookOf(thing).get());
+
+  // Once dropped, the next crossing gets a fresh, working wrapper.
+  wrapped = nullptr;
+  auto rewrapped = membrane(thing, env.policy->addRef());
+  KJ_EXPECT(rewrapped.passThroughRequest().send().wait(env.waitScope).getText() == "inside");
+}
+
+class PassThroughPolicy final: public MembranePolicy, public kj::Refcounted {
+public:
+  kj::Maybe<Capability::Client> inboundCall(uint64_t interfaceId, uint16_t methodId,
+                                            Capability::Client target) override {
+    KJ_FAIL_ASSERT("inboundCall() shouldn't be called");
+  }
+
+  kj::Maybe<Capability::Client> outboundCall(uint64_t interfaceId, uint16_t methodId,
+                                             Capability::Client target) override {
+    KJ_FAIL_ASSERT("outboundCall() shouldn't be called");
+  }
+
+  bool interceptsCalls() override { return false; }
+
+  kj::Own<MembranePolicy> addRef() override {
+    return kj::addRef(*this);
+  }
+};
+
+KJ_TEST("membrane skips call policy when interceptsCalls() is false") {
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+  test::TestMembrane::Client membraned =
+      membrane(kj::heap<TestMembraneImpl>(), kj::refcounted<PassThroughPolicy>());
+
+  testThingImpl(waitScope, membraned, [&]() {
+    return membraned.makeThingRequest().send().wait(waitScope).getThing();
+  }, "inside", "inside", "inside", "inside");
+  testThingImpl(waitScope, membraned, [&]() {
+    return kj::heap<ThingImpl>("outside");
+  }, "outside", "outside", "outside", "outside");
+}
+
 KJ_TEST("apply membrane using copyOutOfMembrane() on struct") {
   TestEnv env;
 
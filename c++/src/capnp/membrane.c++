@@ -21,9 +21,50 @@
 
 #include "membrane.h"
 #include <kj/debug.h>
+#include <unordered_map>
 
 namespace capnp {
 
+namespace _ {  // private
+
+class MembraneWrapperCache {
+  // See MembranePolicy::wrapperCache.  Maps each wrapped capability to its wrapper, separately
+  // for each direction.  The wrappers are not owned: each one removes itself when destroyed, and
+  // since a wrapper holds references to both the policy and the wrapped capability, an entry's
+  // key cannot be reused while the entry exists.
+
+public:
+  static kj::Maybe<ClientHook&> find(MembranePolicy& policy, ClientHook& inner, bool reverse) {
+    KJ_IF_MAYBE(cache, policy.wrapperCache.get()) {
+      auto& map = cache->wrappers[reverse];
+      auto iter = map.find(&inner);
+      if (iter != map.end()) {
+        return *iter->second;
+      }
+    }
+    return nullptr;
+  }
+
+  static void add(MembranePolicy& policy, ClientHook& inner, bool reverse, ClientHook& wrapper) {
+    if (policy.wrapperCache.get() == nullptr) {
+      policy.wrapperCache = kj::heap<MembraneWrapperCache>();
+    }
+    policy.wrapperCache->wrappers[reverse].insert(std::make_pair(&inner, &wrapper));
+  }
+
+  static void remove(MembranePolicy& policy, ClientHook& inner, bool reverse) {
+    KJ_IF_MAYBE(cache, policy.wrapperCache.get()) {
+      cache->wrappers[reverse].erase(&inner);
+    }
+  }
+
+private:
+  std::unordered_map<ClientHook*, ClientHook*> wrappers[2];
+  // Indexed by `reverse`.
+};
+
+}  // namespace _
+
 namespace {
 
 static const char DUMMY = 0;
@@ -219,6 +260,10 @@ public:
     return RemotePromise<AnyPointer>(kj::mv(newPromise), kj::mv(newPipeline));
   }
 
+  void setDeadline(kj::TimePoint deadline) override {
+    inner->setDeadline(deadline);
+  }
+
   const void* getBrand() override {
     return MEMBRANE_BRAND;
   }
@@ -294,6 +339,10 @@ public:
     return kj::addRef(*this);
   }
 
+  kj::Maybe<kj::TimePoint> getDeadline() override {
+    return inner->getDeadline();
+  }
+
 private:
   kj::Own<CallContextHook> inner;
   kj::Own<MembranePolicy> policy;
@@ -313,11 +362,31 @@ public:
       : inner(kj::mv(inner)), policy(kj::mv(policyParam)), reverse(reverse) {
     KJ_IF_MAYBE(r, policy->onRevoked()) {
       revocationTask = r->eagerlyEvaluate([this](kj::Exception&& exception) {
+        uncache();
         this->inner = newBrokenCap(kj::mv(exception));
       });
     }
   }
 
+  ~MembraneHook() noexcept(false) {
+    uncache();
+  }
+
+  static kj::Own<ClientHook> getCached(
+      kj::Own<ClientHook>&& inner, MembranePolicy& policy, bool reverse) {
+    // Returns the wrapper for `inner` created earlier by this policy, or creates and caches a new
+    // one.
+
+    KJ_IF_MAYBE(wrapper, _::MembraneWrapperCache::find(policy, *inner, reverse)) {
+      return wrapper->addRef();
+    }
+
+    auto result = kj::refcounted<MembraneHook>(kj::mv(inner), policy.addRef(), reverse);
+    _::MembraneWrapperCache::add(policy, *result->inner, reverse, *result);
+    result->cached = true;
+    return kj::mv(result);
+  }
+
   static kj::Own<ClientHook> wrap(ClientHook& cap, MembranePolicy& policy, bool reverse) {
     if (cap.getBrand() == MEMBRANE_BRAND) {
       auto& otherMembrane = kj::downcast<MembraneHook>(cap);
@@ -364,9 +433,7 @@ public:
       return r->get()->newCall(interfaceId, methodId, sizeHint);
     }
 
-    auto redirect = reverse
-        ? policy->outboundCall(interfaceId, methodId, Capability::Client(inner->addRef()))
-        : policy->inboundCall(interfaceId, methodId, Capability::Client(inner->addRef()));
+    auto redirect = checkRedirect(interfaceId, methodId);
     KJ_IF_MAYBE(r, redirect) {
       // The policy says that *if* this capability points into the membrane, then we want to
       // redirect the call. However, if this capability is a promise, then it could resolve to
@@ -392,9 +459,7 @@ public:
       return r->get()->call(interfaceId, methodId, kj::mv(context));
     }
 
-    auto redirect = reverse
-        ? policy->outboundCall(interfaceId, methodId, Capability::Client(inner->addRef()))
-        : policy->inboundCall(interfaceId, methodId, Capability::Client(inner->addRef()));
+    auto redirect = checkRedirect(interfaceId, methodId);
     KJ_IF_MAYBE(r, redirect) {
       // The policy says that *if* this capability points into the membrane, then we want to
       // redirect the call. However, if this capability is a promise, then it could resolve to
@@ -475,6 +540,24 @@ private:
   bool reverse;
   kj::Maybe<kj::Own<ClientHook>> resolved;
   kj::Promise<void> revocationTask = nullptr;
+
+  bool cached = false;
+  // Whether this wrapper is registered in the policy's wrapper cache, under `inner`.
+
+  kj::Maybe<Capability::Client> checkRedirect(uint64_t interfaceId, uint16_t methodId) {
+    if (!policy->interceptsCalls()) return nullptr;
+
+    return reverse
+        ? policy->outboundCall(interfaceId, methodId, Capability::Client(inner->addRef()))
+        : policy->inboundCall(interfaceId, methodId, Capability::Client(inner->addRef()));
+  }
+
+  void uncache() {
+    if (cached) {
+      _::MembraneWrapperCache::remove(*policy, *inner, reverse);
+      cached = false;
+    }
+  }
 };
 
 kj::Own<ClientHook> membrane(kj::Own<ClientHook> inner, MembranePolicy& policy, bool reverse) {
@@ -483,14 +566,17 @@ kj::Own<ClientHook> membrane(kj::Own<ClientHook> inner, MembranePolicy& policy,
 
 }  // namespace
 
+MembranePolicy::MembranePolicy() {}
+MembranePolicy::~MembranePolicy() noexcept(false) {}
+
 Capability::Client MembranePolicy::importExternal(Capability::Client external) {
-  return Capability::Client(kj::refcounted<MembraneHook>(
-      ClientHook::from(kj::mv(external)), addRef(), true));
+  return Capability::Client(MembraneHook::getCached(
+      ClientHook::from(kj::mv(external)), *this, true));
 }
 
 Capability::Client MembranePolicy::exportInternal(Capability::Client internal) {
-  return Capability::Client(kj::refcounted<MembraneHook>(
-      ClientHook::from(kj::mv(internal)), addRef(), false));
+  return Capability::Client(MembraneHook::getCached(
+      ClientHook::from(kj::mv(internal)), *this, false));
 }
 
 Capability::Client MembranePolicy::importInternal(
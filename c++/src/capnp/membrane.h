@@ -51,11 +51,16 @@
 
 namespace capnp {
 
+namespace _ { class MembraneWrapperCache; }
+
 class MembranePolicy {
   // Applications may implement this interface to define a membrane policy, which allows some
   // calls crossing the membrane to be blocked or redirected.
 
 public:
+  MembranePolicy();
+  virtual ~MembranePolicy() noexcept(false);
+
   virtual kj::Maybe<Capability::Client> inboundCall(
       uint64_t interfaceId, uint16_t methodId, Capability::Client target) = 0;
   // Given an inbound call (a call originating "outside" the membrane destined for an object
@@ -93,6 +98,12 @@ public:
   //   will enter and then exit the membrane, but calls on the eventual resolution will not cross
   //   the membrane at all, so it is important that these two cases behave the same.
 
+  virtual bool interceptsCalls() { return true; }
+  // Returns false if `inboundCall()` and `outboundCall()` always return null, in which case the
+  // membrane will not invoke them at all. Capabilities crossing the membrane are still wrapped and
+  // revocation still applies; only the per-call policy check is skipped. Override this for
+  // membranes that exist purely for revocation or to interpose on capability passing.
+
   virtual kj::Own<MembranePolicy> addRef() = 0;
   // Return a new owned pointer to the same policy.
   //
@@ -163,6 +174,14 @@ public:
   // capability passed into the membrane and then back out.
   //
   // The default implementation simply returns `external`.
+
+private:
+  kj::Own<_::MembraneWrapperCache> wrapperCache;
+  // Wrappers created by the default `importExternal()` and `exportInternal()`, indexed by the
+  // capability they wrap, so that a capability crossing the membrane repeatedly reuses the same
+  // wrapper. Allocated on first use.
+
+  friend class _::MembraneWrapperCache;
 };
 
 Capability::Client membrane(Capability::Client inner, kj::Own<MembranePolicy> policy);
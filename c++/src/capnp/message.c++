@@ -50,6 +50,10 @@ MessageReader::~MessageReader() noexcept(false) {
   }
 }
 
+kj::Maybe<kj::Array<const byte>> MessageReader::shareData(Data::Reader data) {
+  return nullptr;
+}
+
 bool MessageReader::isCanonical() {
   if (!allocatedArena) {
     static_assert(sizeof(_::ReaderArena) <= sizeof(arenaSpace),
@@ -110,6 +110,13 @@ public:
   // x86/x64, alignment is optional, though recommended for performance, whereas on many other
   // architectures, alignment is required.
 
+  virtual kj::Maybe<kj::Array<const byte>> shareData(Data::Reader data);
+  // If `data` -- a blob within this message -- lives in memory which can outlive the
+  // MessageReader, returns an array referencing that memory which remains valid after the reader
+  // is destroyed.  This lets the caller keep a large blob without copying it and without holding
+  // on to the rest of the message.  Returns null if `data` isn't in such memory, which by default
+  // is always the case; copy the data instead.
+
   inline const ReaderOptions& getOptions();
   // Get the options passed to the constructor.
 
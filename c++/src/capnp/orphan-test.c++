@@ -1026,6 +1026,68 @@ TEST(Orphans, ReferenceExternalData_NoZeroImmediateAbandon) {
   }
 }
 
+class CountingArrayDisposer final: public kj::ArrayDisposer {
+public:
+  mutable uint count = 0;
+
+protected:
+  void disposeImpl(void* firstElement, size_t elementSize, size_t elementCount,
+                   size_t capacity, void (*destroyElement)(void*)) const override {
+    ++count;
+  }
+};
+
+TEST(Orphans, ReferenceExternalDataOwned) {
+  union {
+    word align;
+    byte data[56];
+  };
+  memset(data, 0x55, sizeof(data));
+  CountingArrayDisposer disposer;
+
+  {
+    MallocMessageBuilder builder;
+    auto root = builder.getRoot<TestAllTypes>();
+    root.adoptDataField(builder.getOrphanage().referenceExternalData(
+        kj::Array<const byte>(data, sizeof(data), disposer)));
+
+    auto segments = builder.getSegmentsForOutput();
+    ASSERT_EQ(2, segments.size());
+    EXPECT_EQ(data, segments[1].asBytes().begin());
+    EXPECT_EQ(data, root.asReader().getDataField().begin());
+
+    // Disowning the blob doesn't free it; the message holds it until destroyed.
+    root.disownDataField();
+    EXPECT_EQ(0, disposer.count);
+  }
+
+  EXPECT_EQ(1, disposer.count);
+}
+
+TEST(Orphans, ReferenceExternalDataOwnedOddSize) {
+  // A blob that doesn't fill its last word is copied, lest the message expose bytes past its end.
+
+  union {
+    word align;
+    byte data[50];
+  };
+  memset(data, 0x55, sizeof(data));
+  CountingArrayDisposer disposer;
+
+  MallocMessageBuilder builder;
+  auto orphan = builder.getOrphanage().referenceExternalData(
+      kj::Array<const byte>(data, sizeof(data), disposer));
+  EXPECT_EQ(1, disposer.count);
+  EXPECT_EQ(1, builder.getSegmentsForOutput().size());
+
+  auto reader = orphan.getReader();
+  EXPECT_NE(data, reader.begin());
+  EXPECT_EQ(Data::Reader(data, sizeof(data)), reader);
+
+  // Being a copy, it's writable.
+  orphan.get()[0] = 0;
+}
+
 TEST(Orphans, TruncateData) {
   MallocMessageBuilder message;
   auto orphan = message.getOrphanage().newOrphan<Data>(17);
@@ -162,9 +162,9 @@ public:
   //   can, however, obtain a Reader, e.g. via orphan.getReader() or from a parent Reader (once
   //   the orphan is adopted).  It is your responsibility to make sure your code can deal with
   //   these problems when using this optimization; if you can't, allocate a copy instead.
-  // - `data.begin()` must be aligned to a machine word boundary (32-bit or 64-bit depending on
-  //   the CPU).  Any pointer returned by malloc() as well as any data blob obtained from another
-  //   Cap'n Proto message satisfies this.
+  // - `data.begin()` must be aligned to an 8-byte (Cap'n Proto word) boundary.  Any pointer
+  //   returned by malloc() as well as any data blob obtained from another Cap'n Proto message
+  //   satisfies this.
   // - If `data.size()` is not a multiple of 8, extra bytes past data.end() up until the next 8-byte
   //   boundary will be visible in the raw message when it is written out.  Thus, there must be no
   //   secrets in these bytes.  Data blobs obtained from other Cap'n Proto messages should be safe
@@ -174,6 +174,18 @@ public:
   // into the message tree without copying it.  This is particularly useful when referencing very
   // large blobs, such as whole mmap'd files.
 
+  Orphan<Data> referenceExternalData(kj::Array<const byte>&& data) const;
+  // Like above, but the message takes ownership of `data` and frees it when the `MessageBuilder`
+  // is destroyed.  This removes the lifetime restriction, which matters when the message is
+  // written asynchronously: e.g. an RPC call's params or results may be written to the network
+  // after the call that filled them in has returned.  `TwoPartyVatNetwork` holds the message
+  // until the write which includes it completes, so the data goes from `data` to the socket
+  // without being copied.
+  //
+  // If `data` is not 8-byte aligned or its size is not a multiple of 8 bytes, it is copied into the
+  // message instead, since referencing it would expose bytes past its end.  The read-only
+  // restriction above still applies otherwise.
+
 private:
   _::BuilderArena* arena;
   _::CapTableBuilder* capTable;
@@ -434,4 +446,8 @@ inline Orphan<Data> Orphanage::referenceExternalData(Data::Reader data) const {
   return Orphan<Data>(_::OrphanBuilder::referenceExternalData(arena, data));
 }
 
+inline Orphan<Data> Orphanage::referenceExternalData(kj::Array<const byte>&& data) const {
+  return Orphan<Data>(_::OrphanBuilder::referenceExternalData(arena, capTable, kj::mv(data)));
+}
+
 }  // namespace capnp
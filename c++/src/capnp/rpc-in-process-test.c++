@@ -0,0 +1,154 @@
+// Copyright (c) 2018 Kenton Varda and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#define CAPNP_TESTING_CAPNP 1
+
+#include "rpc-in-process.h"
+#include "test-util.h"
+#include <kj/async-io.h>
+#include <kj/debug.h>
+#include <kj/thread.h>
+#include <kj/test.h>
+
+namespace capnp {
+namespace _ {
+namespace {
+
+kj::Own<kj::Thread> runServer(const InProcessPipe& pipe, int& callCount) {
+  return kj::heap<kj::Thread>([&pipe, &callCount]() {
+    auto io = kj::setupAsyncIo();
+    InProcessVatNetwork network(pipe, rpc::twoparty::Side::SERVER);
+    auto server = makeRpcServer(network, kj::heap<TestPipelineImpl>(callCount));
+    network.onDisconnect().wait(io.waitScope);
+  });
+}
+
+Capability::Client bootstrap(RpcSystem<rpc::twoparty::VatId>& rpcSystem) {
+  MallocMessageBuilder message(4);
+  message.initRoot<rpc::twoparty::VatId>().setSide(rpc::twoparty::Side::SERVER);
+  return rpcSystem.bootstrap(message.getRoot<rpc::twoparty::VatId>());
+}
+
+KJ_TEST("in-process network: calls and pipelining") {
+  auto pipe = newInProcessPipe();
+  int callCount = 0;
+  int reverseCallCount = 0;  // Calls back from server to client.
+
+  auto serverThread = runServer(*pipe, callCount);
+
+  auto io = kj::setupAsyncIo();
+  InProcessVatNetwork network(*pipe, rpc::twoparty::Side::CLIENT);
+  auto rpcClient = makeRpcClient(network);
+
+  auto client = bootstrap(rpcClient).castAs<test::TestPipeline>();
+
+  auto request = client.getCapRequest();
+  request.setN(234);
+  request.setInCap(kj::heap<TestInterfaceImpl>(reverseCallCount));
+  auto promise = request.send();
+
+  auto pipelineRequest = promise.getOutBox().getCap().fooRequest();
+  pipelineRequest.setI(321);
+  auto pipelinePromise = pipelineRequest.send();
+
+  auto pipelineRequest2 = promise.getOutBox().getCap()
+      .castAs<test::TestExtends>().graultRequest();
+  auto pipelinePromise2 = pipelineRequest2.send();
+
+  promise = nullptr;  // Just to be annoying, drop the original promise.
+
+  auto response = pipelinePromise.wait(io.waitScope);
+  KJ_EXPECT(response.getX() == "bar");
+
+  auto response2 = pipelinePromise2.wait(io.waitScope);
+  checkTestMessage(response2);
+
+  KJ_EXPECT(callCount == 3);
+  KJ_EXPECT(reverseCallCount == 1);
+}
+
+KJ_TEST("in-process network: client attaches first") {
+  // Messages sent before the server side exists are held for it.
+
+  auto pipe = newInProcessPipe();
+  int callCount = 0;
+  kj::Own<kj::Thread> serverThread;  // Must outlive the client network.
+
+  auto io = kj::setupAsyncIo();
+  InProcessVatNetwork network(*pipe, rpc::twoparty::Side::CLIENT);
+  auto rpcClient = makeRpcClient(network);
+
+  auto client = bootstrap(rpcClient).castAs<test::TestPipeline>();
+  auto request = client.getCapRequest();
+  request.setN(234);
+  int reverseCallCount = 0;
+  request.setInCap(kj::heap<TestInterfaceImpl>(reverseCallCount));
+  auto promise = request.send();
+
+  serverThread = runServer(*pipe, callCount);
+
+  auto response = promise.wait(io.waitScope);
+  KJ_EXPECT(response.getS() == "bar");
+  KJ_EXPECT(callCount == 1);
+  KJ_EXPECT(reverseCallCount == 1);
+}
+
+KJ_TEST("in-process network: disconnect") {
+  auto pipe = newInProcessPipe();
+  int callCount = 0;
+
+  auto io = kj::setupAsyncIo();
+
+  // The server disconnects as soon as it has handled one call.
+  auto serverThread = kj::heap<kj::Thread>([&]() {
+    auto serverIo = kj::setupAsyncIo();
+    InProcessVatNetwork network(*pipe, rpc::twoparty::Side::SERVER);
+    auto server = makeRpcServer(network, kj::heap<TestInterfaceImpl>(callCount));
+    while (callCount == 0) {
+      serverIo.provider->getTimer().afterDelay(1 * kj::MILLISECONDS).wait(serverIo.waitScope);
+    }
+  });
+
+  InProcessVatNetwork network(*pipe, rpc::twoparty::Side::CLIENT);
+  auto rpcClient = makeRpcClient(network);
+  auto client = bootstrap(rpcClient).castAs<test::TestInterface>();
+
+  {
+    auto request = client.fooRequest();
+    request.setI(123);
+    request.setJ(true);
+    KJ_EXPECT(request.send().wait(io.waitScope).getX() == "foo");
+  }
+
+  network.onDisconnect().wait(io.waitScope);
+  serverThread = nullptr;
+
+  {
+    auto request = client.fooRequest();
+    request.setI(123);
+    request.setJ(true);
+    KJ_EXPECT_THROW(DISCONNECTED, request.send().wait(io.waitScope));
+  }
+}
+
+}  // namespace
+}  // namespace _
+}  // namespace capnp
@@ -0,0 +1,261 @@
+// Copyright (c) 2018 Kenton Varda and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "rpc-in-process.h"
+#include <kj/debug.h>
+
+namespace capnp {
+
+class InProcessPipe::SharedMessage final: public kj::AtomicRefcounted {
+  // A message built by one side and read in place by the other. Ownership is shared because the
+  // RPC system may hold on to the `OutgoingRpcMessage` after send() while the receiver is already
+  // reading (or done with) the message; whichever side lets go last frees it.
+  //
+  // Note that the message must not carry capabilities in its own cap table, since ClientHooks
+  // are not thread-safe. The RPC system never does this: it always imbues messages with its own
+  // capability table and transmits only CapDescriptors.
+
+public:
+  explicit SharedMessage(uint firstSegmentWordSize)
+      : builder(firstSegmentWordSize == 0 ? SUGGESTED_FIRST_SEGMENT_WORDS
+                                          : firstSegmentWordSize) {}
+
+  MallocMessageBuilder builder;
+
+  kj::Array<kj::ArrayPtr<const word>> segments;
+  // Snapshot of the segment table, taken by the sending thread in send().
+};
+
+InProcessPipe::~InProcessPipe() noexcept(false) {}
+
+kj::Own<const InProcessPipe> newInProcessPipe() {
+  return kj::atomicRefcounted<InProcessPipe>();
+}
+
+// =======================================================================================
+
+InProcessVatNetwork::InProcessVatNetwork(const InProcessPipe& pipeParam, rpc::twoparty::Side side,
+                                         ReaderOptions receiveOptions)
+    : pipe(kj::atomicAddRef(pipeParam)), side(side), peerVatId(4),
+      receiveOptions(receiveOptions) {
+  peerVatId.initRoot<rpc::twoparty::VatId>().setSide(
+      side == rpc::twoparty::Side::CLIENT ? rpc::twoparty::Side::SERVER
+                                          : rpc::twoparty::Side::CLIENT);
+
+  auto paf = kj::newPromiseAndFulfiller<void>();
+  disconnectPromise = paf.promise.fork();
+  disconnectFulfiller.fulfiller = kj::mv(paf.fulfiller);
+
+  kj::Vector<kj::Own<InProcessPipe::SharedMessage>> pending;
+  {
+    auto lock = pipe->state.lockExclusive();
+    auto& endpoint = lock->endpoints[sideIndex()];
+    KJ_REQUIRE(!endpoint.attached, "this side of the InProcessPipe is already in use", side);
+    endpoint.attached = true;
+    endpoint.executor = kj::getCurrentThreadExecutor();
+    pending = kj::mv(endpoint.pending);
+    peerEof = endpoint.pendingEof;
+
+    KJ_IF_MAYBE(e, lock->endpoints[peerIndex()].executor) {
+      peerExecutor = e->get()->addRef();
+    }
+  }
+
+  pipe->networks[sideIndex()] = this;
+  inbox = kj::mv(pending);
+}
+
+InProcessVatNetwork::~InProcessVatNetwork() noexcept(false) {
+  pipe->networks[sideIndex()] = nullptr;
+  pipe->state.lockExclusive()->endpoints[sideIndex()].executor = nullptr;
+
+  if (!shutDown) {
+    // Make sure the peer sees EOF.
+    shutDown = true;
+    sendToPeer(nullptr);
+  }
+}
+
+void InProcessVatNetwork::FulfillerDisposer::disposeImpl(void* pointer) const {
+  if (--refcount == 0) {
+    fulfiller->fulfill();
+  }
+}
+
+kj::Own<TwoPartyVatNetworkBase::Connection> InProcessVatNetwork::asConnection() {
+  ++disconnectFulfiller.refcount;
+  return kj::Own<TwoPartyVatNetworkBase::Connection>(this, disconnectFulfiller);
+}
+
+kj::Maybe<kj::Own<TwoPartyVatNetworkBase::Connection>> InProcessVatNetwork::connect(
+    rpc::twoparty::VatId::Reader ref) {
+  if (ref.getSide() == side) {
+    return nullptr;
+  } else {
+    return asConnection();
+  }
+}
+
+kj::Promise<kj::Own<TwoPartyVatNetworkBase::Connection>> InProcessVatNetwork::accept() {
+  if (side == rpc::twoparty::Side::SERVER && !accepted) {
+    accepted = true;
+    return asConnection();
+  } else {
+    // Create a promise that will never be fulfilled.
+    auto paf = kj::newPromiseAndFulfiller<kj::Own<TwoPartyVatNetworkBase::Connection>>();
+    acceptFulfiller = kj::mv(paf.fulfiller);
+    return kj::mv(paf.promise);
+  }
+}
+
+void InProcessVatNetwork::sendToPeer(kj::Maybe<kj::Own<InProcessPipe::SharedMessage>> message) {
+  if (peerExecutor == nullptr) {
+    // We haven't seen the peer yet. Check if it has attached in the meantime; if not, leave the
+    // message for it to pick up when it does.
+    auto lock = pipe->state.lockExclusive();
+    auto& peer = lock->endpoints[peerIndex()];
+    KJ_IF_MAYBE(e, peer.executor) {
+      peerExecutor = e->get()->addRef();
+    } else if (!peer.attached) {
+      KJ_IF_MAYBE(m, message) {
+        peer.pending.add(kj::mv(*m));
+      } else {
+        peer.pendingEof = true;
+      }
+      return;
+    } else {
+      // Peer has already come and gone. Drop the message.
+      return;
+    }
+  }
+
+  // If the peer's loop is already gone, post() returns false and the message is dropped, which
+  // is exactly what writing to a disconnected socket would amount to.
+  KJ_ASSERT_NONNULL(peerExecutor)->post(
+      [pipe = kj::atomicAddRef(*pipe), index = peerIndex(), message = kj::mv(message)]() mutable {
+    deliverTo(*pipe, index, kj::mv(message));
+  });
+}
+
+void InProcessVatNetwork::deliverTo(const InProcessPipe& pipe, uint index,
+                                    kj::Maybe<kj::Own<InProcessPipe::SharedMessage>> message) {
+  InProcessVatNetwork* network = pipe.networks[index];
+  if (network != nullptr) {
+    network->deliver(kj::mv(message));
+  }
+}
+
+void InProcessVatNetwork::deliver(kj::Maybe<kj::Own<InProcessPipe::SharedMessage>> message) {
+  KJ_IF_MAYBE(m, message) {
+    inbox.add(kj::mv(*m));
+  } else {
+    peerEof = true;
+  }
+
+  KJ_IF_MAYBE(f, receiveFulfiller) {
+    f->get()->fulfill();
+    receiveFulfiller = nullptr;
+  }
+}
+
+class InProcessVatNetwork::OutgoingMessageImpl final: public OutgoingRpcMessage {
+public:
+  OutgoingMessageImpl(InProcessVatNetwork& network, uint firstSegmentWordSize)
+      : network(network),
+        message(kj::atomicRefcounted<InProcessPipe::SharedMessage>(firstSegmentWordSize)) {}
+
+  AnyPointer::Builder getBody() override {
+    return message->builder.getRoot<AnyPointer>();
+  }
+
+  void send() override {
+    auto segments = message->builder.getSegmentsForOutput();
+    size_t size = 0;
+    for (auto& segment: segments) {
+      size += segment.size();
+    }
+    KJ_REQUIRE(size < network.receiveOptions.traversalLimitInWords, size,
+               "Trying to send Cap'n Proto message larger than our single-message size limit. The "
+               "other side probably won't accept it (assuming its traversalLimitInWords matches "
+               "ours) and would abort the connection, so I won't send it.") {
+      return;
+    }
+
+    KJ_REQUIRE(!network.shutDown, "already shut down") { return; }
+
+    message->segments = kj::heapArray(segments);
+    network.sendToPeer(kj::atomicAddRef(*message));
+  }
+
+private:
+  InProcessVatNetwork& network;
+  kj::Own<InProcessPipe::SharedMessage> message;
+};
+
+class InProcessVatNetwork::IncomingMessageImpl final: public IncomingRpcMessage {
+public:
+  IncomingMessageImpl(kj::Own<InProcessPipe::SharedMessage> messageParam, ReaderOptions options)
+      : message(kj::mv(messageParam)), reader(message->segments, options) {}
+
+  AnyPointer::Reader getBody() override {
+    return reader.getRoot<AnyPointer>();
+  }
+
+private:
+  kj::Own<InProcessPipe::SharedMessage> message;
+  SegmentArrayMessageReader reader;
+};
+
+rpc::twoparty::VatId::Reader InProcessVatNetwork::getPeerVatId() {
+  return peerVatId.getRoot<rpc::twoparty::VatId>();
+}
+
+kj::Own<OutgoingRpcMessage> InProcessVatNetwork::newOutgoingMessage(uint firstSegmentWordSize) {
+  return kj::heap<OutgoingMessageImpl>(*this, firstSegmentWordSize);
+}
+
+kj::Promise<kj::Maybe<kj::Own<IncomingRpcMessage>>>
+    InProcessVatNetwork::receiveIncomingMessage() {
+  if (inboxPos < inbox.size()) {
+    auto message = kj::mv(inbox[inboxPos++]);
+    if (inboxPos == inbox.size()) {
+      inbox.clear();
+      inboxPos = 0;
+    }
+    return kj::Maybe<kj::Own<IncomingRpcMessage>>(
+        kj::heap<IncomingMessageImpl>(kj::mv(message), receiveOptions));
+  } else if (peerEof) {
+    return kj::Maybe<kj::Own<IncomingRpcMessage>>(nullptr);
+  } else {
+    auto paf = kj::newPromiseAndFulfiller<void>();
+    receiveFulfiller = kj::mv(paf.fulfiller);
+    return paf.promise.then([this]() { return receiveIncomingMessage(); });
+  }
+}
+
+kj::Promise<void> InProcessVatNetwork::shutdown() {
+  KJ_REQUIRE(!shutDown, "already shut down");
+  shutDown = true;
+  sendToPeer(nullptr);
+  return kj::READY_NOW;
+}
+
+}  // namespace capnp
@@ -0,0 +1,190 @@
+// Copyright (c) 2018 Kenton Varda and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#if defined(__GNUC__) && !defined(CAPNP_HEADER_WARNINGS)
+#pragma GCC system_header
+#endif
+
+#include "rpc-twoparty.h"
+#include <kj/mutex.h>
+#include <kj/vector.h>
+
+namespace capnp {
+
+class InProcessVatNetwork;
+
+class InProcessPipe: public kj::AtomicRefcounted {
+  // The shared state of a two-party RPC connection between two threads of the same process.
+  // Create one with `newInProcessPipe()`, hand it to both threads, and have each thread construct
+  // an `InProcessVatNetwork` for its side. The two sides may be constructed in either order;
+  // messages sent before the other side exists are held until it shows up.
+  //
+  // Unlike connecting two threads with a socketpair and `TwoPartyVatNetwork`, messages are never
+  // serialized: the sender's message segments are handed to the receiving thread by pointer,
+  // through the receiving thread's `kj::Executor`, and read there in place.
+
+public:
+  ~InProcessPipe() noexcept(false);
+
+private:
+  class SharedMessage;
+
+  struct Endpoint {
+    kj::Maybe<kj::Own<const kj::Executor>> executor;
+    // Executor of the thread hosting this side. Null until the side's network is constructed, and
+    // null again once it is destroyed.
+
+    kj::Vector<kj::Own<SharedMessage>> pending;
+    // Messages sent to this side before it was attached.
+
+    bool attached = false;
+    bool pendingEof = false;
+    // pendingEof: the other side finished sending before this side was attached.
+  };
+
+  struct State {
+    Endpoint endpoints[2];
+  };
+  kj::MutexGuarded<State> state;
+
+  mutable InProcessVatNetwork* networks[2] = { nullptr, nullptr };
+  // The network attached to each side. Each slot is only ever accessed from the thread hosting
+  // that side.
+
+  InProcessPipe() = default;
+
+  friend class InProcessVatNetwork;
+  friend kj::Own<const InProcessPipe> newInProcessPipe();
+  template <typename T, typename... Params>
+  friend kj::Own<T> kj::atomicRefcounted(Params&&... params);
+};
+
+kj::Own<const InProcessPipe> newInProcessPipe();
+
+class InProcessVatNetwork: public TwoPartyVatNetworkBase,
+                           private TwoPartyVatNetworkBase::Connection {
+  // A `VatNetwork` connecting exactly two vats living on different threads (more precisely,
+  // different `kj::EventLoop`s) of the same process. It behaves like `TwoPartyVatNetwork` -- the
+  // two sides use the same `VatId`s and the same `rpc::twoparty::Side` -- but instead of writing
+  // messages to a byte stream, it posts them to the peer's event loop by pointer, so a call costs
+  // no syscalls beyond the wakeup of an idle peer and no copies at all.
+  //
+  // The thread's `kj::EventPort` must support `wake()`, as those created by `kj::setupAsyncIo()`
+  // do.
+  //
+  // Typical usage:
+  //
+  //     auto pipe = newInProcessPipe();
+  //     kj::Thread serverThread([&]() {
+  //       auto io = kj::setupAsyncIo();
+  //       InProcessVatNetwork network(*pipe, rpc::twoparty::Side::SERVER);
+  //       auto server = makeRpcServer(network, kj::heap<MyServerImpl>());
+  //       network.onDisconnect().wait(io.waitScope);
+  //     });
+  //
+  //     auto io = kj::setupAsyncIo();
+  //     InProcessVatNetwork network(*pipe, rpc::twoparty::Side::CLIENT);
+  //     auto client = makeRpcClient(network);
+  //     ...
+
+public:
+  InProcessVatNetwork(const InProcessPipe& pipe, rpc::twoparty::Side side,
+                      ReaderOptions receiveOptions = ReaderOptions());
+  ~InProcessVatNetwork() noexcept(false);
+  KJ_DISALLOW_COPY(InProcessVatNetwork);
+
+  kj::Promise<void> onDisconnect() { return disconnectPromise.addBranch(); }
+  // Returns a promise that resolves when the peer disconnects.
+
+  rpc::twoparty::Side getSide() { return side; }
+
+  // implements VatNetwork -----------------------------------------------------
+
+  kj::Maybe<kj::Own<TwoPartyVatNetworkBase::Connection>> connect(
+      rpc::twoparty::VatId::Reader ref) override;
+  kj::Promise<kj::Own<TwoPartyVatNetworkBase::Connection>> accept() override;
+
+private:
+  class OutgoingMessageImpl;
+  class IncomingMessageImpl;
+
+  kj::Own<const InProcessPipe> pipe;
+  rpc::twoparty::Side side;
+  MallocMessageBuilder peerVatId;
+  ReaderOptions receiveOptions;
+  bool accepted = false;
+  bool shutDown = false;
+
+  kj::Maybe<kj::Own<const kj::Executor>> peerExecutor;
+  // Cached once the peer has attached, so that sends need not take the pipe's lock.
+
+  bool peerEof = false;
+  // The peer has stopped sending (or has gone away).
+
+  kj::Vector<kj::Own<InProcessPipe::SharedMessage>> inbox;
+  size_t inboxPos = 0;
+  // Messages received but not yet consumed by receiveIncomingMessage().
+
+  kj::Maybe<kj::Own<kj::PromiseFulfiller<void>>> receiveFulfiller;
+  // Fulfilled when a message arrives while the RPC system is waiting for one.
+
+  kj::Own<kj::PromiseFulfiller<kj::Own<TwoPartyVatNetworkBase::Connection>>> acceptFulfiller;
+  // Fulfiller for the promise returned by the second call to accept(). Never fulfilled, because
+  // there is only one connection.
+
+  kj::ForkedPromise<void> disconnectPromise = nullptr;
+
+  class FulfillerDisposer: public kj::Disposer {
+    // See TwoPartyVatNetwork::FulfillerDisposer.
+
+  public:
+    mutable kj::Own<kj::PromiseFulfiller<void>> fulfiller;
+    mutable uint refcount = 0;
+
+    void disposeImpl(void* pointer) const override;
+  };
+  FulfillerDisposer disconnectFulfiller;
+
+  kj::Own<TwoPartyVatNetworkBase::Connection> asConnection();
+
+  uint sideIndex() { return static_cast<uint>(side); }
+  uint peerIndex() { return 1 - static_cast<uint>(side); }
+
+  void sendToPeer(kj::Maybe<kj::Own<InProcessPipe::SharedMessage>> message);
+  // Send a message to the peer, or EOF if null.
+
+  void deliver(kj::Maybe<kj::Own<InProcessPipe::SharedMessage>> message);
+  // Called in this network's thread when a message (or EOF, if null) arrives from the peer.
+
+  static void deliverTo(const InProcessPipe& pipe, uint index,
+                        kj::Maybe<kj::Own<InProcessPipe::SharedMessage>> message);
+
+  // implements Connection -----------------------------------------------------
+
+  rpc::twoparty::VatId::Reader getPeerVatId() override;
+  kj::Own<OutgoingRpcMessage> newOutgoingMessage(uint firstSegmentWordSize) override;
+  kj::Promise<kj::Maybe<kj::Own<IncomingRpcMessage>>> receiveIncomingMessage() override;
+  kj::Promise<void> shutdown() override;
+};
+
+}  // namespace capnp
@@ -0,0 +1,302 @@
+// Copyright (c) 2018 Kenton Varda and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#define CAPNP_TESTING_CAPNP 1
+
+#include "rpc-metrics.h"
+#include "rpc-twoparty.h"
+#include "test-util.h"
+#include <kj/async-io.h>
+#include <kj/debug.h>
+#include <kj/test.h>
+
+namespace capnp {
+namespace _ {
+namespace {
+
+class CountingObserver final: public RpcObserver {
+public:
+  uint questionsSent = 0;
+  uint questionsReturned = 0;
+  uint callsReceived = 0;
+  uint callsReturned = 0;
+  uint exceptions = 0;
+  uint messagesRead = 0;
+  uint messagesWritten = 0;
+
+  void questionSent(const CallEvent& event) override {
+    ++questionsSent;
+    KJ_EXPECT(event.startTime == event.time);
+  }
+  void questionReturned(const CallEvent& event, ReturnType type) override {
+    ++questionsReturned;
+    KJ_EXPECT(event.time >= event.startTime);
+    if (type == ReturnType::EXCEPTION) ++exceptions;
+  }
+  void callReceived(const CallEvent& event) override {
+    ++callsReceived;
+    KJ_EXPECT(event.sizeInWords > 0);
+  }
+  void callReturned(const CallEvent& event, ReturnType type) override {
+    ++callsReturned;
+    KJ_EXPECT(event.time >= event.startTime);
+  }
+  void messageRead(uint16_t type, size_t sizeInWords, kj::TimePoint time) override {
+    ++messagesRead;
+  }
+  void messageWritten(uint16_t type, size_t sizeInWords, kj::TimePoint time) override {
+    ++messagesWritten;
+  }
+  void controlMessagesFlushed(size_t queued, size_t sent) override {
+    controlQueued += queued;
+    controlSent += sent;
+    ++controlBatches;
+  }
+
+  size_t controlQueued = 0;
+  size_t controlSent = 0;
+  uint controlBatches = 0;
+};
+
+struct TestSetup {
+  kj::EventLoop loop;
+  kj::WaitScope waitScope;
+  kj::TwoWayPipe pipe;
+  int callCount = 0;
+  TwoPartyVatNetwork serverNetwork;
+  TwoPartyVatNetwork clientNetwork;
+  RpcSystem<rpc::twoparty::VatId> server;
+  RpcSystem<rpc::twoparty::VatId> client;
+
+  TestSetup()
+      : waitScope(loop), pipe(kj::newTwoWayPipe()),
+        serverNetwork(*pipe.ends[0], rpc::twoparty::Side::SERVER),
+        clientNetwork(*pipe.ends[1], rpc::twoparty::Side::CLIENT),
+        server(makeRpcServer(serverNetwork, kj::heap<TestInterfaceImpl>(callCount))),
+        client(makeRpcClient(clientNetwork)) {}
+
+  test::TestInterface::Client bootstrap() {
+    MallocMessageBuilder message(4);
+    message.initRoot<rpc::twoparty::VatId>().setSide(rpc::twoparty::Side::SERVER);
+    return client.bootstrap(message.getRoot<rpc::twoparty::VatId>())
+        .castAs<test::TestInterface>();
+  }
+
+  void callFoo(test::TestInterface::Client& cap) {
+    auto request = cap.fooRequest();
+    request.setI(123);
+    request.setJ(true);
+    KJ_EXPECT(request.send().wait(waitScope).getX() == "foo");
+  }
+};
+
+KJ_TEST("RpcObserver sees calls and messages") {
+  TestSetup setup;
+  CountingObserver clientObserver;
+  CountingObserver serverObserver;
+  setup.client.setObserver(clientObserver);
+  setup.server.setObserver(serverObserver);
+
+  auto cap = setup.bootstrap();
+  setup.callFoo(cap);
+  setup.callFoo(cap);
+  KJ_EXPECT_THROW(UNIMPLEMENTED, cap.barRequest().send().wait(setup.waitScope));
+
+  KJ_EXPECT(clientObserver.questionsSent == 3);
+  KJ_EXPECT(clientObserver.questionsReturned == 3);
+  KJ_EXPECT(clientObserver.exceptions == 1);
+  KJ_EXPECT(clientObserver.callsReceived == 0);
+  KJ_EXPECT(serverObserver.callsReceived == 3);
+  KJ_EXPECT(serverObserver.callsReturned == 3);
+  KJ_EXPECT(serverObserver.questionsSent == 0);
+
+  // At least the Bootstrap and three Calls went out, and their Returns came back.
+  KJ_EXPECT(clientObserver.messagesWritten >= 4);
+  KJ_EXPECT(clientObserver.messagesRead >= 4);
+
+  // Removing the observer stops notifications.
+  setup.client.setObserver(nullptr);
+  setup.callFoo(cap);
+  KJ_EXPECT(clientObserver.questionsSent == 3);
+  KJ_EXPECT(serverObserver.callsReceived == 4);
+}
+
+KJ_TEST("Finish messages are batched") {
+  TestSetup setup;
+  CountingObserver observer;
+  setup.client.setObserver(observer);
+
+  auto cap = setup.bootstrap();
+  setup.callFoo(cap);
+  kj::evalLater([]() {}).wait(setup.waitScope);
+
+  auto fooRequest = [&]() {
+    auto request = cap.fooRequest();
+    request.setI(123);
+    request.setJ(true);
+    return request;
+  };
+
+  kj::Vector<Response<test::TestInterface::FooResults>> responses;
+  for (uint i = 0; i < 3; i++) {
+    responses.add(fooRequest().send().wait(setup.waitScope));
+  }
+
+  // Dropping the responses queues three Finishes, which go out together at the end of the turn.
+  uint written = observer.messagesWritten;
+  uint batches = observer.controlBatches;
+  responses.clear();
+  KJ_EXPECT(observer.messagesWritten == written);
+  kj::evalLater([]() {}).wait(setup.waitScope);
+  KJ_EXPECT(observer.messagesWritten == written + 3);
+  KJ_EXPECT(observer.controlBatches == batches + 1);
+
+  // A new call sends pending Finishes first, since it may reuse their question IDs.
+  fooRequest().send().wait(setup.waitScope);
+  batches = observer.controlBatches;
+  auto promise = fooRequest().send();
+  KJ_EXPECT(observer.controlBatches == batches + 1);
+  promise.wait(setup.waitScope);
+
+  KJ_EXPECT(observer.controlQueued == observer.controlSent);
+}
+
+KJ_TEST("connection stats and idle trimming") {
+  TestSetup setup;
+
+  auto cap = setup.bootstrap();
+  setup.callFoo(cap);
+  kj::evalLater([]() {}).wait(setup.waitScope);
+
+  auto clientStats = setup.client.getConnectionStats();
+  KJ_ASSERT(clientStats.size() == 1);
+  KJ_EXPECT(clientStats[0].peerVatId.as<rpc::twoparty::VatId>().getSide() ==
+            rpc::twoparty::Side::SERVER);
+  KJ_EXPECT(clientStats[0].imports == 1);
+  KJ_EXPECT(clientStats[0].exports == 0);
+  KJ_EXPECT(clientStats[0].questions == 0);
+
+  auto serverStats = setup.server.getConnectionStats();
+  KJ_ASSERT(serverStats.size() == 1);
+  KJ_EXPECT(serverStats[0].exports == 1);
+  KJ_EXPECT(setup.server.getConnectionStats(0).size() == 0);
+
+  // A burst of concurrent calls grows the question table.
+  {
+    kj::Vector<RemotePromise<test::TestInterface::FooResults>> promises;
+    for (uint i = 0; i < 100; i++) {
+      auto request = cap.fooRequest();
+      request.setI(123);
+      request.setJ(true);
+      promises.add(request.send());
+    }
+    KJ_EXPECT(setup.client.getConnectionStats()[0].questions == 100);
+    for (auto& promise: promises) promise.wait(setup.waitScope);
+  }
+  kj::evalLater([]() {}).wait(setup.waitScope);
+  size_t burstBytes = setup.client.getConnectionStats()[0].tableBytes;
+
+  // The connection saw activity since it was created, so the first call only starts the quiet
+  // period; the second trims it.
+  KJ_EXPECT(setup.client.trimIdleConnections() == 0);
+  KJ_EXPECT(setup.client.trimIdleConnections() == 1);
+  KJ_EXPECT(setup.client.getConnectionStats()[0].tableBytes < burstBytes);
+
+  // Trimming doesn't disturb the connection.
+  setup.callFoo(cap);
+  KJ_EXPECT(setup.client.trimIdleConnections() == 0);
+  setup.callFoo(cap);
+  KJ_EXPECT(setup.client.getConnectionStats()[0].imports == 1);
+}
+
+KJ_TEST("RpcMetrics collects per-method latencies") {
+  TestSetup setup;
+  RpcMetrics metrics;
+  setup.client.setObserver(metrics);
+  setup.server.setObserver(metrics);
+
+  auto cap = setup.bootstrap();
+  setup.callFoo(cap);
+  setup.callFoo(cap);
+  KJ_EXPECT_THROW(UNIMPLEMENTED, cap.barRequest().send().wait(setup.waitScope));
+
+  uint64_t interfaceId = typeId<test::TestInterface>();
+  KJ_EXPECT(metrics.getCallCount(RpcMetrics::Side::CLIENT, interfaceId, 0) == 2);
+  KJ_EXPECT(metrics.getCallCount(RpcMetrics::Side::SERVER, interfaceId, 0) == 2);
+  KJ_EXPECT(metrics.getCallCount(RpcMetrics::Side::CLIENT, interfaceId, 1) == 1);
+  KJ_EXPECT(metrics.getErrorCount(RpcMetrics::Side::CLIENT, interfaceId, 0) == 0);
+  KJ_EXPECT(metrics.getErrorCount(RpcMetrics::Side::CLIENT, interfaceId, 1) == 1);
+  KJ_EXPECT(metrics.getCallCount(RpcMetrics::Side::CLIENT, interfaceId, 2) == 0);
+
+  auto dump = metrics.dumpPrometheus();
+  KJ_EXPECT(kj::_::hasSubstring(dump, kj::str(
+      "capnp_rpc_call_duration_seconds_count{side=\"client\",interface=\"0x",
+      kj::hex(interfaceId), "\",method=\"0\"} 2\n")), dump);
+  KJ_EXPECT(kj::_::hasSubstring(dump, "# TYPE capnp_rpc_call_duration_seconds histogram\n"));
+  KJ_EXPECT(kj::_::hasSubstring(dump, "capnp_rpc_messages_total{direction=\"read\"} "));
+  KJ_EXPECT(kj::_::hasSubstring(dump, "capnp_rpc_control_messages_total{state=\"sent\"} "));
+}
+
+KJ_TEST("RpcMetrics Prometheus format") {
+  RpcMetrics metrics(1);
+
+  auto start = kj::origin<kj::TimePoint>();
+  RpcObserver::CallEvent event = { 0x1234, 5, 0, 10, start, start + 1500 * kj::NANOSECONDS };
+  metrics.questionReturned(event, RpcObserver::ReturnType::RESULTS);
+  event.time = start + 3 * kj::SECONDS;
+  metrics.questionReturned(event, RpcObserver::ReturnType::EXCEPTION);
+  event.time = start + 100 * kj::SECONDS;
+  metrics.questionReturned(event, RpcObserver::ReturnType::RESULTS);
+  metrics.messageRead(2, 7, start);
+
+  auto dump = metrics.dumpPrometheus("test");
+  kj::StringPtr labels = "side=\"client\",interface=\"0x1234\",method=\"5\"";
+  KJ_EXPECT(kj::_::hasSubstring(dump,
+      kj::str("test_call_duration_seconds_bucket{", labels, ",le=\"0.000001\"} 0\n"
+              "test_call_duration_seconds_bucket{", labels, ",le=\"0.000002\"} 1\n")), dump);
+  KJ_EXPECT(kj::_::hasSubstring(dump,
+      kj::str("test_call_duration_seconds_bucket{", labels, ",le=\"4.194304\"} 2\n"
+              "test_call_duration_seconds_bucket{", labels, ",le=\"8.388608\"} 2\n"
+              "test_call_duration_seconds_bucket{", labels, ",le=\"+Inf\"} 3\n"
+              "test_call_duration_seconds_sum{", labels, "} 103.0000015\n"
+              "test_call_duration_seconds_count{", labels, "} 3\n")), dump);
+  KJ_EXPECT(kj::_::hasSubstring(dump,
+      kj::str("test_call_errors_total{", labels, "} 1\n")), dump);
+  KJ_EXPECT(kj::_::hasSubstring(dump, "test_message_words_total{direction=\"read\"} 7\n"), dump);
+
+  // The table only has room for one method, so samples for any other method are dropped, while
+  // the tracked method keeps recording.
+  for (uint16_t i = 0; i < 16; i++) {
+    event.methodId = 100 + i;
+    metrics.questionReturned(event, RpcObserver::ReturnType::RESULTS);
+  }
+  event.methodId = 5;
+  metrics.questionReturned(event, RpcObserver::ReturnType::RESULTS);
+  dump = metrics.dumpPrometheus("test");
+  KJ_EXPECT(kj::_::hasSubstring(dump, "test_dropped_samples_total 16\n"), dump);
+  KJ_EXPECT(kj::_::hasSubstring(dump,
+      kj::str("test_call_duration_seconds_count{", labels, "} 4\n")), dump);
+  KJ_EXPECT(!kj::_::hasSubstring(dump, "method=\"100\""), dump);
+}
+
+}  // namespace
+}  // namespace _
+}  // namespace capnp
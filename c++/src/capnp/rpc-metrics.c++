@@ -0,0 +1,315 @@
+// Copyright (c) 2018 Kenton Varda and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "rpc-metrics.h"
+#include <kj/debug.h>
+#include <kj/vector.h>
+#include <atomic>
+
+namespace capnp {
+
+namespace {
+
+enum SlotState: uint {
+  EMPTY,
+  CLAIMED,   // Some thread is filling in the key.
+  READY
+};
+
+const uint64_t FIRST_BUCKET_NANOS = 1000;
+
+kj::String formatSeconds(uint64_t nanos) {
+  // Formats a duration as decimal seconds, exactly, without going through floating point.
+
+  uint64_t seconds = nanos / 1000000000;
+  uint64_t fraction = nanos % 1000000000;
+  if (fraction == 0) {
+    return kj::str(seconds);
+  }
+
+  char digits[10];
+  for (int i = 8; i >= 0; i--) {
+    digits[i] = '0' + fraction % 10;
+    fraction /= 10;
+  }
+  size_t length = 9;
+  while (digits[length - 1] == '0') --length;
+  digits[length] = '\0';
+  return kj::str(seconds, '.', kj::StringPtr(digits, length));
+}
+
+}  // namespace
+
+struct RpcMetrics::Impl {
+  struct Slot {
+    std::atomic<uint> state = { EMPTY };
+
+    Side side;
+    uint16_t methodId;
+    uint64_t interfaceId;
+    // The key. Written only while CLAIMED, read only once READY.
+
+    std::atomic<uint64_t> buckets[BUCKET_COUNT + 1] = {};
+    // Non-cumulative sample counts. The last bucket counts samples beyond the largest bound.
+
+    std::atomic<uint64_t> sumNanos = { 0 };
+    std::atomic<uint64_t> errors = { 0 };
+  };
+
+  kj::Array<Slot> slots;
+  uint mask;
+
+  uint capacity;
+  std::atomic<uint> used = { 0 };
+  // Slots claimed so far. Once `capacity` is reached, unknown methods are dropped without
+  // claiming (or searching for) an empty slot.
+
+  static constexpr uint MAX_PROBE = 16;
+  // Keys are only ever placed within MAX_PROBE slots of their hash, so neither lookups nor
+  // insertions ever scan further than that, however full the table gets.
+
+  std::atomic<uint64_t> messagesRead = { 0 };
+  std::atomic<uint64_t> wordsRead = { 0 };
+  std::atomic<uint64_t> messagesWritten = { 0 };
+  std::atomic<uint64_t> wordsWritten = { 0 };
+  std::atomic<uint64_t> droppedSamples = { 0 };
+  std::atomic<uint64_t> controlQueued = { 0 };
+  std::atomic<uint64_t> controlSent = { 0 };
+  std::atomic<uint64_t> controlBatches = { 0 };
+
+  explicit Impl(uint maxMethods): capacity(kj::max(maxMethods, 1u)) {
+    // Keep the table at most half full so probe sequences stay short.
+    uint size = 16;
+    while (size < maxMethods * 2) size <<= 1;
+    slots = kj::heapArray<Slot>(size);
+    mask = size - 1;
+  }
+
+  static uint hash(Side side, uint64_t interfaceId, uint16_t methodId) {
+    uint64_t h = (interfaceId ^ (uint64_t(methodId) << 1 | static_cast<uint>(side)))
+               * 0x9e3779b97f4a7c15ull;
+    return h >> 32;
+  }
+
+  static bool matches(const Slot& slot, Side side, uint64_t interfaceId, uint16_t methodId) {
+    return slot.interfaceId == interfaceId && slot.methodId == methodId && slot.side == side;
+  }
+
+  kj::Maybe<Slot&> findOrAdd(Side side, uint64_t interfaceId, uint16_t methodId) {
+    uint start = hash(side, interfaceId, methodId);
+    uint probeLimit = kj::min(MAX_PROBE, mask + 1);
+    for (uint i = 0; i < probeLimit; i++) {
+      Slot& slot = slots[(start + i) & mask];
+      uint state = slot.state.load(std::memory_order_acquire);
+
+      if (state == EMPTY) {
+        if (used.load(std::memory_order_relaxed) >= capacity) {
+          // Saturated. Keys are never placed past an empty slot, so this method isn't tracked.
+          return nullptr;
+        }
+        if (slot.state.compare_exchange_strong(state, CLAIMED, std::memory_order_acquire)) {
+          used.fetch_add(1, std::memory_order_relaxed);
+          slot.side = side;
+          slot.methodId = methodId;
+          slot.interfaceId = interfaceId;
+          slot.state.store(READY, std::memory_order_release);
+          return slot;
+        }
+        // Lost the race; `state` now holds the winner's state.
+      }
+
+      while (state == CLAIMED) {
+        // Another thread is writing the key. This takes a few instructions, so just spin.
+        state = slot.state.load(std::memory_order_acquire);
+      }
+
+      if (matches(slot, side, interfaceId, methodId)) {
+        return slot;
+      }
+    }
+
+    return nullptr;
+  }
+
+  kj::Maybe<const Slot&> find(Side side, uint64_t interfaceId, uint16_t methodId) const {
+    uint start = hash(side, interfaceId, methodId);
+    uint probeLimit = kj::min(MAX_PROBE, mask + 1);
+    for (uint i = 0; i < probeLimit; i++) {
+      const Slot& slot = slots[(start + i) & mask];
+      uint state = slot.state.load(std::memory_order_acquire);
+      if (state == EMPTY) break;
+      if (state == READY && matches(slot, side, interfaceId, methodId)) return slot;
+    }
+    return nullptr;
+  }
+
+  static uint64_t countOf(const Slot& slot) {
+    uint64_t total = 0;
+    for (auto& bucket: slot.buckets) {
+      total += bucket.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+};
+
+RpcMetrics::RpcMetrics(uint maxMethods): impl(kj::heap<Impl>(maxMethods)) {}
+RpcMetrics::~RpcMetrics() noexcept(false) {}
+
+void RpcMetrics::record(Side side, const CallEvent& event, ReturnType type) {
+  KJ_IF_MAYBE(slot, impl->findOrAdd(side, event.interfaceId, event.methodId)) {
+    uint64_t nanos = (event.time - event.startTime) / kj::NANOSECONDS;
+
+    uint bucket = 0;
+    uint64_t bound = FIRST_BUCKET_NANOS;
+    while (bucket < BUCKET_COUNT && nanos > bound) {
+      bound <<= 1;
+      ++bucket;
+    }
+
+    slot->buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    slot->sumNanos.fetch_add(nanos, std::memory_order_relaxed);
+    if (type == ReturnType::EXCEPTION) {
+      slot->errors.fetch_add(1, std::memory_order_relaxed);
+    }
+  } else {
+    impl->droppedSamples.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void RpcMetrics::questionReturned(const CallEvent& event, ReturnType type) {
+  record(Side::CLIENT, event, type);
+}
+
+void RpcMetrics::callReturned(const CallEvent& event, ReturnType type) {
+  record(Side::SERVER, event, type);
+}
+
+void RpcMetrics::messageRead(uint16_t type, size_t sizeInWords, kj::TimePoint time) {
+  impl->messagesRead.fetch_add(1, std::memory_order_relaxed);
+  impl->wordsRead.fetch_add(sizeInWords, std::memory_order_relaxed);
+}
+
+void RpcMetrics::messageWritten(uint16_t type, size_t sizeInWords, kj::TimePoint time) {
+  impl->messagesWritten.fetch_add(1, std::memory_order_relaxed);
+  impl->wordsWritten.fetch_add(sizeInWords, std::memory_order_relaxed);
+}
+
+void RpcMetrics::controlMessagesFlushed(size_t queued, size_t sent) {
+  impl->controlQueued.fetch_add(queued, std::memory_order_relaxed);
+  impl->controlSent.fetch_add(sent, std::memory_order_relaxed);
+  impl->controlBatches.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t RpcMetrics::getCallCount(Side side, uint64_t interfaceId, uint16_t methodId) const {
+  KJ_IF_MAYBE(slot, impl->find(side, interfaceId, methodId)) {
+    return Impl::countOf(*slot);
+  } else {
+    return 0;
+  }
+}
+
+uint64_t RpcMetrics::getErrorCount(Side side, uint64_t interfaceId, uint16_t methodId) const {
+  KJ_IF_MAYBE(slot, impl->find(side, interfaceId, methodId)) {
+    return slot->errors.load(std::memory_order_relaxed);
+  } else {
+    return 0;
+  }
+}
+
+kj::String RpcMetrics::dumpPrometheus(kj::StringPtr prefix) const {
+  kj::Vector<kj::String> lines;
+
+  auto labelsFor = [](const Impl::Slot& slot) {
+    return kj::str("side=\"", slot.side == Side::CLIENT ? "client" : "server",
+                   "\",interface=\"0x", kj::hex(slot.interfaceId),
+                   "\",method=\"", slot.methodId, '"');
+  };
+
+  lines.add(kj::str("# HELP ", prefix, "_call_duration_seconds Time from sending (client) or "
+                    "receiving (server) a call to its return."));
+  lines.add(kj::str("# TYPE ", prefix, "_call_duration_seconds histogram"));
+  for (auto& slot: impl->slots) {
+    if (slot.state.load(std::memory_order_acquire) != READY) continue;
+    auto labels = labelsFor(slot);
+
+    uint64_t cumulative = 0;
+    uint64_t bound = FIRST_BUCKET_NANOS;
+    for (uint i = 0; i < BUCKET_COUNT; i++, bound <<= 1) {
+      cumulative += slot.buckets[i].load(std::memory_order_relaxed);
+      lines.add(kj::str(prefix, "_call_duration_seconds_bucket{", labels,
+                        ",le=\"", formatSeconds(bound), "\"} ", cumulative));
+    }
+    cumulative += slot.buckets[BUCKET_COUNT].load(std::memory_order_relaxed);
+    lines.add(kj::str(prefix, "_call_duration_seconds_bucket{", labels, ",le=\"+Inf\"} ",
+                      cumulative));
+    lines.add(kj::str(prefix, "_call_duration_seconds_sum{", labels, "} ",
+                      formatSeconds(slot.sumNanos.load(std::memory_order_relaxed))));
+    lines.add(kj::str(prefix, "_call_duration_seconds_count{", labels, "} ", cumulative));
+  }
+
+  lines.add(kj::str("# HELP ", prefix, "_call_errors_total Calls which returned an exception."));
+  lines.add(kj::str("# TYPE ", prefix, "_call_errors_total counter"));
+  for (auto& slot: impl->slots) {
+    if (slot.state.load(std::memory_order_acquire) != READY) continue;
+    lines.add(kj::str(prefix, "_call_errors_total{", labelsFor(slot), "} ",
+                      slot.errors.load(std::memory_order_relaxed)));
+  }
+
+  lines.add(kj::str("# HELP ", prefix, "_messages_total RPC messages transferred."));
+  lines.add(kj::str("# TYPE ", prefix, "_messages_total counter"));
+  lines.add(kj::str(prefix, "_messages_total{direction=\"read\"} ",
+                    impl->messagesRead.load(std::memory_order_relaxed)));
+  lines.add(kj::str(prefix, "_messages_total{direction=\"written\"} ",
+                    impl->messagesWritten.load(std::memory_order_relaxed)));
+
+  lines.add(kj::str("# HELP ", prefix, "_message_words_total Size of RPC messages transferred, "
+                    "in 8-byte words."));
+  lines.add(kj::str("# TYPE ", prefix, "_message_words_total counter"));
+  lines.add(kj::str(prefix, "_message_words_total{direction=\"read\"} ",
+                    impl->wordsRead.load(std::memory_order_relaxed)));
+  lines.add(kj::str(prefix, "_message_words_total{direction=\"written\"} ",
+                    impl->wordsWritten.load(std::memory_order_relaxed)));
+
+  lines.add(kj::str("# HELP ", prefix, "_control_messages_total Finish and Release messages "
+                    "requested (queued) and actually written after merging (sent)."));
+  lines.add(kj::str("# TYPE ", prefix, "_control_messages_total counter"));
+  lines.add(kj::str(prefix, "_control_messages_total{state=\"queued\"} ",
+                    impl->controlQueued.load(std::memory_order_relaxed)));
+  lines.add(kj::str(prefix, "_control_messages_total{state=\"sent\"} ",
+                    impl->controlSent.load(std::memory_order_relaxed)));
+
+  lines.add(kj::str("# HELP ", prefix, "_control_batches_total Batches in which queued Finish and "
+                    "Release messages were sent together."));
+  lines.add(kj::str("# TYPE ", prefix, "_control_batches_total counter"));
+  lines.add(kj::str(prefix, "_control_batches_total ",
+                    impl->controlBatches.load(std::memory_order_relaxed)));
+
+  lines.add(kj::str("# HELP ", prefix, "_dropped_samples_total Call latencies not recorded "
+                    "because the method table was full."));
+  lines.add(kj::str("# TYPE ", prefix, "_dropped_samples_total counter"));
+  lines.add(kj::str(prefix, "_dropped_samples_total ",
+                    impl->droppedSamples.load(std::memory_order_relaxed)));
+
+  lines.add(nullptr);  // trailing newline
+  return kj::strArray(lines, "\n");
+}
+
+}  // namespace capnp
@@ -0,0 +1,88 @@
+// Copyright (c) 2018 Kenton Varda and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#if defined(__GNUC__) && !defined(CAPNP_HEADER_WARNINGS)
+#pragma GCC system_header
+#endif
+
+#include "rpc.h"
+
+namespace capnp {
+
+class RpcMetrics final: public RpcObserver {
+  // An `RpcObserver` which keeps a latency histogram for every method called through the
+  // RpcSystem(s) it is installed on, separately for calls we made (client side) and calls we
+  // served (server side), counts messages and words in each direction, and counts how many
+  // `Finish`/`Release` messages were saved by batching them. The collected statistics can be
+  // dumped in the Prometheus text exposition format.
+  //
+  // Recording is lock-free and allocation-free, so a single `RpcMetrics` may be shared by
+  // RpcSystems running on different threads, and may be dumped from any thread while they run.
+  // Methods are assigned histograms on first use from a fixed-size table; once it is full, samples
+  // for new methods are dropped (and counted as such).
+  //
+  //     RpcMetrics metrics;
+  //     rpcSystem.setObserver(metrics);
+  //     ...
+  //     httpResponse.send(metrics.dumpPrometheus());
+
+public:
+  explicit RpcMetrics(uint maxMethods = 1024);
+  // `maxMethods` bounds the number of distinct (side, interface, method) combinations tracked.
+
+  ~RpcMetrics() noexcept(false);
+  KJ_DISALLOW_COPY(RpcMetrics);
+
+  enum class Side: uint8_t {
+    CLIENT,
+    SERVER
+  };
+
+  static constexpr uint BUCKET_COUNT = 24;
+  // Latency buckets are powers of two microseconds, from 1us to about 8s, plus a final bucket
+  // for everything slower.
+
+  uint64_t getCallCount(Side side, uint64_t interfaceId, uint16_t methodId) const;
+  uint64_t getErrorCount(Side side, uint64_t interfaceId, uint16_t methodId) const;
+  // Number of returned calls (of which, respectively, the number returning exceptions) to the
+  // given method so far.
+
+  kj::String dumpPrometheus(kj::StringPtr prefix = "capnp_rpc") const;
+  // Render all statistics in Prometheus text format, with metric names starting with `prefix`.
+
+  // implements RpcObserver ----------------------------------------------------
+
+  void questionReturned(const CallEvent& event, ReturnType type) override;
+  void callReturned(const CallEvent& event, ReturnType type) override;
+  void messageRead(uint16_t type, size_t sizeInWords, kj::TimePoint time) override;
+  void messageWritten(uint16_t type, size_t sizeInWords, kj::TimePoint time) override;
+  void controlMessagesFlushed(size_t queued, size_t sent) override;
+
+private:
+  struct Impl;
+  kj::Own<Impl> impl;
+
+  void record(Side side, const CallEvent& event, ReturnType type);
+};
+
+}  // namespace capnp
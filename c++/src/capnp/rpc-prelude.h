@@ -31,10 +31,14 @@
 #include "capability.h"
 #include "persistent.capnp.h"
 
+namespace kj { class Timer; }
+
 namespace capnp {
 
 class OutgoingRpcMessage;
 class IncomingRpcMessage;
+class RpcObserver;
+struct RpcConnectionStats;
 
 template <typename SturdyRefHostId>
 class RpcSystem;
@@ -58,7 +62,16 @@ public:
     virtual kj::Own<OutgoingRpcMessage> newOutgoingMessage(uint firstSegmentWordSize) = 0;
     virtual kj::Promise<kj::Maybe<kj::Own<IncomingRpcMessage>>> receiveIncomingMessage() = 0;
     virtual kj::Promise<void> shutdown() = 0;
+    virtual size_t getBufferedBytes() = 0;
+    virtual void trimBuffers() = 0;
     virtual AnyStruct::Reader baseGetPeerVatId() = 0;
+    virtual bool baseCanIntroduceTo(Connection& other) = 0;
+    virtual void baseIntroduceTo(Connection& other, AnyPointer::Builder otherContactInfo,
+                                 AnyPointer::Builder thisContactInfo) = 0;
+    virtual kj::Maybe<ConnectionAndProvisionId> baseConnectToIntroduced(
+        AnyPointer::Reader capId) = 0;
+    virtual kj::Maybe<kj::String> baseGetProvideKey(AnyPointer::Reader recipientId) = 0;
+    virtual kj::Maybe<kj::String> baseGetAcceptKey(AnyPointer::Reader provisionId) = 0;
   };
   virtual kj::Maybe<kj::Own<Connection>> baseConnect(AnyStruct::Reader vatId) = 0;
   virtual kj::Promise<kj::Own<Connection>> baseAccept() = 0;
@@ -93,7 +106,11 @@ private:
 
   Capability::Client baseBootstrap(AnyStruct::Reader vatId);
   Capability::Client baseRestore(AnyStruct::Reader vatId, AnyPointer::Reader objectId);
+  void baseSetObserver(kj::Maybe<RpcObserver&> observer);
+  void baseSetTimer(kj::Maybe<kj::Timer&> timer);
   void baseSetFlowLimit(size_t words);
+  kj::Array<RpcConnectionStats> baseGetConnectionStats(size_t limit);
+  size_t baseTrimIdleConnections();
 
   template <typename>
   friend class capnp::RpcSystem;
@@ -198,7 +198,7 @@ typedef VatNetwork<
 
 class TestNetworkAdapter final: public TestNetworkAdapterBase {
 public:
-  TestNetworkAdapter(TestNetwork& network): network(network) {}
+  TestNetworkAdapter(TestNetwork& network, kj::StringPtr name): network(network), name(name) {}
 
   ~TestNetworkAdapter() {
     kj::Exception exception = KJ_EXCEPTION(FAILED, "Network was destroyed.");
@@ -210,13 +210,18 @@ public:
   uint getSentCount() { return sent; }
   uint getReceivedCount() { return received; }
 
+  void setIntroductionsEnabled(bool enabled) { introductionsEnabled = enabled; }
+  // If disabled, this vat refuses to connect to vats it is introduced to, so capabilities passed
+  // to it from a third vat are used through the introducer.
+
   typedef TestNetworkAdapterBase::Connection Connection;
 
   class ConnectionImpl final
       : public Connection, public kj::Refcounted, public kj::TaskSet::ErrorHandler {
   public:
-    ConnectionImpl(TestNetworkAdapter& network, RpcDumper::Sender sender)
-        : network(network), sender(sender), tasks(kj::heap<kj::TaskSet>(*this)) {}
+    ConnectionImpl(TestNetworkAdapter& network, TestNetworkAdapter& peer,
+                   RpcDumper::Sender sender)
+        : network(network), peer(peer), sender(sender), tasks(kj::heap<kj::TaskSet>(*this)) {}
 
     void attach(ConnectionImpl& other) {
       KJ_REQUIRE(partner == nullptr);
@@ -335,12 +340,57 @@ public:
       }
     }
 
+    bool canIntroduceTo(Connection& other) override {
+      return true;
+    }
+
+    void introduceTo(Connection& other,
+                     test::TestThirdPartyCapId::Builder otherContactInfo,
+                     test::TestRecipientId::Builder thisContactInfo) override {
+      uint64_t nonce = ++network.introductionCount;
+      otherContactInfo.setHost(peer.name);
+      otherContactInfo.setNonce(nonce);
+      thisContactInfo.setRecipient(kj::downcast<ConnectionImpl>(other).peer.name);
+      thisContactInfo.setNonce(nonce);
+    }
+
+    kj::Maybe<ConnectionAndProvisionId> connectToIntroduced(
+        test::TestThirdPartyCapId::Reader capId) override {
+      if (!network.introductionsEnabled) {
+        return nullptr;
+      }
+
+      MallocMessageBuilder hostIdMessage(16);
+      auto hostId = hostIdMessage.initRoot<test::TestSturdyRefHostId>();
+      hostId.setHost(capId.getHost());
+      auto connection = KJ_ASSERT_NONNULL(network.connect(hostId));
+
+      auto firstMessage = connection->newOutgoingMessage(0);
+      auto provisionId = Orphanage::getForMessageContaining(firstMessage->getBody())
+          .newOrphan<test::TestProvisionId>();
+      provisionId.get().setIntroducer(peer.name);
+      provisionId.get().setNonce(capId.getNonce());
+
+      return ConnectionAndProvisionId {
+        kj::mv(connection), kj::mv(firstMessage), kj::mv(provisionId)
+      };
+    }
+
+    kj::Maybe<kj::String> getProvideKey(test::TestRecipientId::Reader recipientId) override {
+      return kj::str(peer.name, '/', recipientId.getRecipient(), '/', recipientId.getNonce());
+    }
+
+    kj::Maybe<kj::String> getAcceptKey(test::TestProvisionId::Reader provisionId) override {
+      return kj::str(provisionId.getIntroducer(), '/', peer.name, '/', provisionId.getNonce());
+    }
+
     void taskFailed(kj::Exception&& exception) override {
       ADD_FAILURE() << kj::str(exception).cStr();
     }
 
   private:
     TestNetworkAdapter& network;
+    TestNetworkAdapter& peer;
     RpcDumper::Sender sender KJ_UNUSED_MEMBER;
     kj::Maybe<ConnectionImpl&> partner;
 
@@ -358,8 +408,8 @@ public:
 
     auto iter = connections.find(&dst);
     if (iter == connections.end()) {
-      auto local = kj::refcounted<ConnectionImpl>(*this, RpcDumper::CLIENT);
-      auto remote = kj::refcounted<ConnectionImpl>(dst, RpcDumper::SERVER);
+      auto local = kj::refcounted<ConnectionImpl>(*this, dst, RpcDumper::CLIENT);
+      auto remote = kj::refcounted<ConnectionImpl>(dst, *this, RpcDumper::SERVER);
       local->attach(*remote);
 
       connections[&dst] = kj::addRef(*local);
@@ -392,8 +442,11 @@ public:
 
 private:
   TestNetwork& network;
+  kj::StringPtr name;
   uint sent = 0;
   uint received = 0;
+  uint64_t introductionCount = 0;
+  bool introductionsEnabled = true;
 
   std::map<const TestNetworkAdapter*, kj::Own<ConnectionImpl>> connections;
   std::queue<kj::Own<kj::PromiseFulfiller<kj::Own<Connection>>>> fulfillerQueue;
@@ -403,7 +456,7 @@ private:
 TestNetwork::~TestNetwork() noexcept(false) {}
 
 TestNetworkAdapter& TestNetwork::add(kj::StringPtr name) {
-  return *(map[name] = kj::heap<TestNetworkAdapter>(*this));
+  return *(map[name] = kj::heap<TestNetworkAdapter>(*this, name));
 }
 
 // =======================================================================================
@@ -753,7 +806,9 @@ TEST(Rpc, RetainAndRelease) {
       auto capCopy = client.getHeldRequest().send().wait(context.waitScope).getCap();
 
       {
-        // And call it, without any network communications.
+        // And call it, without any network communications. (First let the deferred `Finish` for
+        // getHeld() go out.)
+        kj::evalLater([]() {}).wait(context.waitScope);
         uint oldSentCount = context.clientNetwork.getSentCount();
         auto request = capCopy.fooRequest();
         request.setI(123);
@@ -1256,6 +1311,102 @@ TEST(Rpc, RealmGatewayImportExport) {
   EXPECT_EQ("foo", response.getSturdyRef());
 }
 
+class CallCountingObserver final: public RpcObserver {
+public:
+  uint callsReceived = 0;
+
+  void callReceived(const CallEvent& event) override {
+    ++callsReceived;
+  }
+};
+
+struct ThreeVatContext {
+  // Alice holds a capability hosted by Carol and passes it to Bob.
+
+  kj::EventLoop loop;
+  kj::WaitScope waitScope;
+  TestNetwork network;
+  int carolCallCount = 0;
+  int bobCallCount = 0;
+  int bobHandleCount = 0;
+  TestNetworkAdapter& aliceNetwork;
+  TestNetworkAdapter& bobNetwork;
+  TestNetworkAdapter& carolNetwork;
+  RpcSystem<test::TestSturdyRefHostId> alice;
+  RpcSystem<test::TestSturdyRefHostId> bob;
+  RpcSystem<test::TestSturdyRefHostId> carol;
+  CallCountingObserver aliceObserver;
+
+  ThreeVatContext()
+      : waitScope(loop),
+        aliceNetwork(network.add("alice")),
+        bobNetwork(network.add("bob")),
+        carolNetwork(network.add("carol")),
+        alice(makeRpcClient(aliceNetwork)),
+        bob(makeRpcServer(bobNetwork, test::TestMoreStuff::Client(
+            kj::heap<TestMoreStuffImpl>(bobCallCount, bobHandleCount)))),
+        carol(makeRpcServer(carolNetwork, test::TestInterface::Client(
+            kj::heap<TestInterfaceImpl>(carolCallCount)))) {
+    alice.setObserver(aliceObserver);
+  }
+
+  Capability::Client bootstrap(kj::StringPtr host) {
+    MallocMessageBuilder message(16);
+    auto hostId = message.initRoot<test::TestSturdyRefHostId>();
+    hostId.setHost(host);
+    return alice.bootstrap(hostId);
+  }
+
+  test::TestMoreStuff::Client giveCarolToBob() {
+    auto carolCap = bootstrap("carol").castAs<test::TestInterface>();
+    auto bobCap = bootstrap("bob").castAs<test::TestMoreStuff>();
+
+    // Only settled capabilities are handed off.
+    carolCap.whenResolved().wait(waitScope);
+
+    auto request = bobCap.holdRequest();
+    request.setCap(carolCap);
+    request.send().wait(waitScope);
+    return bobCap;
+  }
+};
+
+TEST(Rpc, ThirdPartyHandoff) {
+  ThreeVatContext context;
+  auto bobCap = context.giveCarolToBob();
+
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ("bar", bobCap.callHeldRequest().send().wait(context.waitScope).getS());
+  }
+  EXPECT_EQ(3, context.carolCallCount);
+
+  // Bob called Carol directly, not through Alice.
+  EXPECT_EQ(0, context.aliceObserver.callsReceived);
+
+  // Passing the capability back hands it off again, this time over an existing connection.
+  auto held = bobCap.getHeldRequest().send().wait(context.waitScope).getCap();
+  auto request = held.castAs<test::TestInterface>().fooRequest();
+  request.setI(123);
+  request.setJ(true);
+  EXPECT_EQ("foo", request.send().wait(context.waitScope).getX());
+  EXPECT_EQ(4, context.carolCallCount);
+  EXPECT_EQ(0, context.aliceObserver.callsReceived);
+}
+
+TEST(Rpc, ThirdPartyHandoffFallsBackToVine) {
+  ThreeVatContext context;
+  context.bobNetwork.setIntroductionsEnabled(false);
+  auto bobCap = context.giveCarolToBob();
+
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ("bar", bobCap.callHeldRequest().send().wait(context.waitScope).getS());
+  }
+  EXPECT_EQ(3, context.carolCallCount);
+
+  // Bob couldn't connect to Carol, so his calls were proxied by Alice.
+  EXPECT_EQ(3, context.aliceObserver.callsReceived);
+}
+
 }  // namespace
 }  // namespace _ (private)
 }  // namespace capnp
@@ -22,12 +22,17 @@
 #define CAPNP_TESTING_CAPNP 1
 
 #include "rpc-twoparty.h"
+#include "serialize-async.h"
 #include "test-util.h"
 #include <capnp/rpc.capnp.h>
 #include <kj/debug.h>
 #include <kj/thread.h>
 #include <kj/compat/gtest.h>
 
+#if !_WIN32
+#include <unistd.h>
+#endif
+
 // TODO(cleanup): Auto-generate stringification functions for union discriminants.
 namespace capnp {
 namespace rpc {
@@ -69,12 +74,13 @@ private:
   int& handleCount;
 };
 
-kj::AsyncIoProvider::PipeThread runServer(kj::AsyncIoProvider& ioProvider,
-                                          int& callCount, int& handleCount) {
+kj::AsyncIoProvider::PipeThread runServer(
+    kj::AsyncIoProvider& ioProvider, int& callCount, int& handleCount,
+    TwoPartyVatNetwork::Compression compression = TwoPartyVatNetwork::Compression::NONE) {
   return ioProvider.newPipeThread(
-      [&callCount, &handleCount](
+      [&callCount, &handleCount, compression](
        kj::AsyncIoProvider& ioProvider, kj::AsyncIoStream& stream, kj::WaitScope& waitScope) {
-    TwoPartyVatNetwork network(stream, rpc::twoparty::Side::SERVER);
+    TwoPartyVatNetwork network(stream, rpc::twoparty::Side::SERVER, ReaderOptions(), compression);
     TestRestorer restorer(callCount, handleCount);
     auto server = makeRpcServer(network, restorer);
     network.onDisconnect().wait(waitScope);
@@ -278,6 +284,76 @@ TEST(TwoPartyNetwork, Release) {
   EXPECT_EQ(0, handleCount);
 }
 
+class DisembargoCounter final: public RpcObserver {
+public:
+  uint disembargoesWritten = 0;
+  size_t controlSent = 0;
+
+  void messageWritten(uint16_t type, size_t sizeInWords, kj::TimePoint time) override {
+    if (type == rpc::Message::DISEMBARGO) ++disembargoesWritten;
+  }
+  void controlMessagesFlushed(size_t queued, size_t sent) override {
+    controlSent += sent;
+  }
+};
+
+TEST(TwoPartyNetwork, DisembargoOnlyWhenNeeded) {
+  // A Disembargo is only sent when calls through the peer may still be in flight.
+
+  auto ioContext = kj::setupAsyncIo();
+  auto pipe = ioContext.provider->newTwoWayPipe();
+  int callCount = 0;
+  int handleCount = 0;
+
+  TwoPartyVatNetwork serverNetwork(*pipe.ends[0], rpc::twoparty::Side::SERVER);
+  TwoPartyVatNetwork clientNetwork(*pipe.ends[1], rpc::twoparty::Side::CLIENT);
+  auto rpcServer = makeRpcServer(serverNetwork,
+      kj::heap<TestMoreStuffImpl>(callCount, handleCount));
+  auto rpcClient = makeRpcClient(clientNetwork);
+  DisembargoCounter observer;
+  rpcClient.setObserver(observer);
+
+  MallocMessageBuilder vatIdMessage(8);
+  vatIdMessage.initRoot<rpc::twoparty::VatId>().setSide(rpc::twoparty::Side::SERVER);
+  auto client = rpcClient.bootstrap(vatIdMessage.getRoot<rpc::twoparty::VatId>())
+      .castAs<test::TestMoreStuff>();
+  test::TestCallOrder::Client local = kj::heap<TestCallOrderImpl>();
+
+  auto echo = [&]() {
+    auto request = client.echoRequest();
+    request.setCap(local);
+    return request.send();
+  };
+  auto getCallSequence = [](test::TestCallOrder::Client& cap, uint expected) {
+    auto request = cap.getCallSequenceRequest();
+    request.setExpected(expected);
+    return request.send();
+  };
+
+  // The pipelined cap resolves back to our local object, but nothing was sent through the peer.
+  {
+    auto promise = echo();
+    auto pipeline = promise.getCap();
+    promise.wait(ioContext.waitScope);
+    EXPECT_EQ(0, getCallSequence(pipeline, 0).wait(ioContext.waitScope).getN());
+    EXPECT_EQ(0, observer.disembargoesWritten);
+  }
+
+  // A call through the peer is still outstanding when the cap resolves, so an embargo is needed.
+  // The Disembargo goes out with the turn's control messages.
+  {
+    auto promise = echo();
+    auto pipeline = promise.getCap();
+    auto call = getCallSequence(pipeline, 1);
+    size_t controlSent = observer.controlSent;
+    promise.wait(ioContext.waitScope);
+    EXPECT_EQ(2, getCallSequence(pipeline, 2).wait(ioContext.waitScope).getN());
+    EXPECT_EQ(1, call.wait(ioContext.waitScope).getN());
+    EXPECT_EQ(1, observer.disembargoesWritten);
+    EXPECT_GT(observer.controlSent, controlSent);
+  }
+}
+
 TEST(TwoPartyNetwork, Abort) {
   // Verify that aborts are received.
 
@@ -309,6 +385,135 @@ TEST(TwoPartyNetwork, Abort) {
   EXPECT_TRUE(conn->receiveIncomingMessage().wait(ioContext.waitScope) == nullptr);
 }
 
+TEST(TwoPartyNetwork, ExternalDataZeroCopy) {
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+  auto pipe = kj::newTwoWayPipe();
+  TwoPartyVatNetwork clientNetwork(*pipe.ends[0], rpc::twoparty::Side::CLIENT);
+  TwoPartyVatNetwork serverNetwork(*pipe.ends[1], rpc::twoparty::Side::SERVER);
+
+  MallocMessageBuilder refMessage(128);
+  auto hostId = refMessage.initRoot<rpc::twoparty::VatId>();
+  hostId.setSide(rpc::twoparty::Side::SERVER);
+  auto clientConn = KJ_ASSERT_NONNULL(clientNetwork.connect(hostId));
+  auto serverConn = serverNetwork.accept().wait(waitScope);
+
+  {
+    // The blob is owned by the message, so it's fine to drop the message before it's written.
+    auto msg = clientConn->newOutgoingMessage(128);
+    auto body = msg->getBody();
+    auto blob = kj::heapArray<byte>(1 << 20);
+    memset(blob.begin(), 'x', blob.size());
+    body.initAs<test::TestAllTypes>().adoptDataField(
+        Orphanage::getForMessageContaining(body).referenceExternalData(
+            kj::Array<const byte>(kj::mv(blob))));
+    msg->send();
+  }
+
+  auto incoming = KJ_ASSERT_NONNULL(serverConn->receiveIncomingMessage().wait(waitScope));
+  auto data = incoming->getBody().getAs<test::TestAllTypes>().getDataField();
+  ASSERT_EQ(1u << 20, data.size());
+
+  // The receiver can keep the blob after dropping the message.
+  auto shared = KJ_ASSERT_NONNULL(incoming->shareData(data));
+  EXPECT_EQ(data.begin(), shared.begin());
+  incoming = nullptr;
+  EXPECT_EQ('x', shared[0]);
+  EXPECT_EQ('x', shared[shared.size() - 1]);
+}
+
+#if !_WIN32
+class TestFdCap final: public test::TestInterface::Server {
+public:
+  TestFdCap(kj::AutoCloseFd fd): fd(kj::mv(fd)) {}
+
+  kj::Maybe<int> getFd() override { return fd.get(); }
+
+  kj::Promise<void> foo(FooContext context) override {
+    context.getResults().setX("foo");
+    return kj::READY_NOW;
+  }
+
+private:
+  kj::AutoCloseFd fd;
+};
+
+TEST(TwoPartyNetwork, FdPassing) {
+  auto ioContext = kj::setupAsyncIo();
+
+  int pipeFds[2];
+  KJ_SYSCALL(pipe(pipeFds));
+  kj::AutoCloseFd in(pipeFds[0]);
+  kj::AutoCloseFd out(pipeFds[1]);
+
+  TwoPartyServer server(kj::heap<TestFdCap>(kj::mv(out)));
+
+  auto pipe = ioContext.provider->newCapabilityPipe();
+  server.accept(kj::mv(pipe.ends[0]), 2);
+  TwoPartyClient client(*pipe.ends[1], 2);
+  auto cap = client.bootstrap().castAs<test::TestInterface>();
+
+  auto request = cap.fooRequest();
+  EXPECT_EQ("foo", request.send().wait(ioContext.waitScope).getX());
+
+  // The bootstrap capability arrived with a duplicate of the server's end of the pipe.
+  int fd = KJ_ASSERT_NONNULL(cap.getFd().wait(ioContext.waitScope));
+  KJ_SYSCALL(write(fd, "bar", 3));
+  char buffer[4] = {};
+  KJ_SYSCALL(read(in, buffer, 3));
+  EXPECT_STREQ("bar", buffer);
+
+  // A client which doesn't accept FDs sees none, but can still use the capability.
+  auto pipe2 = ioContext.provider->newCapabilityPipe();
+  server.accept(kj::mv(pipe2.ends[0]), 2);
+  TwoPartyClient client2(*pipe2.ends[1]);
+  auto cap2 = client2.bootstrap().castAs<test::TestInterface>();
+  EXPECT_TRUE(cap2.getFd().wait(ioContext.waitScope) == nullptr);
+  EXPECT_EQ("foo", cap2.fooRequest().send().wait(ioContext.waitScope).getX());
+}
+
+TEST(TwoPartyNetwork, FdsOutliveSender) {
+  auto ioContext = kj::setupAsyncIo();
+  auto capPipe = ioContext.provider->newCapabilityPipe();
+  TwoPartyVatNetwork clientNetwork(*capPipe.ends[0], 1, rpc::twoparty::Side::CLIENT);
+  TwoPartyVatNetwork serverNetwork(*capPipe.ends[1], 1, rpc::twoparty::Side::SERVER);
+
+  MallocMessageBuilder refMessage(128);
+  auto hostId = refMessage.initRoot<rpc::twoparty::VatId>();
+  hostId.setSide(rpc::twoparty::Side::SERVER);
+  auto clientConn = KJ_ASSERT_NONNULL(clientNetwork.connect(hostId));
+  auto serverConn = serverNetwork.accept().wait(ioContext.waitScope);
+
+  int pipeFds[2];
+  KJ_SYSCALL(pipe(pipeFds));
+  kj::AutoCloseFd in(pipeFds[0]);
+
+  // The first message occupies the stream, so the second is queued, and the sender closes its
+  // descriptor before the second is written.
+  {
+    auto msg = clientConn->newOutgoingMessage(16);
+    msg->getBody().initAs<test::TestAllTypes>();
+    msg->send();
+  }
+  {
+    auto msg = clientConn->newOutgoingMessage(16);
+    msg->getBody().initAs<test::TestAllTypes>();
+    msg->setFds(kj::heapArray<int>({ pipeFds[1] }));
+    msg->send();
+  }
+  KJ_SYSCALL(close(pipeFds[1]));
+  KJ_ASSERT_NONNULL(serverConn->receiveIncomingMessage().wait(ioContext.waitScope));
+  auto incoming = KJ_ASSERT_NONNULL(
+      serverConn->receiveIncomingMessage().wait(ioContext.waitScope));
+  auto fds = incoming->getAttachedFds();
+  ASSERT_EQ(1u, fds.size());
+  KJ_SYSCALL(write(fds[0], "baz", 3));
+  char buffer[4] = {};
+  KJ_SYSCALL(read(in, buffer, 3));
+  EXPECT_STREQ("baz", buffer);
+}
+#endif
+
 TEST(TwoPartyNetwork, ConvenienceClasses) {
   auto ioContext = kj::setupAsyncIo();
 
@@ -337,6 +542,153 @@ TEST(TwoPartyNetwork, ConvenienceClasses) {
   EXPECT_EQ(1, callCount);
 }
 
+TEST(TwoPartyNetwork, ClientPool) {
+  auto ioContext = kj::setupAsyncIo();
+  auto& network = ioContext.provider->getNetwork();
+
+  int callCounts[2] = {0, 0};
+  kj::Own<TwoPartyServer> servers[2];
+  kj::Own<kj::ConnectionReceiver> listeners[2];
+  kj::Promise<void> listenPromises[2] = {nullptr, nullptr};
+  auto addresses = kj::heapArrayBuilder<kj::Own<kj::NetworkAddress>>(2);
+  for (uint i = 0; i < 2; i++) {
+    servers[i] = kj::heap<TwoPartyServer>(kj::heap<TestInterfaceImpl>(callCounts[i]));
+    listeners[i] = network.parseAddress("127.0.0.1").wait(ioContext.waitScope)->listen();
+    listenPromises[i] = servers[i]->listen(*listeners[i]);
+    addresses.add(network.parseAddress("127.0.0.1", listeners[i]->getPort())
+        .wait(ioContext.waitScope));
+  }
+
+  TwoPartyClientPool pool(ioContext.provider->getTimer(), addresses.finish());
+  auto cap = pool.bootstrap().castAs<test::TestInterface>();
+
+  kj::Vector<RemotePromise<test::TestInterface::FooResults>> promises;
+  for (uint i = 0; i < 10; i++) {
+    auto request = cap.fooRequest();
+    request.setI(123);
+    request.setJ(true);
+    promises.add(request.send());
+  }
+  for (auto& promise: promises) {
+    EXPECT_EQ("foo", promise.wait(ioContext.waitScope).getX());
+  }
+
+  // Each call went to the server with the fewest outstanding, so they alternated.
+  EXPECT_EQ(5, callCounts[0]);
+  EXPECT_EQ(5, callCounts[1]);
+
+  auto stats = pool.getStats();
+  ASSERT_EQ(2u, stats.size());
+  for (auto& backend: stats) {
+    EXPECT_TRUE(backend.connected);
+    EXPECT_EQ(0u, backend.inFlight);
+    EXPECT_EQ(5u, backend.calls);
+    EXPECT_EQ(0u, backend.failures);
+    EXPECT_EQ(1u, backend.connects);
+    EXPECT_TRUE(backend.latency > 0 * kj::NANOSECONDS);
+  }
+}
+
+TEST(TwoPartyNetwork, ClientPoolReconnects) {
+  auto ioContext = kj::setupAsyncIo();
+  auto& network = ioContext.provider->getNetwork();
+  auto& timer = ioContext.provider->getTimer();
+
+  int callCount = 0;
+  auto server = kj::heap<TwoPartyServer>(kj::heap<TestInterfaceImpl>(callCount));
+  auto listener = network.parseAddress("127.0.0.1").wait(ioContext.waitScope)->listen();
+  auto listenPromise = server->listen(*listener);
+
+  auto addresses = kj::heapArrayBuilder<kj::Own<kj::NetworkAddress>>(1);
+  addresses.add(network.parseAddress("127.0.0.1", listener->getPort())
+      .wait(ioContext.waitScope));
+  TwoPartyClientPool pool(timer, addresses.finish(),
+                          TwoPartyClientPool::Policy::POWER_OF_TWO_CHOICES,
+                          10 * kj::MILLISECONDS);
+  auto cap = pool.bootstrap().castAs<test::TestInterface>();
+
+  auto callFoo = [&]() {
+    auto request = cap.fooRequest();
+    request.setI(123);
+    request.setJ(true);
+    EXPECT_EQ("foo", request.send().wait(ioContext.waitScope).getX());
+  };
+
+  callFoo();
+  EXPECT_EQ(1, callCount);
+
+  // Restart the server, dropping the connection.
+  listenPromise = nullptr;
+  server = kj::heap<TwoPartyServer>(kj::heap<TestInterfaceImpl>(callCount));
+  listenPromise = server->listen(*listener);
+
+  for (uint i = 0; i < 1000; i++) {
+    auto stats = pool.getStats();
+    if (stats[0].connects == 2 && stats[0].connected) break;
+    timer.afterDelay(1 * kj::MILLISECONDS).wait(ioContext.waitScope);
+  }
+
+  // The same capability now reaches the new server's bootstrap interface.
+  callFoo();
+  EXPECT_EQ(2, callCount);
+
+  auto stats = pool.getStats();
+  EXPECT_TRUE(stats[0].connected);
+  EXPECT_EQ(2u, stats[0].connects);
+  EXPECT_EQ(2u, stats[0].calls);
+}
+
+class FailingInterfaceImpl final: public test::TestInterface::Server {
+public:
+  kj::Promise<void> foo(FooContext context) override {
+    return KJ_EXCEPTION(FAILED, "always fails");
+  }
+};
+
+TEST(TwoPartyNetwork, ClientPoolAvoidsFailingServer) {
+  auto ioContext = kj::setupAsyncIo();
+  auto& network = ioContext.provider->getNetwork();
+
+  int callCount = 0;
+  kj::Own<TwoPartyServer> servers[2] = {
+    kj::heap<TwoPartyServer>(kj::heap<TestInterfaceImpl>(callCount)),
+    kj::heap<TwoPartyServer>(kj::heap<FailingInterfaceImpl>())
+  };
+  kj::Own<kj::ConnectionReceiver> listeners[2];
+  kj::Promise<void> listenPromises[2] = {nullptr, nullptr};
+  auto addresses = kj::heapArrayBuilder<kj::Own<kj::NetworkAddress>>(2);
+  for (uint i = 0; i < 2; i++) {
+    listeners[i] = network.parseAddress("127.0.0.1").wait(ioContext.waitScope)->listen();
+    listenPromises[i] = servers[i]->listen(*listeners[i]);
+    addresses.add(network.parseAddress("127.0.0.1", listeners[i]->getPort())
+        .wait(ioContext.waitScope));
+  }
+
+  TwoPartyClientPool pool(ioContext.provider->getTimer(), addresses.finish(),
+                          TwoPartyClientPool::Policy::POWER_OF_TWO_CHOICES);
+  auto cap = pool.bootstrap().castAs<test::TestInterface>();
+
+  // One call at a time, so that only latency distinguishes the servers. The failing server
+  // answers at least as fast as the good one, but its failures must not make it look faster.
+  uint failures = 0;
+  for (uint i = 0; i < 50; i++) {
+    auto request = cap.fooRequest();
+    request.setI(123);
+    request.setJ(true);
+    request.send().then([](Response<test::TestInterface::FooResults>&&) {},
+                        [&](kj::Exception&&) { ++failures; })
+        .wait(ioContext.waitScope);
+  }
+
+  EXPECT_LT(failures, 10u);
+  EXPECT_EQ(int(50 - failures), callCount);
+
+  auto stats = pool.getStats();
+  EXPECT_EQ(failures, stats[1].failures);
+  EXPECT_EQ(failures, stats[1].calls);
+  EXPECT_TRUE(stats[1].latency > stats[0].latency);
+}
+
 TEST(TwoPartyNetwork, HugeMessage) {
   auto ioContext = kj::setupAsyncIo();
   int callCount = 0;
@@ -370,6 +722,220 @@ TEST(TwoPartyNetwork, HugeMessage) {
   }
 }
 
+TwoPartyVatNetwork::Compression expectedCompression(TwoPartyVatNetwork::Compression requested) {
+#if !KJ_HAS_ZLIB
+  if (requested != TwoPartyVatNetwork::Compression::NONE) {
+    return TwoPartyVatNetwork::Compression::PACKED;
+  }
+#endif
+  return requested;
+}
+
+void testCompressedConnection(TwoPartyVatNetwork::Compression clientCompression,
+                              TwoPartyVatNetwork::Compression serverCompression) {
+  auto ioContext = kj::setupAsyncIo();
+  int callCount = 0;
+  int handleCount = 0;
+
+  auto serverThread = runServer(*ioContext.provider, callCount, handleCount, serverCompression);
+  TwoPartyVatNetwork network(*serverThread.pipe, rpc::twoparty::Side::CLIENT, ReaderOptions(),
+                             clientCompression);
+  auto rpcClient = makeRpcClient(network);
+
+  auto client = getPersistentCap(rpcClient, rpc::twoparty::Side::SERVER,
+      test::TestSturdyRefObjectId::Tag::TEST_MORE_STUFF).castAs<test::TestMoreStuff>();
+
+  // Several calls in one turn share a frame.
+  kj::Vector<kj::Promise<void>> promises;
+  for (uint i = 0; i < 10; i++) {
+    auto req = client.getCallSequenceRequest();
+    req.setExpected(i);
+    promises.add(req.send().then([i](auto&& response) {
+      EXPECT_EQ(i, response.getN());
+    }));
+  }
+  kj::joinPromises(promises.releaseAsArray()).wait(ioContext.waitScope);
+
+  // A large multi-segment message makes it through (and fails only because the method isn't
+  // implemented).
+  {
+    auto req = client.methodWithDefaultsRequest();
+    auto text = req.initA(1 << 20);
+    memset(text.begin(), 'x', text.size());
+    KJ_EXPECT_THROW_RECOVERABLE(UNIMPLEMENTED,
+        req.send().ignoreResult().wait(ioContext.waitScope));
+  }
+
+  {
+    auto req = client.getCallSequenceRequest();
+    req.setExpected(10);
+    EXPECT_EQ(10, req.send().wait(ioContext.waitScope).getN());
+  }
+
+  EXPECT_TRUE(network.getCompression() == expectedCompression(clientCompression));
+}
+
+TEST(TwoPartyNetwork, Compression) {
+  using Compression = TwoPartyVatNetwork::Compression;
+  testCompressedConnection(Compression::PACKED, Compression::PACKED);
+  testCompressedConnection(Compression::DEFLATE, Compression::DEFLATE);
+  testCompressedConnection(Compression::DEFLATE_FAST, Compression::PACKED);
+
+  // Only one side asks for compression.
+  testCompressedConnection(Compression::DEFLATE, Compression::NONE);
+  testCompressedConnection(Compression::NONE, Compression::DEFLATE);
+}
+
+TEST(TwoPartyNetwork, CompressionWithLegacyPeer) {
+  auto ioContext = kj::setupAsyncIo();
+  auto pipe = ioContext.provider->newTwoWayPipe();
+
+  TwoPartyVatNetwork network(*pipe.ends[0], rpc::twoparty::Side::CLIENT, ReaderOptions(),
+                             TwoPartyVatNetwork::Compression::DEFLATE);
+  auto rpcClient = makeRpcClient(network);
+
+  // Play the part of a peer that predates compression negotiation: reply to the hello with
+  // `unimplemented`, as its RpcSystem would.
+  auto hello = readMessage(*pipe.ends[1]).wait(ioContext.waitScope);
+  {
+    MallocMessageBuilder reply;
+    reply.initRoot<rpc::Message>().setUnimplemented(hello->getRoot<rpc::Message>());
+    writeMessage(*pipe.ends[1], reply).wait(ioContext.waitScope);
+  }
+
+  MallocMessageBuilder vatIdMessage(8);
+  vatIdMessage.initRoot<rpc::twoparty::VatId>().setSide(rpc::twoparty::Side::SERVER);
+  auto client = rpcClient.bootstrap(vatIdMessage.getRoot<rpc::twoparty::VatId>())
+      .castAs<test::TestInterface>();
+  auto promise = client.fooRequest().send();
+
+  // The client swallows the echoed hello and keeps writing plain messages.
+  EXPECT_EQ(rpc::Message::BOOTSTRAP, readMessage(*pipe.ends[1]).wait(ioContext.waitScope)
+      ->getRoot<rpc::Message>().which());
+  EXPECT_EQ(rpc::Message::CALL, readMessage(*pipe.ends[1]).wait(ioContext.waitScope)
+      ->getRoot<rpc::Message>().which());
+  EXPECT_TRUE(network.getCompression() == TwoPartyVatNetwork::Compression::NONE);
+}
+
+class TestDeadlineImpl final: public test::TestInterface::Server {
+public:
+  kj::Maybe<kj::TimePoint> deadline;
+  bool canceled = false;
+
+protected:
+  kj::Promise<void> foo(FooContext context) override {
+    deadline = context.getDeadline();
+    context.getResults().setX("foo");
+    return kj::READY_NOW;
+  }
+
+  kj::Promise<void> bar(BarContext context) override {
+    // Waits forever, unless canceled.
+    context.allowCancellation();
+    return kj::Promise<void>(kj::NEVER_DONE).attach(kj::defer([this]() { canceled = true; }));
+  }
+};
+
+TEST(TwoPartyNetwork, Deadlines) {
+  auto ioContext = kj::setupAsyncIo();
+  auto& timer = ioContext.provider->getTimer();
+  auto pipe = ioContext.provider->newTwoWayPipe();
+
+  auto serverImpl = kj::heap<TestDeadlineImpl>();
+  auto& server = *serverImpl;
+  TwoPartyVatNetwork serverNetwork(*pipe.ends[0], rpc::twoparty::Side::SERVER);
+  TwoPartyVatNetwork clientNetwork(*pipe.ends[1], rpc::twoparty::Side::CLIENT);
+  auto rpcServer = makeRpcServer(serverNetwork, kj::mv(serverImpl));
+  auto rpcClient = makeRpcClient(clientNetwork);
+  rpcServer.setTimer(timer);
+  rpcClient.setTimer(timer);
+
+  MallocMessageBuilder vatIdMessage(8);
+  vatIdMessage.initRoot<rpc::twoparty::VatId>().setSide(rpc::twoparty::Side::SERVER);
+  auto client = rpcClient.bootstrap(vatIdMessage.getRoot<rpc::twoparty::VatId>())
+      .castAs<test::TestInterface>();
+
+  // No deadline unless the caller sets one.
+  client.fooRequest().send().wait(ioContext.waitScope);
+  EXPECT_TRUE(server.deadline == nullptr);
+
+  // The callee sees the caller's deadline, give or take the time spent in transit.
+  {
+    auto deadline = timer.now() + 10 * kj::SECONDS;
+    auto request = client.fooRequest();
+    request.setDeadline(deadline);
+    request.send().wait(ioContext.waitScope);
+    auto received = KJ_ASSERT_NONNULL(server.deadline);
+    EXPECT_TRUE(received <= deadline + 1 * kj::SECONDS);
+    EXPECT_TRUE(received >= deadline - 1 * kj::SECONDS);
+  }
+
+  // A call that outlives its deadline is failed and canceled.
+  {
+    auto request = client.barRequest();
+    request.setDeadline(timer.now() + 10 * kj::MILLISECONDS);
+    KJ_EXPECT_THROW_RECOVERABLE_MESSAGE("call deadline exceeded",
+        request.send().wait(ioContext.waitScope));
+
+    // The local call's pipeline holds it open until the caller's Finish arrives.
+    timer.afterDelay(10 * kj::MILLISECONDS).wait(ioContext.waitScope);
+    EXPECT_TRUE(server.canceled);
+  }
+}
+
+TEST(TwoPartyNetwork, HugeTimeoutMeansNoDeadline) {
+  // A peer may send any `timeoutNanos`.  One too large for a `kj::Duration` must not wrap around
+  // into a deadline in the past.
+
+  auto ioContext = kj::setupAsyncIo();
+  auto pipe = ioContext.provider->newTwoWayPipe();
+
+  auto serverImpl = kj::heap<TestDeadlineImpl>();
+  auto& server = *serverImpl;
+  TwoPartyVatNetwork serverNetwork(*pipe.ends[0], rpc::twoparty::Side::SERVER);
+  TwoPartyVatNetwork clientNetwork(*pipe.ends[1], rpc::twoparty::Side::CLIENT);
+  auto rpcServer = makeRpcServer(serverNetwork, kj::mv(serverImpl));
+  rpcServer.setTimer(ioContext.provider->getTimer());
+
+  MallocMessageBuilder vatIdMessage(8);
+  vatIdMessage.initRoot<rpc::twoparty::VatId>().setSide(rpc::twoparty::Side::SERVER);
+  auto conn = KJ_ASSERT_NONNULL(
+      clientNetwork.connect(vatIdMessage.getRoot<rpc::twoparty::VatId>()));
+
+  {
+    auto msg = conn->newOutgoingMessage(128);
+    msg->getBody().initAs<rpc::Message>().initBootstrap().setQuestionId(0);
+    msg->send();
+  }
+
+  {
+    auto msg = conn->newOutgoingMessage(128);
+    auto call = msg->getBody().initAs<rpc::Message>().initCall();
+    call.setQuestionId(1);
+    call.initTarget().initPromisedAnswer().setQuestionId(0);
+    call.setInterfaceId(typeId<test::TestInterface>());
+    call.setMethodId(0);  // foo
+    call.initParams().getContent().initAs<test::TestInterface::FooParams>();
+    call.setTimeoutNanos(kj::maxValue);
+    msg->send();
+  }
+
+  for (;;) {
+    auto reply = KJ_ASSERT_NONNULL(conn->receiveIncomingMessage().wait(ioContext.waitScope));
+    auto message = reply->getBody().getAs<rpc::Message>();
+    ASSERT_EQ(rpc::Message::RETURN, message.which());
+    auto ret = message.getReturn();
+    if (ret.getAnswerId() == 1) {
+      ASSERT_EQ(rpc::Return::RESULTS, ret.which());
+      EXPECT_EQ("foo", ret.getResults().getContent().getAs<test::TestInterface::FooResults>()
+          .getX());
+      break;
+    }
+  }
+
+  EXPECT_TRUE(server.deadline == nullptr);
+}
+
 class TestAuthenticatedBootstrapImpl final
     : public test::TestAuthenticatedBootstrap<rpc::twoparty::VatId>::Server {
 public:
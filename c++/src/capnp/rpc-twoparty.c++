@@ -21,14 +21,306 @@
 
 #include "rpc-twoparty.h"
 #include "serialize-async.h"
+#include "serialize-packed.h"
+#include <capnp/rpc.capnp.h>
 #include <kj/debug.h>
 
+#if KJ_HAS_ZLIB
+#include <kj/compat/gzip.h>
+#endif
+
+#if !_WIN32
+#include <fcntl.h>
+#endif
+
 namespace capnp {
 
+namespace {
+
+// Compression negotiation
+//
+// A network which wants to compress sends a "hello" message when the connection starts. It looks
+// like an `rpc::Message` with a union discriminant reserved for this in rpc.capnp, whose first
+// pointer field is a `Data` listing the frame codecs the sender can decode. A peer which doesn't
+// know about negotiation responds with `unimplemented`, which tells us to keep writing plain
+// messages. A peer which does responds with its own hello (if it hasn't sent one already).
+//
+// Once each side knows what the other can decode, it may send a "switch" message carrying the
+// chosen codec, after which everything it writes is a sequence of frames:
+//
+//     uint32 size of the encoded frame in bytes, little-endian
+//     uint32 size of the decoded frame in words, little-endian
+//     encoded frame
+//
+// A decoded frame is a concatenation of messages in the standard serialization format. Each
+// direction is negotiated separately. All of this happens below the RpcSystem, which never
+// sees the transport messages.
+
+const uint16_t TRANSPORT_HELLO = 0xfff0;
+const uint16_t TRANSPORT_SWITCH = 0xfff1;
+
+enum FrameCodec: byte {
+  FRAME_PACKED = 1,
+  // Packed encoding.
+
+  FRAME_DEFLATE = 2,
+  // Packed encoding, then a gzip stream that continues across frames, each frame ending at a
+  // sync flush.
+};
+
+const byte DECODABLE_CODECS[] = {
+#if KJ_HAS_ZLIB
+  FRAME_DEFLATE,
+#endif
+  FRAME_PACKED
+};
+
+const size_t FRAME_HEADER_SIZE = 2 * sizeof(uint32_t);
+
+const uint64_t FRAME_SPLIT_WORDS = 1 << 16;
+// A turn's worth of messages is split into multiple frames once it reaches this size, bounding
+// the buffering done on either side. A frame may exceed it by one message.
+
+bool contains(kj::ArrayPtr<const byte> codecs, byte codec) {
+  for (byte c: codecs) {
+    if (c == codec) return true;
+  }
+  return false;
+}
+
+bool canDecode(byte codec) {
+  return contains(kj::arrayPtr(DECODABLE_CODECS, sizeof(DECODABLE_CODECS)), codec);
+}
+
+const size_t FRAME_READ_CHUNK_BYTES = 1 << 16;
+// Frames are read from the stream in pieces of at most this size.
+
+const uint64_t MAX_ENCODED_BYTES_PER_WORD = 10;
+// Packing expands a word to at most 10 bytes (tag, 8 literal bytes, and a run count).
+
+const size_t ZLIB_DEFLATE_STATE_BYTES = (1 << 17) + (1 << 18);
+const size_t ZLIB_INFLATE_STATE_BYTES = (1 << 15) + 7 * 1024;
+// Memory held by a zlib stream with the default window and memory level, per zlib's docs. It
+// lives as long as the connection, since frames share dictionary context.
+
+FrameCodec codecFor(TwoPartyVatNetwork::Compression compression) {
+  switch (compression) {
+    case TwoPartyVatNetwork::Compression::NONE:
+    case TwoPartyVatNetwork::Compression::PACKED:
+      return FRAME_PACKED;
+    case TwoPartyVatNetwork::Compression::DEFLATE:
+    case TwoPartyVatNetwork::Compression::DEFLATE_FAST:
+      return FRAME_DEFLATE;
+  }
+  KJ_UNREACHABLE;
+}
+
+class FrameSink final: public kj::OutputStream {
+  // Passes gzip output on to the buffer of the frame currently being built. The gzip streams live
+  // as long as the connection so that frames share dictionary context, but each frame has its
+  // own buffer.
+
+public:
+  kj::OutputStream* target = nullptr;
+
+  size_t limit = kj::maxValue;
+  // Throw if more than this many bytes are written, to guard against decompression bombs.
+
+  void write(const void* buffer, size_t size) override {
+    KJ_REQUIRE(size <= limit, "decompressed frame is larger than the peer claimed");
+    limit -= size;
+    if (target != nullptr) {
+      target->write(buffer, size);
+    }
+  }
+};
+
+}  // namespace
+
+class TwoPartyVatNetwork::FrameWriter {
+public:
+  FrameWriter(TwoPartyVatNetwork& network, Compression compression)
+      : network(network) {
+#if KJ_HAS_ZLIB
+    if (codecFor(compression) == FRAME_DEFLATE) {
+      compressor = kj::heap<kj::GzipOutputStream>(sink,
+          compression == Compression::DEFLATE_FAST ? Z_BEST_SPEED : Z_DEFAULT_COMPRESSION);
+    }
+#endif
+  }
+
+  void add(kj::Own<OutgoingMessageImpl> message);
+
+  size_t getBufferedBytes();
+
+  void trimBuffers() {
+    if (batch.size() == 0) batch = nullptr;
+  }
+
+private:
+  TwoPartyVatNetwork& network;
+  FrameSink sink;
+#if KJ_HAS_ZLIB
+  kj::Maybe<kj::Own<kj::GzipOutputStream>> compressor;
+#endif
+
+  kj::Vector<kj::Own<OutgoingMessageImpl>> batch;
+  // Messages sent during the current turn, to be written as soon as it ends.
+
+  kj::Promise<void> flush();
+};
+
+class TwoPartyVatNetwork::FrameReader {
+public:
+  FrameReader(TwoPartyVatNetwork& network, FrameCodec codec)
+      : network(network), codec(codec) {
+#if KJ_HAS_ZLIB
+    if (codec == FRAME_DEFLATE) {
+      decompressor = kj::heap<kj::GzipOutputStream>(sink, kj::GzipOutputStream::DECOMPRESS);
+    }
+#endif
+  }
+
+  kj::Promise<kj::Maybe<kj::Own<MessageReader>>> read() {
+    if (inboxPos < inbox.size()) {
+      auto result = kj::mv(inbox[inboxPos++]);
+      if (inboxPos == inbox.size()) {
+        inbox.clear();
+        inboxPos = 0;
+        inboxWords = 0;
+      }
+      return kj::Maybe<kj::Own<MessageReader>>(kj::mv(result));
+    }
+
+    return network.stream.tryRead(header, FRAME_HEADER_SIZE, FRAME_HEADER_SIZE)
+        .then([this](size_t n) -> kj::Promise<kj::Maybe<kj::Own<MessageReader>>> {
+      if (n == 0) {
+        return kj::Maybe<kj::Own<MessageReader>>(nullptr);
+      }
+      KJ_REQUIRE(n == FRAME_HEADER_SIZE, "Premature EOF.") {
+        return kj::Maybe<kj::Own<MessageReader>>(nullptr);
+      }
+
+      uint32_t frameSize = header[0].get();
+      uint64_t decodedWords = header[1].get();
+      uint64_t limit = network.receiveOptions.traversalLimitInWords;
+      // Since `decodedWords` is checked first, this also bounds `frameSize` by the encoded size of
+      // the traversal limit.
+      KJ_REQUIRE(decodedWords <= limit + FRAME_SPLIT_WORDS &&
+                 frameSize <= decodedWords * MAX_ENCODED_BYTES_PER_WORD + 1024,
+                 "Frame exceeds our size limit.", frameSize, decodedWords) {
+        return kj::Maybe<kj::Own<MessageReader>>(nullptr);
+      }
+
+      size_t chunkSize = kj::min(size_t(frameSize), FRAME_READ_CHUNK_BYTES);
+      chunk = kj::heapArray<byte>(chunkSize);
+      packed = kj::heap<kj::VectorOutputStream>(kj::max(chunkSize, size_t(1)));
+#if KJ_HAS_ZLIB
+      if (codec == FRAME_DEFLATE) {
+        sink.target = packed.get();
+        sink.limit = decodedWords * MAX_ENCODED_BYTES_PER_WORD;
+      }
+#endif
+
+      return readFrame(frameSize).then([this, decodedWords]() {
+        decode(decodedWords);
+        return read();
+      });
+    });
+  }
+
+  size_t getBufferedBytes() {
+    size_t result = inbox.capacity() * sizeof(inbox[0]) + inboxWords * sizeof(word) + chunk.size();
+    if (packed.get() != nullptr) result += packed->getArray().size();
+#if KJ_HAS_ZLIB
+    if (decompressor != nullptr) result += ZLIB_INFLATE_STATE_BYTES;
+#endif
+    return result;
+  }
+
+  void trimBuffers() {
+    if (inbox.size() == 0) inbox = nullptr;
+  }
+
+private:
+  TwoPartyVatNetwork& network;
+  FrameCodec codec;
+  FrameSink sink;
+#if KJ_HAS_ZLIB
+  kj::Maybe<kj::Own<kj::GzipOutputStream>> decompressor;
+#endif
+
+  _::WireValue<uint32_t> header[2];
+
+  kj::Array<byte> chunk;
+  kj::Own<kj::VectorOutputStream> packed;
+  // The frame being read arrives in `chunk`-sized pieces, which are accumulated in `packed`
+  // (after inflating them, if the frame is compressed). So, memory use grows only as fast as the
+  // peer actually sends data, however large a frame it announces. Both are freed once the frame
+  // is decoded.
+
+  kj::Vector<kj::Own<MessageReader>> inbox;
+  size_t inboxPos = 0;
+  size_t inboxWords = 0;
+  // Messages decoded from the last frame which have not been returned yet, and the size of that
+  // frame once decoded.
+
+  struct DecodedFrame: public kj::Refcounted {
+    kj::Array<word> words;
+  };
+
+  kj::Promise<void> readFrame(size_t remaining) {
+    if (remaining == 0) return kj::READY_NOW;
+
+    size_t n = kj::min(remaining, chunk.size());
+    return network.stream.read(chunk.begin(), n).then([this, remaining, n]() {
+#if KJ_HAS_ZLIB
+      KJ_IF_MAYBE(d, decompressor) {
+        (*d)->write(chunk.begin(), n);
+      } else {
+        packed->write(chunk.begin(), n);
+      }
+#else
+      packed->write(chunk.begin(), n);
+#endif
+      return readFrame(remaining - n);
+    });
+  }
+
+  void decode(size_t decodedWords) {
+    KJ_DEFER({
+      sink.target = nullptr;
+      chunk = nullptr;
+      packed = nullptr;
+    });
+    auto frame = packed->getArray();
+
+    auto decoded = kj::refcounted<DecodedFrame>();
+    decoded->words = kj::heapArray<word>(decodedWords);
+    inboxWords = decodedWords;
+    {
+      kj::ArrayInputStream input(frame);
+      _::PackedInputStream unpacker(input);
+      unpacker.read(decoded->words.begin(), decoded->words.asBytes().size());
+      KJ_REQUIRE(input.tryGetReadBuffer().size() == 0, "Frame is larger than the peer claimed.") {
+        return;
+      }
+    }
+
+    kj::ArrayPtr<const word> remaining = decoded->words;
+    while (remaining.size() > 0) {
+      auto message = kj::heap<FlatArrayMessageReader>(remaining, network.receiveOptions);
+      remaining = kj::arrayPtr(message->getEnd(), remaining.end());
+      inbox.add(kj::Own<MessageReader>(kj::mv(message)).attach(kj::addRef(*decoded)));
+    }
+  }
+};
+
 TwoPartyVatNetwork::TwoPartyVatNetwork(kj::AsyncIoStream& stream, rpc::twoparty::Side side,
-                                       ReaderOptions receiveOptions)
+                                       ReaderOptions receiveOptions, Compression compression)
     : stream(stream), side(side), peerVatId(4),
-      receiveOptions(receiveOptions), previousWrite(kj::READY_NOW) {
+      receiveOptions(receiveOptions), requestedCompression(compression),
+      previousWrite(kj::READY_NOW) {
   peerVatId.initRoot<rpc::twoparty::VatId>().setSide(
       side == rpc::twoparty::Side::CLIENT ? rpc::twoparty::Side::SERVER
                                           : rpc::twoparty::Side::CLIENT);
@@ -36,6 +328,18 @@ TwoPartyVatNetwork::TwoPartyVatNetwork(kj::AsyncIoStream& stream, rpc::twoparty:
   auto paf = kj::newPromiseAndFulfiller<void>();
   disconnectPromise = paf.promise.fork();
   disconnectFulfiller.fulfiller = kj::mv(paf.fulfiller);
+
+  if (compression != Compression::NONE) {
+    sentHello = true;
+    sendTransportMessage(TRANSPORT_HELLO, kj::arrayPtr(DECODABLE_CODECS, sizeof(DECODABLE_CODECS)));
+  }
+}
+
+TwoPartyVatNetwork::TwoPartyVatNetwork(kj::AsyncCapabilityStream& stream, uint maxFdsPerMessage,
+                                       rpc::twoparty::Side side, ReaderOptions receiveOptions)
+    : TwoPartyVatNetwork(stream, side, receiveOptions) {
+  capStream = stream;
+  this->maxFdsPerMessage = maxFdsPerMessage;
 }
 
 void TwoPartyVatNetwork::FulfillerDisposer::disposeImpl(void* pointer) const {
@@ -81,6 +385,20 @@ public:
     return message.getRoot<AnyPointer>();
   }
 
+  void setFds(kj::Array<int> fds) override {
+#if !_WIN32
+    if (network.capStream != nullptr) {
+      // The descriptors belong to the capabilities the message refers to, which may be released
+      // before the queued write happens, so hold our own copies until then.
+      this->fds = KJ_MAP(fd, fds) {
+        int duped;
+        KJ_SYSCALL(duped = fcntl(fd, F_DUPFD_CLOEXEC, 0));
+        return kj::AutoCloseFd(duped);
+      };
+    }
+#endif
+  }
+
   void send() override {
     size_t size = 0;
     for (auto& segment: message.getSegmentsForOutput()) {
@@ -93,34 +411,184 @@ public:
       return;
     }
 
-    network.previousWrite = KJ_ASSERT_NONNULL(network.previousWrite, "already shut down")
-        .then([&]() {
-      // Note that if the write fails, all further writes will be skipped due to the exception.
-      // We never actually handle this exception because we assume the read end will fail as well
-      // and it's cleaner to handle the failure there.
-      return writeMessage(network.stream, message);
-    }).attach(kj::addRef(*this))
-      // Note that it's important that the eagerlyEvaluate() come *after* the attach() because
-      // otherwise the message (and any capabilities in it) will not be released until a new
-      // message is written! (Kenton once spent all afternoon tracking this down...)
-      .eagerlyEvaluate(nullptr);
+    KJ_IF_MAYBE(writer, network.frameWriter) {
+      writer->get()->add(kj::addRef(*this));
+      return;
+    }
+
+    network.queueWrite(kj::addRef(*this));
   }
 
 private:
   TwoPartyVatNetwork& network;
   MallocMessageBuilder message;
+  kj::Array<kj::AutoCloseFd> fds;
+
+  friend class TwoPartyVatNetwork;
+  friend class FrameWriter;
 };
 
+TwoPartyVatNetwork::~TwoPartyVatNetwork() noexcept(false) {}
+
+void TwoPartyVatNetwork::queueWrite(kj::Own<OutgoingMessageImpl> message) {
+  auto& previous = KJ_ASSERT_NONNULL(previousWrite, "already shut down");
+
+  queuedWrites.add(kj::mv(message));
+  if (queuedWrites.size() == 1) {
+    // Everything sent before the previous write completes (at least, everything sent during the
+    // current turn) goes out in the same write.
+    previous = previous.then([this]() {
+      auto messages = queuedWrites.releaseAsArray();
+      return writeQueued(messages).attach(kj::mv(messages));
+    }, [this](kj::Exception&& exception) -> kj::Promise<void> {
+      // Note that if the write fails, all further writes will be skipped due to the exception.
+      // We never actually handle this exception because we assume the read end will fail as well
+      // and it's cleaner to handle the failure there. Do drop the messages though, lest they (and
+      // any capabilities in them) pile up.
+      queuedWrites.clear();
+      return kj::mv(exception);
+    })
+      // Note that it's important that the messages be attached to the write itself because
+      // otherwise they (and any capabilities in them) would not be released until a new message
+      // is written! (Kenton once spent all afternoon tracking this down...)
+      .eagerlyEvaluate(nullptr);
+  }
+}
+
+kj::Promise<void> TwoPartyVatNetwork::writeQueued(
+    kj::ArrayPtr<kj::Own<OutgoingMessageImpl>> messages) {
+  // Messages carrying FDs get a write of their own, since the descriptors arrive with the first
+  // byte of the write that carries them. Runs of other messages are still written together.
+
+  size_t n = 0;
+  while (n < messages.size() && messages[n]->fds.size() == 0) ++n;
+
+  kj::Promise<void> promise = nullptr;
+  if (n > 0) {
+    auto builders = KJ_MAP(m, messages.slice(0, n)) -> MessageBuilder* { return &m->message; };
+    promise = writeMessages(stream, builders).attach(kj::mv(builders));
+  } else {
+    auto& message = *messages[0];
+    auto fds = KJ_MAP(fd, message.fds) { return fd.get(); };
+    promise = writeMessage(KJ_ASSERT_NONNULL(capStream), fds, message.message)
+        .then([&message]() {
+      // The peer has its own copies now.
+      message.fds = nullptr;
+    }).attach(kj::mv(fds));
+    n = 1;
+  }
+
+  if (n == messages.size()) {
+    return kj::mv(promise);
+  } else {
+    auto rest = messages.slice(n, messages.size());
+    return promise.then([this,rest]() { return writeQueued(rest); });
+  }
+}
+
+void TwoPartyVatNetwork::FrameWriter::add(kj::Own<OutgoingMessageImpl> message) {
+  auto& previousWrite = KJ_ASSERT_NONNULL(network.previousWrite, "already shut down");
+
+  batch.add(kj::mv(message));
+  if (batch.size() == 1) {
+    // First message this turn. Write the batch once everything else that's ready to run has had
+    // a chance to add to it.
+    previousWrite = previousWrite.then([this]() {
+      return kj::evalLater([this]() { return flush(); });
+    }).eagerlyEvaluate(nullptr);
+  }
+}
+
+size_t TwoPartyVatNetwork::FrameWriter::getBufferedBytes() {
+  size_t result = batch.capacity() * sizeof(batch[0]);
+  for (auto& message: batch) {
+    result += computeSerializedSizeInWords(message->message) * sizeof(word);
+  }
+#if KJ_HAS_ZLIB
+  if (compressor != nullptr) result += ZLIB_DEFLATE_STATE_BYTES;
+#endif
+  return result;
+}
+
+kj::Promise<void> TwoPartyVatNetwork::FrameWriter::flush() {
+  auto messages = batch.releaseAsArray();
+  kj::Vector<kj::Own<kj::VectorOutputStream>> frames;
+
+  for (size_t i = 0; i < messages.size();) {
+    auto frame = kj::heap<kj::VectorOutputStream>();
+    byte placeholder[FRAME_HEADER_SIZE] = {};
+    frame->write(placeholder, sizeof(placeholder));
+
+    uint64_t frameWords = 0;
+    {
+#if KJ_HAS_ZLIB
+      kj::Maybe<kj::BufferedOutputStreamWrapper> buffered;
+      kj::BufferedOutputStream* packerOutput = frame.get();
+      KJ_IF_MAYBE(c, compressor) {
+        sink.target = frame.get();
+        packerOutput = &buffered.emplace(**c);
+      }
+#else
+      kj::BufferedOutputStream* packerOutput = frame.get();
+#endif
+
+      _::PackedOutputStream packer(*packerOutput);
+      do {
+        auto segments = messages[i]->message.getSegmentsForOutput();
+        frameWords += computeSerializedSizeInWords(segments);
+        writeMessage(packer, segments);
+      } while (++i < messages.size() && frameWords < FRAME_SPLIT_WORDS);
+
+#if KJ_HAS_ZLIB
+      KJ_IF_MAYBE(b, buffered) {
+        b->flush();
+        KJ_ASSERT_NONNULL(compressor)->flush();
+        sink.target = nullptr;
+      }
+#endif
+    }
+
+    auto bytes = frame->getArray();
+    KJ_ASSERT(bytes.size() - FRAME_HEADER_SIZE <= uint32_t(kj::maxValue));
+    auto header = reinterpret_cast<_::WireValue<uint32_t>*>(bytes.begin());
+    header[0].set(bytes.size() - FRAME_HEADER_SIZE);
+    header[1].set(frameWords);
+    frames.add(kj::mv(frame));
+  }
+
+  // Release the messages (and any capabilities in them) now rather than after the write.
+  messages = nullptr;
+
+  kj::Promise<void> result = kj::READY_NOW;
+  for (auto& frame: frames) {
+    auto bytes = frame->getArray();
+    result = result.then([this, bytes]() {
+      return network.stream.write(bytes.begin(), bytes.size());
+    });
+  }
+  return result.attach(kj::mv(frames));
+}
+
 class TwoPartyVatNetwork::IncomingMessageImpl final: public IncomingRpcMessage {
 public:
-  IncomingMessageImpl(kj::Own<MessageReader> message): message(kj::mv(message)) {}
+  IncomingMessageImpl(kj::Own<MessageReader> message, kj::Array<kj::AutoCloseFd> fds)
+      : message(kj::mv(message)), fds(kj::mv(fds)) {}
 
   AnyPointer::Reader getBody() override {
     return message->getRoot<AnyPointer>();
   }
 
+  kj::Maybe<kj::Array<const byte>> shareData(Data::Reader data) override {
+    return message->shareData(data);
+  }
+
+  kj::ArrayPtr<kj::AutoCloseFd> getAttachedFds() override {
+    return fds;
+  }
+
 private:
   kj::Own<MessageReader> message;
+  kj::Array<kj::AutoCloseFd> fds;
 };
 
 rpc::twoparty::VatId::Reader TwoPartyVatNetwork::getPeerVatId() {
@@ -133,18 +601,131 @@ kj::Own<OutgoingRpcMessage> TwoPartyVatNetwork::newOutgoingMessage(uint firstSeg
 
 kj::Promise<kj::Maybe<kj::Own<IncomingRpcMessage>>> TwoPartyVatNetwork::receiveIncomingMessage() {
   return kj::evalLater([&]() {
-    return tryReadMessage(stream, receiveOptions)
-        .then([&](kj::Maybe<kj::Own<MessageReader>>&& message)
+    return readMessage();
+  });
+}
+
+kj::Promise<kj::Maybe<kj::Own<IncomingRpcMessage>>> TwoPartyVatNetwork::readMessage() {
+  KJ_IF_MAYBE(reader, frameReader) {
+    return reader->get()->read()
+        .then([](kj::Maybe<kj::Own<MessageReader>>&& message)
               -> kj::Maybe<kj::Own<IncomingRpcMessage>> {
       KJ_IF_MAYBE(m, message) {
-        return kj::Own<IncomingRpcMessage>(kj::heap<IncomingMessageImpl>(kj::mv(*m)));
+        return kj::Own<IncomingRpcMessage>(kj::heap<IncomingMessageImpl>(kj::mv(*m), nullptr));
       } else {
         return nullptr;
       }
     });
+  }
+
+  KJ_IF_MAYBE(cs, capStream) {
+    auto fdSpace = kj::heapArray<kj::AutoCloseFd>(maxFdsPerMessage);
+    auto promise = tryReadMessage(*cs, fdSpace, receiveOptions);
+    return promise.then([this,fdSpace = kj::mv(fdSpace)](kj::Maybe<MessageReaderAndFds>&& result)
+                        mutable -> kj::Promise<kj::Maybe<kj::Own<IncomingRpcMessage>>> {
+      KJ_IF_MAYBE(r, result) {
+        auto fds = kj::heapArrayBuilder<kj::AutoCloseFd>(r->fds.size());
+        for (auto& fd: r->fds) {
+          fds.add(kj::mv(fd));
+        }
+        return deliverMessage(kj::mv(r->reader), fds.finish());
+      } else {
+        return kj::Maybe<kj::Own<IncomingRpcMessage>>(nullptr);
+      }
+    });
+  }
+
+  return tryReadMessage(stream, receiveOptions)
+      .then([this](kj::Maybe<kj::Own<MessageReader>>&& message)
+            -> kj::Promise<kj::Maybe<kj::Own<IncomingRpcMessage>>> {
+    KJ_IF_MAYBE(m, message) {
+      return deliverMessage(kj::mv(*m), nullptr);
+    } else {
+      return kj::Maybe<kj::Own<IncomingRpcMessage>>(nullptr);
+    }
   });
 }
 
+kj::Promise<kj::Maybe<kj::Own<IncomingRpcMessage>>> TwoPartyVatNetwork::deliverMessage(
+    kj::Own<MessageReader> message, kj::Array<kj::AutoCloseFd> fds) {
+  if (handleTransportMessage(*message)) {
+    return readMessage();
+  }
+  return kj::Maybe<kj::Own<IncomingRpcMessage>>(
+      kj::heap<IncomingMessageImpl>(kj::mv(message), kj::mv(fds)));
+}
+
+void TwoPartyVatNetwork::sendTransportMessage(uint16_t type, kj::ArrayPtr<const byte> payload) {
+  // Transport messages are laid out like an rpc::Message, so that peers predating negotiation
+  // parse them and respond with `unimplemented`.
+
+  auto message = newOutgoingMessage(8 + payload.size() / sizeof(word));
+  auto root = message->getBody().initAsAnyStruct(1, 1);
+  reinterpret_cast<_::WireValue<uint16_t>*>(root.getDataSection().begin())->set(type);
+  root.getPointerSection()[0].setAs<Data>(payload);
+  message->send();
+}
+
+bool TwoPartyVatNetwork::handleTransportMessage(MessageReader& message) {
+  // Returns true if `message` was a transport message, which the RpcSystem should not see.
+
+  auto root = message.getRoot<rpc::Message>();
+  auto type = static_cast<uint16_t>(root.which());
+
+  if (type == rpc::Message::UNIMPLEMENTED) {
+    // A peer that doesn't know about negotiation sent back our hello. Keep writing plain messages.
+    return static_cast<uint16_t>(root.getUnimplemented().which()) == TRANSPORT_HELLO;
+  } else if (type != TRANSPORT_HELLO && type != TRANSPORT_SWITCH) {
+    return false;
+  }
+
+  auto pointers = message.getRoot<AnyStruct>().getPointerSection();
+  Data::Reader payload = pointers.size() == 0 ? Data::Reader() : pointers[0].getAs<Data>();
+
+  if (type == TRANSPORT_HELLO) {
+    if (!sentHello) {
+      sentHello = true;
+      if (capStream == nullptr) {
+        sendTransportMessage(TRANSPORT_HELLO,
+                             kj::arrayPtr(DECODABLE_CODECS, sizeof(DECODABLE_CODECS)));
+      } else {
+        // Frames can't carry FDs, so tell the peer we can't decode any.
+        sendTransportMessage(TRANSPORT_HELLO, nullptr);
+      }
+    }
+
+    if (requestedCompression == Compression::NONE || frameWriter != nullptr) {
+      return true;
+    }
+
+    auto bothCanDecode = [&](FrameCodec codec) {
+      return contains(payload, codec) && canDecode(codec);
+    };
+
+    Compression chosen = Compression::NONE;
+    if (bothCanDecode(codecFor(requestedCompression))) {
+      chosen = requestedCompression;
+    } else if (bothCanDecode(FRAME_PACKED)) {
+      chosen = Compression::PACKED;
+    }
+
+    if (chosen != Compression::NONE) {
+      byte codec = codecFor(chosen);
+      sendTransportMessage(TRANSPORT_SWITCH, kj::arrayPtr(&codec, 1));
+      frameWriter = kj::heap<FrameWriter>(*this, chosen);
+      writeCompression = chosen;
+    }
+  } else {
+    KJ_REQUIRE(payload.size() == 1 && canDecode(payload[0]),
+               "peer switched to a frame codec we don't support") {
+      return true;
+    }
+    frameReader = kj::heap<FrameReader>(*this, static_cast<FrameCodec>(payload[0]));
+  }
+
+  return true;
+}
+
 kj::Promise<void> TwoPartyVatNetwork::shutdown() {
   kj::Promise<void> result = KJ_ASSERT_NONNULL(previousWrite, "already shut down").then([this]() {
     stream.shutdownWrite();
@@ -153,6 +734,33 @@ kj::Promise<void> TwoPartyVatNetwork::shutdown() {
   return kj::mv(result);
 }
 
+size_t TwoPartyVatNetwork::getBufferedBytes() {
+  size_t result = queuedWrites.capacity() * sizeof(queuedWrites[0]);
+  for (auto& message: queuedWrites) {
+    result += computeSerializedSizeInWords(message->message) * sizeof(word);
+  }
+  KJ_IF_MAYBE(writer, frameWriter) {
+    result += writer->get()->getBufferedBytes();
+  }
+  KJ_IF_MAYBE(reader, frameReader) {
+    result += reader->get()->getBufferedBytes();
+  }
+  return result;
+}
+
+void TwoPartyVatNetwork::trimBuffers() {
+  // The zlib streams can't be reset without breaking the peer's dictionary context, so only the
+  // queues are trimmed.
+
+  if (queuedWrites.size() == 0) queuedWrites = nullptr;
+  KJ_IF_MAYBE(writer, frameWriter) {
+    writer->get()->trimBuffers();
+  }
+  KJ_IF_MAYBE(reader, frameReader) {
+    reader->get()->trimBuffers();
+  }
+}
+
 // =======================================================================================
 
 TwoPartyServer::TwoPartyServer(Capability::Client bootstrapInterface)
@@ -168,6 +776,14 @@ struct TwoPartyServer::AcceptedConnection {
       : connection(kj::mv(connectionParam)),
         network(*connection, rpc::twoparty::Side::SERVER),
         rpcSystem(makeRpcServer(network, kj::mv(bootstrapInterface))) {}
+
+  explicit AcceptedConnection(Capability::Client bootstrapInterface,
+                              kj::Own<kj::AsyncCapabilityStream>&& connectionParam,
+                              uint maxFdsPerMessage)
+      : connection(kj::mv(connectionParam)),
+        network(kj::downcast<kj::AsyncCapabilityStream>(*connection), maxFdsPerMessage,
+                rpc::twoparty::Side::SERVER),
+        rpcSystem(makeRpcServer(network, kj::mv(bootstrapInterface))) {}
 };
 
 void TwoPartyServer::accept(kj::Own<kj::AsyncIoStream>&& connection) {
@@ -178,6 +794,16 @@ void TwoPartyServer::accept(kj::Own<kj::AsyncIoStream>&& connection) {
   tasks.add(promise.attach(kj::mv(connectionState)));
 }
 
+void TwoPartyServer::accept(kj::Own<kj::AsyncCapabilityStream>&& connection,
+                            uint maxFdsPerMessage) {
+  auto connectionState = kj::heap<AcceptedConnection>(
+      bootstrapInterface, kj::mv(connection), maxFdsPerMessage);
+
+  // Run the connection until disconnect.
+  auto promise = connectionState->network.onDisconnect();
+  tasks.add(promise.attach(kj::mv(connectionState)));
+}
+
 kj::Promise<void> TwoPartyServer::listen(kj::ConnectionReceiver& listener) {
   return listener.accept()
       .then([this,&listener](kj::Own<kj::AsyncIoStream>&& connection) mutable {
@@ -194,6 +820,10 @@ TwoPartyClient::TwoPartyClient(kj::AsyncIoStream& connection)
     : network(connection, rpc::twoparty::Side::CLIENT),
       rpcSystem(makeRpcClient(network)) {}
 
+TwoPartyClient::TwoPartyClient(kj::AsyncCapabilityStream& connection, uint maxFdsPerMessage)
+    : network(connection, maxFdsPerMessage, rpc::twoparty::Side::CLIENT),
+      rpcSystem(makeRpcClient(network)) {}
+
 
 TwoPartyClient::TwoPartyClient(kj::AsyncIoStream& connection,
                                Capability::Client bootstrapInterface,
@@ -210,4 +840,385 @@ Capability::Client TwoPartyClient::bootstrap() {
   return rpcSystem.bootstrap(vatId);
 }
 
+// =======================================================================================
+
+namespace {
+
+const uint POOLED_CLIENT_BRAND = 0;
+// Value is irrelevant; used for pointer.
+
+constexpr double LATENCY_DECAY = 0.25;
+// Weight of each new sample in a server's latency moving average.
+
+constexpr double FAILURE_PENALTY = 4;
+// A failed call counts as a latency sample of at least this many times the slowest server's
+// average, so that a server which fails fast doesn't look fast.
+
+constexpr double MAX_LATENCY_NS = 60e9;
+// Cap on latency averages, so that repeated failure penalties can't grow without bound.
+
+}  // namespace
+
+class TwoPartyClientPool::Impl final: public kj::Refcounted, private kj::TaskSet::ErrorHandler {
+public:
+  Impl(kj::Timer& timer, kj::Array<kj::Own<kj::NetworkAddress>> servers, Policy policy,
+       kj::Duration reconnectDelay)
+      : timer(timer), policy(policy), reconnectDelay(reconnectDelay),
+        backends(kj::heapArray<Backend>(servers.size())), tasks(*this) {
+    KJ_REQUIRE(servers.size() > 0, "TwoPartyClientPool needs at least one server");
+    for (uint i: kj::indices(servers)) {
+      backends[i].address = kj::mv(servers[i]);
+      connect(i);
+    }
+  }
+
+  struct Connection {
+    kj::Own<kj::AsyncIoStream> stream;
+    TwoPartyClient client;
+
+    explicit Connection(kj::Own<kj::AsyncIoStream>&& streamParam)
+        : stream(kj::mv(streamParam)), client(*stream) {}
+  };
+
+  enum class State {
+    // In order of preference when choosing a server.
+
+    CONNECTED,
+    CONNECTING,
+    DOWN
+  };
+
+  struct Backend {
+    kj::Own<kj::NetworkAddress> address;
+    kj::Maybe<kj::Own<Connection>> connection;
+
+    kj::Own<ClientHook> bootstrap;
+    // The server's bootstrap interface.  While connecting, a promise on which calls queue up.
+
+    State state = State::DOWN;
+
+    uint generation = 0;
+    // Incremented by each connection attempt, so that callbacks belonging to an earlier one can
+    // tell they are stale.
+
+    uint inFlight = 0;
+    uint64_t calls = 0;
+    uint64_t failures = 0;
+    uint connects = 0;
+    double latencyNs = 0;
+  };
+
+  class CallTracker: public kj::Refcounted {
+    // Counts a call against its server while it is in flight, and records its outcome.
+
+  public:
+    CallTracker(Impl& impl, uint index)
+        : impl(kj::addRef(impl)), index(index),
+          start(kj::systemPreciseMonotonicClock().now()) {
+      auto& backend = impl.backends[index];
+      ++backend.inFlight;
+      ++backend.calls;
+    }
+
+    ~CallTracker() noexcept(false) {
+      --impl->backends[index].inFlight;
+    }
+
+    void succeeded() {
+      impl->addLatencySample(index, elapsedNs());
+    }
+
+    void failed() {
+      ++impl->backends[index].failures;
+      double penalty = FAILURE_PENALTY * impl->maxLatencyNs();
+      impl->addLatencySample(index, kj::max(elapsedNs(), penalty));
+    }
+
+  private:
+    kj::Own<Impl> impl;
+    uint index;
+    kj::TimePoint start;
+
+    double elapsedNs() {
+      return (kj::systemPreciseMonotonicClock().now() - start) / kj::NANOSECONDS;
+    }
+  };
+
+  kj::Timer& timer;
+  Policy policy;
+  kj::Duration reconnectDelay;
+  kj::Array<Backend> backends;
+  uint nextStart = 0;
+  uint64_t randomState = 0x9e3779b97f4a7c15ull;
+  kj::TaskSet tasks;
+
+  uint choose() {
+    // Only consider the servers in the best state available: connected ones if any, else ones
+    // still connecting (calls will wait for them), else all of them (calls will fail).
+
+    State best = State::DOWN;
+    uint candidates = 0;
+    for (auto& backend: backends) {
+      if (backend.state < best) {
+        best = backend.state;
+        candidates = 0;
+      }
+      if (backend.state == best) {
+        ++candidates;
+      }
+    }
+
+    switch (policy) {
+      case Policy::LEAST_OUTSTANDING: {
+        uint n = backends.size();
+        uint start = nextStart++ % n;
+        uint chosen = n;
+        for (uint j = 0; j < n; j++) {
+          uint i = (start + j) % n;
+          if (backends[i].state == best &&
+              (chosen == n || backends[i].inFlight < backends[chosen].inFlight)) {
+            chosen = i;
+          }
+        }
+        return chosen;
+      }
+
+      case Policy::POWER_OF_TWO_CHOICES: {
+        if (candidates == 1) {
+          return nthCandidate(best, 0);
+        }
+        uint a = random() % candidates;
+        uint b = random() % (candidates - 1);
+        if (b >= a) ++b;
+        uint i = nthCandidate(best, a);
+        uint j = nthCandidate(best, b);
+        return expectedWait(i) <= expectedWait(j) ? i : j;
+      }
+    }
+
+    KJ_UNREACHABLE;
+  }
+
+  kj::Own<CallTracker> startCall(uint index) {
+    return kj::refcounted<CallTracker>(*this, index);
+  }
+
+private:
+  uint nthCandidate(State state, uint n) {
+    for (uint i: kj::indices(backends)) {
+      if (backends[i].state == state && n-- == 0) {
+        return i;
+      }
+    }
+    KJ_UNREACHABLE;
+  }
+
+  double expectedWait(uint index) {
+    // A server with no latency samples yet is assumed to be as slow as the slowest one measured,
+    // so that it neither wins every comparison nor gets starved before its first call.
+    auto& backend = backends[index];
+    double latency = backend.latencyNs;
+    if (latency == 0) latency = maxLatencyNs();
+    if (latency == 0) latency = 1;  // Nothing measured yet; compare calls in flight alone.
+    return (backend.inFlight + 1) * latency;
+  }
+
+  double maxLatencyNs() {
+    double result = 0;
+    for (auto& backend: backends) {
+      result = kj::max(result, backend.latencyNs);
+    }
+    return result;
+  }
+
+  void addLatencySample(uint index, double sample) {
+    auto& backend = backends[index];
+    sample = kj::min(sample, MAX_LATENCY_NS);
+    if (backend.latencyNs == 0) {
+      backend.latencyNs = sample;
+    } else {
+      backend.latencyNs += LATENCY_DECAY * (sample - backend.latencyNs);
+    }
+  }
+
+  uint64_t random() {
+    // xorshift64*
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    return (randomState * 0x2545f4914f6cdd1dull) >> 32;
+  }
+
+  void connect(uint index) {
+    auto& backend = backends[index];
+    uint generation = ++backend.generation;
+    backend.state = State::CONNECTING;
+    ++backend.connects;
+
+    auto promise = backend.address->connect()
+        .then([this,index,generation](kj::Own<kj::AsyncIoStream>&& stream) {
+      auto connection = kj::heap<Connection>(kj::mv(stream));
+      auto cap = ClientHook::from(connection->client.bootstrap());
+      tasks.add(connection->client.onDisconnect().then([this,index,generation]() {
+        disconnected(index, generation);
+      }));
+
+      auto& backend = backends[index];
+      backend.connection = kj::mv(connection);
+      backend.state = State::CONNECTED;
+      return kj::mv(cap);
+    }).fork();
+
+    backend.bootstrap = newLocalPromiseClient(promise.addBranch());
+    tasks.add(promise.addBranch().then([this,index,generation](kj::Own<ClientHook>&& cap) {
+      // Calls made from now on can skip the queue.
+      auto& backend = backends[index];
+      if (backend.generation == generation) {
+        backend.bootstrap = kj::mv(cap);
+      }
+    }, [this,index,generation](kj::Exception&& exception) {
+      auto& backend = backends[index];
+      if (backend.generation == generation) {
+        backend.state = State::DOWN;
+        tasks.add(timer.afterDelay(reconnectDelay).then([this,index,generation]() {
+          if (backends[index].generation == generation) {
+            connect(index);
+          }
+        }));
+      }
+    }));
+  }
+
+  void disconnected(uint index, uint generation) {
+    auto& backend = backends[index];
+    if (backend.generation != generation) {
+      return;
+    }
+
+    KJ_IF_MAYBE(connection, backend.connection) {
+      // We may be running in a callback belonging to the connection, so destroy it later.
+      tasks.add(kj::evalLater(kj::mvCapture(*connection, [](kj::Own<Connection>&&) {})));
+      backend.connection = nullptr;
+    }
+
+    // Wait before reconnecting, as after a failed connection attempt, so that a server which
+    // accepts connections and then immediately drops them doesn't put us in a tight loop.
+    backend.state = State::DOWN;
+    tasks.add(timer.afterDelay(reconnectDelay).then([this,index,generation]() {
+      if (backends[index].generation == generation) {
+        connect(index);
+      }
+    }));
+  }
+
+  void taskFailed(kj::Exception&& exception) override {
+    KJ_LOG(ERROR, exception);
+  }
+};
+
+class TwoPartyClientPool::TrackedRequest final: public RequestHook {
+public:
+  TrackedRequest(kj::Own<RequestHook>&& inner, kj::Own<Impl>&& impl, uint index)
+      : inner(kj::mv(inner)), impl(kj::mv(impl)), index(index) {}
+
+  RemotePromise<AnyPointer> send() override {
+    auto tracker = impl->startCall(index);
+    auto errorTracker = kj::addRef(*tracker);
+    auto typeless = inner->send();
+
+    auto promise = kj::implicitCast<kj::Promise<Response<AnyPointer>>&>(typeless).then(
+        [tracker = kj::mv(tracker)](Response<AnyPointer>&& response) mutable {
+      tracker->succeeded();
+      return kj::mv(response);
+    }, [tracker = kj::mv(errorTracker)](kj::Exception&& exception) mutable
+        -> Response<AnyPointer> {
+      tracker->failed();
+      kj::throwFatalException(kj::mv(exception));
+    });
+    AnyPointer::Pipeline pipeline(kj::mv(kj::implicitCast<AnyPointer::Pipeline&>(typeless)));
+    return RemotePromise<AnyPointer>(kj::mv(promise), kj::mv(pipeline));
+  }
+
+  void setDeadline(kj::TimePoint deadline) override {
+    inner->setDeadline(deadline);
+  }
+
+  const void* getBrand() override {
+    return nullptr;
+  }
+
+private:
+  kj::Own<RequestHook> inner;
+  kj::Own<Impl> impl;
+  uint index;
+};
+
+class TwoPartyClientPool::PooledClient final: public ClientHook, public kj::Refcounted {
+public:
+  explicit PooledClient(kj::Own<Impl>&& impl): impl(kj::mv(impl)) {}
+
+  Request<AnyPointer, AnyPointer> newCall(
+      uint64_t interfaceId, uint16_t methodId, kj::Maybe<MessageSize> sizeHint) override {
+    uint index = impl->choose();
+    auto request = impl->backends[index].bootstrap->newCall(interfaceId, methodId, sizeHint);
+    AnyPointer::Builder params = request;
+    return Request<AnyPointer, AnyPointer>(params, kj::heap<TrackedRequest>(
+        RequestHook::from(kj::mv(request)), kj::addRef(*impl), index));
+  }
+
+  VoidPromiseAndPipeline call(uint64_t interfaceId, uint16_t methodId,
+                              kj::Own<CallContextHook>&& context) override {
+    uint index = impl->choose();
+    auto tracker = impl->startCall(index);
+    auto errorTracker = kj::addRef(*tracker);
+    auto result = impl->backends[index].bootstrap->call(interfaceId, methodId, kj::mv(context));
+    result.promise = result.promise.then([tracker = kj::mv(tracker)]() mutable {
+      tracker->succeeded();
+    }, [tracker = kj::mv(errorTracker)](kj::Exception&& exception) mutable {
+      tracker->failed();
+      kj::throwFatalException(kj::mv(exception));
+    });
+    return result;
+  }
+
+  kj::Maybe<ClientHook&> getResolved() override {
+    return nullptr;
+  }
+
+  kj::Maybe<kj::Promise<kj::Own<ClientHook>>> whenMoreResolved() override {
+    return nullptr;
+  }
+
+  kj::Own<ClientHook> addRef() override {
+    return kj::addRef(*this);
+  }
+
+  const void* getBrand() override {
+    return &POOLED_CLIENT_BRAND;
+  }
+
+private:
+  kj::Own<Impl> impl;
+};
+
+TwoPartyClientPool::TwoPartyClientPool(
+    kj::Timer& timer, kj::Array<kj::Own<kj::NetworkAddress>> servers, Policy policy,
+    kj::Duration reconnectDelay)
+    : impl(kj::refcounted<Impl>(timer, kj::mv(servers), policy, reconnectDelay)) {}
+TwoPartyClientPool::~TwoPartyClientPool() noexcept(false) {}
+
+Capability::Client TwoPartyClientPool::bootstrap() {
+  return Capability::Client(kj::refcounted<PooledClient>(kj::addRef(*impl)));
+}
+
+kj::Array<TwoPartyClientPool::BackendStats> TwoPartyClientPool::getStats() const {
+  return KJ_MAP(backend, impl->backends) -> BackendStats {
+    return {
+      backend.state == Impl::State::CONNECTED,
+      backend.inFlight, backend.calls, backend.failures, backend.connects,
+      static_cast<int64_t>(backend.latencyNs) * kj::NANOSECONDS
+    };
+  };
+}
+
 }  // namespace capnp
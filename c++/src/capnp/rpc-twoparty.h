@@ -28,6 +28,7 @@
 #include "rpc.h"
 #include "message.h"
 #include <kj/async-io.h>
+#include <kj/vector.h>
 #include <capnp/rpc-twoparty.capnp.h>
 
 namespace capnp {
@@ -51,15 +52,52 @@ class TwoPartyVatNetwork: public TwoPartyVatNetworkBase,
   // Use `TwoPartyVatNetwork` only if you need the advanced features.
 
 public:
+  enum class Compression: uint8_t {
+    NONE,
+    // Write each message as-is, exactly as `capnp::writeMessage()` would. This is the only format
+    // understood by peers which predate compression negotiation.
+
+    PACKED,
+    // Collect the messages sent during each turn of the event loop into a frame, and pack it
+    // (see `serialize-packed.h`).
+
+    DEFLATE,
+    // Like PACKED, but additionally compress frames with zlib. The compressor is not reset between
+    // frames, so that small messages benefit from dictionary context built up by earlier ones.
+    // Requires that Cap'n Proto was built with zlib; otherwise behaves like PACKED.
+
+    DEFLATE_FAST
+    // Like DEFLATE, using zlib's fastest compression level.
+  };
+
   TwoPartyVatNetwork(kj::AsyncIoStream& stream, rpc::twoparty::Side side,
-                     ReaderOptions receiveOptions = ReaderOptions());
+                     ReaderOptions receiveOptions = ReaderOptions(),
+                     Compression compression = Compression::NONE);
+  // If `compression` is not NONE, the network offers it to the peer as soon as it is constructed,
+  // and writes in the best format that both sides support once the peer answers. Until then, and
+  // forever if the peer doesn't know about negotiation (it will just reply `unimplemented`),
+  // messages are written uncompressed. Independently of `compression`, the network always lets
+  // the peer choose any supported format for the messages it sends us.
+
+  TwoPartyVatNetwork(kj::AsyncCapabilityStream& stream, uint maxFdsPerMessage,
+                     rpc::twoparty::Side side, ReaderOptions receiveOptions = ReaderOptions());
+  // Like the above, but over a stream which can carry file descriptors (typically a Unix socket),
+  // allowing capabilities backed by FDs (see `Capability::Server::getFd()`) to take their
+  // descriptors with them. Up to `maxFdsPerMessage` descriptors are accepted with each incoming
+  // message; any more are closed. Compression is not supported in this mode, since descriptors
+  // must accompany the exact message they belong to.
   KJ_DISALLOW_COPY(TwoPartyVatNetwork);
+  ~TwoPartyVatNetwork() noexcept(false);
 
   kj::Promise<void> onDisconnect() { return disconnectPromise.addBranch(); }
   // Returns a promise that resolves when the peer disconnects.
 
   rpc::twoparty::Side getSide() { return side; }
 
+  Compression getCompression() { return writeCompression; }
+  // Format in which outgoing messages are currently written. This is NONE until negotiation
+  // completes.
+
   // implements VatNetwork -----------------------------------------------------
 
   kj::Maybe<kj::Own<TwoPartyVatNetworkBase::Connection>> connect(
@@ -69,17 +107,35 @@ public:
 private:
   class OutgoingMessageImpl;
   class IncomingMessageImpl;
+  class FrameWriter;
+  class FrameReader;
 
   kj::AsyncIoStream& stream;
+  kj::Maybe<kj::AsyncCapabilityStream&> capStream;
+  uint maxFdsPerMessage = 0;
   rpc::twoparty::Side side;
   MallocMessageBuilder peerVatId;
   ReaderOptions receiveOptions;
   bool accepted = false;
 
+  Compression requestedCompression;
+  Compression writeCompression = Compression::NONE;
+  bool sentHello = false;
+
+  kj::Maybe<kj::Own<FrameWriter>> frameWriter;
+  // Non-null once we have told the peer that we're switching to framed writes.
+
+  kj::Maybe<kj::Own<FrameReader>> frameReader;
+  // Non-null once the peer has told us that it's switching to framed writes.
+
   kj::Maybe<kj::Promise<void>> previousWrite;
   // Resolves when the previous write completes.  This effectively serves as the write queue.
   // Becomes null when shutdown() is called.
 
+  kj::Vector<kj::Own<OutgoingMessageImpl>> queuedWrites;
+  // Unframed messages sent since the last write was started.  They are all written together, in
+  // one system call, once `previousWrite` completes.
+
   kj::Own<kj::PromiseFulfiller<kj::Own<TwoPartyVatNetworkBase::Connection>>> acceptFulfiller;
   // Fulfiller for the promise returned by acceptConnectionAsRefHost() on the client side, or the
   // second call on the server side.  Never fulfilled, because there is only one connection.
@@ -104,12 +160,22 @@ private:
   kj::Own<TwoPartyVatNetworkBase::Connection> asConnection();
   // Returns a pointer to this with the disposer set to disconnectFulfiller.
 
+  void queueWrite(kj::Own<OutgoingMessageImpl> message);
+  kj::Promise<void> writeQueued(kj::ArrayPtr<kj::Own<OutgoingMessageImpl>> messages);
+  void sendTransportMessage(uint16_t type, kj::ArrayPtr<const byte> payload);
+  bool handleTransportMessage(MessageReader& message);
+  kj::Promise<kj::Maybe<kj::Own<IncomingRpcMessage>>> readMessage();
+  kj::Promise<kj::Maybe<kj::Own<IncomingRpcMessage>>> deliverMessage(
+      kj::Own<MessageReader> message, kj::Array<kj::AutoCloseFd> fds);
+
   // implements Connection -----------------------------------------------------
 
   rpc::twoparty::VatId::Reader getPeerVatId() override;
   kj::Own<OutgoingRpcMessage> newOutgoingMessage(uint firstSegmentWordSize) override;
   kj::Promise<kj::Maybe<kj::Own<IncomingRpcMessage>>> receiveIncomingMessage() override;
   kj::Promise<void> shutdown() override;
+  size_t getBufferedBytes() override;
+  void trimBuffers() override;
 };
 
 class TwoPartyServer: private kj::TaskSet::ErrorHandler {
@@ -122,6 +188,9 @@ public:
   void accept(kj::Own<kj::AsyncIoStream>&& connection);
   // Accepts the connection for servicing.
 
+  void accept(kj::Own<kj::AsyncCapabilityStream>&& connection, uint maxFdsPerMessage);
+  // Accepts a connection capable of transmitting file descriptors.
+
   kj::Promise<void> listen(kj::ConnectionReceiver& listener);
   // Listens for connections on the given listener. The returned promise never resolves unless an
   // exception is thrown while trying to accept. You may discard the returned promise to cancel
@@ -141,6 +210,7 @@ class TwoPartyClient {
 
 public:
   explicit TwoPartyClient(kj::AsyncIoStream& connection);
+  TwoPartyClient(kj::AsyncCapabilityStream& connection, uint maxFdsPerMessage);
   TwoPartyClient(kj::AsyncIoStream& connection, Capability::Client bootstrapInterface,
                  rpc::twoparty::Side side = rpc::twoparty::Side::CLIENT);
 
@@ -154,4 +224,68 @@ private:
   RpcSystem<rpc::twoparty::VatId> rpcSystem;
 };
 
+class TwoPartyClientPool {
+  // Maintains two-party connections to several equivalent servers and presents their bootstrap
+  // interfaces as a single capability, spreading each call over the servers.  Only suitable for
+  // stateless interfaces, since consecutive calls may go to different servers (and capabilities
+  // returned by a call remain tied to the server which returned them).
+  //
+  // A server whose connection drops is reconnected, and its bootstrap interface requested again,
+  // without disturbing the capability handed to the application.  Calls in flight on the failed
+  // connection fail with DISCONNECTED and are not retried.  While a server is unreachable, calls
+  // go to the others; a dropped connection or failed connection attempt is retried after
+  // `reconnectDelay`.
+
+public:
+  enum class Policy {
+    LEAST_OUTSTANDING,
+    // Send each call to the server with the fewest calls in flight, rotating among ties.
+
+    POWER_OF_TWO_CHOICES
+    // Pick two servers at random and send the call to the one with the lower expected wait:
+    // calls in flight times a moving average of its recent response latency.  Cheaper than
+    // LEAST_OUTSTANDING for large pools and adapts to servers of differing speed.
+  };
+
+  struct BackendStats {
+    bool connected;
+    // Whether the connection is currently up.
+
+    uint inFlight;
+    // Calls sent through the pool which haven't completed.
+
+    uint64_t calls;
+    uint64_t failures;
+    // Calls sent so far, and how many of them threw.
+
+    uint connects;
+    // Connection attempts so far.
+
+    kj::Duration latency;
+    // Moving average of the time from sending a call to its completion.
+  };
+
+  TwoPartyClientPool(kj::Timer& timer, kj::Array<kj::Own<kj::NetworkAddress>> servers,
+                     Policy policy = Policy::LEAST_OUTSTANDING,
+                     kj::Duration reconnectDelay = 1 * kj::SECONDS);
+  // Starts connecting to all `servers`.  `timer` must outlive the pool and any capabilities
+  // obtained from it.
+  ~TwoPartyClientPool() noexcept(false);
+  KJ_DISALLOW_COPY(TwoPartyClientPool);
+
+  Capability::Client bootstrap();
+  // Returns the load-balanced capability.  It keeps the connections alive, so the pool object
+  // itself may be destroyed first.
+
+  kj::Array<BackendStats> getStats() const;
+  // Statistics for each server, in the order they were given to the constructor.
+
+private:
+  class Impl;
+  class PooledClient;
+  class TrackedRequest;
+
+  kj::Own<Impl> impl;
+};
+
 }  // namespace capnp
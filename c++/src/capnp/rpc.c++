@@ -26,10 +26,12 @@
 #include <kj/async.h>
 #include <kj/one-of.h>
 #include <kj/function.h>
+#include <kj/timer.h>
 #include <functional>  // std::greater
 #include <unordered_map>
 #include <map>
 #include <queue>
+#include <algorithm>
 #include <capnp/rpc.capnp.h>
 
 namespace capnp {
@@ -54,6 +56,10 @@ constexpr const uint CAP_DESCRIPTOR_SIZE_HINT = sizeInWords<rpc::CapDescriptor>(
 
 constexpr const uint64_t MAX_SIZE_HINT = 1 << 20;
 
+constexpr const uint64_t MAX_TIMEOUT_NANOS = 365ull * 24 * 3600 * 1000000000;
+// Incoming `Call.timeoutNanos` values above this are treated as no deadline at all.  Besides
+// being meaningless, they might overflow the signed `kj::Duration`.
+
 uint copySizeHint(MessageSize size) {
   uint64_t sizeHint = size.wordCount + size.capCount * CAP_DESCRIPTOR_SIZE_HINT;
   return kj::min(MAX_SIZE_HINT, sizeHint);
@@ -149,6 +155,14 @@ uint exceptionSizeHint(const kj::Exception& exception) {
 
 // =======================================================================================
 
+template <typename Map>
+size_t mapBytes(const Map& map) {
+  // Approximate heap usage of a std::unordered_map: a node per entry, holding the value, a link
+  // and the cached hash, plus a pointer per bucket.
+  return map.size() * (sizeof(typename Map::value_type) + 2 * sizeof(void*)) +
+         map.bucket_count() * sizeof(void*);
+}
+
 template <typename Id, typename T>
 class ExportTable {
   // Table mapping integers to T, where the integers are chosen locally.
@@ -195,6 +209,36 @@ public:
     }
   }
 
+  size_t size() const {
+    // Number of IDs in use.
+    return slots.size() - freeIds.size();
+  }
+
+  size_t memoryBytes() const {
+    return slots.capacity() * sizeof(T) + freeIds.size() * sizeof(Id);
+  }
+
+  void trim() {
+    // Drops free slots at the end of the table and releases unused capacity.  IDs in use are
+    // unaffected.  Entries may move, so no references to them may be held across this call.
+
+    std::vector<bool> isFree(slots.size(), false);
+    while (!freeIds.empty()) {
+      isFree[freeIds.top()] = true;
+      freeIds.pop();
+    }
+
+    size_t newSize = slots.size();
+    while (newSize > 0 && isFree[newSize - 1]) --newSize;
+
+    kj::Vector<T> newSlots(newSize);
+    for (Id i = 0; i < newSize; i++) {
+      newSlots.add(kj::mv(slots[i]));
+      if (isFree[i]) freeIds.push(i);
+    }
+    slots = kj::mv(newSlots);
+  }
+
 private:
   kj::Vector<T> slots;
   std::priority_queue<Id, std::vector<Id>, std::greater<Id>> freeIds;
@@ -250,6 +294,16 @@ public:
     }
   }
 
+  size_t memoryBytes() const {
+    // Heap memory only; `low` is part of the enclosing object.
+    return mapBytes(high);
+  }
+
+  void trim() {
+    // Releases hash buckets left over from a time when the table was bigger.
+    high.rehash(0);
+  }
+
 private:
   T low[16];
   std::unordered_map<Id, T> high;
@@ -257,6 +311,33 @@ private:
 
 // =======================================================================================
 
+class RpcConnectionState;
+
+class ConnectionRegistry {
+  // The parts of the RpcSystem which a connection needs in order to take part in three-party
+  // handoffs: the other connections, and the table of provisions awaiting pickup.  Implemented by
+  // RpcSystemBase::Impl.  Since the RpcSystem may be destroyed before the RpcConnectionStates
+  // (which are refcounted), a connection must only use this while it is still connected.
+
+public:
+  virtual kj::Maybe<RpcConnectionState&> findConnection(const void* brand) = 0;
+  // Find the connection whose RpcClients carry the given brand, if it's one of ours and still
+  // connected.
+
+  virtual RpcConnectionState& getConnectionState(
+      kj::Own<VatNetworkBase::Connection>&& connection) = 0;
+  // Start managing a new connection, or return the state of the existing one.
+
+  virtual kj::Promise<void> provide(kj::String key, kj::Own<ClientHook> cap) = 0;
+  // Offer `cap` for pickup by an `Accept` with the same key (see VatNetwork::Connection::
+  // getProvideKey()).  The returned promise resolves when it has been picked up; canceling it
+  // withdraws the offer.
+
+  virtual kj::Promise<kj::Own<ClientHook>> accept(kj::String key) = 0;
+  // Pick up the capability provided under `key`, waiting for the `Provide` if it hasn't arrived
+  // yet.  Canceling the returned promise stops waiting.
+};
+
 class RpcConnectionState final: public kj::TaskSet::ErrorHandler, public kj::Refcounted {
 public:
   struct DisconnectInfo {
@@ -267,12 +348,14 @@ public:
   RpcConnectionState(BootstrapFactoryBase& bootstrapFactory,
                      kj::Maybe<RealmGateway<>::Client> gateway,
                      kj::Maybe<SturdyRefRestorerBase&> restorer,
+                     ConnectionRegistry& registry,
                      kj::Own<VatNetworkBase::Connection>&& connectionParam,
                      kj::Own<kj::PromiseFulfiller<DisconnectInfo>>&& disconnectFulfiller,
-                     size_t flowLimit)
+                     size_t flowLimit, kj::Maybe<RpcObserver&> observer,
+                     kj::Maybe<kj::Timer&> timer)
       : bootstrapFactory(bootstrapFactory), gateway(kj::mv(gateway)),
-        restorer(restorer), disconnectFulfiller(kj::mv(disconnectFulfiller)), flowLimit(flowLimit),
-        tasks(*this) {
+        restorer(restorer), registry(registry), disconnectFulfiller(kj::mv(disconnectFulfiller)),
+        flowLimit(flowLimit), observer(observer), timer(timer), tasks(*this) {
     connection.init<Connected>(kj::mv(connectionParam));
     tasks.add(messageLoop());
   }
@@ -283,6 +366,7 @@ public:
     }
 
     QuestionId questionId;
+    flushControl();  // Question IDs may be reused once their `Finish` is sent.
     auto& question = questions.next(questionId);
 
     question.isAwaitingReturn = true;
@@ -295,7 +379,7 @@ public:
     paf.promise = paf.promise.attach(kj::addRef(*questionRef));
 
     {
-      auto message = connection.get<Connected>()->newOutgoingMessage(
+      auto message = newOutgoingMessage(
           objectId.targetSize().wordCount + messageSizeHint<rpc::Bootstrap>());
 
       auto builder = message->getBody().initAs<rpc::Message>().initBootstrap();
@@ -330,6 +414,7 @@ public:
       kj::Vector<kj::Own<ClientHook>> clientsToRelease;
       kj::Vector<kj::Promise<kj::Own<RpcResponse>>> tailCallsToRelease;
       kj::Vector<kj::Promise<void>> resolveOpsToRelease;
+      kj::Vector<kj::Promise<void>> handoffOpsToRelease;
 
       // All current questions complete with exceptions.
       questions.forEach([&](QuestionId id, Question& question) {
@@ -351,6 +436,8 @@ public:
         KJ_IF_MAYBE(context, answer.callContext) {
           context->requestCancel();
         }
+
+        handoffOpsToRelease.add(kj::mv(answer.handoffOp));
       });
 
       exports.forEach([&](ExportId id, Export& exp) {
@@ -377,9 +464,14 @@ public:
              *newException);
     }
 
+    // Control messages still queued refer to tables that no longer exist.
+    pendingControl.clear();
+    pendingReleases.clear();
+    controlQueued = 0;
+
     // Send an abort message, but ignore failure.
     kj::runCatchingExceptions([&]() {
-      auto message = connection.get<Connected>()->newOutgoingMessage(
+      auto message = newOutgoingMessage(
           messageSizeHint<void>() + exceptionSizeHint(exception));
       fromException(exception, message->getBody().getAs<rpc::Message>().initAbort());
       message->send();
@@ -405,6 +497,63 @@ public:
     maybeUnblockFlow();
   }
 
+  void setObserver(kj::Maybe<RpcObserver&> newObserver) {
+    observer = newObserver;
+  }
+
+  void setTimer(kj::Maybe<kj::Timer&> newTimer) {
+    timer = newTimer;
+  }
+
+  kj::Maybe<RpcConnectionStats> getStats() {
+    // Returns null if disconnected.
+
+    if (!connection.is<Connected>()) return nullptr;
+    auto& conn = *connection.get<Connected>();
+
+    RpcConnectionStats stats;
+    stats.peerVatId = conn.baseGetPeerVatId();
+    stats.exports = exports.size();
+    stats.questions = questions.size();
+    stats.imports = 0;
+    imports.forEach([&](ImportId, Import& import) {
+      if (import.importClient != nullptr) ++stats.imports;
+    });
+    stats.answers = 0;
+    answers.forEach([&](AnswerId, Answer& answer) {
+      if (answer.active) ++stats.answers;
+    });
+    stats.tableBytes = exports.memoryBytes() + questions.memoryBytes() + answers.memoryBytes() +
+        imports.memoryBytes() + embargoes.memoryBytes() + mapBytes(exportsByCap) +
+        pendingControl.capacity() * sizeof(PendingControl) + mapBytes(pendingReleases);
+    stats.bufferedBytes = conn.getBufferedBytes();
+    stats.callWordsInFlight = callWordsInFlight;
+    return stats;
+  }
+
+  bool trimIfIdle() {
+    // If no messages were sent or received since the last call, compacts the tables and asks the
+    // connection to release spare buffer space, returning true.
+
+    if (activeSinceTrim || !connection.is<Connected>()) {
+      activeSinceTrim = false;
+      return false;
+    }
+
+    exports.trim();
+    questions.trim();
+    answers.trim();
+    imports.trim();
+    embargoes.trim();
+    exportsByCap.rehash(0);
+    if (pendingControl.size() == 0) {
+      pendingControl = nullptr;
+      pendingReleases.rehash(0);
+    }
+    connection.get<Connected>()->trimBuffers();
+    return true;
+  }
+
 private:
   class RpcClient;
   class ImportClient;
@@ -433,6 +582,13 @@ private:
   // means that any time we read an ID from a received message, its type should invert.
   // TODO(cleanup):  Perhaps we could enforce that in a type-safe way?  Hmm...
 
+  struct CallCounter: public kj::Refcounted {
+    // Counts calls that were sent to a particular RpcClient and have not yet returned.  See
+    // PromiseClient::resolve().
+
+    uint count = 0;
+  };
+
   struct Question {
     kj::Array<ExportId> paramExports;
     // List of exports that were sent in the request.  If the response has `releaseParamCaps` these
@@ -451,6 +607,16 @@ private:
     bool skipFinish = false;
     // If true, don't send a Finish message.
 
+    bool isObserved = false;
+    uint16_t methodId = 0;
+    uint64_t interfaceId = 0;
+    kj::TimePoint sendTime = kj::origin<kj::TimePoint>();
+    // If an observer was installed when the call was sent, the call's identity and send time,
+    // to be reported along with the `Return`.
+
+    kj::Maybe<kj::Own<CallCounter>> callCounter;
+    // The target's call counter, if it had one.  Decremented when the `Return` arrives.
+
     inline bool operator==(decltype(nullptr)) const {
       return !isAwaitingReturn && selfRef == nullptr;
     }
@@ -482,6 +648,13 @@ private:
     kj::Array<ExportId> resultExports;
     // List of exports that were sent in the results.  If the finish has `releaseResultCaps` these
     // will need to be released.
+
+    kj::Promise<void> handoffOp = nullptr;
+    // For a `Provide` or `Accept`, the operation waiting for the other half of the handoff, which
+    // then sends the `Return`.
+
+    bool handoffPending = false;
+    // True while `handoffOp` has yet to send the `Return`.
   };
 
   struct Export {
@@ -535,6 +708,7 @@ private:
   BootstrapFactoryBase& bootstrapFactory;
   kj::Maybe<RealmGateway<>::Client> gateway;
   kj::Maybe<SturdyRefRestorerBase&> restorer;
+  ConnectionRegistry& registry;
 
   typedef kj::Own<VatNetworkBase::Connection> Connected;
   typedef kj::Exception Disconnected;
@@ -565,6 +739,39 @@ private:
   // If non-null, we're currently blocking incoming messages waiting for callWordsInFlight to drop
   // below flowLimit. Fulfill this to un-block.
 
+  kj::Maybe<RpcObserver&> observer;
+  // If non-null, notified of calls and messages. See RpcSystem::setObserver().
+
+  kj::Maybe<kj::Timer&> timer;
+  // If non-null, used to convert call deadlines to and from timeouts, and to enforce them. See
+  // RpcSystem::setTimer().
+
+  struct PendingControl {
+    // A message waiting to be sent. See deferFinish(), deferRelease() and deferMessage().
+
+    rpc::Message::Which type;
+    uint32_t id;
+    // The question ID (Finish) or import ID (Release).
+
+    uint32_t referenceCount;
+    // For Release, the number of references to release. For Finish, 1 to release the result caps,
+    // 0 otherwise.
+
+    kj::Own<OutgoingRpcMessage> message;
+    // For any other type, the message itself, already built.
+  };
+
+  kj::Vector<PendingControl> pendingControl;
+  std::unordered_map<ImportId, size_t> pendingReleases;
+  // Queued control messages in the order they were requested, and the index in `pendingControl`
+  // of each import's Release, into which later releases of the same import are merged.
+
+  size_t controlQueued = 0;
+  // Number of control messages requested since the last flush, counting merged ones.
+
+  bool activeSinceTrim = true;
+  // Whether any message was sent or received since the last trimIfIdle().
+
   kj::TaskSet tasks;
 
   // =====================================================================================
@@ -598,6 +805,10 @@ private:
     // that other client -- return a reference to the other client, transitively.  Otherwise,
     // return a new reference to *this.
 
+    kj::Maybe<kj::Own<CallCounter>> callCounter;
+    // If non-null, counts calls sent to this client that have not yet returned.  Set up by a
+    // PromiseClient wrapping this client.
+
     // implements ClientHook -----------------------------------------
 
     Request<AnyPointer, AnyPointer> newCall(
@@ -643,9 +854,7 @@ private:
         return newBrokenRequest(kj::cp(connectionState->connection.get<Disconnected>()), sizeHint);
       }
 
-      auto request = kj::heap<RpcRequest>(
-          *connectionState, *connectionState->connection.get<Connected>(),
-          sizeHint, kj::addRef(*this));
+      auto request = kj::heap<RpcRequest>(*connectionState, sizeHint, kj::addRef(*this));
       auto callBuilder = request->getCall();
 
       callBuilder.setInterfaceId(interfaceId);
@@ -688,6 +897,9 @@ private:
       auto request = newCallNoIntercept(interfaceId, methodId, params.targetSize());
 
       request.set(params);
+      KJ_IF_MAYBE(d, context->getDeadline()) {
+        request.setDeadline(*d);
+      }
       context->releaseParams();
 
       // We can and should propagate cancellation.
@@ -726,12 +938,7 @@ private:
 
         // Send a message releasing our remote references.
         if (remoteRefcount > 0 && connectionState->connection.is<Connected>()) {
-          auto message = connectionState->connection.get<Connected>()->newOutgoingMessage(
-              messageSizeHint<rpc::Release>());
-          rpc::Release::Builder builder = message->getBody().initAs<rpc::Message>().initRelease();
-          builder.setId(importId);
-          builder.setReferenceCount(remoteRefcount);
-          message->send();
+          connectionState->deferRelease(importId, remoteRefcount);
         }
       });
     }
@@ -741,6 +948,14 @@ private:
       ++remoteRefcount;
     }
 
+    void setFdIfMissing(kj::AutoCloseFd newFd) {
+      // The peer attached an FD to this capability. If we already have one from an earlier copy of
+      // the same import, keep that (the new one refers to the same object anyway).
+      if (fd == nullptr) {
+        fd = kj::mv(newFd);
+      }
+    }
+
     kj::Maybe<ExportId> writeDescriptor(rpc::CapDescriptor::Builder descriptor) override {
       descriptor.setReceiverHosted(importId);
       return nullptr;
@@ -766,8 +981,17 @@ private:
       return nullptr;
     }
 
+    kj::Maybe<int> getFd() override {
+      KJ_IF_MAYBE(f, fd) {
+        return f->get();
+      } else {
+        return nullptr;
+      }
+    }
+
   private:
     ImportId importId;
+    kj::Maybe<kj::AutoCloseFd> fd;
 
     uint remoteRefcount = 0;
     // Number of times we've received this import from the peer.
@@ -843,6 +1067,16 @@ private:
                 // will cause the connection to be terminated.
                 connectionState.tasks.add(kj::mv(e));
               })) {
+      if (cap->getBrand() == &connectionState) {
+        // Count the calls we forward to `initial`, so that resolve() can tell whether any are
+        // still on their way through the peer.
+        auto& initialClient = kj::downcast<RpcClient>(*cap);
+        if (initialClient.callCounter == nullptr) {
+          initialClient.callCounter = kj::refcounted<CallCounter>();
+        }
+        callsInFlight = kj::addRef(*KJ_ASSERT_NONNULL(initialClient.callCounter));
+      }
+
       // Create a client that starts out forwarding all calls to `initial` but, once `eventual`
       // resolves, will forward there instead.  In addition, `whenMoreResolved()` will return a fork
       // of `eventual`.  Note that this means the application could hold on to `eventual` even after
@@ -897,7 +1131,7 @@ private:
             ->newCall(interfaceId, methodId, sizeHint);
       }
 
-      receivedCall = true;
+      if (callsInFlight == nullptr) receivedCall = true;
       return cap->newCall(interfaceId, methodId, sizeHint);
     }
 
@@ -923,7 +1157,7 @@ private:
         };
       }
 
-      receivedCall = true;
+      if (callsInFlight == nullptr) receivedCall = true;
       return cap->call(interfaceId, methodId, kj::mv(context));
     }
 
@@ -951,18 +1185,30 @@ private:
     kj::Promise<void> resolveSelfPromise;
 
     bool receivedCall = false;
+    // Set when the promise was used in a way that might make calls to it through the peer which
+    // we can't count: it was sent to the peer or targeted by a message, or we have no call
+    // counter for `cap`.
+
+    kj::Maybe<kj::Own<CallCounter>> callsInFlight;
+    // Counts the calls made through `cap` that have not yet returned, if `cap` is one of ours.
 
     void resolve(kj::Own<ClientHook> replacement, bool isError) {
+      bool callsMayBeInFlight = receivedCall;
+      KJ_IF_MAYBE(c, callsInFlight) {
+        if (c->get()->count > 0) callsMayBeInFlight = true;
+      }
+
       const void* replacementBrand = replacement->getBrand();
       if (replacementBrand != connectionState.get() &&
           replacementBrand != &ClientHook::NULL_CAPABILITY_BRAND &&
-          receivedCall && !isError && connectionState->connection.is<Connected>()) {
-        // The new capability is hosted locally, not on the remote machine.  And, we had made calls
-        // to the promise.  We need to make sure those calls echo back to us before we allow new
-        // calls to go directly to the local capability, so we need to set a local embargo and send
-        // a `Disembargo` to echo through the peer.
-
-        auto message = connectionState->connection.get<Connected>()->newOutgoingMessage(
+          callsMayBeInFlight && !isError && connectionState->connection.is<Connected>()) {
+        // The new capability is hosted locally, not on the remote machine.  And, calls we made to
+        // the promise may still be on their way.  We need to make sure those calls echo back to us
+        // before we allow new calls to go directly to the local capability, so we need to set a
+        // local embargo and send a `Disembargo` to echo through the peer.  (If every call has
+        // already returned, it has already been delivered, so there is nothing to wait for.)
+
+        auto message = connectionState->newOutgoingMessage(
             messageSizeHint<rpc::Disembargo>() + MESSAGE_TARGET_SIZE_HINT);
 
         auto disembargo = message->getBody().initAs<rpc::Message>().initDisembargo();
@@ -991,8 +1237,10 @@ private:
         // client instead.
         replacement = newLocalPromiseClient(kj::mv(embargoPromise));
 
-        // Send the `Disembargo`.
-        message->send();
+        // Send the `Disembargo` along with this turn's other control messages, so that many
+        // promises resolving at once cost one write.  Nothing can be sent to the old target after
+        // this point, and new questions flush the queue first, so the delay is harmless.
+        connectionState->deferMessage(kj::mv(message));
       }
 
       cap = kj::mv(replacement);
@@ -1072,6 +1320,9 @@ private:
         ++exp.refcount;
         descriptor.setSenderHosted(iter->second);
         return iter->second;
+      } else KJ_IF_MAYBE(vineId, writeThirdPartyDescriptor(*inner, descriptor)) {
+        // The capability lives in another vat, which our peer can reach directly.
+        return *vineId;
       } else {
         // This is the first time we've seen this capability.
         ExportId exportId;
@@ -1093,22 +1344,62 @@ private:
     }
   }
 
-  kj::Array<ExportId> writeDescriptors(kj::ArrayPtr<kj::Maybe<kj::Own<ClientHook>>> capTable,
+  kj::Array<ExportId> writeDescriptors(OutgoingRpcMessage& message,
+                                       kj::ArrayPtr<kj::Maybe<kj::Own<ClientHook>>> capTable,
                                        rpc::Payload::Builder payload) {
     auto capTableBuilder = payload.initCapTable(capTable.size());
     kj::Vector<ExportId> exports(capTable.size());
+    kj::Vector<int> fds;
     for (uint i: kj::indices(capTable)) {
       KJ_IF_MAYBE(cap, capTable[i]) {
         KJ_IF_MAYBE(exportId, writeDescriptor(**cap, capTableBuilder[i])) {
           exports.add(*exportId);
         }
+        attachFd(**cap, capTableBuilder[i], fds);
       } else {
         capTableBuilder[i].setNone();
       }
     }
+    if (fds.size() > 0) {
+      message.setFds(fds.releaseAsArray());
+    }
     return exports.releaseAsArray();
   }
 
+  void attachFd(ClientHook& cap, rpc::CapDescriptor::Builder descriptor, kj::Vector<int>& fds) {
+    // If `descriptor` exports a capability backed by a file descriptor, add the descriptor to
+    // `fds` and record its index. Capabilities hosted by the peer (or elsewhere) already came with
+    // whatever FD they have, so only our own exports are considered.
+
+    switch (descriptor.which()) {
+      case rpc::CapDescriptor::SENDER_HOSTED:
+      case rpc::CapDescriptor::SENDER_PROMISE:
+        break;
+      default:
+        return;
+    }
+
+    if (fds.size() >= 0xff) {
+      // The index wouldn't fit (0xff means "none"). The capability still works, just without its
+      // FD.
+      return;
+    }
+
+    ClientHook* inner = &cap;
+    for (;;) {
+      KJ_IF_MAYBE(resolved, inner->getResolved()) {
+        inner = resolved;
+      } else {
+        break;
+      }
+    }
+
+    KJ_IF_MAYBE(fd, inner->getFd()) {
+      descriptor.setAttachedFd(fds.size());
+      fds.add(*fd);
+    }
+  }
+
   kj::Maybe<kj::Own<ClientHook>> writeTarget(ClientHook& cap, rpc::MessageTarget::Builder target) {
     // If calls to the given capability should pass over this connection, fill in `target`
     // appropriately for such a call and return nullptr.  Otherwise, return a `ClientHook` to which
@@ -1195,17 +1486,23 @@ private:
       }
 
       // OK, we have to send a `Resolve` message.
-      auto message = connection.get<Connected>()->newOutgoingMessage(
+      auto message = newOutgoingMessage(
           messageSizeHint<rpc::Resolve>() + sizeInWords<rpc::CapDescriptor>() + 16);
       auto resolve = message->getBody().initAs<rpc::Message>().initResolve();
       resolve.setPromiseId(exportId);
-      writeDescriptor(*exp.clientHook, resolve.initCap());
+      auto descriptor = resolve.initCap();
+      writeDescriptor(*exp.clientHook, descriptor);
+      kj::Vector<int> fds;
+      attachFd(*exp.clientHook, descriptor, fds);
+      if (fds.size() > 0) {
+        message->setFds(fds.releaseAsArray());
+      }
       message->send();
 
       return kj::READY_NOW;
     }, [this,exportId](kj::Exception&& exception) {
       // send error resolution
-      auto message = connection.get<Connected>()->newOutgoingMessage(
+      auto message = newOutgoingMessage(
           messageSizeHint<rpc::Resolve>() + exceptionSizeHint(exception) + 8);
       auto resolve = message->getBody().initAs<rpc::Message>().initResolve();
       resolve.setPromiseId(exportId);
@@ -1220,7 +1517,8 @@ private:
   // =====================================================================================
   // Interpreting CapDescriptor
 
-  kj::Own<ClientHook> import(ImportId importId, bool isPromise) {
+  kj::Own<ClientHook> import(ImportId importId, bool isPromise,
+                             kj::Maybe<kj::AutoCloseFd> fd = nullptr) {
     // Receive a new import.
 
     auto& import = imports[importId];
@@ -1237,6 +1535,10 @@ private:
     // We just received a copy of this import ID, so the remote refcount has gone up.
     importClient->addRemoteRef();
 
+    KJ_IF_MAYBE(f, fd) {
+      importClient->setFdIfMissing(kj::mv(*f));
+    }
+
     if (isPromise) {
       // We need to construct a PromiseClient around this import, if we haven't already.
       KJ_IF_MAYBE(c, import.appClient) {
@@ -1262,15 +1564,22 @@ private:
     }
   }
 
-  kj::Maybe<kj::Own<ClientHook>> receiveCap(rpc::CapDescriptor::Reader descriptor) {
+  kj::Maybe<kj::Own<ClientHook>> receiveCap(rpc::CapDescriptor::Reader descriptor,
+                                            kj::ArrayPtr<kj::AutoCloseFd> fds) {
+    uint fdIndex = descriptor.getAttachedFd();
+    kj::Maybe<kj::AutoCloseFd> fd;
+    if (fdIndex < fds.size() && fds[fdIndex] != nullptr) {
+      fd = kj::mv(fds[fdIndex]);
+    }
+
     switch (descriptor.which()) {
       case rpc::CapDescriptor::NONE:
         return nullptr;
 
       case rpc::CapDescriptor::SENDER_HOSTED:
-        return import(descriptor.getSenderHosted(), false);
+        return import(descriptor.getSenderHosted(), false, kj::mv(fd));
       case rpc::CapDescriptor::SENDER_PROMISE:
-        return import(descriptor.getSenderPromise(), true);
+        return import(descriptor.getSenderPromise(), true, kj::mv(fd));
 
       case rpc::CapDescriptor::RECEIVER_HOSTED:
         KJ_IF_MAYBE(exp, exports.find(descriptor.getReceiverHosted())) {
@@ -1298,8 +1607,7 @@ private:
       }
 
       case rpc::CapDescriptor::THIRD_PARTY_HOSTED:
-        // We don't support third-party caps, so use the vine instead.
-        return import(descriptor.getThirdPartyHosted().getVineId(), false);
+        return receiveThirdPartyCap(descriptor.getThirdPartyHosted());
 
       default:
         KJ_FAIL_REQUIRE("unknown CapDescriptor type") { break; }
@@ -1307,10 +1615,11 @@ private:
     }
   }
 
-  kj::Array<kj::Maybe<kj::Own<ClientHook>>> receiveCaps(List<rpc::CapDescriptor>::Reader capTable) {
+  kj::Array<kj::Maybe<kj::Own<ClientHook>>> receiveCaps(List<rpc::CapDescriptor>::Reader capTable,
+                                                        kj::ArrayPtr<kj::AutoCloseFd> fds) {
     auto result = kj::heapArrayBuilder<kj::Maybe<kj::Own<ClientHook>>>(capTable.size());
     for (auto cap: capTable) {
-      result.add(receiveCap(cap));
+      result.add(receiveCap(cap, fds));
     }
     return result.finish();
   }
@@ -1335,21 +1644,17 @@ private:
 
         // Send the "Finish" message (if the connection is not already broken).
         if (connectionState->connection.is<Connected>() && !question.skipFinish) {
-          auto message = connectionState->connection.get<Connected>()->newOutgoingMessage(
-              messageSizeHint<rpc::Finish>());
-          auto builder = message->getBody().getAs<rpc::Message>().initFinish();
-          builder.setQuestionId(id);
           // If we're still awaiting a return, then this request is being canceled, and we're going
           // to ignore any capabilities in the return message, so set releaseResultCaps true. If we
           // already received the return, then we've already built local proxies for the caps and
           // will send Release messages when those are destroyed.
-          builder.setReleaseResultCaps(question.isAwaitingReturn);
-          message->send();
+          connectionState->deferFinish(id, question.isAwaitingReturn);
         }
 
         // Check if the question has returned and, if so, remove it from the table.
-        // Remove question ID from the table.  Must do this *after* sending `Finish` to ensure that
-        // the ID is not re-allocated before the `Finish` message can be sent.
+        // Remove question ID from the table.  Must do this *after* queuing `Finish`; the pending
+        // `Finish` is flushed before any new question ID is allocated, so the ID cannot be
+        // re-allocated before the `Finish` message is sent.
         if (question.isAwaitingReturn) {
           // Still waiting for return, so just remove the QuestionRef pointer from the table.
           question.selfRef = nullptr;
@@ -1383,11 +1688,11 @@ private:
 
   class RpcRequest final: public RequestHook {
   public:
-    RpcRequest(RpcConnectionState& connectionState, VatNetworkBase::Connection& connection,
-               kj::Maybe<MessageSize> sizeHint, kj::Own<RpcClient>&& target)
+    RpcRequest(RpcConnectionState& connectionState, kj::Maybe<MessageSize> sizeHint,
+               kj::Own<RpcClient>&& target)
         : connectionState(kj::addRef(connectionState)),
           target(kj::mv(target)),
-          message(connection.newOutgoingMessage(
+          message(connectionState.newOutgoingMessage(
               firstSegmentSize(sizeHint, messageSizeHint<rpc::Call>() +
                   sizeInWords<rpc::Payload>() + MESSAGE_TARGET_SIZE_HINT))),
           callBuilder(message->getBody().getAs<rpc::Message>().initCall()),
@@ -1416,6 +1721,9 @@ private:
         auto replacement = redirect->get()->newCall(
             callBuilder.getInterfaceId(), callBuilder.getMethodId(), paramsBuilder.targetSize());
         replacement.set(paramsBuilder);
+        KJ_IF_MAYBE(d, deadline) {
+          replacement.setDeadline(*d);
+        }
         return replacement.send();
       } else {
         auto sendResult = sendInternal(false);
@@ -1477,6 +1785,10 @@ private:
       return TailInfo { questionId, kj::mv(promise), kj::mv(pipeline) };
     }
 
+    void setDeadline(kj::TimePoint newDeadline) override {
+      deadline = newDeadline;
+    }
+
     const void* getBrand() override {
       return connectionState.get();
     }
@@ -1489,6 +1801,7 @@ private:
     BuilderCapabilityTable capTable;
     rpc::Call::Builder callBuilder;
     AnyPointer::Builder paramsBuilder;
+    kj::Maybe<kj::TimePoint> deadline;
 
     struct SendInternalResult {
       kj::Own<QuestionRef> questionRef;
@@ -1496,12 +1809,22 @@ private:
     };
 
     SendInternalResult sendInternal(bool isTailCall) {
+      KJ_IF_MAYBE(d, deadline) {
+        KJ_IF_MAYBE(t, connectionState->timer) {
+          // Send the time remaining. If there is none left, send the smallest possible timeout
+          // rather than zero, which would mean no deadline at all.
+          auto now = t->now();
+          callBuilder.setTimeoutNanos(*d > now ? (*d - now) / kj::NANOSECONDS : 1);
+        }
+      }
+
       // Build the cap table.
       auto exports = connectionState->writeDescriptors(
-          capTable.getTable(), callBuilder.getParams());
+          *message, capTable.getTable(), callBuilder.getParams());
 
       // Init the question table.  Do this after writing descriptors to avoid interference.
       QuestionId questionId;
+      connectionState->flushControl();  // Question IDs may be reused once their `Finish` is sent.
       auto& question = connectionState->questions.next(questionId);
       question.isAwaitingReturn = true;
       question.paramExports = kj::mv(exports);
@@ -1530,6 +1853,21 @@ private:
         question.isAwaitingReturn = false;
         question.skipFinish = true;
         result.questionRef->reject(kj::mv(*exception));
+      } else KJ_IF_MAYBE(o, connectionState->observer) {
+        question.isObserved = true;
+        question.interfaceId = callBuilder.getInterfaceId();
+        question.methodId = callBuilder.getMethodId();
+        question.sendTime = kj::systemPreciseMonotonicClock().now();
+        o->questionSent({ question.interfaceId, question.methodId, questionId,
+                          callBuilder.totalSize().wordCount, question.sendTime,
+                          question.sendTime });
+      }
+
+      if (question.isAwaitingReturn) {
+        KJ_IF_MAYBE(c, target->callCounter) {
+          ++c->get()->count;
+          question.callCounter = kj::addRef(**c);
+        }
       }
 
       // Send and return.
@@ -1656,6 +1994,10 @@ private:
       return kj::addRef(*this);
     }
 
+    kj::Maybe<kj::Array<const byte>> shareData(Data::Reader data) override {
+      return message->shareData(data);
+    }
+
   private:
     kj::Own<RpcConnectionState> connectionState;
     kj::Own<IncomingRpcMessage> message;
@@ -1691,7 +2033,7 @@ private:
 
       // Build the cap table.
       auto capTable = this->capTable.getTable();
-      auto exports = connectionState.writeDescriptors(capTable, payload);
+      auto exports = connectionState.writeDescriptors(*message, capTable, payload);
 
       // Capabilities that we are returning are subject to embargos. See `Disembargo` in rpc.capnp.
       // As explained there, in order to deal with the Tribble 4-way race condition, we need to
@@ -1762,6 +2104,13 @@ private:
           redirectResults(redirectResults),
           cancelFulfiller(kj::mv(cancelFulfiller)) {
       connectionState.callWordsInFlight += requestSize;
+
+      KJ_IF_MAYBE(o, connectionState.observer) {
+        isObserved = true;
+        receiveTime = kj::systemPreciseMonotonicClock().now();
+        o->callReceived({ interfaceId, methodId, answerId, requestSize,
+                          receiveTime, receiveTime });
+      }
     }
 
     ~RpcCallContext() noexcept(false) {
@@ -1770,7 +2119,7 @@ private:
         unwindDetector.catchExceptionsIfUnwinding([&]() {
           // Don't send anything if the connection is broken.
           if (connectionState->connection.is<Connected>()) {
-            auto message = connectionState->connection.get<Connected>()->newOutgoingMessage(
+            auto message = connectionState->newOutgoingMessage(
                 messageSizeHint<rpc::Return>() + sizeInWords<rpc::Payload>());
             auto builder = message->getBody().initAs<rpc::Message>().initReturn();
 
@@ -1786,6 +2135,7 @@ private:
             }
 
             message->send();
+            observeReturn(builder);
           }
 
           cleanupAnswerTable(nullptr, true);
@@ -1830,6 +2180,8 @@ private:
           return;
         }
 
+        observeReturn(returnMessage);
+
         KJ_IF_MAYBE(e, exports) {
           // Caps were returned, so we can't free the pipeline yet.
           cleanupAnswerTable(kj::mv(*e), false);
@@ -1843,7 +2195,7 @@ private:
       KJ_ASSERT(!redirectResults);
       if (isFirstResponder()) {
         if (connectionState->connection.is<Connected>()) {
-          auto message = connectionState->connection.get<Connected>()->newOutgoingMessage(
+          auto message = connectionState->newOutgoingMessage(
               messageSizeHint<rpc::Return>() + exceptionSizeHint(exception));
           auto builder = message->getBody().initAs<rpc::Message>().initReturn();
 
@@ -1852,6 +2204,7 @@ private:
           fromException(exception, builder.initException());
 
           message->send();
+          observeReturn(builder);
         }
 
         // Do not allow releasing the pipeline because we want pipelined calls to propagate the
@@ -1877,6 +2230,22 @@ private:
       }
     }
 
+    void setDeadline(kj::TimePoint newDeadline, kj::Timer& timer) {
+      // Sets the deadline the caller asked for.  Once it passes, the call is failed with an
+      // OVERLOADED exception and canceled, as soon as cancellation is allowed.
+
+      deadline = newDeadline;
+
+      if (!redirectResults) {
+        deadlineTask = timer.atTime(newDeadline).then([this]() {
+          deadlineExpired = true;
+          if (cancellationFlags & CANCEL_ALLOWED) {
+            cancelForDeadline();
+          }
+        }).eagerlyEvaluate(nullptr);
+      }
+    }
+
     // implements CallContextHook ------------------------------------
 
     AnyPointer::Reader getParams() override {
@@ -1895,7 +2264,7 @@ private:
         if (redirectResults || !connectionState->connection.is<Connected>()) {
           response = kj::refcounted<LocallyRedirectedRpcResponse>(sizeHint);
         } else {
-          auto message = connectionState->connection.get<Connected>()->newOutgoingMessage(
+          auto message = connectionState->newOutgoingMessage(
               firstSegmentSize(sizeHint, messageSizeHint<rpc::Return>() +
                                sizeInWords<rpc::Payload>()));
           returnMessage = message->getBody().initAs<rpc::Message>().initReturn();
@@ -1919,6 +2288,10 @@ private:
       KJ_REQUIRE(response == nullptr,
                  "Can't call tailCall() after initializing the results struct.");
 
+      KJ_IF_MAYBE(d, deadline) {
+        request->setDeadline(*d);
+      }
+
       if (request->getBrand() == connectionState.get() && !redirectResults) {
         // The tail call is headed towards the peer that called us in the first place, so we can
         // optimize out the return trip.
@@ -1926,7 +2299,7 @@ private:
         KJ_IF_MAYBE(tailInfo, kj::downcast<RpcRequest>(*request).tailSend()) {
           if (isFirstResponder()) {
             if (connectionState->connection.is<Connected>()) {
-              auto message = connectionState->connection.get<Connected>()->newOutgoingMessage(
+              auto message = connectionState->newOutgoingMessage(
                   messageSizeHint<rpc::Return>());
               auto builder = message->getBody().initAs<rpc::Message>().initReturn();
 
@@ -1935,6 +2308,7 @@ private:
               builder.setTakeFromOtherQuestion(tailInfo->questionId);
 
               message->send();
+              observeReturn(builder);
             }
 
             // There are no caps in our return message, but of course the tail results could have
@@ -1971,8 +2345,13 @@ private:
         // We just set CANCEL_ALLOWED, and CANCEL_REQUESTED was already set previously.  Initiate
         // the cancellation.
         cancelFulfiller->fulfill();
+      } else if (deadlineExpired) {
+        cancelForDeadline();
       }
     }
+    kj::Maybe<kj::TimePoint> getDeadline() override {
+      return deadline;
+    }
     kj::Own<CallContextHook> addRef() override {
       return kj::addRef(*this);
     }
@@ -1983,7 +2362,11 @@ private:
 
     uint64_t interfaceId;
     uint16_t methodId;
-    // For debugging.
+    // For debugging and for the observer.
+
+    bool isObserved = false;
+    kj::TimePoint receiveTime = kj::origin<kj::TimePoint>();
+    // If an observer was installed when the call was received, the time it was received.
 
     // Request ---------------------------------------------
 
@@ -2015,10 +2398,43 @@ private:
     // exclusive-joined with the outermost promise waiting on the call return, so fulfilling it
     // cancels that promise.
 
+    // Deadline --------------------------------------------
+
+    kj::Maybe<kj::TimePoint> deadline;
+    // The deadline derived from the caller's `Call.timeoutNanos`, if any.
+
+    bool deadlineExpired = false;
+    kj::Promise<void> deadlineTask = nullptr;
+    // Waits for the deadline, then cancels the call if allowed or remembers that it should be
+    // canceled once it is.
+
     kj::UnwindDetector unwindDetector;
 
     // -----------------------------------------------------
 
+    void observeReturn(rpc::Return::Reader ret) {
+      // Report a `Return` we just sent to the observer.
+
+      if (isObserved) {
+        KJ_IF_MAYBE(o, connectionState->observer) {
+          o->callReturned({ interfaceId, methodId, answerId, ret.totalSize().wordCount,
+                            receiveTime, kj::systemPreciseMonotonicClock().now() },
+                          observedReturnType(ret));
+        }
+      }
+    }
+
+    void cancelForDeadline() {
+      // The deadline passed and cancellation is allowed.  Unlike a cancellation requested with
+      // `Finish`, the caller is still waiting, so tell it why before canceling.
+
+      if (responseSent || (cancellationFlags & CANCEL_REQUESTED)) return;
+
+      sendErrorReturn(KJ_EXCEPTION(OVERLOADED, "call deadline exceeded",
+                                   interfaceId, methodId));
+      cancelFulfiller->fulfill();
+    }
+
     bool isFirstResponder() {
       if (responseSent) {
         return false;
@@ -2061,6 +2477,131 @@ private:
   // =====================================================================================
   // Message handling
 
+  class ObservedOutgoingMessage final: public OutgoingRpcMessage {
+    // Wraps messages created while an observer is installed, to report them once sent.
+
+  public:
+    ObservedOutgoingMessage(RpcConnectionState& connectionState,
+                            kj::Own<OutgoingRpcMessage>&& inner)
+        : connectionState(kj::addRef(connectionState)), inner(kj::mv(inner)) {}
+
+    AnyPointer::Builder getBody() override {
+      return inner->getBody();
+    }
+
+    void send() override {
+      inner->send();
+
+      KJ_IF_MAYBE(o, connectionState->observer) {
+        auto body = inner->getBody();
+        o->messageWritten(body.getAs<rpc::Message>().which(), body.targetSize().wordCount,
+                          kj::systemPreciseMonotonicClock().now());
+      }
+    }
+
+  private:
+    kj::Own<RpcConnectionState> connectionState;
+    kj::Own<OutgoingRpcMessage> inner;
+  };
+
+  void deferFinish(QuestionId questionId, bool releaseResultCaps) {
+    queueControl(PendingControl { rpc::Message::FINISH, questionId, releaseResultCaps, {} });
+  }
+
+  void deferRelease(ImportId importId, uint32_t referenceCount) {
+    auto insertResult = pendingReleases.insert(std::make_pair(importId, pendingControl.size()));
+    if (insertResult.second) {
+      queueControl(PendingControl { rpc::Message::RELEASE, importId, referenceCount, {} });
+    } else {
+      // The import was dropped, re-imported and dropped again this turn. Release it all at once.
+      pendingControl[insertResult.first->second].referenceCount += referenceCount;
+      ++controlQueued;
+    }
+  }
+
+  void deferMessage(kj::Own<OutgoingRpcMessage>&& message) {
+    // Queues an already-built message to go out with the control messages.  A Release queued
+    // earlier this turn may be for an import the message refers to, so later releases must not be
+    // merged into it (and thereby moved ahead of the message).
+
+    pendingReleases.clear();
+    auto type = message->getBody().getAs<rpc::Message>().which();
+    queueControl(PendingControl { type, 0, 0, kj::mv(message) });
+  }
+
+  void queueControl(PendingControl&& control) {
+    // Control messages only ever let the peer free things (or, for `Disembargo`, lift an embargo
+    // on our side), so delaying them a little is always safe with one exception: a question ID
+    // must not be reused before its `Finish` has been sent. We therefore flush before allocating
+    // question IDs, and otherwise at the end of the turn, so that a burst of completions or drops
+    // goes out back-to-back (which the network can then combine into a single write) rather than
+    // each on its own.
+
+    if (pendingControl.empty()) {
+      tasks.add(kj::evalLater([this]() { flushControl(); }));
+    }
+    pendingControl.add(kj::mv(control));
+    ++controlQueued;
+  }
+
+  void flushControl() {
+    if (pendingControl.empty()) return;
+
+    auto batch = pendingControl.releaseAsArray();
+    pendingReleases.clear();
+    size_t queued = controlQueued;
+    controlQueued = 0;
+
+    if (!connection.is<Connected>()) return;
+
+    for (auto& control: batch) {
+      if (control.type == rpc::Message::FINISH) {
+        auto message = newOutgoingMessage(messageSizeHint<rpc::Finish>());
+        auto builder = message->getBody().initAs<rpc::Message>().initFinish();
+        builder.setQuestionId(control.id);
+        builder.setReleaseResultCaps(control.referenceCount != 0);
+        message->send();
+      } else if (control.type == rpc::Message::RELEASE) {
+        auto message = newOutgoingMessage(messageSizeHint<rpc::Release>());
+        auto builder = message->getBody().initAs<rpc::Message>().initRelease();
+        builder.setId(control.id);
+        builder.setReferenceCount(control.referenceCount);
+        message->send();
+      } else {
+        control.message->send();
+      }
+    }
+
+    KJ_IF_MAYBE(o, observer) {
+      o->controlMessagesFlushed(queued, batch.size());
+    }
+  }
+
+  kj::Own<OutgoingRpcMessage> newOutgoingMessage(uint firstSegmentWordSize) {
+    // Start a new message on the connection, which must be connected.
+
+    activeSinceTrim = true;
+    return observeOutgoingMessage(
+        connection.get<Connected>()->newOutgoingMessage(firstSegmentWordSize));
+  }
+
+  kj::Own<OutgoingRpcMessage> observeOutgoingMessage(kj::Own<OutgoingRpcMessage>&& message) {
+    if (observer == nullptr) {
+      return kj::mv(message);
+    } else {
+      return kj::heap<ObservedOutgoingMessage>(*this, kj::mv(message));
+    }
+  }
+
+  static RpcObserver::ReturnType observedReturnType(const rpc::Return::Reader& ret) {
+    switch (ret.which()) {
+      case rpc::Return::RESULTS: return RpcObserver::ReturnType::RESULTS;
+      case rpc::Return::EXCEPTION: return RpcObserver::ReturnType::EXCEPTION;
+      case rpc::Return::CANCELED: return RpcObserver::ReturnType::CANCELED;
+      default: return RpcObserver::ReturnType::REDIRECTED;
+    }
+  }
+
   void maybeUnblockFlow() {
     if (callWordsInFlight < flowLimit) {
       KJ_IF_MAYBE(w, flowWaiter) {
@@ -2103,6 +2644,12 @@ private:
 
   void handleMessage(kj::Own<IncomingRpcMessage> message) {
     auto reader = message->getBody().getAs<rpc::Message>();
+    activeSinceTrim = true;
+
+    KJ_IF_MAYBE(o, observer) {
+      o->messageRead(reader.which(), message->getBody().targetSize().wordCount,
+                     kj::systemPreciseMonotonicClock().now());
+    }
 
     switch (reader.which()) {
       case rpc::Message::UNIMPLEMENTED:
@@ -2130,7 +2677,7 @@ private:
         break;
 
       case rpc::Message::RESOLVE:
-        handleResolve(reader.getResolve());
+        handleResolve(kj::mv(message), reader.getResolve());
         break;
 
       case rpc::Message::RELEASE:
@@ -2141,9 +2688,17 @@ private:
         handleDisembargo(reader.getDisembargo());
         break;
 
+      case rpc::Message::PROVIDE:
+        handleProvide(reader.getProvide());
+        break;
+
+      case rpc::Message::ACCEPT:
+        handleAccept(reader.getAccept());
+        break;
+
       default: {
         if (connection.is<Connected>()) {
-          auto message = connection.get<Connected>()->newOutgoingMessage(
+          auto message = newOutgoingMessage(
               firstSegmentSize(reader.totalSize(), messageSizeHint<void>()));
           message->getBody().initAs<rpc::Message>().setUnimplemented(reader);
           message->send();
@@ -2187,12 +2742,36 @@ private:
         break;
       }
 
+      case rpc::Message::PROVIDE:
+        failUnimplementedQuestion(message.getProvide().getQuestionId());
+        break;
+
+      case rpc::Message::ACCEPT:
+        failUnimplementedQuestion(message.getAccept().getQuestionId());
+        break;
+
       default:
         KJ_FAIL_ASSERT("Peer did not implement required RPC message type.", (uint)message.which());
         break;
     }
   }
 
+  void failUnimplementedQuestion(QuestionId id) {
+    // The peer doesn't support three-party handoffs after all.  Fail the question, and don't
+    // `Finish` it, since the peer never recorded it.
+
+    KJ_IF_MAYBE(question, questions.find(id)) {
+      question->isAwaitingReturn = false;
+      question->skipFinish = true;
+      KJ_IF_MAYBE(questionRef, question->selfRef) {
+        questionRef->reject(KJ_EXCEPTION(UNIMPLEMENTED,
+            "peer does not support three-party handoff"));
+      } else {
+        questions.erase(id, *question);
+      }
+    }
+  }
+
   void handleAbort(const rpc::Exception::Reader& exception) {
     kj::throwRecoverableException(toException(exception));
   }
@@ -2231,7 +2810,7 @@ private:
     }
 
     VatNetworkBase::Connection& conn = *connection.get<Connected>();
-    auto response = conn.newOutgoingMessage(
+    auto response = newOutgoingMessage(
         messageSizeHint<rpc::Return>() + sizeInWords<rpc::CapDescriptor>() + 32);
 
     rpc::Return::Builder ret = response->getBody().getAs<rpc::Message>().initReturn();
@@ -2262,7 +2841,7 @@ private:
 
       auto capTableArray = capTable.getTable();
       KJ_DASSERT(capTableArray.size() == 1);
-      resultExports = writeDescriptors(capTableArray, payload);
+      resultExports = writeDescriptors(*response, capTableArray, payload);
       capHook = KJ_ASSERT_NONNULL(capTableArray[0])->addRef();
     })) {
       fromException(*exception, ret.initException());
@@ -2307,7 +2886,7 @@ private:
     }
 
     auto payload = call.getParams();
-    auto capTableArray = receiveCaps(payload.getCapTable());
+    auto capTableArray = receiveCaps(payload.getCapTable(), message->getAttachedFds());
     auto cancelPaf = kj::newPromiseAndFulfiller<void>();
 
     AnswerId answerId = call.getQuestionId();
@@ -2330,6 +2909,13 @@ private:
       answer.callContext = *context;
     }
 
+    uint64_t timeoutNanos = call.getTimeoutNanos();
+    if (timeoutNanos > 0 && timeoutNanos <= MAX_TIMEOUT_NANOS) {
+      KJ_IF_MAYBE(t, timer) {
+        context->setDeadline(t->now() + static_cast<int64_t>(timeoutNanos) * kj::NANOSECONDS, *t);
+      }
+    }
+
     auto promiseAndPipeline = startCall(
         call.getInterfaceId(), call.getMethodId(), kj::mv(capability), context->addRef());
 
@@ -2485,6 +3071,20 @@ private:
       KJ_REQUIRE(question->isAwaitingReturn, "Duplicate Return.") { return; }
       question->isAwaitingReturn = false;
 
+      KJ_IF_MAYBE(c, question->callCounter) {
+        --c->get()->count;
+        question->callCounter = nullptr;
+      }
+
+      if (question->isObserved) {
+        KJ_IF_MAYBE(o, observer) {
+          o->questionReturned({ question->interfaceId, question->methodId, ret.getAnswerId(),
+                                ret.totalSize().wordCount, question->sendTime,
+                                kj::systemPreciseMonotonicClock().now() },
+                              observedReturnType(ret));
+        }
+      }
+
       if (ret.getReleaseParamCaps()) {
         exportsToRelease = kj::mv(question->paramExports);
       } else {
@@ -2500,7 +3100,7 @@ private:
             }
 
             auto payload = ret.getResults();
-            auto capTableArray = receiveCaps(payload.getCapTable());
+            auto capTableArray = receiveCaps(payload.getCapTable(), message->getAttachedFds());
             questionRef->fulfill(kj::refcounted<RpcResponseImpl>(
                 *this, kj::addRef(*questionRef), kj::mv(message),
                 kj::mv(capTableArray), payload.getContent()));
@@ -2585,6 +3185,15 @@ private:
 
       pipelineToRelease = kj::mv(answer->pipeline);
 
+      if (answer->handoffPending) {
+        // A `Provide` or `Accept` canceled before it completed.  Dropping the operation withdraws
+        // the provision or stops waiting for it.  The caller still expects a `Return`.
+        answer->handoffPending = false;
+        answerToRelease = answers.erase(finish.getQuestionId());
+        sendCanceledReturn(finish.getQuestionId());
+        return;
+      }
+
       // If the call isn't actually done yet, cancel it.  Otherwise, we can go ahead and erase the
       // question from the table.
       KJ_IF_MAYBE(context, answer->callContext) {
@@ -2600,14 +3209,14 @@ private:
   // ---------------------------------------------------------------------------
   // Level 1
 
-  void handleResolve(const rpc::Resolve::Reader& resolve) {
+  void handleResolve(kj::Own<IncomingRpcMessage>&& message, const rpc::Resolve::Reader& resolve) {
     kj::Own<ClientHook> replacement;
     kj::Maybe<kj::Exception> exception;
 
     // Extract the replacement capability.
     switch (resolve.which()) {
       case rpc::Resolve::CAP:
-        KJ_IF_MAYBE(cap, receiveCap(resolve.getCap())) {
+        KJ_IF_MAYBE(cap, receiveCap(resolve.getCap(), message->getAttachedFds())) {
           replacement = kj::mv(*cap);
         } else {
           KJ_FAIL_REQUIRE("'Resolve' contained 'CapDescriptor.none'.") { return; }
@@ -2709,7 +3318,7 @@ private:
 
           RpcClient& downcasted = kj::downcast<RpcClient>(*target);
 
-          auto message = connection.get<Connected>()->newOutgoingMessage(
+          auto message = newOutgoingMessage(
               messageSizeHint<rpc::Disembargo>() + MESSAGE_TARGET_SIZE_HINT);
           auto builder = message->getBody().initAs<rpc::Message>().initDisembargo();
 
@@ -2755,11 +3364,302 @@ private:
 
   // ---------------------------------------------------------------------------
   // Level 2
+
+  // ---------------------------------------------------------------------------
+  // Level 3
+
+  class VineClient final: public ClientHook, public kj::Refcounted {
+    // Exported alongside a `thirdPartyHosted` descriptor, for the recipient to fall back on if it
+    // can't pick the capability up directly.  Calls are simply forwarded to the capability.  Keeps
+    // the `Provide` open until the vine is released or used, since a recipient calling the vine
+    // has given up on the handoff.
+
+  public:
+    VineClient(kj::Own<ClientHook>&& inner, kj::Own<QuestionRef>&& provide)
+        : inner(kj::mv(inner)), provide(kj::mv(provide)) {}
+
+    Request<AnyPointer, AnyPointer> newCall(
+        uint64_t interfaceId, uint16_t methodId, kj::Maybe<MessageSize> sizeHint) override {
+      provide = nullptr;
+      return inner->newCall(interfaceId, methodId, sizeHint);
+    }
+
+    VoidPromiseAndPipeline call(uint64_t interfaceId, uint16_t methodId,
+                                kj::Own<CallContextHook>&& context) override {
+      provide = nullptr;
+      return inner->call(interfaceId, methodId, kj::mv(context));
+    }
+
+    kj::Maybe<ClientHook&> getResolved() override {
+      return nullptr;
+    }
+
+    kj::Maybe<kj::Promise<kj::Own<ClientHook>>> whenMoreResolved() override {
+      return nullptr;
+    }
+
+    kj::Own<ClientHook> addRef() override {
+      return kj::addRef(*this);
+    }
+
+    const void* getBrand() override {
+      return nullptr;
+    }
+
+  private:
+    kj::Own<ClientHook> inner;
+    kj::Maybe<kj::Own<QuestionRef>> provide;
+  };
+
+  kj::Maybe<ExportId> writeThirdPartyDescriptor(
+      ClientHook& cap, rpc::CapDescriptor::Builder descriptor) {
+    // If `cap` is a settled capability imported over another of our connections, and the network
+    // can introduce our peer to that connection's peer, hand it off: `Provide` it there and
+    // describe it to our peer as `thirdPartyHosted`, with a vine through us to fall back on.
+    // Returns the vine's export ID, or null (having written nothing) if no handoff is possible.
+
+    if (!connection.is<Connected>()) {
+      return nullptr;
+    }
+
+    KJ_IF_MAYBE(host, registry.findConnection(cap.getBrand())) {
+      if (cap.whenMoreResolved() != nullptr) {
+        // A promise may yet resolve somewhere else entirely.
+        return nullptr;
+      }
+
+      KJ_IF_MAYBE(provide, host->provideTo(*connection.get<Connected>(), cap, descriptor)) {
+        ExportId exportId;
+        auto& exp = exports.next(exportId);
+        exp.refcount = 1;
+        exp.clientHook = kj::refcounted<VineClient>(cap.addRef(), kj::mv(*provide));
+        descriptor.getThirdPartyHosted().setVineId(exportId);
+        return exportId;
+      }
+    }
+
+    return nullptr;
+  }
+
+  kj::Maybe<kj::Own<QuestionRef>> provideTo(VatNetworkBase::Connection& recipient,
+                                            ClientHook& cap,
+                                            rpc::CapDescriptor::Builder descriptor) {
+    // Called on the connection over which `cap` was imported, to hand it to the peer of
+    // `recipient`: sends a `Provide` naming that peer and writes `descriptor` as
+    // `thirdPartyHosted`. The returned question must be held for as long as the recipient might
+    // still pick up the capability.  Returns null if the network can't introduce the recipient to
+    // our peer.
+
+    if (!connection.is<Connected>()) {
+      return nullptr;
+    }
+
+    VatNetworkBase::Connection& conn = *connection.get<Connected>();
+    if (!conn.baseCanIntroduceTo(recipient)) {
+      return nullptr;
+    }
+
+    auto message = newOutgoingMessage(
+        messageSizeHint<rpc::Provide>() + sizeInWords<rpc::MessageTarget>() + 16);
+    auto provide = message->getBody().initAs<rpc::Message>().initProvide();
+    if (writeTarget(cap, provide.initTarget()) != nullptr) {
+      // Calls would be redirected elsewhere after all.
+      return nullptr;
+    }
+    conn.baseIntroduceTo(recipient, descriptor.initThirdPartyHosted().getId(),
+                         provide.getRecipient());
+
+    QuestionId questionId;
+    flushControl();  // Question IDs may be reused once their `Finish` is sent.
+    auto& question = questions.next(questionId);
+    question.isAwaitingReturn = true;
+
+    // Nothing waits for the `Return`; the QuestionRef is only needed to send the `Finish`.
+    auto paf = kj::newPromiseAndFulfiller<kj::Promise<kj::Own<RpcResponse>>>();
+    auto questionRef = kj::refcounted<QuestionRef>(*this, questionId, kj::mv(paf.fulfiller));
+    question.selfRef = *questionRef;
+
+    provide.setQuestionId(questionId);
+    message->send();
+
+    return kj::mv(questionRef);
+  }
+
+  kj::Own<ClientHook> receiveThirdPartyCap(rpc::ThirdPartyCapDescriptor::Reader descriptor) {
+    // Pick up a capability hosted by a third vat directly from that vat, falling back to the vine
+    // if the network can't connect us or the `Accept` fails.  Calls made before the `Accept`
+    // returns are queued locally.
+
+    auto vine = import(descriptor.getVineId(), false);
+
+    if (connection.is<Connected>()) {
+      KJ_IF_MAYBE(introduced,
+                  connection.get<Connected>()->baseConnectToIntroduced(descriptor.getId())) {
+        auto& host = registry.getConnectionState(kj::mv(introduced->connection));
+        auto promise = host.accept(kj::mv(introduced->firstMessage),
+                                   kj::mv(introduced->provisionId));
+
+        // Once the capability is picked up, the vine is dropped, letting the introducer `Finish`
+        // its `Provide`.
+        return newLocalPromiseClient(promise.then(
+            [](kj::Own<ClientHook>&& cap) { return kj::mv(cap); },
+            kj::mvCapture(vine, [](kj::Own<ClientHook>&& vine, kj::Exception&& exception) {
+          return kj::mv(vine);
+        })));
+      }
+    }
+
+    return kj::mv(vine);
+  }
+
+  kj::Promise<kj::Own<ClientHook>> accept(kj::Own<OutgoingRpcMessage>&& firstMessage,
+                                          Orphan<AnyPointer>&& provisionId) {
+    // Send an `Accept` for a capability which some introducer provided to us here, using the
+    // message and `ProvisionId` prepared by VatNetwork::Connection::connectToIntroduced().
+
+    if (connection.is<Disconnected>()) {
+      return kj::cp(connection.get<Disconnected>());
+    }
+
+    QuestionId questionId;
+    flushControl();  // Question IDs may be reused once their `Finish` is sent.
+    auto& question = questions.next(questionId);
+    question.isAwaitingReturn = true;
+
+    auto paf = kj::newPromiseAndFulfiller<kj::Promise<kj::Own<RpcResponse>>>();
+    auto questionRef = kj::refcounted<QuestionRef>(*this, questionId, kj::mv(paf.fulfiller));
+    question.selfRef = *questionRef;
+
+    auto message = observeOutgoingMessage(kj::mv(firstMessage));
+    auto builder = message->getBody().initAs<rpc::Message>().initAccept();
+    builder.setQuestionId(questionId);
+    builder.getProvision().adopt(kj::mv(provisionId));
+    builder.setEmbargo(false);
+    message->send();
+
+    return paf.promise.attach(kj::mv(questionRef))
+        .then([](kj::Own<RpcResponse>&& response) {
+      return response->getResults().getPipelinedCap(nullptr);
+    });
+  }
+
+  void handleProvide(const rpc::Provide::Reader& provide) {
+    AnswerId answerId = provide.getQuestionId();
+
+    kj::Promise<void> op = nullptr;
+    KJ_IF_MAYBE(target, getMessageTarget(provide.getTarget())) {
+      KJ_IF_MAYBE(key, connection.get<Connected>()->baseGetProvideKey(provide.getRecipient())) {
+        op = registry.provide(kj::mv(*key), kj::mv(*target));
+      } else {
+        op = KJ_EXCEPTION(FAILED, "'Provide.recipient' not understood by this network");
+      }
+    } else {
+      // Exception already thrown.
+      return;
+    }
+
+    auto& answer = answers[answerId];
+    KJ_REQUIRE(!answer.active, "questionId is already in use", answerId) {
+      return;
+    }
+
+    answer.active = true;
+    answer.handoffPending = true;
+    answer.handoffOp = op.then([this,answerId]() {
+      sendHandoffReturn(answerId, nullptr);
+    }, [this,answerId](kj::Exception&& exception) {
+      sendHandoffException(answerId, kj::mv(exception));
+    }).eagerlyEvaluate([this](kj::Exception&& exception) {
+      // Put the exception on the TaskSet which will cause the connection to be terminated.
+      tasks.add(kj::mv(exception));
+    });
+  }
+
+  void handleAccept(const rpc::Accept::Reader& accept) {
+    AnswerId answerId = accept.getQuestionId();
+
+    kj::Promise<kj::Own<ClientHook>> promise = nullptr;
+    if (accept.getEmbargo()) {
+      // We never request embargoed handoffs ourselves.
+      promise = KJ_EXCEPTION(UNIMPLEMENTED, "embargoed 'Accept' is not supported");
+    } else KJ_IF_MAYBE(key,
+        connection.get<Connected>()->baseGetAcceptKey(accept.getProvision())) {
+      promise = registry.accept(kj::mv(*key));
+    } else {
+      promise = KJ_EXCEPTION(FAILED, "'Accept.provision' not understood by this network");
+    }
+
+    auto& answer = answers[answerId];
+    KJ_REQUIRE(!answer.active, "questionId is already in use", answerId) {
+      return;
+    }
+
+    auto forked = promise.fork();
+    answer.active = true;
+    answer.handoffPending = true;
+    answer.pipeline = kj::Own<PipelineHook>(kj::refcounted<SingleCapPipeline>(
+        newLocalPromiseClient(forked.addBranch())));
+    answer.handoffOp = forked.addBranch().then([this,answerId](kj::Own<ClientHook>&& cap) {
+      sendHandoffReturn(answerId, kj::mv(cap));
+    }, [this,answerId](kj::Exception&& exception) {
+      sendHandoffException(answerId, kj::mv(exception));
+    }).eagerlyEvaluate([this](kj::Exception&& exception) {
+      // Put the exception on the TaskSet which will cause the connection to be terminated.
+      tasks.add(kj::mv(exception));
+    });
+  }
+
+  void sendHandoffReturn(AnswerId answerId, kj::Maybe<kj::Own<ClientHook>> cap) {
+    // Return from a `Provide`, with no results, or an `Accept`, with the capability picked up.
+
+    auto message = newOutgoingMessage(
+        messageSizeHint<rpc::Return>() + sizeInWords<rpc::CapDescriptor>() + 32);
+    auto ret = message->getBody().initAs<rpc::Message>().initReturn();
+    ret.setAnswerId(answerId);
+    ret.setReleaseParamCaps(false);
+    auto payload = ret.initResults();
+
+    kj::Array<ExportId> resultExports;
+    KJ_IF_MAYBE(c, cap) {
+      BuilderCapabilityTable capTable;
+      capTable.imbue(payload.getContent()).setAs<Capability>(Capability::Client(kj::mv(*c)));
+      resultExports = writeDescriptors(*message, capTable.getTable(), payload);
+    }
+
+    auto& answer = KJ_ASSERT_NONNULL(answers.find(answerId));
+    answer.handoffPending = false;
+    answer.resultExports = kj::mv(resultExports);
+
+    message->send();
+  }
+
+  void sendHandoffException(AnswerId answerId, kj::Exception&& exception) {
+    auto message = newOutgoingMessage(
+        messageSizeHint<rpc::Return>() + exceptionSizeHint(exception));
+    auto ret = message->getBody().initAs<rpc::Message>().initReturn();
+    ret.setAnswerId(answerId);
+    ret.setReleaseParamCaps(false);
+    fromException(exception, ret.initException());
+
+    KJ_ASSERT_NONNULL(answers.find(answerId)).handoffPending = false;
+
+    message->send();
+  }
+
+  void sendCanceledReturn(AnswerId answerId) {
+    auto message = newOutgoingMessage(messageSizeHint<rpc::Return>());
+    auto ret = message->getBody().initAs<rpc::Message>().initReturn();
+    ret.setAnswerId(answerId);
+    ret.setReleaseParamCaps(false);
+    ret.setCanceled();
+    message->send();
+  }
 };
 
 }  // namespace
 
-class RpcSystemBase::Impl final: private BootstrapFactoryBase, private kj::TaskSet::ErrorHandler {
+class RpcSystemBase::Impl final: private BootstrapFactoryBase, private ConnectionRegistry,
+                                 private kj::TaskSet::ErrorHandler {
 public:
   Impl(VatNetworkBase& network, kj::Maybe<Capability::Client> bootstrapInterface,
        kj::Maybe<RealmGateway<>::Client> gateway)
@@ -2811,6 +3711,22 @@ public:
     }
   }
 
+  void setObserver(kj::Maybe<RpcObserver&> newObserver) {
+    observer = newObserver;
+
+    for (auto& conn: connections) {
+      conn.second->setObserver(newObserver);
+    }
+  }
+
+  void setTimer(kj::Maybe<kj::Timer&> newTimer) {
+    timer = newTimer;
+
+    for (auto& conn: connections) {
+      conn.second->setTimer(newTimer);
+    }
+  }
+
   void setFlowLimit(size_t words) {
     flowLimit = words;
 
@@ -2819,6 +3735,30 @@ public:
     }
   }
 
+  kj::Array<RpcConnectionStats> getConnectionStats(size_t limit) {
+    kj::Vector<RpcConnectionStats> result(connections.size());
+    for (auto& conn: connections) {
+      KJ_IF_MAYBE(stats, conn.second->getStats()) {
+        result.add(*stats);
+      }
+    }
+
+    std::sort(result.begin(), result.end(),
+        [](const RpcConnectionStats& a, const RpcConnectionStats& b) {
+      return a.totalBytes() > b.totalBytes();
+    });
+    if (result.size() > limit) result.truncate(limit);
+    return result.releaseAsArray();
+  }
+
+  size_t trimIdleConnections() {
+    size_t count = 0;
+    for (auto& conn: connections) {
+      if (conn.second->trimIfIdle()) ++count;
+    }
+    return count;
+  }
+
 private:
   VatNetworkBase& network;
   kj::Maybe<Capability::Client> bootstrapInterface;
@@ -2826,35 +3766,142 @@ private:
   kj::Maybe<RealmGateway<>::Client> gateway;
   kj::Maybe<SturdyRefRestorerBase&> restorer;
   size_t flowLimit = kj::maxValue;
+  kj::Maybe<RpcObserver&> observer;
+  kj::Maybe<kj::Timer&> timer;
   kj::TaskSet tasks;
 
   typedef std::unordered_map<VatNetworkBase::Connection*, kj::Own<RpcConnectionState>>
       ConnectionMap;
   ConnectionMap connections;
 
+  std::unordered_map<const void*, RpcConnectionState*> connectionsByBrand;
+  // The same connections, keyed by the brand of the RpcClients they create.
+
+  struct Provision {
+    // An entry in `provisions`: either a provided capability waiting for its `Accept`, or an
+    // `Accept` waiting for its `Provide`.
+
+    kj::Maybe<kj::Own<ClientHook>> cap;
+    kj::Own<kj::PromiseFulfiller<void>> provider;
+    // The provided capability, and the fulfiller to call when it's picked up.
+
+    kj::Own<kj::PromiseFulfiller<kj::Own<ClientHook>>> acceptor;
+    // If the `Accept` arrived first, fulfill this with the capability.
+  };
+
+  std::map<kj::String, Provision> provisions;
+  // Three-party handoffs in progress with this vat as the host, by key (see
+  // VatNetwork::Connection::getProvideKey()).
+
+  class ProvisionRegistration {
+    // Attached to the promises returned by provide() and accept() to remove the entry when they
+    // are canceled.
+
+  public:
+    ProvisionRegistration(Impl& impl, kj::String key, const void* owner)
+        : impl(impl), key(kj::mv(key)), owner(owner) {}
+    KJ_DISALLOW_COPY(ProvisionRegistration);
+
+    ~ProvisionRegistration() noexcept(false) {
+      auto iter = impl.provisions.find(key);
+      if (iter != impl.provisions.end() &&
+          (iter->second.provider.get() == owner || iter->second.acceptor.get() == owner)) {
+        impl.provisions.erase(iter);
+      }
+    }
+
+  private:
+    Impl& impl;
+    kj::String key;
+    const void* owner;
+    // The fulfiller of the entry this registration belongs to.  Once the entry is picked up, the
+    // key may be reused by another one, which must be left alone.
+  };
+
   kj::UnwindDetector unwindDetector;
 
-  RpcConnectionState& getConnectionState(kj::Own<VatNetworkBase::Connection>&& connection) {
+  kj::Maybe<RpcConnectionState&> findConnection(const void* brand) override {
+    auto iter = connectionsByBrand.find(brand);
+    if (iter == connectionsByBrand.end()) {
+      return nullptr;
+    } else {
+      return *iter->second;
+    }
+  }
+
+  RpcConnectionState& getConnectionState(
+      kj::Own<VatNetworkBase::Connection>&& connection) override {
     auto iter = connections.find(connection);
     if (iter == connections.end()) {
       VatNetworkBase::Connection* connectionPtr = connection;
       auto onDisconnect = kj::newPromiseAndFulfiller<RpcConnectionState::DisconnectInfo>();
+      auto newState = kj::refcounted<RpcConnectionState>(
+          bootstrapFactory, gateway, restorer, static_cast<ConnectionRegistry&>(*this),
+          kj::mv(connection),
+          kj::mv(onDisconnect.fulfiller), flowLimit, observer, timer);
+      RpcConnectionState& result = *newState;
       tasks.add(onDisconnect.promise
-          .then([this,connectionPtr](RpcConnectionState::DisconnectInfo info) {
+          .then([this,connectionPtr,&result](RpcConnectionState::DisconnectInfo info) {
+        connectionsByBrand.erase(&result);
         connections.erase(connectionPtr);
         tasks.add(kj::mv(info.shutdownPromise));
       }));
-      auto newState = kj::refcounted<RpcConnectionState>(
-          bootstrapFactory, gateway, restorer, kj::mv(connection),
-          kj::mv(onDisconnect.fulfiller), flowLimit);
-      RpcConnectionState& result = *newState;
       connections.insert(std::make_pair(connectionPtr, kj::mv(newState)));
+      connectionsByBrand.insert(std::make_pair(&result, &result));
       return result;
     } else {
       return *iter->second;
     }
   }
 
+  kj::Promise<void> provide(kj::String key, kj::Own<ClientHook> cap) override {
+    auto iter = provisions.find(key);
+    if (iter != provisions.end()) {
+      auto& provision = iter->second;
+      if (provision.cap != nullptr) {
+        return KJ_EXCEPTION(FAILED, "duplicate 'Provide'");
+      } else if (provision.acceptor->isWaiting()) {
+        // The `Accept` got here first.
+        provision.acceptor->fulfill(kj::mv(cap));
+        provisions.erase(iter);
+        return kj::READY_NOW;
+      } else {
+        provisions.erase(iter);
+      }
+    }
+
+    auto paf = kj::newPromiseAndFulfiller<void>();
+    auto registration = kj::heap<ProvisionRegistration>(
+        *this, kj::heapString(key), paf.fulfiller.get());
+    auto& provision = provisions[kj::mv(key)];
+    provision.cap = kj::mv(cap);
+    provision.provider = kj::mv(paf.fulfiller);
+    return paf.promise.attach(kj::mv(registration));
+  }
+
+  kj::Promise<kj::Own<ClientHook>> accept(kj::String key) override {
+    auto iter = provisions.find(key);
+    if (iter != provisions.end()) {
+      auto& provision = iter->second;
+      KJ_IF_MAYBE(cap, provision.cap) {
+        auto result = kj::mv(*cap);
+        provision.provider->fulfill();
+        provisions.erase(iter);
+        return kj::mv(result);
+      } else if (provision.acceptor->isWaiting()) {
+        return KJ_EXCEPTION(FAILED, "duplicate 'Accept'");
+      } else {
+        provisions.erase(iter);
+      }
+    }
+
+    auto paf = kj::newPromiseAndFulfiller<kj::Own<ClientHook>>();
+    auto registration = kj::heap<ProvisionRegistration>(
+        *this, kj::heapString(key), paf.fulfiller.get());
+    provisions[kj::mv(key)].acceptor = kj::mv(paf.fulfiller);
+    return paf.promise.attach(kj::mv(registration));
+  }
+
   kj::Promise<void> acceptLoop() {
     auto receive = network.baseAccept().then(
         [this](kj::Own<VatNetworkBase::Connection>&& connection) {
@@ -2909,9 +3956,28 @@ Capability::Client RpcSystemBase::baseRestore(
   return impl->restore(hostId, objectId);
 }
 
+void RpcSystemBase::baseSetObserver(kj::Maybe<RpcObserver&> observer) {
+  impl->setObserver(observer);
+}
+
+void RpcSystemBase::baseSetTimer(kj::Maybe<kj::Timer&> timer) {
+  impl->setTimer(timer);
+}
+
 void RpcSystemBase::baseSetFlowLimit(size_t words) {
   return impl->setFlowLimit(words);
 }
 
+kj::Array<RpcConnectionStats> RpcSystemBase::baseGetConnectionStats(size_t limit) {
+  return impl->getConnectionStats(limit);
+}
+
+size_t RpcSystemBase::baseTrimIdleConnections() {
+  return impl->trimIdleConnections();
+}
+
 }  // namespace _ (private)
+
+RpcObserver::~RpcObserver() noexcept(false) {}
+
 }  // namespace capnp
@@ -8,19 +8,19 @@ namespace schemas {
 static const ::capnp::_::AlignedData<232> b_91b79f1f808db032 = {
   {   0,   0,   0,   0,   5,   0,   6,   0,
      50, 176, 141, 128,  31, 159, 183, 145,
-     16,   0,   0,   0,   1,   0,   1,   0,
+     10,   0,   0,   0,   1,   0,   1,   0,
      80, 162,  82,  37,  27, 152,  18, 179,
       1,   0,   7,   0,   0,   0,  14,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     21,   0,   0,   0, 194,   0,   0,   0,
+     21,   0,   0,   0, 146,   0,   0,   0,
      29,   0,   0,   0,   7,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
      25,   0,   0,   0,  23,   3,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     99,  97, 112, 110, 112,  47, 114, 112,
-     99,  46,  99,  97, 112, 110, 112,  58,
-     77, 101, 115, 115,  97, 103, 101,   0,
+    114, 112,  99,  46,  99,  97, 112, 110,
+    112,  58,  77, 101, 115, 115,  97, 103,
+    101,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   1,   0,   1,   0,
      56,   0,   0,   0,   3,   0,   4,   0,
       0,   0, 255, 255,   0,   0,   0,   0,
@@ -262,23 +262,22 @@ const ::capnp::_::RawSchema s_91b79f1f808db032 = {
   12, 14, i_91b79f1f808db032, nullptr, nullptr, { &s_91b79f1f808db032, nullptr, nullptr, 0, 0, nullptr }
 };
 #endif  // !CAPNP_LITE
-static const ::capnp::_::AlignedData<51> b_e94ccf8031176ec4 = {
+static const ::capnp::_::AlignedData<50> b_e94ccf8031176ec4 = {
   {   0,   0,   0,   0,   5,   0,   6,   0,
     196, 110,  23,  49, 128, 207,  76, 233,
-     16,   0,   0,   0,   1,   0,   1,   0,
+     10,   0,   0,   0,   1,   0,   1,   0,
      80, 162,  82,  37,  27, 152,  18, 179,
       1,   0,   7,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     21,   0,   0,   0, 210,   0,   0,   0,
-     33,   0,   0,   0,   7,   0,   0,   0,
+     21,   0,   0,   0, 162,   0,   0,   0,
+     29,   0,   0,   0,   7,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     29,   0,   0,   0, 119,   0,   0,   0,
+     25,   0,   0,   0, 119,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     99,  97, 112, 110, 112,  47, 114, 112,
-     99,  46,  99,  97, 112, 110, 112,  58,
-     66, 111, 111, 116, 115, 116, 114,  97,
-    112,   0,   0,   0,   0,   0,   0,   0,
+    114, 112,  99,  46,  99,  97, 112, 110,
+    112,  58,  66, 111, 111, 116, 115, 116,
+    114,  97, 112,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   1,   0,   1,   0,
       8,   0,   0,   0,   3,   0,   4,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
@@ -320,77 +319,83 @@ static const ::capnp::_::AlignedData<51> b_e94ccf8031176ec4 = {
 static const uint16_t m_e94ccf8031176ec4[] = {1, 0};
 static const uint16_t i_e94ccf8031176ec4[] = {0, 1};
 const ::capnp::_::RawSchema s_e94ccf8031176ec4 = {
-  0xe94ccf8031176ec4, b_e94ccf8031176ec4.words, 51, nullptr, m_e94ccf8031176ec4,
+  0xe94ccf8031176ec4, b_e94ccf8031176ec4.words, 50, nullptr, m_e94ccf8031176ec4,
   0, 2, i_e94ccf8031176ec4, nullptr, nullptr, { &s_e94ccf8031176ec4, nullptr, nullptr, 0, 0, nullptr }
 };
 #endif  // !CAPNP_LITE
-static const ::capnp::_::AlignedData<121> b_836a53ce789d4cd4 = {
+static const ::capnp::_::AlignedData<136> b_836a53ce789d4cd4 = {
   {   0,   0,   0,   0,   5,   0,   6,   0,
     212,  76, 157, 120, 206,  83, 106, 131,
-     16,   0,   0,   0,   1,   0,   3,   0,
+     10,   0,   0,   0,   1,   0,   4,   0,
      80, 162,  82,  37,  27, 152,  18, 179,
       3,   0,   7,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     21,   0,   0,   0, 170,   0,   0,   0,
-     29,   0,   0,   0,   7,   0,   0,   0,
+     21,   0,   0,   0, 122,   0,   0,   0,
+     25,   0,   0,   0,   7,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     25,   0,   0,   0, 143,   1,   0,   0,
+     21,   0,   0,   0, 199,   1,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     99,  97, 112, 110, 112,  47, 114, 112,
-     99,  46,  99,  97, 112, 110, 112,  58,
-     67,  97, 108, 108,   0,   0,   0,   0,
+    114, 112,  99,  46,  99,  97, 112, 110,
+    112,  58,  67,  97, 108, 108,   0,   0,
       0,   0,   0,   0,   1,   0,   1,   0,
-     28,   0,   0,   0,   3,   0,   4,   0,
+     32,   0,   0,   0,   3,   0,   4,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   1,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-    181,   0,   0,   0,  90,   0,   0,   0,
+    209,   0,   0,   0,  90,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-    180,   0,   0,   0,   3,   0,   1,   0,
-    192,   0,   0,   0,   2,   0,   1,   0,
+    208,   0,   0,   0,   3,   0,   1,   0,
+    220,   0,   0,   0,   2,   0,   1,   0,
       1,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   1,   0,   1,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-    189,   0,   0,   0,  58,   0,   0,   0,
+    217,   0,   0,   0,  58,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-    184,   0,   0,   0,   3,   0,   1,   0,
-    196,   0,   0,   0,   2,   0,   1,   0,
+    212,   0,   0,   0,   3,   0,   1,   0,
+    224,   0,   0,   0,   2,   0,   1,   0,
       2,   0,   0,   0,   1,   0,   0,   0,
       0,   0,   1,   0,   2,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-    193,   0,   0,   0,  98,   0,   0,   0,
+    221,   0,   0,   0,  98,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-    192,   0,   0,   0,   3,   0,   1,   0,
-    204,   0,   0,   0,   2,   0,   1,   0,
+    220,   0,   0,   0,   3,   0,   1,   0,
+    232,   0,   0,   0,   2,   0,   1,   0,
       3,   0,   0,   0,   2,   0,   0,   0,
       0,   0,   1,   0,   3,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-    201,   0,   0,   0,  74,   0,   0,   0,
+    229,   0,   0,   0,  74,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-    200,   0,   0,   0,   3,   0,   1,   0,
-    212,   0,   0,   0,   2,   0,   1,   0,
+    228,   0,   0,   0,   3,   0,   1,   0,
+    240,   0,   0,   0,   2,   0,   1,   0,
       5,   0,   0,   0,   1,   0,   0,   0,
       0,   0,   1,   0,   4,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-    209,   0,   0,   0,  58,   0,   0,   0,
+    237,   0,   0,   0,  58,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-    204,   0,   0,   0,   3,   0,   1,   0,
-    216,   0,   0,   0,   2,   0,   1,   0,
+    232,   0,   0,   0,   3,   0,   1,   0,
+    244,   0,   0,   0,   2,   0,   1,   0,
       6,   0,   0,   0,   0,   0,   0,   0,
       1,   0,   0,   0,   0,   0,   0,   0,
     153,  95, 171,  26, 246, 176, 232, 218,
-    213,   0,   0,   0, 114,   0,   0,   0,
+    241,   0,   0,   0, 114,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
       4,   0,   0,   0, 128,   0,   0,   0,
       0,   0,   1,   0,   8,   0,   0,   0,
       1,   0,   0,   0,   0,   0,   0,   0,
-    193,   0,   0,   0, 194,   0,   0,   0,
+    221,   0,   0,   0, 194,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-    196,   0,   0,   0,   3,   0,   1,   0,
-    208,   0,   0,   0,   2,   0,   1,   0,
+    224,   0,   0,   0,   3,   0,   1,   0,
+    236,   0,   0,   0,   2,   0,   1,   0,
+      7,   0,   0,   0,   3,   0,   0,   0,
+      0,   0,   1,   0,   9,   0,   0,   0,
+      1,   0,   0,   0,   0,   0,   0,   0,
+    233,   0,   0,   0, 106,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+    232,   0,   0,   0,   3,   0,   1,   0,
+    244,   0,   0,   0,   2,   0,   1,   0,
     113, 117, 101, 115, 116, 105, 111, 110,
      73, 100,   0,   0,   0,   0,   0,   0,
       8,   0,   0,   0,   0,   0,   0,   0,
@@ -445,6 +450,15 @@ static const ::capnp::_::AlignedData<121> b_836a53ce789d4cd4 = {
       0,   0,   0,   0,   0,   0,   0,   0,
       1,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+    116, 105, 109, 101, 111, 117, 116,  78,
+     97, 110, 111, 115,   0,   0,   0,   0,
+      9,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      9,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0, }
 };
 ::capnp::word const* const bp_836a53ce789d4cd4 = b_836a53ce789d4cd4.words;
@@ -454,31 +468,30 @@ static const ::capnp::_::RawSchema* const d_836a53ce789d4cd4[] = {
   &s_9a0e61223d96743b,
   &s_dae8b0f61aab5f99,
 };
-static const uint16_t m_836a53ce789d4cd4[] = {6, 2, 3, 4, 0, 5, 1};
-static const uint16_t i_836a53ce789d4cd4[] = {0, 1, 2, 3, 4, 5, 6};
+static const uint16_t m_836a53ce789d4cd4[] = {6, 2, 3, 4, 0, 5, 1, 7};
+static const uint16_t i_836a53ce789d4cd4[] = {0, 1, 2, 3, 4, 5, 6, 7};
 const ::capnp::_::RawSchema s_836a53ce789d4cd4 = {
-  0x836a53ce789d4cd4, b_836a53ce789d4cd4.words, 121, d_836a53ce789d4cd4, m_836a53ce789d4cd4,
-  3, 7, i_836a53ce789d4cd4, nullptr, nullptr, { &s_836a53ce789d4cd4, nullptr, nullptr, 0, 0, nullptr }
+  0x836a53ce789d4cd4, b_836a53ce789d4cd4.words, 136, d_836a53ce789d4cd4, m_836a53ce789d4cd4,
+  3, 8, i_836a53ce789d4cd4, nullptr, nullptr, { &s_836a53ce789d4cd4, nullptr, nullptr, 0, 0, nullptr }
 };
 #endif  // !CAPNP_LITE
-static const ::capnp::_::AlignedData<65> b_dae8b0f61aab5f99 = {
+static const ::capnp::_::AlignedData<64> b_dae8b0f61aab5f99 = {
   {   0,   0,   0,   0,   5,   0,   6,   0,
     153,  95, 171,  26, 246, 176, 232, 218,
-     21,   0,   0,   0,   1,   0,   3,   0,
+     15,   0,   0,   0,   1,   0,   4,   0,
     212,  76, 157, 120, 206,  83, 106, 131,
       3,   0,   7,   0,   1,   0,   3,   0,
       3,   0,   0,   0,   0,   0,   0,   0,
-     21,   0,   0,   0,  26,   1,   0,   0,
+     21,   0,   0,   0, 234,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     29,   0,   0,   0, 175,   0,   0,   0,
+     25,   0,   0,   0, 175,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     99,  97, 112, 110, 112,  47, 114, 112,
-     99,  46,  99,  97, 112, 110, 112,  58,
-     67,  97, 108, 108,  46, 115, 101, 110,
-    100,  82, 101, 115, 117, 108, 116, 115,
-     84, 111,   0,   0,   0,   0,   0,   0,
+    114, 112,  99,  46,  99,  97, 112, 110,
+    112,  58,  67,  97, 108, 108,  46, 115,
+    101, 110, 100,  82, 101, 115, 117, 108,
+    116, 115,  84, 111,   0,   0,   0,   0,
      12,   0,   0,   0,   3,   0,   4,   0,
       0,   0, 255, 255,   0,   0,   0,   0,
       0,   0,   1,   0,   5,   0,   0,   0,
@@ -536,26 +549,26 @@ static const ::capnp::_::RawSchema* const d_dae8b0f61aab5f99[] = {
 static const uint16_t m_dae8b0f61aab5f99[] = {0, 2, 1};
 static const uint16_t i_dae8b0f61aab5f99[] = {0, 1, 2};
 const ::capnp::_::RawSchema s_dae8b0f61aab5f99 = {
-  0xdae8b0f61aab5f99, b_dae8b0f61aab5f99.words, 65, d_dae8b0f61aab5f99, m_dae8b0f61aab5f99,
+  0xdae8b0f61aab5f99, b_dae8b0f61aab5f99.words, 64, d_dae8b0f61aab5f99, m_dae8b0f61aab5f99,
   1, 3, i_dae8b0f61aab5f99, nullptr, nullptr, { &s_dae8b0f61aab5f99, nullptr, nullptr, 0, 0, nullptr }
 };
 #endif  // !CAPNP_LITE
 static const ::capnp::_::AlignedData<148> b_9e19b28d3db3573a = {
   {   0,   0,   0,   0,   5,   0,   6,   0,
      58,  87, 179,  61, 141, 178,  25, 158,
-     16,   0,   0,   0,   1,   0,   2,   0,
+     10,   0,   0,   0,   1,   0,   2,   0,
      80, 162,  82,  37,  27, 152,  18, 179,
       1,   0,   7,   0,   0,   0,   6,   0,
       3,   0,   0,   0,   0,   0,   0,   0,
-     21,   0,   0,   0, 186,   0,   0,   0,
+     21,   0,   0,   0, 138,   0,   0,   0,
      29,   0,   0,   0,   7,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
      25,   0,   0,   0, 199,   1,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     99,  97, 112, 110, 112,  47, 114, 112,
-     99,  46,  99,  97, 112, 110, 112,  58,
-     82, 101, 116, 117, 114, 110,   0,   0,
+    114, 112,  99,  46,  99,  97, 112, 110,
+    112,  58,  82, 101, 116, 117, 114, 110,
+      0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   1,   0,   1,   0,
      32,   0,   0,   0,   3,   0,   4,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
@@ -706,19 +719,19 @@ const ::capnp::_::RawSchema s_9e19b28d3db3573a = {
 static const ::capnp::_::AlignedData<50> b_d37d2eb2c2f80e63 = {
   {   0,   0,   0,   0,   5,   0,   6,   0,
      99,  14, 248, 194, 178,  46, 125, 211,
-     16,   0,   0,   0,   1,   0,   1,   0,
+     10,   0,   0,   0,   1,   0,   1,   0,
      80, 162,  82,  37,  27, 152,  18, 179,
       0,   0,   7,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     21,   0,   0,   0, 186,   0,   0,   0,
+     21,   0,   0,   0, 138,   0,   0,   0,
      29,   0,   0,   0,   7,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
      25,   0,   0,   0, 119,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     99,  97, 112, 110, 112,  47, 114, 112,
-     99,  46,  99,  97, 112, 110, 112,  58,
-     70, 105, 110, 105, 115, 104,   0,   0,
+    114, 112,  99,  46,  99,  97, 112, 110,
+    112,  58,  70, 105, 110, 105, 115, 104,
+      0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   1,   0,   1,   0,
       8,   0,   0,   0,   3,   0,   4,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
@@ -767,19 +780,19 @@ const ::capnp::_::RawSchema s_d37d2eb2c2f80e63 = {
 static const ::capnp::_::AlignedData<64> b_bbc29655fa89086e = {
   {   0,   0,   0,   0,   5,   0,   6,   0,
     110,   8, 137, 250,  85, 150, 194, 187,
-     16,   0,   0,   0,   1,   0,   1,   0,
+     10,   0,   0,   0,   1,   0,   1,   0,
      80, 162,  82,  37,  27, 152,  18, 179,
       1,   0,   7,   0,   0,   0,   2,   0,
       2,   0,   0,   0,   0,   0,   0,   0,
-     21,   0,   0,   0, 194,   0,   0,   0,
+     21,   0,   0,   0, 146,   0,   0,   0,
      29,   0,   0,   0,   7,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
      25,   0,   0,   0, 175,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     99,  97, 112, 110, 112,  47, 114, 112,
-     99,  46,  99,  97, 112, 110, 112,  58,
-     82, 101, 115, 111, 108, 118, 101,   0,
+    114, 112,  99,  46,  99,  97, 112, 110,
+    112,  58,  82, 101, 115, 111, 108, 118,
+    101,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   1,   0,   1,   0,
      12,   0,   0,   0,   3,   0,   4,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
@@ -846,19 +859,19 @@ const ::capnp::_::RawSchema s_bbc29655fa89086e = {
 static const ::capnp::_::AlignedData<48> b_ad1a6c0d7dd07497 = {
   {   0,   0,   0,   0,   5,   0,   6,   0,
     151, 116, 208, 125,  13, 108,  26, 173,
-     16,   0,   0,   0,   1,   0,   1,   0,
+     10,   0,   0,   0,   1,   0,   1,   0,
      80, 162,  82,  37,  27, 152,  18, 179,
       0,   0,   7,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     21,   0,   0,   0, 194,   0,   0,   0,
+     21,   0,   0,   0, 146,   0,   0,   0,
      29,   0,   0,   0,   7,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
      25,   0,   0,   0, 119,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     99,  97, 112, 110, 112,  47, 114, 112,
-     99,  46,  99,  97, 112, 110, 112,  58,
-     82, 101, 108, 101,  97, 115, 101,   0,
+    114, 112,  99,  46,  99,  97, 112, 110,
+    112,  58,  82, 101, 108, 101,  97, 115,
+    101,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   1,   0,   1,   0,
       8,   0,   0,   0,   3,   0,   4,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
@@ -902,23 +915,22 @@ const ::capnp::_::RawSchema s_ad1a6c0d7dd07497 = {
   0, 2, i_ad1a6c0d7dd07497, nullptr, nullptr, { &s_ad1a6c0d7dd07497, nullptr, nullptr, 0, 0, nullptr }
 };
 #endif  // !CAPNP_LITE
-static const ::capnp::_::AlignedData<41> b_f964368b0fbd3711 = {
+static const ::capnp::_::AlignedData<40> b_f964368b0fbd3711 = {
   {   0,   0,   0,   0,   5,   0,   6,   0,
      17,  55, 189,  15, 139,  54, 100, 249,
-     16,   0,   0,   0,   1,   0,   1,   0,
+     10,   0,   0,   0,   1,   0,   1,   0,
      80, 162,  82,  37,  27, 152,  18, 179,
       1,   0,   7,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     21,   0,   0,   0, 218,   0,   0,   0,
-     33,   0,   0,   0,   7,   0,   0,   0,
+     21,   0,   0,   0, 170,   0,   0,   0,
+     29,   0,   0,   0,   7,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     29,   0,   0,   0, 119,   0,   0,   0,
+     25,   0,   0,   0, 119,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     99,  97, 112, 110, 112,  47, 114, 112,
-     99,  46,  99,  97, 112, 110, 112,  58,
-     68, 105, 115, 101, 109,  98,  97, 114,
-    103, 111,   0,   0,   0,   0,   0,   0,
+    114, 112,  99,  46,  99,  97, 112, 110,
+    112,  58,  68, 105, 115, 101, 109,  98,
+     97, 114, 103, 111,   0,   0,   0,   0,
       0,   0,   0,   0,   1,   0,   1,   0,
       8,   0,   0,   0,   3,   0,   4,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
@@ -954,28 +966,27 @@ static const ::capnp::_::RawSchema* const d_f964368b0fbd3711[] = {
 static const uint16_t m_f964368b0fbd3711[] = {1, 0};
 static const uint16_t i_f964368b0fbd3711[] = {0, 1};
 const ::capnp::_::RawSchema s_f964368b0fbd3711 = {
-  0xf964368b0fbd3711, b_f964368b0fbd3711.words, 41, d_f964368b0fbd3711, m_f964368b0fbd3711,
+  0xf964368b0fbd3711, b_f964368b0fbd3711.words, 40, d_f964368b0fbd3711, m_f964368b0fbd3711,
   2, 2, i_f964368b0fbd3711, nullptr, nullptr, { &s_f964368b0fbd3711, nullptr, nullptr, 0, 0, nullptr }
 };
 #endif  // !CAPNP_LITE
-static const ::capnp::_::AlignedData<81> b_d562b4df655bdd4d = {
+static const ::capnp::_::AlignedData<80> b_d562b4df655bdd4d = {
   {   0,   0,   0,   0,   5,   0,   6,   0,
      77, 221,  91, 101, 223, 180,  98, 213,
-     27,   0,   0,   0,   1,   0,   1,   0,
+     21,   0,   0,   0,   1,   0,   1,   0,
      17,  55, 189,  15, 139,  54, 100, 249,
       1,   0,   7,   0,   1,   0,   4,   0,
       2,   0,   0,   0,   0,   0,   0,   0,
-     21,   0,   0,   0,  26,   1,   0,   0,
+     21,   0,   0,   0, 234,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     29,   0,   0,   0, 231,   0,   0,   0,
+     25,   0,   0,   0, 231,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     99,  97, 112, 110, 112,  47, 114, 112,
-     99,  46,  99,  97, 112, 110, 112,  58,
-     68, 105, 115, 101, 109,  98,  97, 114,
-    103, 111,  46,  99, 111, 110, 116, 101,
-    120, 116,   0,   0,   0,   0,   0,   0,
+    114, 112,  99,  46,  99,  97, 112, 110,
+    112,  58,  68, 105, 115, 101, 109,  98,
+     97, 114, 103, 111,  46,  99, 111, 110,
+    116, 101, 120, 116,   0,   0,   0,   0,
      16,   0,   0,   0,   3,   0,   4,   0,
       0,   0, 255, 255,   0,   0,   0,   0,
       0,   0,   1,   0,   1,   0,   0,   0,
@@ -1049,26 +1060,26 @@ static const ::capnp::_::RawSchema* const d_d562b4df655bdd4d[] = {
 static const uint16_t m_d562b4df655bdd4d[] = {2, 3, 1, 0};
 static const uint16_t i_d562b4df655bdd4d[] = {0, 1, 2, 3};
 const ::capnp::_::RawSchema s_d562b4df655bdd4d = {
-  0xd562b4df655bdd4d, b_d562b4df655bdd4d.words, 81, d_d562b4df655bdd4d, m_d562b4df655bdd4d,
+  0xd562b4df655bdd4d, b_d562b4df655bdd4d.words, 80, d_d562b4df655bdd4d, m_d562b4df655bdd4d,
   1, 4, i_d562b4df655bdd4d, nullptr, nullptr, { &s_d562b4df655bdd4d, nullptr, nullptr, 0, 0, nullptr }
 };
 #endif  // !CAPNP_LITE
 static const ::capnp::_::AlignedData<64> b_9c6a046bfbc1ac5a = {
   {   0,   0,   0,   0,   5,   0,   6,   0,
      90, 172, 193, 251, 107,   4, 106, 156,
-     16,   0,   0,   0,   1,   0,   1,   0,
+     10,   0,   0,   0,   1,   0,   1,   0,
      80, 162,  82,  37,  27, 152,  18, 179,
       2,   0,   7,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     21,   0,   0,   0, 194,   0,   0,   0,
+     21,   0,   0,   0, 146,   0,   0,   0,
      29,   0,   0,   0,   7,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
      25,   0,   0,   0, 175,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     99,  97, 112, 110, 112,  47, 114, 112,
-     99,  46,  99,  97, 112, 110, 112,  58,
-     80, 114, 111, 118, 105, 100, 101,   0,
+    114, 112,  99,  46,  99,  97, 112, 110,
+    112,  58,  80, 114, 111, 118, 105, 100,
+    101,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   1,   0,   1,   0,
      12,   0,   0,   0,   3,   0,   4,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
@@ -1134,19 +1145,19 @@ const ::capnp::_::RawSchema s_9c6a046bfbc1ac5a = {
 static const ::capnp::_::AlignedData<64> b_d4c9b56290554016 = {
   {   0,   0,   0,   0,   5,   0,   6,   0,
      22,  64,  85, 144,  98, 181, 201, 212,
-     16,   0,   0,   0,   1,   0,   1,   0,
+     10,   0,   0,   0,   1,   0,   1,   0,
      80, 162,  82,  37,  27, 152,  18, 179,
       1,   0,   7,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     21,   0,   0,   0, 186,   0,   0,   0,
+     21,   0,   0,   0, 138,   0,   0,   0,
      29,   0,   0,   0,   7,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
      25,   0,   0,   0, 175,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     99,  97, 112, 110, 112,  47, 114, 112,
-     99,  46,  99,  97, 112, 110, 112,  58,
-     65,  99,  99, 101, 112, 116,   0,   0,
+    114, 112,  99,  46,  99,  97, 112, 110,
+    112,  58,  65,  99,  99, 101, 112, 116,
+      0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   1,   0,   1,   0,
      12,   0,   0,   0,   3,   0,   4,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
@@ -1206,22 +1217,21 @@ const ::capnp::_::RawSchema s_d4c9b56290554016 = {
   0, 3, i_d4c9b56290554016, nullptr, nullptr, { &s_d4c9b56290554016, nullptr, nullptr, 0, 0, nullptr }
 };
 #endif  // !CAPNP_LITE
-static const ::capnp::_::AlignedData<63> b_fbe1980490e001af = {
+static const ::capnp::_::AlignedData<62> b_fbe1980490e001af = {
   {   0,   0,   0,   0,   5,   0,   6,   0,
     175,   1, 224, 144,   4, 152, 225, 251,
-     16,   0,   0,   0,   1,   0,   1,   0,
+     10,   0,   0,   0,   1,   0,   1,   0,
      80, 162,  82,  37,  27, 152,  18, 179,
       2,   0,   7,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     21,   0,   0,   0, 170,   0,   0,   0,
-     29,   0,   0,   0,   7,   0,   0,   0,
+     21,   0,   0,   0, 122,   0,   0,   0,
+     25,   0,   0,   0,   7,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     25,   0,   0,   0, 175,   0,   0,   0,
+     21,   0,   0,   0, 175,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     99,  97, 112, 110, 112,  47, 114, 112,
-     99,  46,  99,  97, 112, 110, 112,  58,
-     74, 111, 105, 110,   0,   0,   0,   0,
+    114, 112,  99,  46,  99,  97, 112, 110,
+    112,  58,  74, 111, 105, 110,   0,   0,
       0,   0,   0,   0,   1,   0,   1,   0,
      12,   0,   0,   0,   3,   0,   4,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
@@ -1279,27 +1289,26 @@ static const ::capnp::_::RawSchema* const d_fbe1980490e001af[] = {
 static const uint16_t m_fbe1980490e001af[] = {2, 0, 1};
 static const uint16_t i_fbe1980490e001af[] = {0, 1, 2};
 const ::capnp::_::RawSchema s_fbe1980490e001af = {
-  0xfbe1980490e001af, b_fbe1980490e001af.words, 63, d_fbe1980490e001af, m_fbe1980490e001af,
+  0xfbe1980490e001af, b_fbe1980490e001af.words, 62, d_fbe1980490e001af, m_fbe1980490e001af,
   1, 3, i_fbe1980490e001af, nullptr, nullptr, { &s_fbe1980490e001af, nullptr, nullptr, 0, 0, nullptr }
 };
 #endif  // !CAPNP_LITE
-static const ::capnp::_::AlignedData<50> b_95bc14545813fbc1 = {
+static const ::capnp::_::AlignedData<49> b_95bc14545813fbc1 = {
   {   0,   0,   0,   0,   5,   0,   6,   0,
     193, 251,  19,  88,  84,  20, 188, 149,
-     16,   0,   0,   0,   1,   0,   1,   0,
+     10,   0,   0,   0,   1,   0,   1,   0,
      80, 162,  82,  37,  27, 152,  18, 179,
       1,   0,   7,   0,   0,   0,   2,   0,
       2,   0,   0,   0,   0,   0,   0,   0,
-     21,   0,   0,   0, 242,   0,   0,   0,
-     33,   0,   0,   0,   7,   0,   0,   0,
+     21,   0,   0,   0, 194,   0,   0,   0,
+     29,   0,   0,   0,   7,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     29,   0,   0,   0, 119,   0,   0,   0,
+     25,   0,   0,   0, 119,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     99,  97, 112, 110, 112,  47, 114, 112,
-     99,  46,  99,  97, 112, 110, 112,  58,
-     77, 101, 115, 115,  97, 103, 101,  84,
-     97, 114, 103, 101, 116,   0,   0,   0,
+    114, 112,  99,  46,  99,  97, 112, 110,
+    112,  58,  77, 101, 115, 115,  97, 103,
+    101,  84,  97, 114, 103, 101, 116,   0,
       0,   0,   0,   0,   1,   0,   1,   0,
       8,   0,   0,   0,   3,   0,   4,   0,
       0,   0, 255, 255,   0,   0,   0,   0,
@@ -1343,26 +1352,26 @@ static const ::capnp::_::RawSchema* const d_95bc14545813fbc1[] = {
 static const uint16_t m_95bc14545813fbc1[] = {0, 1};
 static const uint16_t i_95bc14545813fbc1[] = {0, 1};
 const ::capnp::_::RawSchema s_95bc14545813fbc1 = {
-  0x95bc14545813fbc1, b_95bc14545813fbc1.words, 50, d_95bc14545813fbc1, m_95bc14545813fbc1,
+  0x95bc14545813fbc1, b_95bc14545813fbc1.words, 49, d_95bc14545813fbc1, m_95bc14545813fbc1,
   1, 2, i_95bc14545813fbc1, nullptr, nullptr, { &s_95bc14545813fbc1, nullptr, nullptr, 0, 0, nullptr }
 };
 #endif  // !CAPNP_LITE
 static const ::capnp::_::AlignedData<52> b_9a0e61223d96743b = {
   {   0,   0,   0,   0,   5,   0,   6,   0,
      59, 116, 150,  61,  34,  97,  14, 154,
-     16,   0,   0,   0,   1,   0,   0,   0,
+     10,   0,   0,   0,   1,   0,   0,   0,
      80, 162,  82,  37,  27, 152,  18, 179,
       2,   0,   7,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     21,   0,   0,   0, 194,   0,   0,   0,
+     21,   0,   0,   0, 146,   0,   0,   0,
      29,   0,   0,   0,   7,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
      25,   0,   0,   0, 119,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     99,  97, 112, 110, 112,  47, 114, 112,
-     99,  46,  99,  97, 112, 110, 112,  58,
-     80,  97, 121, 108, 111,  97, 100,   0,
+    114, 112,  99,  46,  99,  97, 112, 110,
+    112,  58,  80,  97, 121, 108, 111,  97,
+    100,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   1,   0,   1,   0,
       8,   0,   0,   0,   3,   0,   4,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
@@ -1413,67 +1422,73 @@ const ::capnp::_::RawSchema s_9a0e61223d96743b = {
   1, 2, i_9a0e61223d96743b, nullptr, nullptr, { &s_9a0e61223d96743b, nullptr, nullptr, 0, 0, nullptr }
 };
 #endif  // !CAPNP_LITE
-static const ::capnp::_::AlignedData<114> b_8523ddc40b86b8b0 = {
+static const ::capnp::_::AlignedData<129> b_8523ddc40b86b8b0 = {
   {   0,   0,   0,   0,   5,   0,   6,   0,
     176, 184, 134,  11, 196, 221,  35, 133,
-     16,   0,   0,   0,   1,   0,   1,   0,
+     10,   0,   0,   0,   1,   0,   1,   0,
      80, 162,  82,  37,  27, 152,  18, 179,
       1,   0,   7,   0,   0,   0,   6,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     21,   0,   0,   0, 242,   0,   0,   0,
-     33,   0,   0,   0,   7,   0,   0,   0,
+     21,   0,   0,   0, 194,   0,   0,   0,
+     29,   0,   0,   0,   7,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     29,   0,   0,   0,  87,   1,   0,   0,
+     25,   0,   0,   0, 143,   1,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     99,  97, 112, 110, 112,  47, 114, 112,
-     99,  46,  99,  97, 112, 110, 112,  58,
-     67,  97, 112,  68, 101, 115,  99, 114,
-    105, 112, 116, 111, 114,   0,   0,   0,
+    114, 112,  99,  46,  99,  97, 112, 110,
+    112,  58,  67,  97, 112,  68, 101, 115,
+     99, 114, 105, 112, 116, 111, 114,   0,
       0,   0,   0,   0,   1,   0,   1,   0,
-     24,   0,   0,   0,   3,   0,   4,   0,
+     28,   0,   0,   0,   3,   0,   4,   0,
       0,   0, 255, 255,   0,   0,   0,   0,
       0,   0,   1,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-    153,   0,   0,   0,  42,   0,   0,   0,
+    181,   0,   0,   0,  42,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-    148,   0,   0,   0,   3,   0,   1,   0,
-    160,   0,   0,   0,   2,   0,   1,   0,
+    176,   0,   0,   0,   3,   0,   1,   0,
+    188,   0,   0,   0,   2,   0,   1,   0,
       1,   0, 254, 255,   1,   0,   0,   0,
       0,   0,   1,   0,   1,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-    157,   0,   0,   0, 106,   0,   0,   0,
+    185,   0,   0,   0, 106,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-    156,   0,   0,   0,   3,   0,   1,   0,
-    168,   0,   0,   0,   2,   0,   1,   0,
+    184,   0,   0,   0,   3,   0,   1,   0,
+    196,   0,   0,   0,   2,   0,   1,   0,
       2,   0, 253, 255,   1,   0,   0,   0,
       0,   0,   1,   0,   2,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-    165,   0,   0,   0, 114,   0,   0,   0,
+    193,   0,   0,   0, 114,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-    164,   0,   0,   0,   3,   0,   1,   0,
-    176,   0,   0,   0,   2,   0,   1,   0,
+    192,   0,   0,   0,   3,   0,   1,   0,
+    204,   0,   0,   0,   2,   0,   1,   0,
       3,   0, 252, 255,   1,   0,   0,   0,
       0,   0,   1,   0,   3,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-    173,   0,   0,   0, 122,   0,   0,   0,
+    201,   0,   0,   0, 122,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-    172,   0,   0,   0,   3,   0,   1,   0,
-    184,   0,   0,   0,   2,   0,   1,   0,
+    200,   0,   0,   0,   3,   0,   1,   0,
+    212,   0,   0,   0,   2,   0,   1,   0,
       4,   0, 251, 255,   0,   0,   0,   0,
       0,   0,   1,   0,   4,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-    181,   0,   0,   0, 122,   0,   0,   0,
+    209,   0,   0,   0, 122,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-    180,   0,   0,   0,   3,   0,   1,   0,
-    192,   0,   0,   0,   2,   0,   1,   0,
+    208,   0,   0,   0,   3,   0,   1,   0,
+    220,   0,   0,   0,   2,   0,   1,   0,
       5,   0, 250, 255,   0,   0,   0,   0,
       0,   0,   1,   0,   5,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-    189,   0,   0,   0, 138,   0,   0,   0,
+    217,   0,   0,   0, 138,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-    192,   0,   0,   0,   3,   0,   1,   0,
-    204,   0,   0,   0,   2,   0,   1,   0,
+    220,   0,   0,   0,   3,   0,   1,   0,
+    232,   0,   0,   0,   2,   0,   1,   0,
+      6,   0,   0,   0,   2,   0,   0,   0,
+      0,   0,   1,   0,   6,   0,   0,   0,
+      1,   0,   0,   0,   0,   0,   0,   0,
+    229,   0,   0,   0,  90,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+    228,   0,   0,   0,   3,   0,   1,   0,
+    240,   0,   0,   0,   2,   0,   1,   0,
     110, 111, 110, 101,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
@@ -1526,6 +1541,15 @@ static const ::capnp::_::AlignedData<114> b_8523ddc40b86b8b0 = {
       0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
      16,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+     97, 116, 116,  97,  99, 104, 101, 100,
+     70, 100,   0,   0,   0,   0,   0,   0,
+      6,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,
+      6,   0, 255,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0, }
 };
@@ -1535,30 +1559,30 @@ static const ::capnp::_::RawSchema* const d_8523ddc40b86b8b0[] = {
   &s_d37007fde1f0027d,
   &s_d800b1d6cd6f1ca0,
 };
-static const uint16_t m_8523ddc40b86b8b0[] = {0, 4, 3, 1, 2, 5};
-static const uint16_t i_8523ddc40b86b8b0[] = {0, 1, 2, 3, 4, 5};
+static const uint16_t m_8523ddc40b86b8b0[] = {6, 0, 4, 3, 1, 2, 5};
+static const uint16_t i_8523ddc40b86b8b0[] = {0, 1, 2, 3, 4, 5, 6};
 const ::capnp::_::RawSchema s_8523ddc40b86b8b0 = {
-  0x8523ddc40b86b8b0, b_8523ddc40b86b8b0.words, 114, d_8523ddc40b86b8b0, m_8523ddc40b86b8b0,
-  2, 6, i_8523ddc40b86b8b0, nullptr, nullptr, { &s_8523ddc40b86b8b0, nullptr, nullptr, 0, 0, nullptr }
+  0x8523ddc40b86b8b0, b_8523ddc40b86b8b0.words, 129, d_8523ddc40b86b8b0, m_8523ddc40b86b8b0,
+  2, 7, i_8523ddc40b86b8b0, nullptr, nullptr, { &s_8523ddc40b86b8b0, nullptr, nullptr, 0, 0, nullptr }
 };
 #endif  // !CAPNP_LITE
 static const ::capnp::_::AlignedData<57> b_d800b1d6cd6f1ca0 = {
   {   0,   0,   0,   0,   5,   0,   6,   0,
     160,  28, 111, 205, 214, 177,   0, 216,
-     16,   0,   0,   0,   1,   0,   1,   0,
+     10,   0,   0,   0,   1,   0,   1,   0,
      80, 162,  82,  37,  27, 152,  18, 179,
       1,   0,   7,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     21,   0,   0,   0, 250,   0,   0,   0,
+     21,   0,   0,   0, 202,   0,   0,   0,
      33,   0,   0,   0,  23,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
      41,   0,   0,   0, 119,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     99,  97, 112, 110, 112,  47, 114, 112,
-     99,  46,  99,  97, 112, 110, 112,  58,
-     80, 114, 111, 109, 105, 115, 101, 100,
-     65, 110, 115, 119, 101, 114,   0,   0,
+    114, 112,  99,  46,  99,  97, 112, 110,
+    112,  58,  80, 114, 111, 109, 105, 115,
+    101, 100,  65, 110, 115, 119, 101, 114,
+      0,   0,   0,   0,   0,   0,   0,   0,
       4,   0,   0,   0,   1,   0,   1,   0,
     129, 144,  86,  21,  68, 148,  22, 243,
       1,   0,   0,   0,  26,   0,   0,   0,
@@ -1613,24 +1637,23 @@ const ::capnp::_::RawSchema s_d800b1d6cd6f1ca0 = {
   1, 2, i_d800b1d6cd6f1ca0, nullptr, nullptr, { &s_d800b1d6cd6f1ca0, nullptr, nullptr, 0, 0, nullptr }
 };
 #endif  // !CAPNP_LITE
-static const ::capnp::_::AlignedData<50> b_f316944415569081 = {
+static const ::capnp::_::AlignedData<49> b_f316944415569081 = {
   {   0,   0,   0,   0,   5,   0,   6,   0,
     129, 144,  86,  21,  68, 148,  22, 243,
-     31,   0,   0,   0,   1,   0,   1,   0,
+     25,   0,   0,   0,   1,   0,   1,   0,
     160,  28, 111, 205, 214, 177,   0, 216,
       0,   0,   7,   0,   0,   0,   2,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     21,   0,   0,   0,  18,   1,   0,   0,
-     37,   0,   0,   0,   7,   0,   0,   0,
+     21,   0,   0,   0, 226,   0,   0,   0,
+     33,   0,   0,   0,   7,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     33,   0,   0,   0, 119,   0,   0,   0,
+     29,   0,   0,   0, 119,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     99,  97, 112, 110, 112,  47, 114, 112,
-     99,  46,  99,  97, 112, 110, 112,  58,
-     80, 114, 111, 109, 105, 115, 101, 100,
-     65, 110, 115, 119, 101, 114,  46,  79,
-    112,   0,   0,   0,   0,   0,   0,   0,
+    114, 112,  99,  46,  99,  97, 112, 110,
+    112,  58,  80, 114, 111, 109, 105, 115,
+    101, 100,  65, 110, 115, 119, 101, 114,
+     46,  79, 112,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   1,   0,   1,   0,
       8,   0,   0,   0,   3,   0,   4,   0,
       0,   0, 255, 255,   0,   0,   0,   0,
@@ -1670,28 +1693,28 @@ static const ::capnp::_::AlignedData<50> b_f316944415569081 = {
 static const uint16_t m_f316944415569081[] = {1, 0};
 static const uint16_t i_f316944415569081[] = {0, 1};
 const ::capnp::_::RawSchema s_f316944415569081 = {
-  0xf316944415569081, b_f316944415569081.words, 50, nullptr, m_f316944415569081,
+  0xf316944415569081, b_f316944415569081.words, 49, nullptr, m_f316944415569081,
   0, 2, i_f316944415569081, nullptr, nullptr, { &s_f316944415569081, nullptr, nullptr, 0, 0, nullptr }
 };
 #endif  // !CAPNP_LITE
 static const ::capnp::_::AlignedData<49> b_d37007fde1f0027d = {
   {   0,   0,   0,   0,   5,   0,   6,   0,
     125,   2, 240, 225, 253,   7, 112, 211,
-     16,   0,   0,   0,   1,   0,   1,   0,
+     10,   0,   0,   0,   1,   0,   1,   0,
      80, 162,  82,  37,  27, 152,  18, 179,
       1,   0,   7,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     21,   0,   0,   0,  66,   1,   0,   0,
+     21,   0,   0,   0,  18,   1,   0,   0,
      37,   0,   0,   0,   7,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
      33,   0,   0,   0, 119,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     99,  97, 112, 110, 112,  47, 114, 112,
-     99,  46,  99,  97, 112, 110, 112,  58,
-     84, 104, 105, 114, 100,  80,  97, 114,
-    116, 121,  67,  97, 112,  68, 101, 115,
-     99, 114, 105, 112, 116, 111, 114,   0,
+    114, 112,  99,  46,  99,  97, 112, 110,
+    112,  58,  84, 104, 105, 114, 100,  80,
+     97, 114, 116, 121,  67,  97, 112,  68,
+    101, 115,  99, 114, 105, 112, 116, 111,
+    114,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   1,   0,   1,   0,
       8,   0,   0,   0,   3,   0,   4,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
@@ -1734,23 +1757,22 @@ const ::capnp::_::RawSchema s_d37007fde1f0027d = {
   0, 2, i_d37007fde1f0027d, nullptr, nullptr, { &s_d37007fde1f0027d, nullptr, nullptr, 0, 0, nullptr }
 };
 #endif  // !CAPNP_LITE
-static const ::capnp::_::AlignedData<85> b_d625b7063acf691a = {
+static const ::capnp::_::AlignedData<84> b_d625b7063acf691a = {
   {   0,   0,   0,   0,   5,   0,   6,   0,
      26, 105, 207,  58,   6, 183,  37, 214,
-     16,   0,   0,   0,   1,   0,   1,   0,
+     10,   0,   0,   0,   1,   0,   1,   0,
      80, 162,  82,  37,  27, 152,  18, 179,
       1,   0,   7,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     21,   0,   0,   0, 210,   0,   0,   0,
-     33,   0,   0,   0,  23,   0,   0,   0,
+     21,   0,   0,   0, 162,   0,   0,   0,
+     29,   0,   0,   0,  23,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     41,   0,   0,   0, 231,   0,   0,   0,
+     37,   0,   0,   0, 231,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     99,  97, 112, 110, 112,  47, 114, 112,
-     99,  46,  99,  97, 112, 110, 112,  58,
-     69, 120,  99, 101, 112, 116, 105, 111,
-    110,   0,   0,   0,   0,   0,   0,   0,
+    114, 112,  99,  46,  99,  97, 112, 110,
+    112,  58,  69, 120,  99, 101, 112, 116,
+    105, 111, 110,   0,   0,   0,   0,   0,
       4,   0,   0,   0,   1,   0,   1,   0,
      88, 189,  76,  63, 226, 150, 140, 178,
       1,   0,   0,   0,  42,   0,   0,   0,
@@ -1829,27 +1851,27 @@ static const ::capnp::_::RawSchema* const d_d625b7063acf691a[] = {
 static const uint16_t m_d625b7063acf691a[] = {2, 1, 0, 3};
 static const uint16_t i_d625b7063acf691a[] = {0, 1, 2, 3};
 const ::capnp::_::RawSchema s_d625b7063acf691a = {
-  0xd625b7063acf691a, b_d625b7063acf691a.words, 85, d_d625b7063acf691a, m_d625b7063acf691a,
+  0xd625b7063acf691a, b_d625b7063acf691a.words, 84, d_d625b7063acf691a, m_d625b7063acf691a,
   1, 4, i_d625b7063acf691a, nullptr, nullptr, { &s_d625b7063acf691a, nullptr, nullptr, 0, 0, nullptr }
 };
 #endif  // !CAPNP_LITE
 static const ::capnp::_::AlignedData<37> b_b28c96e23f4cbd58 = {
   {   0,   0,   0,   0,   5,   0,   6,   0,
      88, 189,  76,  63, 226, 150, 140, 178,
-     26,   0,   0,   0,   2,   0,   0,   0,
+     20,   0,   0,   0,   2,   0,   0,   0,
      26, 105, 207,  58,   6, 183,  37, 214,
       0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     21,   0,   0,   0, 250,   0,   0,   0,
+     21,   0,   0,   0, 202,   0,   0,   0,
      33,   0,   0,   0,   7,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
      29,   0,   0,   0, 103,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
-     99,  97, 112, 110, 112,  47, 114, 112,
-     99,  46,  99,  97, 112, 110, 112,  58,
-     69, 120,  99, 101, 112, 116, 105, 111,
-    110,  46,  84, 121, 112, 101,   0,   0,
+    114, 112,  99,  46,  99,  97, 112, 110,
+    112,  58,  69, 120,  99, 101, 112, 116,
+    105, 111, 110,  46,  84, 121, 112, 101,
+      0,   0,   0,   0,   0,   0,   0,   0,
       0,   0,   0,   0,   1,   0,   1,   0,
      16,   0,   0,   0,   1,   0,   2,   0,
       0,   0,   0,   0,   0,   0,   0,   0,
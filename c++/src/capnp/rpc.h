@@ -27,6 +27,8 @@
 
 #include "capability.h"
 #include "rpc-prelude.h"
+#include <kj/time.h>
+#include <kj/io.h>
 
 namespace capnp {
 
@@ -111,6 +113,31 @@ public:
   // You may emulate the old concept of object IDs by exporting a bootstrap interface which has
   // methods that can be used to obtain other capabilities by ID.
 
+  void setObserver(kj::Maybe<RpcObserver&> observer);
+  // Installs an observer to be notified of call and message activity on all of this RpcSystem's
+  // connections, or removes it if null. See `RpcObserver`. The observer must outlive the
+  // RpcSystem, or be removed first.
+
+  void setTimer(kj::Maybe<kj::Timer&> timer);
+  // Enables call deadlines (see `Request::setDeadline()`), measured by `timer`. Outgoing calls
+  // with a deadline carry the time remaining; incoming calls that carry a timeout get a deadline,
+  // visible through `CallContext::getDeadline()`, and are failed with OVERLOADED and canceled once
+  // it passes. Without a timer, deadlines are neither sent nor enforced. The timer must outlive
+  // the RpcSystem, or be removed first.
+
+  kj::Array<RpcConnectionStats> getConnectionStats(size_t limit = kj::maxValue);
+  // Returns the memory usage of each of this RpcSystem's connections, heaviest first (by
+  // `RpcConnectionStats::totalBytes()`), and at most `limit` of them. Useful for finding the
+  // peers responsible for a server's memory footprint.
+
+  size_t trimIdleConnections();
+  // Compacts the capability tables and releases spare buffer memory (see
+  // `VatNetwork::Connection::trimBuffers()`) of every connection which has neither sent nor
+  // received a message since the previous call, and returns how many connections were trimmed.
+  // Call this periodically, e.g. once a minute from a timer, so that connections which once saw a
+  // burst of traffic don't hold on to the memory it needed forever. Trimming doesn't affect the
+  // connection's state, only the memory used to represent it.
+
   void setFlowLimit(size_t words);
   // Sets the incoming call flow limit. If more than `words` worth of call messages have not yet
   // received responses, the RpcSystem will not read further messages from the stream. This can be
@@ -294,6 +321,112 @@ private:
   Capability::Client baseRestore(AnyPointer::Reader ref) override final;
 };
 
+// =======================================================================================
+// Instrumentation
+
+class RpcObserver {
+  // Receives notification of the calls and messages passing over the connections of an
+  // RpcSystem, e.g. to collect per-method latency statistics (see `RpcMetrics` in rpc-metrics.h)
+  // or to feed a tracing system. Install with `RpcSystem::setObserver()`.
+  //
+  // Callbacks are invoked synchronously from the RPC system, in the thread of its event loop, and
+  // must not throw or call back into the RPC system. When no observer is installed, the RPC system
+  // does not so much as read the clock, so there is no cost to leaving instrumentation compiled
+  // in.
+  //
+  // Sizes are in words and count the message's entire content, including the RPC protocol
+  // envelope. All times come from `kj::systemPreciseMonotonicClock()`.
+
+public:
+  virtual ~RpcObserver() noexcept(false);
+
+  enum class ReturnType: uint8_t {
+    RESULTS,
+    // The call completed successfully.
+
+    EXCEPTION,
+    // The call threw an exception.
+
+    CANCELED,
+    // The caller canceled the call before it completed.
+
+    REDIRECTED
+    // The results were sent elsewhere (a tail call), so the call's actual outcome is reported
+    // against another question.
+  };
+
+  struct CallEvent {
+    uint64_t interfaceId;
+    uint16_t methodId;
+
+    uint32_t questionId;
+    // The question ID of the call, as assigned by the caller.
+
+    size_t sizeInWords;
+    // Size of the Call or Return message.
+
+    kj::TimePoint startTime;
+    // When the call was sent (for questions) or received (for calls). For the initial event this
+    // equals `time`.
+
+    kj::TimePoint time;
+    // When the event occurred.
+  };
+
+  virtual void questionSent(const CallEvent& event) {}
+  // A call was sent to the peer.
+
+  virtual void questionReturned(const CallEvent& event, ReturnType type) {}
+  // The peer returned from a call we sent.
+
+  virtual void callReceived(const CallEvent& event) {}
+  // A call was received from the peer.
+
+  virtual void callReturned(const CallEvent& event, ReturnType type) {}
+  // We returned from a call received from the peer.
+
+  virtual void messageRead(uint16_t type, size_t sizeInWords, kj::TimePoint time) {}
+  virtual void messageWritten(uint16_t type, size_t sizeInWords, kj::TimePoint time) {}
+  // A message of any kind was received from or sent to the peer. `type` is the message's
+  // `rpc::Message::Which` (see rpc.capnp.h), given as an integer so that this header need not
+  // depend on the protocol schema.
+
+  virtual void controlMessagesFlushed(size_t queued, size_t sent) {}
+  // `Finish` and `Release` messages are not sent immediately but collected over an event loop
+  // turn and then sent together, merging `Release`s of the same import. This is called when a
+  // batch goes out: `queued` messages were requested and `sent` were actually written.
+};
+
+struct RpcConnectionStats {
+  // Memory usage of one connection of an RpcSystem. See `RpcSystem::getConnectionStats()`.
+
+  AnyStruct::Reader peerVatId;
+  // The connection's `VatNetwork::Connection::getPeerVatId()`; use `as<VatId>()` to read it.
+  // Valid only until the connection is dropped, so copy whatever you need before returning to the
+  // event loop.
+
+  size_t exports;
+  size_t imports;
+  size_t questions;
+  size_t answers;
+  // Number of live entries in each of the connection's four tables.
+
+  size_t tableBytes;
+  // Approximate memory, in bytes, held by the four tables and associated indexes, including
+  // space left over from entries that have since been freed.
+
+  size_t bufferedBytes;
+  // The connection's `VatNetwork::Connection::getBufferedBytes()`.
+
+  size_t callWordsInFlight;
+  // Size of the calls received from the peer which have not yet returned; see
+  // `RpcSystem::setFlowLimit()`.
+
+  inline size_t totalBytes() const {
+    return tableBytes + bufferedBytes + callWordsInFlight * sizeof(word);
+  }
+};
+
 // =======================================================================================
 // VatNetwork
 
@@ -308,6 +441,12 @@ public:
   virtual void send() = 0;
   // Send the message, or at least put it in a queue to be sent later.  Note that the builder
   // returned by `getBody()` remains valid at least until the `OutgoingRpcMessage` is destroyed.
+
+  virtual void setFds(kj::Array<int> fds) {}
+  // Attach file descriptors to the message, to be sent along with it. The RPC system refers to
+  // them by index from `CapDescriptor.attachedFd`. The descriptors are owned by the caller and
+  // remain open at least until the message is destroyed. The default implementation, for networks
+  // that cannot pass FDs, drops them, in which case the receiver simply sees no attachments.
 };
 
 class IncomingRpcMessage {
@@ -317,6 +456,15 @@ public:
   virtual AnyPointer::Reader getBody() = 0;
   // Get the message body, to be interpreted by the caller.  (The standard RPC implementation
   // interprets it as a Message as defined in rpc.capnp.)
+
+  virtual kj::Maybe<kj::Array<const byte>> shareData(Data::Reader data) { return nullptr; }
+  // Like `MessageReader::shareData()`: if `data` lies within this message in memory which can
+  // outlive it, returns an array referencing that memory.
+
+  virtual kj::ArrayPtr<kj::AutoCloseFd> getAttachedFds() { return nullptr; }
+  // Gets the file descriptors that arrived with this message, in the order they were passed to
+  // `setFds()` by the sender. The RPC system may move descriptors out of the array to take
+  // ownership of them.
 };
 
 template <typename VatId, typename ProvisionId, typename RecipientId,
@@ -385,8 +533,61 @@ public:
     // Waits until all outgoing messages have been sent, then shuts down the outgoing stream. The
     // returned promise resolves after shutdown is complete.
 
+    virtual size_t getBufferedBytes() override { return 0; }
+    // Returns an estimate of the memory, in bytes, held by the connection's own buffers: messages
+    // queued but not yet written, messages read but not yet delivered, and spare capacity. Used
+    // by `RpcSystem::getConnectionStats()`.
+
+    virtual void trimBuffers() override {}
+    // Releases whatever buffer memory the connection can give up without losing data, e.g. spare
+    // capacity left over from a burst of traffic. Called by `RpcSystem::trimIdleConnections()`.
+
+    // Level 3 features ----------------------------------------------
+    //
+    // These allow the RPC system to hand a capability hosted by one peer directly to another,
+    // rather than proxying every call through this vat.  See `Provide`, `Accept`, and
+    // `ThirdPartyCapDescriptor` in rpc.capnp.  The default implementations disable this, in which
+    // case capabilities passed between peers are proxied as usual.
+
+    virtual bool canIntroduceTo(Connection& other) { return false; }
+    // Returns true if the peer of `other` (the "recipient") can be introduced to the peer of this
+    // connection (the "host"), so that the recipient can connect to the host directly and pick up
+    // a capability provided there.  `other` is another connection created by the same network.
+
+    virtual void introduceTo(Connection& other,
+                             typename ThirdPartyCapId::Builder otherContactInfo,
+                             typename RecipientId::Builder thisContactInfo);
+    // Called only if `canIntroduceTo(other)` returned true.  Fills in `otherContactInfo`, to be
+    // sent to the recipient, telling it how to reach the host and which provision to pick up, and
+    // `thisContactInfo`, to be sent to the host in a `Provide`, telling it whom to expect.
+
+    virtual kj::Maybe<ConnectionAndProvisionId> connectToIntroduced(
+        typename ThirdPartyCapId::Reader capId);
+    // Called on the recipient's connection to the introducer, with a `ThirdPartyCapId` which the
+    // introducer sent over it.  Connects to the host and allocates the `ProvisionId` to present
+    // in the `Accept`.  Returns null if the host can't be reached directly, in which case the
+    // recipient uses the vine (a proxy through the introducer) instead.
+
+    virtual kj::Maybe<kj::String> getProvideKey(typename RecipientId::Reader recipientId);
+    virtual kj::Maybe<kj::String> getAcceptKey(typename ProvisionId::Reader provisionId);
+    // Called on the host to match up a `Provide` with the `Accept` picking it up.  getProvideKey()
+    // is called on the connection to the introducer, with the `RecipientId` from the `Provide`.
+    // getAcceptKey() is called on the connection to the recipient, with the `ProvisionId` from the
+    // `Accept`.  The two must return equal strings exactly when the `Accept` comes from the
+    // recipient the introducer named and refers to the same provision; incorporating the
+    // authenticated identities of both peers is the network's job.  Returns null if the ID is
+    // malformed.
+
   private:
     AnyStruct::Reader baseGetPeerVatId() override;
+    bool baseCanIntroduceTo(_::VatNetworkBase::Connection& other) override;
+    void baseIntroduceTo(_::VatNetworkBase::Connection& other,
+                         AnyPointer::Builder otherContactInfo,
+                         AnyPointer::Builder thisContactInfo) override;
+    kj::Maybe<_::VatNetworkBase::ConnectionAndProvisionId> baseConnectToIntroduced(
+        AnyPointer::Reader capId) override;
+    kj::Maybe<kj::String> baseGetProvideKey(AnyPointer::Reader recipientId) override;
+    kj::Maybe<kj::String> baseGetAcceptKey(AnyPointer::Reader provisionId) override;
   };
 
   // Level 0 features ------------------------------------------------
@@ -453,6 +654,79 @@ AnyStruct::Reader VatNetwork<
   return getPeerVatId();
 }
 
+template <typename SturdyRef, typename ProvisionId, typename RecipientId,
+          typename ThirdPartyCapId, typename JoinResult>
+void VatNetwork<SturdyRef, ProvisionId, RecipientId, ThirdPartyCapId, JoinResult>::Connection::introduceTo(
+    Connection& other, typename ThirdPartyCapId::Builder otherContactInfo,
+    typename RecipientId::Builder thisContactInfo) {
+  // Never called, since canIntroduceTo() returns false by default.
+}
+
+template <typename SturdyRef, typename ProvisionId, typename RecipientId,
+          typename ThirdPartyCapId, typename JoinResult>
+kj::Maybe<typename VatNetwork<SturdyRef, ProvisionId, RecipientId, ThirdPartyCapId, JoinResult>::ConnectionAndProvisionId>
+    VatNetwork<SturdyRef, ProvisionId, RecipientId, ThirdPartyCapId, JoinResult>::Connection::
+    connectToIntroduced(typename ThirdPartyCapId::Reader capId) {
+  return nullptr;
+}
+
+template <typename SturdyRef, typename ProvisionId, typename RecipientId,
+          typename ThirdPartyCapId, typename JoinResult>
+kj::Maybe<kj::String> VatNetwork<SturdyRef, ProvisionId, RecipientId, ThirdPartyCapId, JoinResult>::Connection::
+    getProvideKey(typename RecipientId::Reader recipientId) {
+  return nullptr;
+}
+
+template <typename SturdyRef, typename ProvisionId, typename RecipientId,
+          typename ThirdPartyCapId, typename JoinResult>
+kj::Maybe<kj::String> VatNetwork<SturdyRef, ProvisionId, RecipientId, ThirdPartyCapId, JoinResult>::Connection::
+    getAcceptKey(typename ProvisionId::Reader provisionId) {
+  return nullptr;
+}
+
+template <typename SturdyRef, typename ProvisionId, typename RecipientId,
+          typename ThirdPartyCapId, typename JoinResult>
+bool VatNetwork<SturdyRef, ProvisionId, RecipientId, ThirdPartyCapId, JoinResult>::Connection::
+    baseCanIntroduceTo(_::VatNetworkBase::Connection& other) {
+  return canIntroduceTo(kj::downcast<Connection>(other));
+}
+
+template <typename SturdyRef, typename ProvisionId, typename RecipientId,
+          typename ThirdPartyCapId, typename JoinResult>
+void VatNetwork<SturdyRef, ProvisionId, RecipientId, ThirdPartyCapId, JoinResult>::Connection::
+    baseIntroduceTo(_::VatNetworkBase::Connection& other, AnyPointer::Builder otherContactInfo,
+                    AnyPointer::Builder thisContactInfo) {
+  introduceTo(kj::downcast<Connection>(other), otherContactInfo.initAs<ThirdPartyCapId>(),
+              thisContactInfo.initAs<RecipientId>());
+}
+
+template <typename SturdyRef, typename ProvisionId, typename RecipientId,
+          typename ThirdPartyCapId, typename JoinResult>
+kj::Maybe<_::VatNetworkBase::ConnectionAndProvisionId> VatNetwork<SturdyRef, ProvisionId, RecipientId, ThirdPartyCapId, JoinResult>::
+    Connection::baseConnectToIntroduced(AnyPointer::Reader capId) {
+  KJ_IF_MAYBE(result, connectToIntroduced(capId.getAs<ThirdPartyCapId>())) {
+    return _::VatNetworkBase::ConnectionAndProvisionId {
+      kj::mv(result->connection), kj::mv(result->firstMessage), kj::mv(result->provisionId)
+    };
+  } else {
+    return nullptr;
+  }
+}
+
+template <typename SturdyRef, typename ProvisionId, typename RecipientId,
+          typename ThirdPartyCapId, typename JoinResult>
+kj::Maybe<kj::String> VatNetwork<SturdyRef, ProvisionId, RecipientId, ThirdPartyCapId, JoinResult>::Connection::
+    baseGetProvideKey(AnyPointer::Reader recipientId) {
+  return getProvideKey(recipientId.getAs<RecipientId>());
+}
+
+template <typename SturdyRef, typename ProvisionId, typename RecipientId,
+          typename ThirdPartyCapId, typename JoinResult>
+kj::Maybe<kj::String> VatNetwork<SturdyRef, ProvisionId, RecipientId, ThirdPartyCapId, JoinResult>::Connection::
+    baseGetAcceptKey(AnyPointer::Reader provisionId) {
+  return getAcceptKey(provisionId.getAs<ProvisionId>());
+}
+
 template <typename SturdyRef>
 Capability::Client SturdyRefRestorer<SturdyRef>::baseRestore(AnyPointer::Reader ref) {
 #pragma GCC diagnostic push
@@ -499,6 +773,26 @@ Capability::Client RpcSystem<VatId>::restore(
   return baseRestore(_::PointerHelpers<VatId>::getInternalReader(hostId), objectId);
 }
 
+template <typename VatId>
+inline void RpcSystem<VatId>::setObserver(kj::Maybe<RpcObserver&> observer) {
+  baseSetObserver(observer);
+}
+
+template <typename VatId>
+inline void RpcSystem<VatId>::setTimer(kj::Maybe<kj::Timer&> timer) {
+  baseSetTimer(timer);
+}
+
+template <typename VatId>
+inline kj::Array<RpcConnectionStats> RpcSystem<VatId>::getConnectionStats(size_t limit) {
+  return baseGetConnectionStats(limit);
+}
+
+template <typename VatId>
+inline size_t RpcSystem<VatId>::trimIdleConnections() {
+  return baseTrimIdleConnections();
+}
+
 template <typename VatId>
 inline void RpcSystem<VatId>::setFlowLimit(size_t words) {
   baseSetFlowLimit(words);
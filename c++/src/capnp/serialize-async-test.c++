@@ -343,6 +343,84 @@ TEST(SerializeAsyncTest, WriteAsyncEvenSegmentCount) {
   writeMessage(*output, message).wait(ioContext.waitScope);
 }
 
+TEST(SerializeAsyncTest, WriteMessagesAsync) {
+  PipeWithSmallBuffer fds;
+  auto ioContext = kj::setupAsyncIo();
+  auto output = ioContext.lowLevelProvider->wrapOutputFd(fds[1]);
+
+  // Mix odd and even segment counts, so that the segment tables have different padding.
+  TestMessageBuilder message1(1);
+  TestMessageBuilder message2(7);
+  TestMessageBuilder message3(10);
+  MessageBuilder* builders[3] = { &message1, &message2, &message3 };
+  for (auto builder: builders) {
+    auto list = builder->getRoot<TestAllTypes>().initStructList(16);
+    for (auto element: list) {
+      initTestMessage(element);
+    }
+  }
+
+  kj::Thread thread([&]() {
+    SocketInputStream input(fds[0]);
+    for (uint i = 0; i < 3; i++) {
+      InputStreamMessageReader reader(input);
+      auto listReader = reader.getRoot<TestAllTypes>().getStructList();
+      EXPECT_EQ(16u, listReader.size());
+      for (auto element: listReader) {
+        checkTestMessage(element);
+      }
+    }
+  });
+
+  writeMessages(*output, builders).wait(ioContext.waitScope);
+}
+
+TEST(SerializeAsyncTest, LargeSegmentsReceivedSeparately) {
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+  auto pipe = kj::newOneWayPipe();
+
+  MallocMessageBuilder builder;
+  auto root = builder.getRoot<TestAllTypes>();
+  root.setTextField("small");
+  auto blob = kj::heapArray<byte>(100000);
+  for (auto i: kj::indices(blob)) {
+    blob[i] = i % 251;
+  }
+  root.adoptDataField(builder.getOrphanage().referenceExternalData(
+      kj::Array<const byte>(kj::mv(blob))));
+  ASSERT_EQ(2u, builder.getSegmentsForOutput().size());
+
+  auto writePromise = writeMessage(*pipe.out, builder);
+  auto reader = readMessage(*pipe.in).wait(waitScope);
+  writePromise.wait(waitScope);
+
+  auto data = reader->getRoot<TestAllTypes>().getDataField();
+  ASSERT_EQ(100000u, data.size());
+
+  // The large segment was received into a page-aligned buffer of its own, which outlives the
+  // rest of the message.
+  auto shared = KJ_ASSERT_NONNULL(reader->shareData(data));
+  EXPECT_EQ(data.begin(), shared.begin());
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(shared.begin()) % 4096);
+  EXPECT_TRUE(reader->shareData(reader->getRoot<TestAllTypes>().getTextField().asBytes())
+      == nullptr);
+
+  reader = nullptr;
+  bool intact = true;
+  for (auto i: kj::indices(shared)) {
+    intact = intact && shared[i] == i % 251;
+  }
+  EXPECT_TRUE(intact);
+
+  // With enough scratch space, everything is read into it as before.
+  auto scratch = kj::heapArray<word>(20000);
+  writePromise = writeMessage(*pipe.out, builder);
+  reader = readMessage(*pipe.in, ReaderOptions(), scratch).wait(waitScope);
+  writePromise.wait(waitScope);
+  EXPECT_TRUE(reader->shareData(reader->getRoot<TestAllTypes>().getDataField()) == nullptr);
+}
+
 }  // namespace
 }  // namespace _ (private)
 }  // namespace capnp
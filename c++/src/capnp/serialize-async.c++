@@ -21,11 +21,77 @@
 
 #include "serialize-async.h"
 #include <kj/debug.h>
+#include <stdlib.h>
+
+#if _WIN32
+#include <malloc.h>
+#endif
 
 namespace capnp {
 
 namespace {
 
+constexpr size_t LARGE_SEGMENT_WORDS = 8192;
+// Segments at least this big (64 KiB) are received into page-aligned buffers of their own,
+// rather than into the one buffer holding the rest of the message.  A blob attached with
+// `Orphanage::referenceExternalData()` travels as a segment of its own, so when it is large, the
+// receiver can take it over with `MessageReader::shareData()` without copying it.
+
+constexpr size_t SEGMENT_BUFFER_ALIGNMENT = 4096;
+
+class SegmentBuffer final: public kj::Refcounted {
+  // A page-aligned buffer holding one large segment.
+
+public:
+  explicit SegmentBuffer(size_t wordCount): size(wordCount) {
+#if _WIN32
+    words = reinterpret_cast<word*>(
+        _aligned_malloc(wordCount * sizeof(word), SEGMENT_BUFFER_ALIGNMENT));
+    KJ_ASSERT(words != nullptr, "memory allocation failed", wordCount);
+#else
+    void* ptr;
+    int error = posix_memalign(&ptr, SEGMENT_BUFFER_ALIGNMENT, wordCount * sizeof(word));
+    if (error != 0) {
+      KJ_FAIL_SYSCALL("posix_memalign", error, wordCount);
+    }
+    words = reinterpret_cast<word*>(ptr);
+#endif
+  }
+
+  ~SegmentBuffer() noexcept(false) {
+#if _WIN32
+    _aligned_free(words);
+#else
+    free(words);
+#endif
+  }
+
+  KJ_DISALLOW_COPY(SegmentBuffer);
+
+  kj::ArrayPtr<word> asWords() { return kj::arrayPtr(words, size); }
+
+private:
+  word* words;
+  size_t size;
+};
+
+class SharedSegmentDisposer final: public kj::ArrayDisposer {
+  // Disposer for an array pointing into a SegmentBuffer.  Holds a reference to the buffer and
+  // deletes itself along with the array.
+
+public:
+  explicit SharedSegmentDisposer(kj::Own<SegmentBuffer>&& buffer): buffer(kj::mv(buffer)) {}
+
+protected:
+  void disposeImpl(void* firstElement, size_t elementSize, size_t elementCount,
+                   size_t capacity, void (*destroyElement)(void*)) const override {
+    delete this;
+  }
+
+private:
+  kj::Own<SegmentBuffer> buffer;
+};
+
 class AsyncMessageReader: public MessageReader {
 public:
   inline AsyncMessageReader(ReaderOptions options): MessageReader(options) {
@@ -35,17 +101,32 @@ public:
 
   kj::Promise<bool> read(kj::AsyncInputStream& inputStream, kj::ArrayPtr<word> scratchSpace);
 
+  kj::Promise<kj::Maybe<size_t>> readWithFds(
+      kj::AsyncCapabilityStream& inputStream, kj::ArrayPtr<kj::AutoCloseFd> fds,
+      kj::ArrayPtr<word> scratchSpace);
+  // Returns the number of descriptors received, or null on EOF.
+
   // implements MessageReader ----------------------------------------
 
   kj::ArrayPtr<const word> getSegment(uint id) override {
     if (id >= segmentCount()) {
       return nullptr;
     } else {
-      uint32_t size = id == 0 ? segment0Size() : moreSizes[id - 1].get();
-      return kj::arrayPtr(segmentStarts[id], size);
+      return kj::arrayPtr(segmentStarts[id], segmentSize(id));
     }
   }
 
+  kj::Maybe<kj::Array<const byte>> shareData(Data::Reader data) override {
+    for (auto& buffer: largeSegments) {
+      auto bytes = buffer->asWords().asBytes();
+      if (data.begin() >= bytes.begin() && data.end() <= bytes.end()) {
+        return kj::Array<const byte>(data.begin(), data.size(),
+                                     *new SharedSegmentDisposer(kj::addRef(*buffer)));
+      }
+    }
+    return nullptr;
+  }
+
 private:
   _::WireValue<uint32_t> firstWord[2];
   kj::Array<_::WireValue<uint32_t>> moreSizes;
@@ -54,13 +135,24 @@ private:
   kj::Array<word> ownedSpace;
   // Only if scratchSpace wasn't big enough.
 
+  kj::Vector<kj::Own<SegmentBuffer>> largeSegments;
+  // Segments of at least LARGE_SEGMENT_WORDS, only if scratchSpace wasn't big enough.
+
+  kj::Array<kj::ArrayPtr<word>> readPlan;
+  // Contiguous regions into which the segments are read, in order.
+
   inline uint segmentCount() { return firstWord[0].get() + 1; }
   inline uint segment0Size() { return firstWord[1].get(); }
+  inline size_t segmentSize(uint id) {
+    return id == 0 ? segment0Size() : moreSizes[id - 1].get();
+  }
 
   kj::Promise<void> readAfterFirstWord(
       kj::AsyncInputStream& inputStream, kj::ArrayPtr<word> scratchSpace);
   kj::Promise<void> readSegments(
       kj::AsyncInputStream& inputStream, kj::ArrayPtr<word> scratchSpace);
+  kj::Promise<void> readRegions(
+      kj::AsyncInputStream& inputStream, kj::ArrayPtr<const kj::ArrayPtr<word>> regions);
 };
 
 kj::Promise<bool> AsyncMessageReader::read(kj::AsyncInputStream& inputStream,
@@ -80,6 +172,30 @@ kj::Promise<bool> AsyncMessageReader::read(kj::AsyncInputStream& inputStream,
   });
 }
 
+kj::Promise<kj::Maybe<size_t>> AsyncMessageReader::readWithFds(
+    kj::AsyncCapabilityStream& inputStream, kj::ArrayPtr<kj::AutoCloseFd> fds,
+    kj::ArrayPtr<word> scratchSpace) {
+  // Descriptors arrive with the first byte of the message, so only the first read needs to look
+  // for them.
+  return inputStream.tryReadWithFds(firstWord, sizeof(firstWord), sizeof(firstWord),
+                                    fds.begin(), fds.size())
+      .then([this,&inputStream,KJ_CPCAP(scratchSpace)](
+          kj::AsyncCapabilityStream::ReadResult result) mutable
+          -> kj::Promise<kj::Maybe<size_t>> {
+    if (result.byteCount == 0) {
+      return kj::Maybe<size_t>(nullptr);
+    } else if (result.byteCount < sizeof(firstWord)) {
+      // EOF in first word.
+      KJ_FAIL_REQUIRE("Premature EOF.") {
+        return kj::Maybe<size_t>(nullptr);
+      }
+    }
+
+    return readAfterFirstWord(inputStream, scratchSpace)
+        .then([result]() -> kj::Maybe<size_t> { return result.capCount; });
+  });
+}
+
 kj::Promise<void> AsyncMessageReader::readAfterFirstWord(kj::AsyncInputStream& inputStream,
                                                          kj::ArrayPtr<word> scratchSpace) {
   if (segmentCount() == 0) {
@@ -122,27 +238,58 @@ kj::Promise<void> AsyncMessageReader::readSegments(kj::AsyncInputStream& inputSt
     return kj::READY_NOW;  // exception will be propagated
   }
 
+  size_t largeThreshold = kj::maxValue;
   if (scratchSpace.size() < totalWords) {
-    // TODO(perf):  Consider allocating each segment as a separate chunk to reduce memory
-    //   fragmentation.
-    ownedSpace = kj::heapArray<word>(totalWords);
+    // Allocate each large segment separately, so that the application can take over the content
+    // of one without keeping the rest of the message.  The rest share a single allocation.
+    largeThreshold = LARGE_SEGMENT_WORDS;
+    size_t smallWords = 0;
+    for (uint i = 0; i < segmentCount(); i++) {
+      size_t size = segmentSize(i);
+      if (size < largeThreshold) smallWords += size;
+    }
+    ownedSpace = kj::heapArray<word>(smallWords);
     scratchSpace = ownedSpace;
   }
 
   segmentStarts = kj::heapArray<const word*>(segmentCount());
+  kj::Vector<kj::ArrayPtr<word>> regions;
+  size_t offset = 0;
+
+  for (uint i = 0; i < segmentCount(); i++) {
+    size_t size = segmentSize(i);
+    kj::ArrayPtr<word> space;
+    if (size >= largeThreshold) {
+      auto buffer = kj::refcounted<SegmentBuffer>(size);
+      space = buffer->asWords();
+      largeSegments.add(kj::mv(buffer));
+    } else {
+      space = scratchSpace.slice(offset, offset + size);
+      offset += size;
+    }
+    segmentStarts[i] = space.begin();
 
-  segmentStarts[0] = scratchSpace.begin();
-
-  if (segmentCount() > 1) {
-    size_t offset = segment0Size();
-
-    for (uint i = 1; i < segmentCount(); i++) {
-      segmentStarts[i] = scratchSpace.begin() + offset;
-      offset += moreSizes[i-1].get();
+    if (regions.size() > 0 && regions.back().end() == space.begin()) {
+      regions.back() = kj::arrayPtr(regions.back().begin(), space.end());
+    } else {
+      regions.add(space);
     }
   }
 
-  return inputStream.read(scratchSpace.begin(), totalWords * sizeof(word));
+  readPlan = regions.releaseAsArray();
+  return readRegions(inputStream, readPlan);
+}
+
+kj::Promise<void> AsyncMessageReader::readRegions(
+    kj::AsyncInputStream& inputStream, kj::ArrayPtr<const kj::ArrayPtr<word>> regions) {
+  kj::ArrayPtr<word> region = regions[0];
+  auto promise = inputStream.read(region.begin(), region.size() * sizeof(word));
+  if (regions.size() == 1) {
+    return kj::mv(promise);
+  }
+  return promise.then([this,&inputStream,regions]() {
+    return readRegions(inputStream, regions.slice(1, regions.size()));
+  });
 }
 
 
@@ -172,6 +319,35 @@ kj::Promise<kj::Maybe<kj::Own<MessageReader>>> tryReadMessage(
   }));
 }
 
+kj::Promise<MessageReaderAndFds> readMessage(
+    kj::AsyncCapabilityStream& input, kj::ArrayPtr<kj::AutoCloseFd> fdSpace,
+    ReaderOptions options, kj::ArrayPtr<word> scratchSpace) {
+  return tryReadMessage(input, fdSpace, options, scratchSpace)
+      .then([](kj::Maybe<MessageReaderAndFds>&& result) {
+    KJ_IF_MAYBE(r, result) {
+      return kj::mv(*r);
+    } else {
+      KJ_FAIL_REQUIRE("Premature EOF.");
+    }
+  });
+}
+
+kj::Promise<kj::Maybe<MessageReaderAndFds>> tryReadMessage(
+    kj::AsyncCapabilityStream& input, kj::ArrayPtr<kj::AutoCloseFd> fdSpace,
+    ReaderOptions options, kj::ArrayPtr<word> scratchSpace) {
+  auto reader = kj::heap<AsyncMessageReader>(options);
+  auto promise = reader->readWithFds(input, fdSpace, scratchSpace);
+  return promise.then(kj::mvCapture(reader,
+        [fdSpace](kj::Own<MessageReader>&& reader, kj::Maybe<size_t> fdCount) mutable
+        -> kj::Maybe<MessageReaderAndFds> {
+    KJ_IF_MAYBE(n, fdCount) {
+      return MessageReaderAndFds { kj::mv(reader), fdSpace.slice(0, *n) };
+    } else {
+      return nullptr;
+    }
+  }));
+}
+
 // =======================================================================================
 
 namespace {
@@ -183,38 +359,94 @@ struct WriteArrays {
   kj::Array<kj::ArrayPtr<const byte>> pieces;
 };
 
-}  // namespace
+size_t tableSizeFor(kj::ArrayPtr<const kj::ArrayPtr<const word>> segments) {
+  return (segments.size() + 2) & ~size_t(1);
+}
 
-kj::Promise<void> writeMessage(kj::AsyncOutputStream& output,
-                               kj::ArrayPtr<const kj::ArrayPtr<const word>> segments) {
-  KJ_REQUIRE(segments.size() > 0, "Tried to serialize uninitialized message.");
+void fillWriteArrays(kj::ArrayPtr<const kj::ArrayPtr<const word>> segments,
+                     kj::ArrayPtr<_::WireValue<uint32_t>> table,
+                     kj::ArrayPtr<const byte>*& pieces) {
+  // Fills in `table` (of size tableSizeFor(segments)) and appends the message's pieces, starting
+  // with the table, at `pieces`.
 
-  WriteArrays arrays;
-  arrays.table = kj::heapArray<_::WireValue<uint32_t>>((segments.size() + 2) & ~size_t(1));
+  KJ_REQUIRE(segments.size() > 0, "Tried to serialize uninitialized message.");
 
   // We write the segment count - 1 because this makes the first word zero for single-segment
   // messages, improving compression.  We don't bother doing this with segment sizes because
   // one-word segments are rare anyway.
-  arrays.table[0].set(segments.size() - 1);
+  table[0].set(segments.size() - 1);
   for (uint i = 0; i < segments.size(); i++) {
-    arrays.table[i + 1].set(segments[i].size());
+    table[i + 1].set(segments[i].size());
   }
   if (segments.size() % 2 == 0) {
     // Set padding byte.
-    arrays.table[segments.size() + 1].set(0);
+    table[segments.size() + 1].set(0);
   }
 
+  *pieces++ = table.asBytes();
+  for (auto& segment: segments) {
+    *pieces++ = segment.asBytes();
+  }
+}
+
+}  // namespace
+
+kj::Promise<void> writeMessage(kj::AsyncOutputStream& output,
+                               kj::ArrayPtr<const kj::ArrayPtr<const word>> segments) {
+  return writeMessages(output, kj::arrayPtr(&segments, 1));
+}
+
+kj::Promise<void> writeMessage(kj::AsyncCapabilityStream& output, kj::ArrayPtr<const int> fds,
+                               kj::ArrayPtr<const kj::ArrayPtr<const word>> segments) {
+  WriteArrays arrays;
+  arrays.table = kj::heapArray<_::WireValue<uint32_t>>(tableSizeFor(segments));
   arrays.pieces = kj::heapArray<kj::ArrayPtr<const byte>>(segments.size() + 1);
-  arrays.pieces[0] = arrays.table.asBytes();
 
-  for (uint i = 0; i < segments.size(); i++) {
-    arrays.pieces[i + 1] = segments[i].asBytes();
+  auto pieces = arrays.pieces.begin();
+  fillWriteArrays(segments, arrays.table, pieces);
+
+  auto promise = output.writeWithFds(arrays.pieces[0],
+                                     arrays.pieces.slice(1, arrays.pieces.size()), fds);
+
+  // Make sure the arrays aren't freed until the write completes.
+  return promise.then(kj::mvCapture(arrays, [](WriteArrays&&) {}));
+}
+
+kj::Promise<void> writeMessages(
+    kj::AsyncOutputStream& output,
+    kj::ArrayPtr<const kj::ArrayPtr<const kj::ArrayPtr<const word>>> messages) {
+  KJ_REQUIRE(messages.size() > 0, "Tried to serialize zero messages.");
+
+  size_t tableSize = 0;
+  size_t pieceCount = 0;
+  for (auto& segments: messages) {
+    tableSize += tableSizeFor(segments);
+    pieceCount += segments.size() + 1;
   }
 
+  WriteArrays arrays;
+  arrays.table = kj::heapArray<_::WireValue<uint32_t>>(tableSize);
+  arrays.pieces = kj::heapArray<kj::ArrayPtr<const byte>>(pieceCount);
+
+  auto table = arrays.table.begin();
+  auto pieces = arrays.pieces.begin();
+  for (auto& segments: messages) {
+    size_t size = tableSizeFor(segments);
+    fillWriteArrays(segments, kj::arrayPtr(table, size), pieces);
+    table += size;
+  }
+  KJ_ASSERT(pieces == arrays.pieces.end());
+
   auto promise = output.write(arrays.pieces);
 
   // Make sure the arrays aren't freed until the write completes.
   return promise.then(kj::mvCapture(arrays, [](WriteArrays&&) {}));
 }
 
+kj::Promise<void> writeMessages(kj::AsyncOutputStream& output,
+                                kj::ArrayPtr<MessageBuilder*> builders) {
+  auto messages = KJ_MAP(builder, builders) { return builder->getSegmentsForOutput(); };
+  return writeMessages(output, messages);
+}
+
 }  // namespace capnp
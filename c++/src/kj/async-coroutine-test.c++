@@ -0,0 +1,108 @@
+// Copyright (c) 2013-2014 Sandstorm Development Group, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// Built as a separate test binary in C++20 mode; see CMakeLists.txt.
+
+#include "async.h"
+#include "debug.h"
+#include <kj/compat/gtest.h>
+
+#if !KJ_HAS_COROUTINE
+#error "This file must be compiled as C++20 by a compiler that KJ_HAS_COROUTINE accepts."
+#endif
+
+namespace kj {
+namespace {
+
+Promise<int> addLater(int a, int b) {
+  int x = co_await evalLater([a]() { return a; });
+  int y = co_await evalLater([b]() { return b; });
+  co_return x + y;
+}
+
+Promise<void> failLater() {
+  co_await evalLater([]() {});
+  KJ_FAIL_ASSERT("oops");
+}
+
+Promise<int> awaitFailure() {
+  try {
+    co_await failLater();
+  } catch (const kj::Exception& e) {
+    KJ_EXPECT(e.getDescription().endsWith("oops"), e.getDescription());
+    co_return 321;
+  }
+  co_return 0;
+}
+
+TEST(Async, Coroutine) {
+  EventLoop loop;
+  WaitScope waitScope(loop);
+
+  EXPECT_EQ(5, addLater(2, 3).wait(waitScope));
+
+  Promise<int> promise = addLater(1, 1);
+  EXPECT_EQ(42, addLater(20, 20).then([&](int n) {
+    return promise.then([n](int m) { return n + m; });
+  }).wait(waitScope));
+
+  KJ_EXPECT_THROW_MESSAGE("oops", failLater().wait(waitScope));
+  EXPECT_EQ(321, awaitFailure().wait(waitScope));
+}
+
+class SetOnDestruction {
+public:
+  explicit SetOnDestruction(bool& flag): flag(flag) {}
+  ~SetOnDestruction() { flag = true; }
+
+private:
+  bool& flag;
+};
+
+Promise<void> awaitThenSet(Promise<void> promise, bool* destroyed, bool* finished) {
+  SetOnDestruction guard(*destroyed);
+  co_await promise;
+  *finished = true;
+}
+
+TEST(Async, CoroutineCancellation) {
+  EventLoop loop;
+  WaitScope waitScope(loop);
+
+  bool destroyed = false;
+  bool finished = false;
+  auto paf = newPromiseAndFulfiller<void>();
+
+  {
+    auto promise = awaitThenSet(kj::mv(paf.promise), &destroyed, &finished);
+    evalLater([]() {}).wait(waitScope);
+    EXPECT_FALSE(destroyed);
+    EXPECT_TRUE(paf.fulfiller->isWaiting());
+  }
+
+  // Dropping the promise destroyed the frame and the promise it was awaiting.
+  EXPECT_TRUE(destroyed);
+  EXPECT_FALSE(finished);
+  EXPECT_FALSE(paf.fulfiller->isWaiting());
+}
+
+}  // namespace
+}  // namespace kj
@@ -104,6 +104,12 @@ public:
 
   void armBreadthFirst();
   // Like `armDepthFirst()` except that the event is placed at the end of the queue.
+  //
+  // Both place the event in the lane of the currently-firing event.  See `EventPriority`.
+
+  void armBreadthFirst(EventPriority priority);
+  // Like `armBreadthFirst()`, but uses the given lane.  If the event is already queued in another
+  // lane, it is moved to the end of this one.
 
   kj::String trace();
   // Dump debug info about this event.
@@ -113,6 +119,8 @@ public:
   // Default implementation returns nullptr.
 
 protected:
+  bool isArmed() const { return prev != nullptr; }
+
   virtual Maybe<Own<Event>> fire() = 0;
   // Fire the event.  Possibly returns a pointer to itself, which will be discarded by the
   // caller.  This is the only way that an event can delete itself as a result of firing, as
@@ -124,6 +132,11 @@ private:
   Event* next;
   Event** prev;
   bool firing = false;
+  byte lane = 0;
+  // While queued, the index of the EventLoop's lane holding this event.
+
+  void disarm();
+  // Remove from the queue, if queued.
 };
 
 class PromiseNode {
@@ -175,6 +188,37 @@ protected:
 
 // -------------------------------------------------------------------
 
+template <typename T>
+class PromiseNodeDisposer final: public Disposer {
+public:
+  virtual void disposeImpl(void* pointer) const override {
+    KJ_DEFER(freePromiseNode(pointer, sizeof(T)));
+    reinterpret_cast<T*>(pointer)->~T();
+  }
+
+  static const PromiseNodeDisposer instance;
+};
+
+template <typename T>
+const PromiseNodeDisposer<T> PromiseNodeDisposer<T>::instance = PromiseNodeDisposer<T>();
+
+template <typename T, typename... Params>
+Own<T> allocPromise(Params&&... params) {
+  // Like heap<T>(), but for promise nodes and events.  Promises create and destroy nodes at a
+  // furious rate, so their memory is recycled through free lists kept by the thread's EventLoop
+  // (see allocPromiseNode()).
+
+  void* memory = allocPromiseNode(sizeof(T));
+  bool constructed = false;
+  KJ_DEFER(if (!constructed) freePromiseNode(memory, sizeof(T)));
+  T* result = reinterpret_cast<T*>(memory);
+  ctor(*result, kj::fwd<Params>(params)...);
+  constructed = true;
+  return Own<T>(result, PromiseNodeDisposer<T>::instance);
+}
+
+// -------------------------------------------------------------------
+
 class ImmediatePromiseNodeBase: public PromiseNode {
 public:
   ImmediatePromiseNodeBase();
@@ -508,7 +552,7 @@ public:
   ForkHub(Own<PromiseNode>&& inner): ForkHubBase(kj::mv(inner), result) {}
 
   Promise<_::UnfixVoid<T>> addBranch() {
-    return Promise<_::UnfixVoid<T>>(false, kj::heap<ForkBranch<T>>(addRef(*this)));
+    return Promise<_::UnfixVoid<T>>(false, allocPromise<ForkBranch<T>>(addRef(*this)));
   }
 
   _::SplitTuplePromise<T> split() {
@@ -526,7 +570,7 @@ private:
   template <size_t index>
   ReducePromises<typename SplitBranch<T, index>::Element> addSplit() {
     return ReducePromises<typename SplitBranch<T, index>::Element>(
-        false, maybeChain(kj::heap<SplitBranch<T, index>>(addRef(*this)),
+        false, maybeChain(allocPromise<SplitBranch<T, index>>(addRef(*this)),
                           implicitCast<typename SplitBranch<T, index>::Element*>(nullptr)));
   }
 };
@@ -572,7 +616,7 @@ private:
 
 template <typename T>
 Own<PromiseNode> maybeChain(Own<PromiseNode>&& node, Promise<T>*) {
-  return heap<ChainPromiseNode>(kj::mv(node));
+  return allocPromise<ChainPromiseNode>(kj::mv(node));
 }
 
 template <typename T>
@@ -736,11 +780,33 @@ private:
   ExceptionOr<T> result;
 };
 
+// -------------------------------------------------------------------
+
+class PriorityPromiseNode final: public PromiseNode, private Event {
+  // Passes through the result of its dependency, but wakes the dependent in a particular lane of
+  // the event loop.  See Promise::atPriority().
+
+public:
+  PriorityPromiseNode(Own<PromiseNode>&& dependency, EventPriority priority);
+
+  void onReady(Event* event) noexcept override;
+  void get(ExceptionOrValue& output) noexcept override;
+  PromiseNode* getInnerForTrace() override;
+
+private:
+  Own<PromiseNode> dependency;
+  EventPriority priority;
+  Event* event = nullptr;
+  bool ready = false;
+
+  Maybe<Own<Event>> fire() override;
+};
+
 template <typename T>
 Own<PromiseNode> spark(Own<PromiseNode>&& node) {
   // Forces evaluation of the given node to begin as soon as possible, even if no one is waiting
   // on it.
-  return heap<EagerPromiseNode<T>>(kj::mv(node));
+  return allocPromise<EagerPromiseNode<T>>(kj::mv(node));
 }
 
 // -------------------------------------------------------------------
@@ -805,11 +871,11 @@ private:
 
 template <typename T>
 Promise<T>::Promise(_::FixVoid<T> value)
-    : PromiseBase(heap<_::ImmediatePromiseNode<_::FixVoid<T>>>(kj::mv(value))) {}
+    : PromiseBase(_::allocPromise<_::ImmediatePromiseNode<_::FixVoid<T>>>(kj::mv(value))) {}
 
 template <typename T>
 Promise<T>::Promise(kj::Exception&& exception)
-    : PromiseBase(heap<_::ImmediateBrokenPromiseNode>(kj::mv(exception))) {}
+    : PromiseBase(_::allocPromise<_::ImmediateBrokenPromiseNode>(kj::mv(exception))) {}
 
 template <typename T>
 template <typename Func, typename ErrorFunc>
@@ -817,7 +883,7 @@ PromiseForResult<Func, T> Promise<T>::then(Func&& func, ErrorFunc&& errorHandler
   typedef _::FixVoid<_::ReturnType<Func, T>> ResultT;
 
   Own<_::PromiseNode> intermediate =
-      heap<_::TransformPromiseNode<ResultT, _::FixVoid<T>, Func, ErrorFunc>>(
+      _::allocPromise<_::TransformPromiseNode<ResultT, _::FixVoid<T>, Func, ErrorFunc>>(
           kj::mv(node), kj::fwd<Func>(func), kj::fwd<ErrorFunc>(errorHandler));
   auto result = _::ChainPromises<_::ReturnType<Func, T>>(false,
       _::maybeChain(kj::mv(intermediate), implicitCast<ResultT*>(nullptr)));
@@ -924,13 +990,14 @@ _::SplitTuplePromise<T> Promise<T>::split() {
 
 template <typename T>
 Promise<T> Promise<T>::exclusiveJoin(Promise<T>&& other) {
-  return Promise(false, heap<_::ExclusiveJoinPromiseNode>(kj::mv(node), kj::mv(other.node)));
+  return Promise(false,
+      _::allocPromise<_::ExclusiveJoinPromiseNode>(kj::mv(node), kj::mv(other.node)));
 }
 
 template <typename T>
 template <typename... Attachments>
 Promise<T> Promise<T>::attach(Attachments&&... attachments) {
-  return Promise(false, kj::heap<_::AttachmentPromiseNode<Tuple<Attachments...>>>(
+  return Promise(false, _::allocPromise<_::AttachmentPromiseNode<Tuple<Attachments...>>>(
       kj::mv(node), kj::tuple(kj::fwd<Attachments>(attachments)...)));
 }
 
@@ -948,6 +1015,11 @@ Promise<T> Promise<T>::eagerlyEvaluate(decltype(nullptr)) {
   return Promise(false, _::spark<_::FixVoid<T>>(kj::mv(node)));
 }
 
+template <typename T>
+Promise<T> Promise<T>::atPriority(EventPriority priority) {
+  return Promise(false, _::allocPromise<_::PriorityPromiseNode>(kj::mv(node), priority));
+}
+
 template <typename T>
 kj::String Promise<T>::trace() {
   return PromiseBase::trace();
@@ -958,6 +1030,11 @@ inline PromiseForResult<Func, void> evalLater(Func&& func) {
   return _::yield().then(kj::fwd<Func>(func), _::PropagateException());
 }
 
+template <typename Func>
+inline PromiseForResult<Func, void> evalLater(Func&& func, EventPriority priority) {
+  return _::yield(priority).then(kj::fwd<Func>(func), _::PropagateException());
+}
+
 template <typename Func>
 inline PromiseForResult<Func, void> evalNow(Func&& func) {
   PromiseForResult<Func, void> result = nullptr;
@@ -983,7 +1060,7 @@ void Promise<void>::detach(ErrorFunc&& errorHandler) {
 
 template <typename T>
 Promise<Array<T>> joinPromises(Array<Promise<T>>&& promises) {
-  return Promise<Array<T>>(false, kj::heap<_::ArrayJoinPromiseNode<T>>(
+  return Promise<Array<T>>(false, _::allocPromise<_::ArrayJoinPromiseNode<T>>(
       KJ_MAP(p, promises) { return kj::mv(p.node); },
       heapArray<_::ExceptionOr<T>>(promises.size())));
 }
@@ -1107,9 +1184,138 @@ bool PromiseFulfiller<void>::rejectIfThrows(Func&& func) {
   }
 }
 
+// =======================================================================================
+
+template <typename Func>
+bool Executor::post(Func&& func) const {
+  auto work = new _::XThreadWorkImpl<Decay<Func>>(kj::fwd<Func>(func));
+  if (postImpl(work)) {
+    return true;
+  } else {
+    delete work;
+    return false;
+  }
+}
+
+namespace _ {  // private
+
+template <typename Func>
+class XThreadCallImpl final: public XThreadCall {
+public:
+  typedef FixVoid<UnwrapPromise<PromiseForResult<Func, void>>> T;
+
+  template <typename F>
+  XThreadCallImpl(Maybe<Own<const Executor>> replyTo, F&& func)
+      : XThreadCall(kj::mv(replyTo)), func(kj::fwd<F>(func)) {}
+
+  ExceptionOr<T> result;
+
+  PromiseFulfiller<UnfixVoid<T>>* fulfiller = nullptr;
+  // Fulfiller of the calling thread's promise, for executeAsync(). Only touched on that thread.
+
+protected:
+  Promise<void> run() override {
+    Promise<void> promise = nullptr;
+    KJ_IF_MAYBE(exception, kj::runCatchingExceptions([&]() {
+      promise = receive(
+          MaybeVoidCaller<Void, FixVoid<ReturnType<Func, void>>>::apply(func, Void()));
+    })) {
+      result.exception = kj::mv(*exception);
+      return READY_NOW;
+    }
+    return promise;
+  }
+
+  ExceptionOrValue& getResult() override { return result; }
+
+  void deliver() override {
+    if (fulfiller != nullptr) {
+      KJ_IF_MAYBE(exception, result.exception) {
+        fulfiller->reject(kj::mv(*exception));
+      } else KJ_IF_MAYBE(value, result.value) {
+        fulfiller->fulfill(kj::mv(*value));
+      }
+    }
+  }
+
+private:
+  Func func;
+
+  template <typename U>
+  Promise<void> receive(U&& value) {
+    result.value = kj::mv(value);
+    return READY_NOW;
+  }
+  template <typename U>
+  Promise<void> receive(Promise<U>&& promise) {
+    return promise.then([this](U&& value) {
+      result.value = kj::mv(value);
+    }, [this](Exception&& exception) {
+      result.exception = kj::mv(exception);
+    });
+  }
+  Promise<void> receive(Promise<void>&& promise) {
+    return promise.then([this]() {
+      result.value = Void();
+    }, [this](Exception&& exception) {
+      result.exception = kj::mv(exception);
+    });
+  }
+};
+
+template <typename Call>
+class XThreadCallAdapter {
+  // Ties an executeAsync() call to the lifetime of the calling thread's promise.
+
+public:
+  XThreadCallAdapter(PromiseFulfiller<UnfixVoid<typename Call::T>>& fulfiller, Own<Call>&& call,
+                     const Executor& target)
+      : call(kj::mv(call)) {
+    this->call->fulfiller = &fulfiller;
+    this->call->start(target);
+  }
+
+  ~XThreadCallAdapter() noexcept(false) {
+    call->fulfiller = nullptr;
+    call->cancel();
+  }
+
+private:
+  Own<Call> call;
+};
+
+}  // namespace _ (private)
+
+template <typename Func>
+PromiseForResult<Func, void> Executor::executeAsync(Func&& func) const {
+  if (isCurrentThread()) {
+    return evalLater(kj::fwd<Func>(func));
+  }
+
+  typedef _::XThreadCallImpl<Decay<Func>> Call;
+  return newAdaptedPromise<_::UnwrapPromise<PromiseForResult<Func, void>>,
+                           _::XThreadCallAdapter<Call>>(
+      atomicRefcounted<Call>(getCurrentThreadExecutor(), kj::fwd<Func>(func)), *this);
+}
+
+template <typename Func>
+_::UnwrapPromise<PromiseForResult<Func, void>> Executor::executeSync(Func&& func) const {
+  auto call = atomicRefcounted<_::XThreadCallImpl<Decay<Func>>>(nullptr, kj::fwd<Func>(func));
+  call->runSync(*this);
+
+  KJ_IF_MAYBE(value, call->result.value) {
+    return _::returnMaybeVoid(kj::mv(*value));
+  } else KJ_IF_MAYBE(exception, call->result.exception) {
+    throwFatalException(kj::mv(*exception));
+  } else {
+    // Result contained neither a value nor an exception?
+    KJ_UNREACHABLE;
+  }
+}
+
 template <typename T, typename Adapter, typename... Params>
 Promise<T> newAdaptedPromise(Params&&... adapterConstructorParams) {
-  return Promise<T>(false, heap<_::AdapterPromiseNode<_::FixVoid<T>, Adapter>>(
+  return Promise<T>(false, _::allocPromise<_::AdapterPromiseNode<_::FixVoid<T>, Adapter>>(
       kj::fwd<Params>(adapterConstructorParams)...));
 }
 
@@ -1118,11 +1324,178 @@ PromiseFulfillerPair<T> newPromiseAndFulfiller() {
   auto wrapper = _::WeakFulfiller<T>::make();
 
   Own<_::PromiseNode> intermediate(
-      heap<_::AdapterPromiseNode<_::FixVoid<T>, _::PromiseAndFulfillerAdapter<T>>>(*wrapper));
+      _::allocPromise<_::AdapterPromiseNode<_::FixVoid<T>, _::PromiseAndFulfillerAdapter<T>>>(
+          *wrapper));
   _::ReducePromises<T> promise(false,
       _::maybeChain(kj::mv(intermediate), implicitCast<T*>(nullptr)));
 
   return PromiseFulfillerPair<T> { kj::mv(promise), kj::mv(wrapper) };
 }
 
+#if KJ_HAS_COROUTINE
+// =======================================================================================
+// Coroutines
+
+namespace _ {  // private
+
+class CoroutineBase: public PromiseNode, public Event, private Disposer {
+  // The promise_type of a coroutine returning Promise<T>.  It lives in the coroutine frame and
+  // doubles as the PromiseNode at the head of the returned promise, and as the Event which resumes
+  // the coroutine when the promise it is awaiting becomes ready.  Disposing of the node destroys
+  // the frame.
+  //
+  // Everything here is defined inline, since the library itself may well be compiled without
+  // coroutine support.
+
+public:
+  CoroutineBase(std::coroutine_handle<> handle, ExceptionOrValue& result)
+      : handle(handle), result(result) {}
+
+  std::suspend_never initial_suspend() { return {}; }
+  std::suspend_always final_suspend() noexcept { return {}; }
+  // Run eagerly up to the first co_await, and keep the frame (holding the result) around until the
+  // promise is destroyed.
+
+  void unhandled_exception() {
+#if !KJ_NO_EXCEPTIONS
+    KJ_IF_MAYBE(exception, kj::runCatchingExceptions([]() { throw; })) {
+      result.addException(kj::mv(*exception));
+    }
+    onReadyEvent.arm();
+#endif
+  }
+
+  template <typename T>
+  class Awaiter;
+
+  template <typename T>
+  Awaiter<T> await_transform(Promise<T>& promise) {
+    return Awaiter<T>(*this, kj::mv(promise.node));
+  }
+  template <typename T>
+  Awaiter<T> await_transform(Promise<T>&& promise) {
+    return Awaiter<T>(*this, kj::mv(promise.node));
+  }
+
+  static void* operator new(size_t size) { return allocPromiseNode(size); }
+  static void operator delete(void* pointer, size_t size) { freePromiseNode(pointer, size); }
+  // Frames come from the same free lists as other promise nodes.
+
+  void onReady(Event* event) noexcept override {
+    onReadyEvent.init(event);
+  }
+
+  PromiseNode* getInnerForTrace() override {
+    return awaiting == nullptr ? nullptr : awaiting->get();
+  }
+
+protected:
+  std::coroutine_handle<> handle;
+  ExceptionOrValue& result;
+  OnReadyEvent onReadyEvent;
+
+  Own<PromiseNode>* awaiting = nullptr;
+  // The node being awaited, if suspended.
+
+  Own<PromiseNode> asNode() { return Own<PromiseNode>(this, *this); }
+  void fulfilled() { onReadyEvent.arm(); }
+
+private:
+  Maybe<Own<Event>> fire() override {
+    handle.resume();
+    return nullptr;
+  }
+
+  void disposeImpl(void* pointer) const override {
+    // Destroys this object too, along with anything the coroutine was awaiting.
+    auto frame = handle;
+    frame.destroy();
+  }
+};
+
+template <typename T>
+class CoroutineBase::Awaiter {
+public:
+  Awaiter(CoroutineBase& coroutine, Own<PromiseNode>&& node)
+      : coroutine(coroutine), node(kj::mv(node)) {}
+  Awaiter(Awaiter&&) = default;
+  ~Awaiter() noexcept(false) {
+    if (coroutine.awaiting == &node) coroutine.awaiting = nullptr;
+  }
+
+  bool await_ready() const { return false; }
+
+  void await_suspend(std::coroutine_handle<>) {
+    coroutine.awaiting = &node;
+    node->setSelfPointer(&node);
+    node->onReady(&coroutine);
+  }
+
+  T await_resume() {
+    coroutine.awaiting = nullptr;
+    ExceptionOr<FixVoid<T>> result;
+    node->get(result);
+    node = nullptr;
+
+    KJ_IF_MAYBE(exception, result.exception) {
+      throwFatalException(kj::mv(*exception));
+    }
+    if constexpr (!isSameType<T, void>()) {
+      return kj::mv(*readMaybe(result.value));
+    }
+  }
+
+private:
+  CoroutineBase& coroutine;
+  Own<PromiseNode> node;
+};
+
+template <typename Self, typename T>
+class CoroutineReturn {
+public:
+  void return_value(T value) { static_cast<Self*>(this)->fulfill(kj::mv(value)); }
+};
+
+template <typename Self>
+class CoroutineReturn<Self, void> {
+public:
+  void return_void() { static_cast<Self*>(this)->fulfill(Void()); }
+};
+
+template <typename T>
+class Coroutine final: public CoroutineBase, public CoroutineReturn<Coroutine<T>, T> {
+public:
+  Coroutine(): CoroutineBase(std::coroutine_handle<Coroutine>::from_promise(*this), value) {}
+
+  Promise<T> get_return_object() { return Promise<T>(false, asNode()); }
+
+  void get(ExceptionOrValue& output) noexcept override {
+    output.as<FixVoid<T>>() = kj::mv(value);
+  }
+
+private:
+  ExceptionOr<FixVoid<T>> value;
+
+  void fulfill(FixVoid<T>&& result) {
+    value.value = kj::mv(result);
+    fulfilled();
+  }
+
+  friend class CoroutineReturn<Coroutine<T>, T>;
+};
+
+}  // namespace _ (private)
+#endif  // KJ_HAS_COROUTINE
+
 }  // namespace kj
+
+#if KJ_HAS_COROUTINE
+namespace std {
+
+template <typename T, typename... Params>
+struct coroutine_traits<kj::Promise<T>, Params...> {
+  using promise_type = kj::_::Coroutine<T>;
+};
+
+}  // namespace std
+#endif
@@ -28,6 +28,7 @@
 #include "async-io.h"
 #include "async-io-internal.h"
 #include "debug.h"
+#include "io.h"
 #include <kj/compat/gtest.h>
 #include <sys/types.h>
 #if _WIN32
@@ -42,6 +43,7 @@
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include "async-unix.h"
 #endif
 
 namespace kj {
@@ -233,6 +235,48 @@ TEST(AsyncIo, CapabilityPipe) {
   EXPECT_EQ("bar", result);
   EXPECT_EQ("foo", result2);
 }
+
+TEST(AsyncIo, CapabilityPipeWithFds) {
+  auto ioContext = setupAsyncIo();
+  auto pipe = ioContext.provider->newCapabilityPipe();
+
+  int fds[2];
+  KJ_SYSCALL(::pipe(fds));
+  AutoCloseFd in(fds[0]);
+  AutoCloseFd out(fds[1]);
+
+  // Send both ends of a pipe along with some gathered data.
+  ArrayPtr<const byte> more[] = { "bar"_kj.asBytes(), "baz"_kj.asBytes() };
+  auto writePromise = pipe.ends[0]->writeWithFds("foo"_kj.asBytes(), more, fds);
+
+  char buffer[16];
+  AutoCloseFd received[3];
+  auto result = pipe.ends[1]->tryReadWithFds(buffer, 9, sizeof(buffer), received, 3)
+      .wait(ioContext.waitScope);
+  writePromise.wait(ioContext.waitScope);
+
+  EXPECT_EQ(9u, result.byteCount);
+  EXPECT_EQ("foobarbaz", heapString(buffer, result.byteCount));
+  ASSERT_EQ(2u, result.capCount);
+
+  // The received descriptors refer to the same pipe.
+  KJ_SYSCALL(::write(received[1], "x", 1));
+  char c;
+  KJ_SYSCALL(::read(in, &c, 1));
+  EXPECT_EQ('x', c);
+
+  // A read with no room for descriptors closes them, and plain writes carry none.
+  writePromise = pipe.ends[0]->writeWithFds("qux"_kj.asBytes(), nullptr, fds);
+  result = pipe.ends[1]->tryReadWithFds(buffer, 3, 3, nullptr, 0).wait(ioContext.waitScope);
+  writePromise.wait(ioContext.waitScope);
+  EXPECT_EQ(3u, result.byteCount);
+  EXPECT_EQ(0u, result.capCount);
+
+  pipe.ends[0]->write("abc", 3).wait(ioContext.waitScope);
+  result = pipe.ends[1]->tryReadWithFds(buffer, 3, 3, received, 3).wait(ioContext.waitScope);
+  EXPECT_EQ(3u, result.byteCount);
+  EXPECT_EQ(0u, result.capCount);
+}
 #endif
 
 TEST(AsyncIo, PipeThread) {
@@ -1375,5 +1419,128 @@ KJ_TEST("Userland pipe pumpFrom EOF on abortRead()") {
   pipe2.out = nullptr;
 }
 
+#if KJ_USE_IO_URING
+class IoUringScope {
+  // Enables io_uring for event ports created while this object exists.
+
+public:
+  IoUringScope() { UnixEventPort::setIoUringEnabled(true); }
+  ~IoUringScope() { UnixEventPort::setIoUringEnabled(false); }
+};
+
+KJ_TEST("io_uring network round trip") {
+  IoUringScope scope;
+  auto ioContext = setupAsyncIo();
+  if (ioContext.unixEventPort.getIoUring() == nullptr) {
+    KJ_LOG(WARNING, "io_uring not available; skipping test");
+    return;
+  }
+  auto& ring = KJ_ASSERT_NONNULL(ioContext.unixEventPort.getIoUring());
+  auto& network = ioContext.provider->getNetwork();
+
+  auto listener = network.parseAddress("127.0.0.1").wait(ioContext.waitScope)->listen();
+  auto acceptPromise = listener->accept();
+  auto client = network.parseAddress("127.0.0.1", listener->getPort())
+      .wait(ioContext.waitScope)->connect().wait(ioContext.waitScope);
+  auto server = acceptPromise.wait(ioContext.waitScope);
+
+  char buffer[8];
+  auto readPromise = server->tryRead(buffer, 6, sizeof(buffer));
+  client->write("foo", 3).wait(ioContext.waitScope);
+  KJ_EXPECT(!readPromise.poll(ioContext.waitScope));
+  client->write("bar", 3).wait(ioContext.waitScope);
+  KJ_EXPECT(readPromise.wait(ioContext.waitScope) == 6);
+  KJ_EXPECT(heapString(buffer, 6) == "foobar");
+
+  ArrayPtr<const byte> pieces[] = { "ba"_kj.asBytes(), "z"_kj.asBytes() };
+  server->write(pieces).wait(ioContext.waitScope);
+  KJ_EXPECT(client->tryRead(buffer, 3, sizeof(buffer)).wait(ioContext.waitScope) == 3);
+  KJ_EXPECT(heapString(buffer, 3) == "baz");
+
+  server = nullptr;
+  KJ_EXPECT(client->tryRead(buffer, 1, sizeof(buffer)).wait(ioContext.waitScope) == 0);
+
+  KJ_EXPECT(ring.getStats().operations > 0);
+}
+
+KJ_TEST("io_uring large write and cancellation") {
+  IoUringScope scope;
+  auto ioContext = setupAsyncIo();
+  if (ioContext.unixEventPort.getIoUring() == nullptr) {
+    KJ_LOG(WARNING, "io_uring not available; skipping test");
+    return;
+  }
+
+  auto pipe = ioContext.provider->newTwoWayPipe();
+
+  // Bigger than the socket buffer, so the write has to wait for the reader.
+  auto data = heapArray<byte>(1 << 22);
+  for (size_t i = 0; i < data.size(); i++) data[i] = i * 7;
+  auto writePromise = pipe.ends[0]->write(data.begin(), data.size());
+
+  auto received = heapArray<byte>(data.size());
+  KJ_EXPECT(pipe.ends[1]->tryRead(received.begin(), received.size(), received.size())
+      .wait(ioContext.waitScope) == received.size());
+  writePromise.wait(ioContext.waitScope);
+  KJ_EXPECT(received == data);
+
+  // Cancel a read the kernel is waiting on, then make sure the stream still works.
+  char buffer[4];
+  {
+    auto readPromise = pipe.ends[1]->tryRead(buffer, 1, sizeof(buffer));
+    KJ_EXPECT(!readPromise.poll(ioContext.waitScope));
+  }
+  pipe.ends[0]->write("qux", 3).wait(ioContext.waitScope);
+  KJ_EXPECT(pipe.ends[1]->tryRead(buffer, 3, sizeof(buffer)).wait(ioContext.waitScope) == 3);
+  KJ_EXPECT(heapString(buffer, 3) == "qux");
+
+  // Timers still fire while we wait in the ring.
+  ioContext.provider->getTimer().afterDelay(1 * MILLISECONDS).wait(ioContext.waitScope);
+}
+
+KJ_TEST("io_uring waits before reading a drained stream") {
+  IoUringScope scope;
+  auto ioContext = setupAsyncIo();
+  KJ_IF_MAYBE(ring, ioContext.unixEventPort.getIoUring()) {
+    auto pipe = ioContext.provider->newTwoWayPipe();
+    char buffer[8];
+
+    // A short read means the stream has been drained...
+    pipe.ends[0]->write("foo", 3).wait(ioContext.waitScope);
+    KJ_EXPECT(pipe.ends[1]->tryRead(buffer, 1, sizeof(buffer)).wait(ioContext.waitScope) == 3);
+
+    // ...so the next read polls first rather than trying a read that fails with -EAGAIN.
+    auto before = ring->getStats().operations;
+    auto readPromise = pipe.ends[1]->tryRead(buffer, 1, sizeof(buffer));
+    KJ_EXPECT(!readPromise.poll(ioContext.waitScope));
+    pipe.ends[0]->write("bar", 3).wait(ioContext.waitScope);
+    KJ_EXPECT(readPromise.wait(ioContext.waitScope) == 3);
+    KJ_EXPECT(heapString(buffer, 3) == "bar");
+    KJ_EXPECT(ring->getStats().operations - before == 3, "expected poll, write, read");
+  } else {
+    KJ_LOG(WARNING, "io_uring not available; skipping test");
+  }
+}
+
+KJ_TEST("io_uring registered buffers") {
+  IoUringScope scope;
+  auto ioContext = setupAsyncIo();
+  KJ_IF_MAYBE(ring, ioContext.unixEventPort.getIoUring()) {
+    auto pool = heapArray<byte>(4096);
+    ArrayPtr<byte> buffers[] = { pool };
+    ring->registerBuffers(buffers);
+
+    auto pipe = ioContext.provider->newTwoWayPipe();
+    pipe.ends[0]->write("hello", 5).wait(ioContext.waitScope);
+    KJ_EXPECT(pipe.ends[1]->tryRead(pool.begin() + 100, 5, 10).wait(ioContext.waitScope) == 5);
+    KJ_EXPECT(heapString(pool.slice(100, 105).asChars()) == "hello");
+
+    ring->unregisterBuffers();
+  } else {
+    KJ_LOG(WARNING, "io_uring not available; skipping test");
+  }
+}
+#endif  // KJ_USE_IO_URING
+
 }  // namespace
 }  // namespace kj
@@ -130,15 +130,31 @@ class AsyncStreamFd: public OwnedFileDescriptor, public AsyncCapabilityStream {
 public:
   AsyncStreamFd(UnixEventPort& eventPort, int fd, uint flags)
       : OwnedFileDescriptor(fd, flags),
-        eventPort(eventPort),
-        observer(eventPort, fd, UnixEventPort::FdObserver::OBSERVE_READ_WRITE) {}
+        eventPort(eventPort) {
+#if KJ_USE_IO_URING
+    ring = eventPort.getIoUring();
+    if (ring != nullptr) return;
+#endif
+    observer.emplace(eventPort, fd, UnixEventPort::FdObserver::OBSERVE_READ_WRITE);
+  }
   virtual ~AsyncStreamFd() noexcept(false) {}
 
   Promise<size_t> tryRead(void* buffer, size_t minBytes, size_t maxBytes) override {
+#if KJ_USE_IO_URING
+    KJ_IF_MAYBE(r, ring) {
+      return tryReadRing(*r, buffer, minBytes, maxBytes, 0);
+    }
+#endif
     return tryReadInternal(buffer, minBytes, maxBytes, 0);
   }
 
   Promise<void> write(const void* buffer, size_t size) override {
+#if KJ_USE_IO_URING
+    KJ_IF_MAYBE(r, ring) {
+      return writeRing(*r, arrayPtr(reinterpret_cast<const byte*>(buffer), size), nullptr);
+    }
+#endif
+
     ssize_t writeResult;
     KJ_NONBLOCKING_SYSCALL(writeResult = ::write(fd, buffer, size)) {
       // Error.
@@ -166,12 +182,22 @@ public:
     buffer = reinterpret_cast<const byte*>(buffer) + n;
     size -= n;
 
-    return observer.whenBecomesWritable().then([=]() {
+    return getObserver().whenBecomesWritable().then([=]() {
       return write(buffer, size);
     });
   }
 
   Promise<void> write(ArrayPtr<const ArrayPtr<const byte>> pieces) override {
+#if KJ_USE_IO_URING
+    KJ_IF_MAYBE(r, ring) {
+      if (pieces.size() == 0) {
+        return READY_NOW;
+      } else {
+        return writeRing(*r, pieces[0], pieces.slice(1, pieces.size()));
+      }
+    }
+#endif
+
     if (pieces.size() == 0) {
       return writeInternal(nullptr, nullptr);
     } else {
@@ -227,6 +253,67 @@ public:
     return tryReceiveFdImpl<AutoCloseFd>();
   }
 
+  Promise<ReadResult> tryReadWithFds(void* buffer, size_t minBytes, size_t maxBytes,
+                                     AutoCloseFd* fdBuffer, size_t maxFds) override {
+    return tryReadWithFdsInternal(buffer, minBytes, maxBytes, fdBuffer, maxFds, {0, 0});
+  }
+
+  Promise<void> writeWithFds(ArrayPtr<const byte> data,
+                             ArrayPtr<const ArrayPtr<const byte>> moreData,
+                             ArrayPtr<const int> fds) override {
+    if (fds.size() == 0) {
+      return writeInternal(data, moreData);
+    }
+
+    const size_t iovmax = kj::miniposix::iovMax(1 + moreData.size());
+    KJ_STACK_ARRAY(struct iovec, iov, kj::min(1 + moreData.size(), iovmax), 16, 128);
+    iov[0].iov_base = const_cast<byte*>(data.begin());
+    iov[0].iov_len = data.size();
+    for (uint i = 1; i < iov.size(); i++) {
+      iov[i].iov_base = const_cast<byte*>(moreData[i - 1].begin());
+      iov[i].iov_len = moreData[i - 1].size();
+    }
+
+    size_t controlSize = CMSG_SPACE(fds.asBytes().size());
+    KJ_STACK_ARRAY(struct cmsghdr, cmsgSpace,
+        (controlSize + sizeof(struct cmsghdr) - 1) / sizeof(struct cmsghdr), 4, 64);
+    memset(cmsgSpace.begin(), 0, cmsgSpace.asBytes().size());
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov.begin();
+    msg.msg_iovlen = iov.size();
+    msg.msg_control = cmsgSpace.begin();
+    msg.msg_controllen = controlSize;
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(fds.asBytes().size());
+    memcpy(CMSG_DATA(cmsg), fds.begin(), fds.asBytes().size());
+
+    ssize_t n;
+    KJ_NONBLOCKING_SYSCALL(n = sendmsg(fd, &msg, 0));
+    if (n < 0) {
+      return getObserver().whenBecomesWritable().then([this,data,moreData,fds]() {
+        return writeWithFds(data, moreData, fds);
+      });
+    }
+
+    // The descriptors went out with the first byte. Write whatever is left of the data normally.
+    size_t written = n;
+    while (written >= data.size() && moreData.size() > 0) {
+      written -= data.size();
+      data = moreData[0];
+      moreData = moreData.slice(1, moreData.size());
+    }
+    data = data.slice(written, data.size());
+    if (data.size() == 0 && moreData.size() == 0) {
+      return READY_NOW;
+    }
+    return writeInternal(data, moreData);
+  }
+
   kj::Promise<void> sendFd(int fdToSend) override {
     struct msghdr msg;
     struct iovec iov;
@@ -255,7 +342,7 @@ public:
     ssize_t n;
     KJ_NONBLOCKING_SYSCALL(n = sendmsg(fd, &msg, 0));
     if (n < 0) {
-      return observer.whenBecomesWritable().then([this,fdToSend]() {
+      return getObserver().whenBecomesWritable().then([this,fdToSend]() {
         return sendFd(fdToSend);
       });
     } else {
@@ -280,7 +367,7 @@ public:
 
     if (pollResult == 0) {
       // Not ready yet. We can safely use the edge-triggered observer.
-      return observer.whenBecomesWritable();
+      return getObserver().whenBecomesWritable();
     } else {
       // Ready now.
       return kj::READY_NOW;
@@ -289,7 +376,28 @@ public:
 
 private:
   UnixEventPort& eventPort;
-  UnixEventPort::FdObserver observer;
+  Maybe<UnixEventPort::FdObserver> observer;
+
+#if KJ_USE_IO_URING
+  Maybe<UnixEventPort::IoUring&> ring;
+  // If non-null, reads and writes go through the ring, and `observer` is only created if we end
+  // up needing readiness notifications after all.
+
+  bool readPollFirst = false;
+  // Set when the last read found no more data waiting, in which case the next read most likely
+  // would too: it then waits with `poll()` before reading, which costs two operations rather than
+  // three for a read that fails with -EAGAIN first.
+#endif
+
+  UnixEventPort::FdObserver& getObserver() {
+    KJ_IF_MAYBE(o, observer) {
+      return *o;
+    } else {
+      // Registering with epoll reports the FD's current state, so nothing is missed by doing
+      // it late.
+      return observer.emplace(eventPort, fd, UnixEventPort::FdObserver::OBSERVE_READ_WRITE);
+    }
+  }
 
   Promise<size_t> tryReadInternal(void* buffer, size_t minBytes, size_t maxBytes,
                                   size_t alreadyRead) {
@@ -314,7 +422,7 @@ private:
 
     if (n < 0) {
       // Read would block.
-      return observer.whenBecomesReadable().then([=]() {
+      return getObserver().whenBecomesReadable().then([=]() {
         return tryReadInternal(buffer, minBytes, maxBytes, alreadyRead);
       });
     } else if (n == 0) {
@@ -331,7 +439,7 @@ private:
       maxBytes -= n;
       alreadyRead += n;
 
-      KJ_IF_MAYBE(atEnd, observer.atEndHint()) {
+      KJ_IF_MAYBE(atEnd, getObserver().atEndHint()) {
         if (*atEnd) {
           // We've already received an indication that the next read() will return EOF, so there's
           // nothing to wait for.
@@ -344,7 +452,7 @@ private:
           // that even if it was received since then, whenBecomesReadable() will catch that. So,
           // let's go ahead and skip calling read() here and instead go straight to waiting for
           // more input.
-          return observer.whenBecomesReadable().then([=]() {
+          return getObserver().whenBecomesReadable().then([=]() {
             return tryReadInternal(buffer, minBytes, maxBytes, alreadyRead);
           });
         }
@@ -357,6 +465,89 @@ private:
     }
   }
 
+  Promise<ReadResult> tryReadWithFdsInternal(void* buffer, size_t minBytes, size_t maxBytes,
+                                             AutoCloseFd* fdBuffer, size_t maxFds,
+                                             ReadResult alreadyRead) {
+    // Like tryReadInternal(), but uses recvmsg() to pick up any descriptors which arrive with the
+    // data.
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+
+    struct iovec iov;
+    iov.iov_base = buffer;
+    iov.iov_len = maxBytes;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    size_t controlSize = maxFds == 0 ? 0 : CMSG_SPACE(sizeof(int) * maxFds);
+    KJ_STACK_ARRAY(struct cmsghdr, cmsgSpace,
+        (controlSize + sizeof(struct cmsghdr) - 1) / sizeof(struct cmsghdr), 4, 64);
+    if (controlSize > 0) {
+      memset(cmsgSpace.begin(), 0, cmsgSpace.asBytes().size());
+      msg.msg_control = cmsgSpace.begin();
+      msg.msg_controllen = controlSize;
+    }
+
+#ifdef MSG_CMSG_CLOEXEC
+    int recvmsgFlags = MSG_CMSG_CLOEXEC;
+#else
+    int recvmsgFlags = 0;
+#endif
+
+    ssize_t n;
+    KJ_NONBLOCKING_SYSCALL(n = recvmsg(fd, &msg, recvmsgFlags)) {
+      // Error.
+      goto error;
+    }
+    if (false) {
+    error:
+      return alreadyRead;
+    }
+
+    if (n < 0) {
+      // Read would block.
+      return getObserver().whenBecomesReadable().then([=]() {
+        return tryReadWithFdsInternal(buffer, minBytes, maxBytes, fdBuffer, maxFds, alreadyRead);
+      });
+    }
+
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+        size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (size_t i = 0; i < count; i++) {
+          int receivedFd;
+          memcpy(&receivedFd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(receivedFd));
+          AutoCloseFd ownFd(receivedFd);
+#ifndef MSG_CMSG_CLOEXEC
+          setCloseOnExec(ownFd);
+#endif
+          if (maxFds > 0) {
+            *fdBuffer++ = kj::mv(ownFd);
+            --maxFds;
+            ++alreadyRead.capCount;
+          }
+        }
+      }
+    }
+
+    if (n == 0) {
+      // EOF -OR- maxBytes == 0.
+      return alreadyRead;
+    }
+
+    alreadyRead.byteCount += n;
+    if (implicitCast<size_t>(n) >= minBytes) {
+      return alreadyRead;
+    }
+
+    // Short read; keep going until EAGAIN, then wait.
+    buffer = reinterpret_cast<byte*>(buffer) + n;
+    return tryReadWithFdsInternal(buffer, minBytes - n, maxBytes - n, fdBuffer, maxFds,
+                                  alreadyRead);
+  }
+
   Promise<void> writeInternal(ArrayPtr<const byte> firstPiece,
                               ArrayPtr<const ArrayPtr<const byte>> morePieces) {
     const size_t iovmax = kj::miniposix::iovMax(1 + morePieces.size());
@@ -405,7 +596,7 @@ private:
           return writeInternal(firstPiece, morePieces);
         }
 
-        return observer.whenBecomesWritable().then([=]() {
+        return getObserver().whenBecomesWritable().then([=]() {
           return writeInternal(firstPiece, morePieces);
         });
       } else if (morePieces.size() == 0) {
@@ -422,6 +613,105 @@ private:
     }
   }
 
+#if KJ_USE_IO_URING
+  Promise<size_t> tryReadRing(UnixEventPort::IoUring& ring, void* buffer, size_t minBytes,
+                              size_t maxBytes, size_t alreadyRead) {
+    // Like tryReadInternal(), but submits the read to the ring, which waits for data itself.
+
+    if (readPollFirst) {
+      // The kernel won't wait for us, so ask the ring to. (See IoUring for why not `observer`.)
+      readPollFirst = false;
+      return ring.poll(fd, POLLIN).then([=,&ring](int) {
+        return tryReadRing(ring, buffer, minBytes, maxBytes, alreadyRead);
+      });
+    }
+
+    return ring.read(fd, buffer, maxBytes).then(
+        [this,&ring,buffer,minBytes,maxBytes,alreadyRead](int result) -> Promise<size_t> {
+      if (result == -EAGAIN || result == -EWOULDBLOCK) {
+        readPollFirst = true;
+        return tryReadRing(ring, buffer, minBytes, maxBytes, alreadyRead);
+      } else if (result == -EINTR) {
+        return tryReadRing(ring, buffer, minBytes, maxBytes, alreadyRead);
+      } else if (result < 0) {
+        KJ_FAIL_SYSCALL("read", -result) { break; }
+        return alreadyRead;
+      }
+
+      size_t n = result;
+      if (n < maxBytes) {
+        // We drained the FD (or hit EOF).
+        readPollFirst = true;
+      }
+
+      if (n == 0) {
+        // EOF -OR- maxBytes == 0.
+        return alreadyRead;
+      } else if (n >= minBytes) {
+        return alreadyRead + n;
+      } else {
+        return tryReadRing(ring, reinterpret_cast<byte*>(buffer) + n,
+                           minBytes - n, maxBytes - n, alreadyRead + n);
+      }
+    });
+  }
+
+  Promise<void> writeRing(UnixEventPort::IoUring& ring, ArrayPtr<const byte> firstPiece,
+                          ArrayPtr<const ArrayPtr<const byte>> morePieces) {
+    // Like writeInternal(), but submits the write to the ring, which waits for buffer space
+    // itself.
+
+    const size_t iovmax = kj::miniposix::iovMax(1 + morePieces.size());
+    KJ_STACK_ARRAY(ArrayPtr<const byte>, pieces, kj::min(1 + morePieces.size(), iovmax), 16, 128);
+    pieces[0] = firstPiece;
+    for (uint i = 1; i < pieces.size(); i++) {
+      pieces[i] = morePieces[i - 1];
+    }
+
+    size_t attempted = 0;
+    for (auto& piece: pieces) attempted += piece.size();
+
+    return ring.write(fd, pieces).then(
+        [this,&ring,firstPiece,morePieces,attempted](int result) mutable -> Promise<void> {
+      if (result == -EAGAIN || result == -EWOULDBLOCK) {
+        // The kernel didn't wait for us. Ask the ring to. (See IoUring for why not `observer`.)
+        return ring.poll(fd, POLLOUT).then([=,&ring](int) {
+          return writeRing(ring, firstPiece, morePieces);
+        });
+      } else if (result == -EINTR) {
+        return writeRing(ring, firstPiece, morePieces);
+      } else if (result < 0) {
+        KJ_FAIL_SYSCALL("writev", -result) { break; }
+        return READY_NOW;
+      }
+
+      // Discard all data that was written, then issue a new write for what's left (if any).
+      size_t n = result;
+      bool full = n < attempted;
+      for (;;) {
+        if (n < firstPiece.size()) {
+          // Partial write, or we hit the IOV_MAX limit.
+          auto rest = firstPiece.slice(n, firstPiece.size());
+          if (full) {
+            // The buffer is full, so another write now would only fail with -EAGAIN.
+            return ring.poll(fd, POLLOUT).then([=,&ring](int) {
+              return writeRing(ring, rest, morePieces);
+            });
+          }
+          return writeRing(ring, rest, morePieces);
+        } else if (morePieces.size() == 0) {
+          KJ_DASSERT(n == firstPiece.size(), n);
+          return READY_NOW;
+        } else {
+          n -= firstPiece.size();
+          firstPiece = morePieces[0];
+          morePieces = morePieces.slice(1, morePieces.size());
+        }
+      }
+    });
+  }
+#endif
+
   template <typename T>
   kj::Promise<kj::Maybe<T>> tryReceiveFdImpl() {
     struct msghdr msg;
@@ -452,7 +742,7 @@ private:
     ssize_t n;
     KJ_NONBLOCKING_SYSCALL(n = recvmsg(fd, &msg, recvmsgFlags));
     if (n < 0) {
-      return observer.whenBecomesReadable().then([this]() {
+      return getObserver().whenBecomesReadable().then([this]() {
         return tryReceiveFdImpl<T>();
       });
     } else if (n == 0) {
@@ -949,14 +1239,50 @@ Promise<Array<SocketAddress>> SocketAddress::lookupHost(
 
 // =======================================================================================
 
+bool isTransientAcceptError(int error) {
+  // According to the Linux man page, accept() may report an error if the accepted connection is
+  // already broken.  In this case, we really ought to just ignore it and keep waiting.  But it's
+  // hard to say exactly what errors are such network errors and which ones are permanent errors.
+  // We've made a guess here.
+
+  switch (error) {
+    case EINTR:
+    case ENETDOWN:
+#ifdef EPROTO
+    // EPROTO is not defined on OpenBSD.
+    case EPROTO:
+#endif
+    case EHOSTDOWN:
+    case EHOSTUNREACH:
+    case ENETUNREACH:
+    case ECONNABORTED:
+    case ETIMEDOUT:
+      return true;
+
+    default:
+      return false;
+  }
+}
+
 class FdConnectionReceiver final: public ConnectionReceiver, public OwnedFileDescriptor {
 public:
   FdConnectionReceiver(UnixEventPort& eventPort, int fd,
                        LowLevelAsyncIoProvider::NetworkFilter& filter, uint flags)
-      : OwnedFileDescriptor(fd, flags), eventPort(eventPort), filter(filter),
-        observer(eventPort, fd, UnixEventPort::FdObserver::OBSERVE_READ) {}
+      : OwnedFileDescriptor(fd, flags), eventPort(eventPort), filter(filter) {
+#if KJ_USE_IO_URING
+    ring = eventPort.getIoUring();
+    if (ring != nullptr) return;
+#endif
+    observer.emplace(eventPort, fd, UnixEventPort::FdObserver::OBSERVE_READ);
+  }
 
   Promise<Own<AsyncIoStream>> accept() override {
+#if KJ_USE_IO_URING
+    KJ_IF_MAYBE(r, ring) {
+      return acceptRing(*r);
+    }
+#endif
+
     int newFd;
 
     struct sockaddr_storage addr;
@@ -987,28 +1313,14 @@ public:
         case EWOULDBLOCK:
 #endif
           // Not ready yet.
-          return observer.whenBecomesReadable().then([this]() {
+          return getObserver().whenBecomesReadable().then([this]() {
             return accept();
           });
 
-        case EINTR:
-        case ENETDOWN:
-#ifdef EPROTO
-        // EPROTO is not defined on OpenBSD.
-        case EPROTO:
-#endif
-        case EHOSTDOWN:
-        case EHOSTUNREACH:
-        case ENETUNREACH:
-        case ECONNABORTED:
-        case ETIMEDOUT:
-          // According to the Linux man page, accept() may report an error if the accepted
-          // connection is already broken.  In this case, we really ought to just ignore it and
-          // keep waiting.  But it's hard to say exactly what errors are such network errors and
-          // which ones are permanent errors.  We've made a guess here.
-          goto retry;
-
         default:
+          if (isTransientAcceptError(error)) {
+            goto retry;
+          }
           KJ_FAIL_SYSCALL("accept", error);
       }
 
@@ -1031,7 +1343,63 @@ public:
 public:
   UnixEventPort& eventPort;
   LowLevelAsyncIoProvider::NetworkFilter& filter;
-  UnixEventPort::FdObserver observer;
+  Maybe<UnixEventPort::FdObserver> observer;
+
+#if KJ_USE_IO_URING
+  Maybe<UnixEventPort::IoUring&> ring;
+
+  bool acceptPollFirst = false;
+  // Set when the last connection only arrived after we waited for it, in which case the next one
+  // most likely won't be waiting either, so we wait with `poll()` before accepting. Cleared when a
+  // connection was already waiting, since more may be queued behind it.
+
+  Promise<Own<AsyncIoStream>> acceptRing(UnixEventPort::IoUring& ring, bool polled = false) {
+    if (acceptPollFirst && !polled) {
+      // The kernel won't wait for us, so ask the ring to. (See IoUring for why not `observer`.)
+      return ring.poll(fd, POLLIN).then([this,&ring](int) {
+        return acceptRing(ring, true);
+      });
+    }
+
+    struct PeerAddress {
+      struct sockaddr_storage addr;
+      uint addrlen = sizeof(addr);
+    };
+    auto peer = heap<PeerAddress>();
+    auto& peerRef = *peer;
+
+    return ring.accept(fd, reinterpret_cast<struct sockaddr*>(&peer->addr), &peer->addrlen,
+                       SOCK_NONBLOCK | SOCK_CLOEXEC)
+        .then([this,&ring,&peerRef,polled](int newFd) -> Promise<Own<AsyncIoStream>> {
+      if (newFd >= 0) {
+        acceptPollFirst = polled;
+        if (!filter.shouldAllow(reinterpret_cast<struct sockaddr*>(&peerRef.addr),
+                                peerRef.addrlen)) {
+          // Drop disallowed address.
+          close(newFd);
+          return accept();
+        } else {
+          return Own<AsyncIoStream>(heap<AsyncStreamFd>(eventPort, newFd, NEW_FD_FLAGS));
+        }
+      } else if (newFd == -EAGAIN || newFd == -EWOULDBLOCK) {
+        acceptPollFirst = true;
+        return acceptRing(ring);
+      } else if (isTransientAcceptError(-newFd)) {
+        return accept();
+      } else {
+        KJ_FAIL_SYSCALL("accept", -newFd);
+      }
+    }).attach(kj::mv(peer));
+  }
+#endif
+
+  UnixEventPort::FdObserver& getObserver() {
+    KJ_IF_MAYBE(o, observer) {
+      return *o;
+    } else {
+      return observer.emplace(eventPort, fd, UnixEventPort::FdObserver::OBSERVE_READ);
+    }
+  }
 };
 
 class DatagramPortImpl final: public DatagramPort, public OwnedFileDescriptor {
@@ -1095,6 +1463,31 @@ public:
     // especially setting nonblocking mode and taking ownership.
     auto result = heap<AsyncStreamFd>(eventPort, fd, flags);
 
+#if KJ_USE_IO_URING
+    KJ_IF_MAYBE(ring, eventPort.getIoUring()) {
+      auto& r = *ring;
+      return r.connect(fd, addr, addrlen).then([&r,fd](int error) -> Promise<void> {
+        if (error == -EINPROGRESS || error == -EAGAIN || error == -EINTR) {
+          // The kernel didn't wait for us, or we were interrupted while the connection continues
+          // in the background. Wait for the socket to become writable, then check the outcome.
+          return r.poll(fd, POLLOUT).then([fd](int) {
+            int err;
+            socklen_t errlen = sizeof(err);
+            KJ_SYSCALL(getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &errlen));
+            if (err != 0) {
+              KJ_FAIL_SYSCALL("connect()", err) { break; }
+            }
+          });
+        } else if (error < 0) {
+          KJ_FAIL_SYSCALL("connect()", -error) { break; }
+        }
+        return READY_NOW;
+      }).then(kj::mvCapture(result, [](Own<AsyncStreamFd>&& stream) -> Own<AsyncIoStream> {
+        return kj::mv(stream);
+      }));
+    }
+#endif
+
     // Unfortunately connect() doesn't fit the mold of KJ_NONBLOCKING_SYSCALL, since it indicates
     // non-blocking using EINPROGRESS.
     for (;;) {
@@ -1152,6 +1152,15 @@ Promise<Maybe<AutoCloseFd>> AsyncCapabilityStream::tryReceiveFd() {
 Promise<void> AsyncCapabilityStream::sendFd(int fd) {
   return KJ_EXCEPTION(UNIMPLEMENTED, "this stream cannot send file descriptors");
 }
+Promise<AsyncCapabilityStream::ReadResult> AsyncCapabilityStream::tryReadWithFds(
+    void* buffer, size_t minBytes, size_t maxBytes, AutoCloseFd* fdBuffer, size_t maxFds) {
+  return KJ_EXCEPTION(UNIMPLEMENTED, "this stream cannot receive file descriptors");
+}
+Promise<void> AsyncCapabilityStream::writeWithFds(
+    ArrayPtr<const byte> data, ArrayPtr<const ArrayPtr<const byte>> moreData,
+    ArrayPtr<const int> fds) {
+  return KJ_EXCEPTION(UNIMPLEMENTED, "this stream cannot send file descriptors");
+}
 
 void AsyncIoStream::getsockopt(int level, int option, void* value, uint* length) {
   KJ_UNIMPLEMENTED("Not a socket.");
@@ -170,6 +170,23 @@ public:
   virtual Promise<Maybe<AutoCloseFd>> tryReceiveFd();
   virtual Promise<void> sendFd(int fd);
   // Transfer a raw file descriptor. Default implementation throws UNIMPLEMENTED.
+
+  struct ReadResult {
+    size_t byteCount;
+    size_t capCount;
+  };
+
+  virtual Promise<ReadResult> tryReadWithFds(void* buffer, size_t minBytes, size_t maxBytes,
+                                             AutoCloseFd* fdBuffer, size_t maxFds);
+  virtual Promise<void> writeWithFds(ArrayPtr<const byte> data,
+                                     ArrayPtr<const ArrayPtr<const byte>> moreData,
+                                     ArrayPtr<const int> fds);
+  // Like tryRead() and write(), but also transfer file descriptors along with the data. The
+  // descriptors travel with the first byte of `data`; the receiver gets them from whichever
+  // tryReadWithFds() call receives that byte, so the protocol must be framed such that a read
+  // which could receive descriptors begins there. Descriptors beyond `maxFds` are closed. The
+  // sender keeps ownership of `fds`, which need only remain open until the returned promise
+  // resolves. Default implementations throw UNIMPLEMENTED.
 };
 
 struct OneWayPipe {
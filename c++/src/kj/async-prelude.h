@@ -31,6 +31,21 @@
 #include "exception.h"
 #include "tuple.h"
 
+#ifndef KJ_HAS_COROUTINE
+#if defined(__cpp_impl_coroutine) && (defined(__clang__) || !defined(__GNUC__) || __GNUC__ >= 13)
+// GCC 12 crashes (internal compiler error) compiling a coroutine whose return type has a
+// `noexcept(false)` destructor, which `Promise` does, so coroutine support starts at GCC 13.
+#define KJ_HAS_COROUTINE 1
+#else
+#define KJ_HAS_COROUTINE 0
+#endif
+#endif
+// Whether functions returning `Promise<T>` may be written as C++20 coroutines.  See `Promise`.
+
+#if KJ_HAS_COROUTINE
+#include <coroutine>
+#endif
+
 namespace kj {
 
 class EventLoop;
@@ -38,6 +53,7 @@ template <typename T>
 class Promise;
 class WaitScope;
 class TaskSet;
+enum class EventPriority;
 
 template <typename T>
 Promise<Array<T>> joinPromises(Array<Promise<T>>&& promises);
@@ -68,6 +84,12 @@ using ReducePromises = decltype(reducePromiseType((T*)nullptr, false));
 // reduces Promise<T> to something else. In particular this allows Promise<capnp::RemotePromise<U>>
 // to reduce to capnp::RemotePromise<U>.
 
+template <typename T> struct UnwrapPromise_;
+template <typename T> struct UnwrapPromise_<Promise<T>> { typedef T Type; };
+template <typename T>
+using UnwrapPromise = typename UnwrapPromise_<T>::Type;
+// Promise<T> -> T
+
 class PropagateException {
   // A functor which accepts a kj::Exception as a parameter and returns a broken promise of
   // arbitrary type which simply propagates the exception.
@@ -184,6 +206,9 @@ class PromiseNode;
 class ChainPromiseNode;
 template <typename T>
 class ForkHub;
+class CoroutineBase;
+template <typename T>
+class Coroutine;
 
 class Event;
 
@@ -200,6 +225,7 @@ private:
 
   friend class kj::EventLoop;
   friend class ChainPromiseNode;
+  friend class CoroutineBase;
   template <typename>
   friend class kj::Promise;
   friend class kj::TaskSet;
@@ -211,7 +237,10 @@ private:
 void detach(kj::Promise<void>&& promise);
 void waitImpl(Own<_::PromiseNode>&& node, _::ExceptionOrValue& result, WaitScope& waitScope);
 bool pollImpl(_::PromiseNode& node, WaitScope& waitScope);
+void* allocPromiseNode(size_t size);
+void freePromiseNode(void* pointer, size_t size) noexcept;
 Promise<void> yield();
+Promise<void> yield(EventPriority priority);
 Own<PromiseNode> neverDone();
 
 class NeverDone {
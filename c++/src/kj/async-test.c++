@@ -22,6 +22,7 @@
 #include "async.h"
 #include "debug.h"
 #include <kj/compat/gtest.h>
+#include <string.h>
 
 namespace kj {
 namespace {
@@ -809,5 +810,174 @@ TEST(Async, Poll) {
   paf.promise.wait(waitScope);
 }
 
+class FulfillingEventPort final: public EventPort {
+  // wait() fulfills `pending` instead of blocking.
+public:
+  Own<PromiseFulfiller<void>> pending;
+
+  bool wait() override {
+    if (pending.get() != nullptr) {
+      pending->fulfill();
+      pending = nullptr;
+    }
+    return false;
+  }
+  bool poll() override { return false; }
+};
+
+class RecordingObserver final: public EventLoopObserver {
+public:
+  uint turnCount = 0;
+  size_t maxQueueDepth = 0;
+  uint waitCount = 0;
+  Vector<String> slowEvents;
+
+  void onTurn(Duration duration, size_t queueDepth) override {
+    ++turnCount;
+    maxQueueDepth = kj::max(maxQueueDepth, queueDepth);
+  }
+  void onWait(Duration duration) override {
+    ++waitCount;
+  }
+  void onSlowEvent(Duration duration, StringPtr trace) override {
+    KJ_EXPECT(duration >= 20 * MILLISECONDS);
+    slowEvents.add(heapString(trace));
+  }
+};
+
+struct StallingCallback {
+  void operator()() {
+    auto& clock = systemPreciseMonotonicClock();
+    TimePoint start = clock.now();
+    while (clock.now() - start < 20 * MILLISECONDS) {}
+  }
+};
+
+TEST(Async, EventLoopObserver) {
+  FulfillingEventPort port;
+  EventLoop loop(port);
+  WaitScope waitScope(loop);
+  RecordingObserver observer;
+  loop.setObserver(observer, 10 * MILLISECONDS);
+
+  auto promises = heapArrayBuilder<Promise<void>>(4);
+  for (uint i = 0; i < 3; i++) {
+    promises.add(evalLater([]() {}));
+  }
+  // Eagerly evaluated so that the callback runs in a turn rather than in wait().
+  promises.add(evalLater(StallingCallback()).eagerlyEvaluate(nullptr));
+  joinPromises(promises.finish()).wait(waitScope);
+
+  KJ_EXPECT(observer.turnCount >= 4);
+  KJ_EXPECT(observer.maxQueueDepth >= 4);
+  KJ_ASSERT(observer.slowEvents.size() == 1);
+#if !KJ_NO_RTTI
+  KJ_EXPECT(strstr(observer.slowEvents[0].cStr(), "StallingCallback") != nullptr,
+            observer.slowEvents[0]);
+#endif
+  KJ_EXPECT(observer.waitCount == 0);
+
+  auto paf = newPromiseAndFulfiller<void>();
+  port.pending = kj::mv(paf.fulfiller);
+  paf.promise.wait(waitScope);
+  KJ_EXPECT(observer.waitCount == 1);
+
+  loop.clearObserver();
+  uint turnCount = observer.turnCount;
+  evalLater(StallingCallback()).eagerlyEvaluate(nullptr).wait(waitScope);
+  KJ_EXPECT(observer.turnCount == turnCount);
+  KJ_EXPECT(observer.slowEvents.size() == 1);
+}
+
+TEST(Async, EventPriority) {
+  EventLoop loop;
+  WaitScope waitScope(loop);
+
+  String order;
+  auto log = [&order](char c) { order = str(order, c); };
+
+  auto promises = heapArrayBuilder<Promise<void>>(6);
+  promises.add(evalLater([&]() { log('n'); }));
+  promises.add(evalLater([&]() { log('b'); }, EventPriority::BACKGROUND));
+  promises.add(evalLater([&]() { log('n'); }));
+  promises.add(evalLater([&]() {
+    log('h');
+    // Inherits the lane of the current event.
+    return evalLater([&]() { log('H'); });
+  }, EventPriority::HIGH));
+  promises.add(Promise<void>(READY_NOW).atPriority(EventPriority::HIGH).then([&]() { log('a'); }));
+  promises.add(evalLater([&]() { log('n'); }));
+  for (auto& promise: promises) {
+    // Evaluate each promise in its own event, rather than when the join collects its result.
+    promise = promise.eagerlyEvaluate(nullptr);
+  }
+  joinPromises(promises.finish()).wait(waitScope);
+
+  // All high-priority work runs first and background work runs last. Within the high lane, the
+  // continuation 'H' is armed depth-first while 'h' runs, so it goes ahead of 'a', just as it
+  // would within a single lane.
+  KJ_EXPECT(order == "hHannnb", order);
+}
+
+TEST(Async, EventPriorityStarvation) {
+  EventLoop loop;
+  WaitScope waitScope(loop);
+
+  // A high-priority task that never stops yielding must not starve the other lanes.
+  bool stop = false;
+  uint highTurns = 0;
+  Function<Promise<void>()> spin = [&]() -> Promise<void> {
+    if (stop) return READY_NOW;
+    ++highTurns;
+    return evalLater([&]() { return spin(); });
+  };
+  auto high = evalLater([&]() { return spin(); }, EventPriority::HIGH).eagerlyEvaluate(nullptr);
+
+  uint normalTurns = 0;
+  auto normal = evalLater([&]() { ++normalTurns; }).eagerlyEvaluate(nullptr);
+  auto background = evalLater([&]() {
+    stop = true;
+  }, EventPriority::BACKGROUND).eagerlyEvaluate(nullptr);
+
+  background.wait(waitScope);
+  KJ_EXPECT(normalTurns == 1);
+  KJ_EXPECT(highTurns <= 2 * (EventLoop::MAX_PASSED_OVER + 1), highTurns);
+  high.wait(waitScope);
+  normal.wait(waitScope);
+}
+
+TEST(Async, PromiseNodeLifetimes) {
+  // Promise nodes are recycled by the EventLoop, but may be created and destroyed in any order,
+  // including outside of the loop's lifetime.
+
+  Promise<int> before = 123;
+  Promise<int> after = nullptr;
+
+  {
+    EventLoop loop;
+    WaitScope waitScope(loop);
+
+    Vector<Promise<int>> promises;
+    for (int i = 0; i < 300; i++) {
+      promises.add(evalLater([i]() { return i; }).then([](int i) { return i * 2; }));
+    }
+    for (size_t i = 1; i < promises.size(); i += 2) {
+      promises[i] = nullptr;
+    }
+    for (size_t i = 0; i < promises.size(); i += 2) {
+      int result = promises[i].wait(waitScope);
+      EXPECT_EQ(i * 2, result);
+    }
+
+    int result = before.then([](int i) { return i + 1; }).wait(waitScope);
+    EXPECT_EQ(124, result);
+    after = evalLater([]() { return 456; });
+    before = 789;
+  }
+
+  after = nullptr;
+  before = nullptr;
+}
+
 }  // namespace
 }  // namespace kj
@@ -23,6 +23,7 @@
 
 #include "async-unix.h"
 #include "thread.h"
+#include "mutex.h"
 #include "debug.h"
 #include "io.h"
 #include <unistd.h>
@@ -651,6 +652,257 @@ TEST(AsyncUnixTest, Wake) {
   EXPECT_TRUE(port.wait());
 }
 
+TEST(AsyncUnixTest, BusyPoll) {
+  captureSignals();
+  UnixEventPort port;
+  port.setBusyPollDuration(50 * MILLISECONDS);
+  port.setEventBatchSize(1);
+  port.setSocketBusyPoll(50);
+  EventLoop loop(port);
+  WaitScope waitScope(loop);
+
+  // Several FDs ready at once are still all collected, one per epoll_wait().
+  int pipefds[2];
+  KJ_SYSCALL(pipe(pipefds));
+  KJ_DEFER({ close(pipefds[1]); close(pipefds[0]); });
+  int sockets[2];
+  KJ_SYSCALL(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets));
+  KJ_DEFER({ close(sockets[1]); close(sockets[0]); });
+
+  UnixEventPort::FdObserver observer(port, pipefds[0], UnixEventPort::FdObserver::OBSERVE_READ);
+  UnixEventPort::FdObserver observer2(port, sockets[0], UnixEventPort::FdObserver::OBSERVE_READ);
+  auto promise1 = observer.whenBecomesReadable();
+  auto promise2 = observer2.whenBecomesReadable();
+  KJ_SYSCALL(write(pipefds[1], "foo", 3));
+  KJ_SYSCALL(write(sockets[1], "bar", 3));
+  promise1.wait(waitScope);
+  promise2.wait(waitScope);
+
+  // A wake-up arriving while spinning, or after the spin gave up, is noticed.
+  port.wake();
+  EXPECT_TRUE(port.wait());
+  {
+    Thread thread([&]() {
+      delay();
+      port.wake();
+    });
+    EXPECT_TRUE(port.wait());
+  }
+
+  // Spinning stops for timers.
+  port.setBusyPollDuration(10 * SECONDS);
+  auto& timer = port.getTimer();
+  auto start = timer.now();
+  timer.afterDelay(10 * MILLISECONDS).wait(waitScope);
+  KJ_EXPECT(timer.now() - start >= 10 * MILLISECONDS);
+  KJ_EXPECT(timer.now() - start < 5 * SECONDS);
+}
+
+TEST(AsyncUnixTest, ExecutorPost) {
+  captureSignals();
+  UnixEventPort port;
+  EventLoop loop(port);
+  WaitScope waitScope(loop);
+
+  auto executor = getCurrentThreadExecutor();
+  EXPECT_TRUE(executor->isLive());
+
+  auto paf = newPromiseAndFulfiller<uint>();
+  uint count = 0;
+
+  Thread thread([&]() {
+    for (uint i = 0; i < 100; i++) {
+      if (i % 10 == 0) delay();
+      KJ_ASSERT(executor->post([&count,&paf,i]() {
+        // Posted work runs in order, on the loop's thread.
+        KJ_ASSERT(count == i);
+        if (++count == 100) paf.fulfiller->fulfill(kj::cp(count));
+      }));
+    }
+  });
+
+  EXPECT_EQ(100, paf.promise.wait(waitScope));
+}
+
+TEST(AsyncUnixTest, ExecutorOutlivesLoop) {
+  captureSignals();
+  Own<const Executor> executor;
+  bool destroyed = false;
+
+  {
+    UnixEventPort port;
+    EventLoop loop(port);
+    WaitScope waitScope(loop);
+    executor = getCurrentThreadExecutor();
+
+    // Posted but never run: destroyed along with the loop.
+    auto deferred = kj::defer([&destroyed]() { destroyed = true; });
+    EXPECT_TRUE(executor->post([deferred = kj::mv(deferred)]() {
+      KJ_FAIL_ASSERT("shouldn't run");
+    }));
+  }
+
+  EXPECT_TRUE(destroyed);
+  EXPECT_FALSE(executor->isLive());
+  EXPECT_FALSE(executor->post([]() { KJ_FAIL_ASSERT("shouldn't run"); }));
+}
+
+class ExecutorThread {
+  // Runs an event loop in a separate thread until stop() is called.
+
+public:
+  ExecutorThread(): thread([this]() {
+    UnixEventPort port;
+    EventLoop loop(port);
+    WaitScope waitScope(loop);
+    auto paf = newPromiseAndFulfiller<void>();
+    exitFulfiller = kj::mv(paf.fulfiller);
+    *executor.lockExclusive() = getCurrentThreadExecutor();
+    paf.promise.wait(waitScope);
+  }) {}
+
+  const Executor& get() {
+    return executor.when([](const Maybe<Own<const Executor>>& e) { return e != nullptr; },
+        [](Maybe<Own<const Executor>>& e) -> const Executor& { return *KJ_ASSERT_NONNULL(e); });
+  }
+
+  void stop() {
+    get().executeSync([this]() { exitFulfiller->fulfill(); });
+  }
+
+private:
+  MutexGuarded<Maybe<Own<const Executor>>> executor;
+  Own<PromiseFulfiller<void>> exitFulfiller;
+  Thread thread;
+};
+
+TEST(AsyncUnixTest, ExecutorExecuteAsync) {
+  captureSignals();
+  UnixEventPort port;
+  EventLoop loop(port);
+  WaitScope waitScope(loop);
+
+  ExecutorThread other;
+  auto& executor = other.get();
+
+  EXPECT_EQ(123, executor.executeAsync([]() { return 123; }).wait(waitScope));
+
+  // Promise-returning functions are waited for on the executor's thread.
+  EXPECT_EQ("foo", executor.executeAsync([]() {
+    return evalLater([]() { return kj::str("foo"); });
+  }).wait(waitScope));
+
+  bool ran = false;
+  executor.executeAsync([&ran]() { ran = true; }).wait(waitScope);
+  EXPECT_TRUE(ran);
+
+  kj::Maybe<Exception> exception = kj::runCatchingExceptions([&]() {
+    executor.executeAsync([]() -> int { KJ_FAIL_ASSERT("oops"); }).wait(waitScope);
+  });
+  EXPECT_TRUE(exception != nullptr);
+
+  // On the executor's own thread, this is just evalLater().
+  EXPECT_EQ(456, getCurrentThreadExecutor()->executeAsync([]() { return 456; }).wait(waitScope));
+
+  other.stop();
+}
+
+TEST(AsyncUnixTest, ExecutorExecuteSync) {
+  ExecutorThread other;
+
+  // The calling thread doesn't need an event loop.
+  EXPECT_EQ(123, other.get().executeSync([]() { return 123; }));
+  EXPECT_EQ(456, other.get().executeSync([]() {
+    return evalLater([]() { return 456; });
+  }));
+
+  kj::Maybe<Exception> exception = kj::runCatchingExceptions([&]() {
+    other.get().executeSync([]() { KJ_FAIL_ASSERT("oops"); });
+  });
+  EXPECT_TRUE(exception != nullptr);
+
+  other.stop();
+}
+
+TEST(AsyncUnixTest, ExecutorCancelFromCaller) {
+  captureSignals();
+  UnixEventPort port;
+  EventLoop loop(port);
+  WaitScope waitScope(loop);
+
+  ExecutorThread other;
+  auto& executor = other.get();
+
+  MutexGuarded<bool> started(false);
+  bool canceled = false;
+  auto promise = executor.executeAsync([&]() {
+    *started.lockExclusive() = true;
+    return Promise<void>(NEVER_DONE).attach(kj::defer([&canceled]() { canceled = true; }));
+  });
+  started.when([](const bool& b) { return b; }, [](bool&) {});
+
+  // Destroying the promise blocks until the other thread has dropped the promise `func` returned.
+  promise = nullptr;
+  EXPECT_TRUE(canceled);
+
+  other.stop();
+}
+
+TEST(AsyncUnixTest, ExecutorCancelNested) {
+  // The other thread, in dropping the canceled call, cancels a call it made back to us. That needs
+  // our help while we are blocked waiting for it.
+
+  captureSignals();
+  UnixEventPort port;
+  EventLoop loop(port);
+  WaitScope waitScope(loop);
+
+  ExecutorThread other;
+  auto& executor = other.get();
+  auto self = getCurrentThreadExecutor();
+
+  auto paf = newPromiseAndFulfiller<void>();
+  bool canceled = false;
+  auto promise = executor.executeAsync([&]() {
+    return self->executeAsync([&]() {
+      paf.fulfiller->fulfill();
+      return Promise<void>(NEVER_DONE).attach(kj::defer([&canceled]() { canceled = true; }));
+    });
+  });
+  paf.promise.wait(waitScope);
+
+  promise = nullptr;
+  EXPECT_TRUE(canceled);
+
+  other.stop();
+}
+
+TEST(AsyncUnixTest, ExecutorLoopExits) {
+  captureSignals();
+  UnixEventPort port;
+  EventLoop loop(port);
+  WaitScope waitScope(loop);
+
+  Own<const Executor> executor;
+  Promise<void> promise = nullptr;
+  {
+    ExecutorThread other;
+    executor = other.get().addRef();
+    promise = executor->executeAsync([]() -> Promise<void> { return NEVER_DONE; });
+    executor->executeSync([]() {});  // make sure the call has started
+    other.stop();
+  }
+
+  kj::Maybe<Exception> exception = kj::runCatchingExceptions([&]() { promise.wait(waitScope); });
+  EXPECT_TRUE(KJ_ASSERT_NONNULL(exception).getType() == Exception::Type::DISCONNECTED);
+
+  // Calls made after the loop is gone fail the same way.
+  exception = kj::runCatchingExceptions([&]() {
+    executor->executeAsync([]() {}).wait(waitScope);
+  });
+  EXPECT_TRUE(KJ_ASSERT_NONNULL(exception).getType() == Exception::Type::DISCONNECTED);
+}
+
 int exitCodeForSignal = 0;
 void exitSignalHandler(int) {
   _exit(exitCodeForSignal);
@@ -38,6 +38,14 @@
 #include <sys/epoll.h>
 #include <sys/signalfd.h>
 #include <sys/eventfd.h>
+#include <sys/socket.h>
+#if KJ_USE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <poll.h>
+#endif
 #else
 #include <poll.h>
 #endif
@@ -283,6 +291,26 @@ void UnixEventPort::gotSignal(const siginfo_t& siginfo) {
 // =======================================================================================
 // epoll FdObserver implementation
 
+#if KJ_USE_IO_URING
+namespace {
+
+bool ioUringEnabled = false;
+
+}  // namespace
+
+void UnixEventPort::setIoUringEnabled(bool enabled) {
+  ioUringEnabled = enabled;
+}
+
+Maybe<UnixEventPort::IoUring&> UnixEventPort::getIoUring() {
+  KJ_IF_MAYBE(ring, ioUring) {
+    return **ring;
+  } else {
+    return nullptr;
+  }
+}
+#endif
+
 UnixEventPort::UnixEventPort()
     : timerImpl(readClock()),
       epollFd(-1),
@@ -294,6 +322,7 @@ UnixEventPort::UnixEventPort()
   KJ_SYSCALL(fd = epoll_create1(EPOLL_CLOEXEC));
   epollFd = AutoCloseFd(fd);
 
+  memset(&signalFdSigset, 0, sizeof(signalFdSigset));  // see updateSignalFdMask()
   KJ_SYSCALL(sigemptyset(&signalFdSigset));
   KJ_SYSCALL(fd = signalfd(-1, &signalFdSigset, SFD_NONBLOCK | SFD_CLOEXEC));
   signalFd = AutoCloseFd(fd);
@@ -304,11 +333,22 @@ UnixEventPort::UnixEventPort()
 
   struct epoll_event event;
   memset(&event, 0, sizeof(event));
-  event.events = EPOLLIN;
+  event.events = EPOLLIN | EPOLLET;
+  // Edge-triggered, like FdObservers. We always drain both FDs anyway, and a level-triggered
+  // entry would leave the epoll FD itself looking readable for a while after it was drained,
+  // which would wake io_uring's poll of it spuriously.
   event.data.u64 = 0;
   KJ_SYSCALL(epoll_ctl(epollFd, EPOLL_CTL_ADD, signalFd, &event));
   event.data.u64 = 1;
   KJ_SYSCALL(epoll_ctl(epollFd, EPOLL_CTL_ADD, eventFd, &event));
+
+  epollEvents = heapArray<struct epoll_event>(16);
+
+#if KJ_USE_IO_URING
+  if (ioUringEnabled) {
+    ioUring = IoUring::tryCreate(*this);
+  }
+#endif
 }
 
 UnixEventPort::~UnixEventPort() noexcept(false) {
@@ -337,6 +377,14 @@ UnixEventPort::FdObserver::FdObserver(UnixEventPort& eventPort, int fd, uint fla
   event.data.ptr = this;
 
   KJ_SYSCALL(epoll_ctl(eventPort.epollFd, EPOLL_CTL_ADD, fd, &event));
+
+#ifdef SO_BUSY_POLL
+  if (eventPort.socketBusyPoll != 0) {
+    // Best-effort; see setSocketBusyPoll().
+    int value = eventPort.socketBusyPoll;
+    setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &value, sizeof(value));
+  }
+#endif
 }
 
 UnixEventPort::FdObserver::~FdObserver() noexcept(false) {
@@ -399,13 +447,49 @@ Promise<void> UnixEventPort::FdObserver::whenUrgentDataAvailable() {
 }
 
 bool UnixEventPort::wait() {
-  return doEpollWait(
-      timerImpl.timeoutToNextEvent(readClock(), MILLISECONDS, int(maxValue))
-          .map([](uint64_t t) -> int { return t; })
-          .orDefault(-1));
+  int timeout = timerImpl.timeoutToNextEvent(readClock(), MILLISECONDS, int(maxValue))
+      .map([](uint64_t t) -> int { return t; })
+      .orDefault(-1);
+
+#if KJ_USE_IO_URING
+  KJ_IF_MAYBE(ring, ioUring) {
+    updateSignalFdMask();
+    if (ring->get()->waitForCompletions(timeout)) {
+      // Something is waiting in the epoll set too; collect it without blocking.
+      return doEpollWait(0);
+    } else {
+      timerImpl.advanceTo(readClock());
+      return false;
+    }
+  }
+#endif
+
+  if (busyPollDuration > 0 * SECONDS) {
+    bool woken = false;
+    if (busyPoll(woken)) return woken;
+
+    // Nothing happened while spinning, so block, for less time than before.
+    timeout = timerImpl.timeoutToNextEvent(readClock(), MILLISECONDS, int(maxValue))
+        .map([](uint64_t t) -> int { return t; })
+        .orDefault(-1);
+  }
+
+  return doEpollWait(timeout);
 }
 
 bool UnixEventPort::poll() {
+#if KJ_USE_IO_URING
+  KJ_IF_MAYBE(ring, ioUring) {
+    updateSignalFdMask();
+    if (ring->get()->waitForCompletions(0)) {
+      return doEpollWait(0);
+    } else {
+      timerImpl.advanceTo(readClock());
+      return false;
+    }
+  }
+#endif
+
   return doEpollWait(0);
 }
 
@@ -524,8 +608,11 @@ static siginfo_t toRegularSiginfo(const struct signalfd_siginfo& siginfo) {
   return result;
 }
 
-bool UnixEventPort::doEpollWait(int timeout) {
+void UnixEventPort::updateSignalFdMask() {
   sigset_t newMask;
+  // sigemptyset() may only clear the part of the set actually used for signals, but we memcmp()
+  // the whole thing below.
+  memset(&newMask, 0, sizeof(newMask));
   sigemptyset(&newMask);
 
   {
@@ -545,9 +632,52 @@ bool UnixEventPort::doEpollWait(int timeout) {
     signalFdSigset = newMask;
     KJ_SYSCALL(signalfd(signalFd, &signalFdSigset, SFD_NONBLOCK | SFD_CLOEXEC));
   }
+}
+
+void UnixEventPort::setBusyPollDuration(Duration duration) {
+  busyPollDuration = duration;
+}
+
+void UnixEventPort::setEventBatchSize(uint size) {
+  KJ_REQUIRE(size > 0, "event batch size must be positive");
+  epollEvents = heapArray<struct epoll_event>(size);
+}
+
+void UnixEventPort::setSocketBusyPoll(uint microseconds) {
+  socketBusyPoll = microseconds;
+}
+
+bool UnixEventPort::busyPoll(bool& woken) {
+  // Spin on non-blocking epoll_wait() calls until something happens, a timer comes due, or the
+  // busy-poll duration is up. Returns true in the first two cases, meaning that wait() should
+  // return `woken` rather than block.
+
+  Maybe<TimePoint> nextTimer = timerImpl.nextEvent();
+  TimePoint spinEnd = readClock() + busyPollDuration;
+
+  for (;;) {
+    bool gotEvents = false;
+    woken = doEpollWait(0, gotEvents);
+    if (gotEvents) return true;
+
+    TimePoint now = timerImpl.now();  // doEpollWait() just advanced it
+    KJ_IF_MAYBE(t, nextTimer) {
+      if (now >= *t) return true;
+    }
+    if (now >= spinEnd) return false;
+  }
+}
+
+bool UnixEventPort::doEpollWait(int timeout) {
+  bool gotEvents = false;
+  return doEpollWait(timeout, gotEvents);
+}
 
-  struct epoll_event events[16];
-  int n = epoll_wait(epollFd, events, kj::size(events), timeout);
+bool UnixEventPort::doEpollWait(int timeout, bool& gotEvents) {
+  updateSignalFdMask();
+
+  auto& events = epollEvents;
+  int n = epoll_wait(epollFd, events.begin(), events.size(), timeout);
   if (n < 0) {
     int error = errno;
     if (error == EINTR) {
@@ -561,6 +691,7 @@ bool UnixEventPort::doEpollWait(int timeout) {
   }
 
   bool woken = false;
+  gotEvents = n > 0;
 
   for (int i = 0; i < n; i++) {
     if (events[i].data.u64 == 0) {
@@ -594,6 +725,400 @@ bool UnixEventPort::doEpollWait(int timeout) {
   return woken;
 }
 
+#if KJ_USE_IO_URING
+// =======================================================================================
+// io_uring implementation, layered on top of epoll
+
+namespace {
+
+constexpr uint IO_URING_ENTRIES = 256;
+// Size of the submission queue. The kernel makes the completion queue twice as big, and keeps
+// any overflow on its side (IORING_FEAT_NODROP), so this only bounds how many operations we can
+// queue in one turn before we have to submit early.
+
+constexpr size_t IO_URING_MAX_TRANSFER = 1u << 30;
+// Reads and writes report their result in an int, so cap their size well below INT_MAX.
+
+constexpr uint64_t EPOLL_USER_DATA = 0;
+constexpr uint64_t IGNORED_USER_DATA = 1;
+// `user_data` values of submissions which aren't an `Operation`. Anything else is a pointer.
+
+static_assert(sizeof(socklen_t) == sizeof(uint), "IoUring::accept() assumes socklen_t is uint");
+
+Maybe<uint> findRegisteredBuffer(ArrayPtr<const ArrayPtr<byte>> registered,
+                                 const void* begin, size_t size) {
+  auto ptr = reinterpret_cast<const byte*>(begin);
+  for (uint i = 0; i < registered.size(); i++) {
+    if (ptr >= registered[i].begin() && ptr + size <= registered[i].end()) {
+      return i;
+    }
+  }
+  return nullptr;
+}
+
+void setPollEvents(struct io_uring_sqe& sqe, uint events) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  sqe.poll32_events = events << 16 | events >> 16;  // the kernel expects it word-swapped
+#else
+  sqe.poll32_events = events;
+#endif
+}
+
+}  // namespace
+
+class UnixEventPort::IoUring::Operation {
+  // Adapter for a single queued operation. Its address is the submission's `user_data`.
+
+public:
+  template <typename Prepare>
+  Operation(PromiseFulfiller<int>& fulfiller, IoUring& ring, Prepare&& prepare)
+      : fulfiller(fulfiller), ring(ring) {
+    auto& sqe = ring.getSqe();
+    prepare(sqe, *this);
+    sqe.user_data = reinterpret_cast<uintptr_t>(this);
+    ring.pushSqe();
+  }
+
+  ~Operation() noexcept(false) {
+    if (!done) {
+      // The kernel may still write into the caller's buffer; make sure it won't before we let the
+      // caller free it.
+      ring.cancel(*this);
+    }
+  }
+
+  KJ_DISALLOW_COPY(Operation);
+
+  void complete(int result) {
+    done = true;
+    if (!cancelling) {
+      fulfiller.fulfill(kj::mv(result));
+    }
+  }
+
+  bool done = false;
+  bool cancelling = false;
+
+  Array<struct iovec> iov;
+  struct sockaddr_storage addr;
+  // Storage for arguments that the kernel reads at submission time, which is later than the call
+  // that queued the operation.
+
+private:
+  PromiseFulfiller<int>& fulfiller;
+  IoUring& ring;
+};
+
+Maybe<Own<UnixEventPort::IoUring>> UnixEventPort::IoUring::tryCreate(UnixEventPort& eventPort) {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+#ifdef IORING_SETUP_COOP_TASKRUN
+  // Completions are only ever collected in io_uring_enter(), so there's no need for the kernel to
+  // interrupt us to run them.
+  params.flags = IORING_SETUP_COOP_TASKRUN;
+#endif
+
+  int fd = syscall(__NR_io_uring_setup, IO_URING_ENTRIES, &params);
+  if (fd < 0 && errno == EINVAL && params.flags != 0) {
+    // Kernel too old for the flags. Try without.
+    memset(&params, 0, sizeof(params));
+    fd = syscall(__NR_io_uring_setup, IO_URING_ENTRIES, &params);
+  }
+  if (fd < 0) {
+    // No io_uring here (ENOSYS), or it has been forbidden (EPERM). Stick with epoll.
+    return nullptr;
+  }
+  AutoCloseFd ownFd(fd);
+
+  constexpr uint REQUIRED_FEATURES = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP |
+      IORING_FEAT_SUBMIT_STABLE | IORING_FEAT_RW_CUR_POS | IORING_FEAT_EXT_ARG;
+  if ((params.features & REQUIRED_FEATURES) != REQUIRED_FEATURES) {
+    // Kernel older than 5.11. Stick with epoll.
+    return nullptr;
+  }
+
+  auto ring = new IoUring(eventPort, ownFd.release(), params);
+  return Own<IoUring>(ring, _::HeapDisposer<IoUring>::instance);
+}
+
+UnixEventPort::IoUring::IoUring(
+    UnixEventPort& eventPort, int fd, const struct io_uring_params& params)
+    : eventPort(eventPort), ringFd(fd) {
+  size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(uint);
+  size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  ringMemorySize = kj::max(sqSize, cqSize);
+  ringMemory = mmap(nullptr, ringMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    ringFd, IORING_OFF_SQ_RING);
+  if (ringMemory == MAP_FAILED) {
+    KJ_FAIL_SYSCALL("mmap(IORING_OFF_SQ_RING)", errno);
+  }
+
+  sqeMemorySize = params.sq_entries * sizeof(struct io_uring_sqe);
+  sqeMemory = mmap(nullptr, sqeMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   ringFd, IORING_OFF_SQES);
+  if (sqeMemory == MAP_FAILED) {
+    int error = errno;
+    munmap(ringMemory, ringMemorySize);
+    KJ_FAIL_SYSCALL("mmap(IORING_OFF_SQES)", error);
+  }
+
+  byte* ring = reinterpret_cast<byte*>(ringMemory);
+  sqHead = reinterpret_cast<uint*>(ring + params.sq_off.head);
+  sqTail = reinterpret_cast<uint*>(ring + params.sq_off.tail);
+  sqMask = *reinterpret_cast<uint*>(ring + params.sq_off.ring_mask);
+  sqEntries = params.sq_entries;
+  sqes = reinterpret_cast<struct io_uring_sqe*>(sqeMemory);
+
+  // We always fill SQEs in ring order, so the indirection array can be the identity mapping.
+  uint* sqArray = reinterpret_cast<uint*>(ring + params.sq_off.array);
+  for (uint i = 0; i < sqEntries; i++) {
+    sqArray[i] = i;
+  }
+
+  cqHead = reinterpret_cast<uint*>(ring + params.cq_off.head);
+  cqTail = reinterpret_cast<uint*>(ring + params.cq_off.tail);
+  cqMask = *reinterpret_cast<uint*>(ring + params.cq_off.ring_mask);
+  cqes = reinterpret_cast<struct io_uring_cqe*>(ring + params.cq_off.cqes);
+}
+
+UnixEventPort::IoUring::~IoUring() noexcept(false) {
+  // Closing the ring FD cancels anything still outstanding (only our own epoll poll, if the
+  // app has been well-behaved).
+  munmap(sqeMemory, sqeMemorySize);
+  munmap(ringMemory, ringMemorySize);
+}
+
+Promise<int> UnixEventPort::IoUring::read(int fd, void* buffer, size_t size) {
+  return newAdaptedPromise<int, Operation>(*this,
+      [&](struct io_uring_sqe& sqe, Operation&) {
+    sqe.opcode = IORING_OP_READ;
+    sqe.fd = fd;
+    sqe.off = ~uint64_t(0);  // current position, for files that have one
+    sqe.addr = reinterpret_cast<uintptr_t>(buffer);
+    sqe.len = kj::min(size, IO_URING_MAX_TRANSFER);
+    KJ_IF_MAYBE(index, findRegisteredBuffer(registeredBuffers, buffer, size)) {
+      sqe.opcode = IORING_OP_READ_FIXED;
+      sqe.buf_index = *index;
+    }
+  });
+}
+
+Promise<int> UnixEventPort::IoUring::write(int fd, ArrayPtr<const ArrayPtr<const byte>> pieces) {
+  return newAdaptedPromise<int, Operation>(*this,
+      [&](struct io_uring_sqe& sqe, Operation& op) {
+    sqe.fd = fd;
+    sqe.off = ~uint64_t(0);
+    if (pieces.size() == 1) {
+      sqe.opcode = IORING_OP_WRITE;
+      sqe.addr = reinterpret_cast<uintptr_t>(pieces[0].begin());
+      sqe.len = kj::min(pieces[0].size(), IO_URING_MAX_TRANSFER);
+      KJ_IF_MAYBE(index, findRegisteredBuffer(
+          registeredBuffers, pieces[0].begin(), pieces[0].size())) {
+        sqe.opcode = IORING_OP_WRITE_FIXED;
+        sqe.buf_index = *index;
+      }
+    } else {
+      op.iov = heapArray<struct iovec>(pieces.size());
+      for (uint i = 0; i < pieces.size(); i++) {
+        // writev() interface is not const-correct.  :(
+        op.iov[i].iov_base = const_cast<byte*>(pieces[i].begin());
+        op.iov[i].iov_len = pieces[i].size();
+      }
+      sqe.opcode = IORING_OP_WRITEV;
+      sqe.addr = reinterpret_cast<uintptr_t>(op.iov.begin());
+      sqe.len = op.iov.size();
+    }
+  });
+}
+
+Promise<int> UnixEventPort::IoUring::accept(
+    int fd, struct sockaddr* addr, uint* addrlen, int flags) {
+  return newAdaptedPromise<int, Operation>(*this,
+      [&](struct io_uring_sqe& sqe, Operation&) {
+    sqe.opcode = IORING_OP_ACCEPT;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<uintptr_t>(addr);
+    sqe.addr2 = reinterpret_cast<uintptr_t>(addrlen);
+    sqe.accept_flags = flags;
+  });
+}
+
+Promise<int> UnixEventPort::IoUring::connect(int fd, const struct sockaddr* addr, uint addrlen) {
+  return newAdaptedPromise<int, Operation>(*this,
+      [&](struct io_uring_sqe& sqe, Operation& op) {
+    KJ_REQUIRE(addrlen <= sizeof(op.addr), "Sorry, your sockaddr is too big for me.");
+    memcpy(&op.addr, addr, addrlen);
+    sqe.opcode = IORING_OP_CONNECT;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<uintptr_t>(&op.addr);
+    sqe.off = addrlen;
+  });
+}
+
+Promise<int> UnixEventPort::IoUring::poll(int fd, short events) {
+  return newAdaptedPromise<int, Operation>(*this,
+      [&](struct io_uring_sqe& sqe, Operation&) {
+    sqe.opcode = IORING_OP_POLL_ADD;
+    sqe.fd = fd;
+    setPollEvents(sqe, static_cast<unsigned short>(events));
+  });
+}
+
+void UnixEventPort::IoUring::registerBuffers(ArrayPtr<ArrayPtr<byte>> buffers) {
+  unregisterBuffers();
+  if (buffers.size() == 0) return;
+
+  KJ_STACK_ARRAY(struct iovec, iov, buffers.size(), 16, 64);
+  for (uint i = 0; i < buffers.size(); i++) {
+    iov[i].iov_base = buffers[i].begin();
+    iov[i].iov_len = buffers[i].size();
+  }
+  KJ_SYSCALL(syscall(__NR_io_uring_register, ringFd.get(), IORING_REGISTER_BUFFERS,
+                     iov.begin(), iov.size()));
+  registeredBuffers = heapArray(buffers);
+}
+
+void UnixEventPort::IoUring::unregisterBuffers() {
+  if (registeredBuffers.size() > 0) {
+    KJ_SYSCALL(syscall(__NR_io_uring_register, ringFd.get(), IORING_UNREGISTER_BUFFERS,
+                       nullptr, 0));
+    registeredBuffers = nullptr;
+  }
+}
+
+struct io_uring_sqe& UnixEventPort::IoUring::getSqe() {
+  uint tail = *sqTail;  // only we write the tail
+  while (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+    // The submission queue is full. Hand what we have to the kernel early to make room.
+    enter(0, 0);
+    reapCompletions();
+  }
+
+  auto& sqe = sqes[tail & sqMask];
+  memset(&sqe, 0, sizeof(sqe));
+  sqe.user_data = IGNORED_USER_DATA;
+  return sqe;
+}
+
+void UnixEventPort::IoUring::pushSqe() {
+  __atomic_store_n(sqTail, *sqTail + 1, __ATOMIC_RELEASE);
+  ++unsubmitted;
+}
+
+bool UnixEventPort::IoUring::enter(uint minComplete, int timeout) {
+  // Submits everything queued and, if `minComplete` is non-zero, waits up to `timeout`
+  // milliseconds (-1 = forever) for completions. Returns false if the wait was cut short.
+
+  uint flags = IORING_ENTER_GETEVENTS;
+  struct io_uring_getevents_arg arg;
+  struct __kernel_timespec ts;
+  void* argPtr = nullptr;
+  size_t argSize = 0;
+  if (minComplete > 0 && timeout >= 0) {
+    memset(&arg, 0, sizeof(arg));
+    ts.tv_sec = timeout / 1000;
+    ts.tv_nsec = (timeout % 1000) * 1000000ll;
+    arg.ts = reinterpret_cast<uintptr_t>(&ts);
+    flags |= IORING_ENTER_EXT_ARG;
+    argPtr = &arg;
+    argSize = sizeof(arg);
+  }
+
+  long n = syscall(__NR_io_uring_enter, ringFd.get(), unsubmitted, minComplete, flags,
+                   argPtr, argSize);
+  ++stats.systemCalls;
+  if (n < 0) {
+    int error = errno;
+    switch (error) {
+      case EINTR:
+        // As with epoll_wait(), let the event loop spin once and recompute the timeout.
+      case ETIME:
+        // Timed out.
+      case EBUSY:
+      case EAGAIN:
+        // The completion queue overflowed or the kernel is short on memory. Our caller will reap
+        // completions before trying again.
+        return false;
+      default:
+        KJ_FAIL_SYSCALL("io_uring_enter()", error);
+    }
+  }
+
+  stats.operations += n;
+  unsubmitted -= n;
+  return true;
+}
+
+void UnixEventPort::IoUring::reapCompletions() {
+  uint head = *cqHead;
+  while (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+    auto& cqe = cqes[head & cqMask];
+    uint64_t userData = cqe.user_data;
+    int result = cqe.res;
+    __atomic_store_n(cqHead, ++head, __ATOMIC_RELEASE);
+
+    if (userData == EPOLL_USER_DATA) {
+      epollArmed = false;
+      epollReady = true;
+    } else if (userData != IGNORED_USER_DATA) {
+      reinterpret_cast<Operation*>(userData)->complete(result);
+    }
+  }
+}
+
+bool UnixEventPort::IoUring::waitForCompletions(int timeout) {
+  // Returns true if the epoll FD is ready and needs to be checked.
+
+  if (!epollArmed) {
+    auto& sqe = getSqe();
+    sqe.opcode = IORING_OP_POLL_ADD;
+    sqe.fd = eventPort.epollFd;
+    setPollEvents(sqe, POLLIN);
+    sqe.user_data = EPOLL_USER_DATA;
+    pushSqe();
+    epollArmed = true;
+  }
+
+  if (epollReady || *cqHead != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+    // A cancellation already collected events on our behalf. Don't block.
+    timeout = 0;
+  }
+
+  enter(timeout == 0 ? 0 : 1, timeout);
+  reapCompletions();
+
+  bool result = epollReady;
+  epollReady = false;
+  return result;
+}
+
+void UnixEventPort::IoUring::cancel(Operation& op) {
+  op.cancelling = true;
+
+  reapCompletions();
+  if (op.done) return;
+
+  auto& sqe = getSqe();
+  sqe.opcode = IORING_OP_ASYNC_CANCEL;
+  sqe.fd = -1;
+  sqe.addr = reinterpret_cast<uintptr_t>(&op);
+  sqe.user_data = IGNORED_USER_DATA;
+  pushSqe();
+
+  // Cancellation of a request waiting on a socket or pipe takes effect while the kernel processes
+  // the submission, so submit it without waiting and collect the request's completion right away.
+  // The completion of the cancellation itself is ignored whenever it turns up. Only a request
+  // already executing in the kernel (e.g. on a regular file) has to be waited out, since it may
+  // still be using the caller's buffer.
+  enter(0, 0);
+  reapCompletions();
+  while (!op.done) {
+    enter(1, -1);
+    reapCompletions();
+  }
+}
+#endif  // KJ_USE_IO_URING
+
 #else  // KJ_USE_EPOLL
 // =======================================================================================
 // Traditional poll() FdObserver implementation.
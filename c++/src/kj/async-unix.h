@@ -40,6 +40,24 @@
 #define KJ_USE_EPOLL 1
 #endif
 
+#if KJ_USE_EPOLL && !defined(KJ_USE_IO_URING) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+// io_uring is layered on top of the epoll implementation, and is only used if enabled at runtime.
+// See `UnixEventPort::setIoUringEnabled()`.
+#define KJ_USE_IO_URING 1
+#endif
+#endif
+
+struct sockaddr;
+#if KJ_USE_EPOLL
+struct epoll_event;
+#endif
+#if KJ_USE_IO_URING
+struct io_uring_params;
+struct io_uring_sqe;
+struct io_uring_cqe;
+#endif
+
 namespace kj {
 
 class UnixEventPort: public EventPort {
@@ -98,6 +116,45 @@ public:
 
   Timer& getTimer() { return timerImpl; }
 
+#if KJ_USE_IO_URING
+  class IoUring;
+  // Submits I/O operations through a Linux io_uring instance. See definition below.
+
+  static void setIoUringEnabled(bool enabled);
+  // Chooses whether `UnixEventPort`s constructed after this call submit stream reads, writes,
+  // accepts, and connects through io_uring rather than making one system call per operation and
+  // per readiness notification. Submissions are batched and handed to the kernel together each
+  // time the event loop runs out of work, in the same system call that waits for completions.
+  // Disabled by default. Like `setReservedSignal()`, call this at startup.
+  //
+  // If the kernel does not support io_uring (or it has been forbidden, e.g. by seccomp), the
+  // port silently falls back to plain epoll. Use `getIoUring()` to find out which was chosen.
+
+  Maybe<IoUring&> getIoUring();
+  // Returns the port's io_uring instance, or null if the port uses plain epoll.
+#endif
+
+#if KJ_USE_EPOLL
+  void setBusyPollDuration(Duration duration);
+  // When the event loop runs out of work, keep polling for events without blocking for up to
+  // `duration` (or until the next timer event, if sooner) before actually going to sleep. This
+  // burns CPU, but an event arriving during the spin is picked up within microseconds, without
+  // paying for the scheduler to wake the thread. Useful for latency-sensitive loops that have a
+  // core to themselves. Zero, the default, disables spinning. Has no effect when the port uses
+  // io_uring.
+
+  void setEventBatchSize(uint size);
+  // Sets how many readiness events are collected from the kernel per system call. Defaults to 16.
+  // Loops watching many busy FDs can raise this to spend fewer system calls per event.
+
+  void setSocketBusyPoll(uint microseconds);
+  // Sets SO_BUSY_POLL to `microseconds` on every socket subsequently observed through an
+  // `FdObserver`, so that the kernel busy-polls the device queue when a read finds no data (see
+  // socket(7)). Raising the value above the system default (net.core.busy_read) requires
+  // CAP_NET_ADMIN; failures, and FDs which aren't sockets, are silently ignored. Zero, the default,
+  // leaves sockets alone.
+#endif
+
   Promise<int> onChildExit(Maybe<pid_t>& pid);
   // When the given child process exits, resolves to its wait status, as returned by wait(2). You
   // will need to use the WIFEXITED() etc. macros to interpret the status code.
@@ -161,7 +218,21 @@ private:
   // Signal mask as currently set on the signalFd. Tracked so we can detect whether or not it
   // needs updating.
 
+  Array<struct epoll_event> epollEvents;
+  // Receives events from epoll_wait(). See setEventBatchSize().
+
+  Duration busyPollDuration = 0 * SECONDS;
+  uint socketBusyPoll = 0;
+
   bool doEpollWait(int timeout);
+  bool doEpollWait(int timeout, bool& gotEvents);
+  bool busyPoll(bool& woken);
+  void updateSignalFdMask();
+
+#if KJ_USE_IO_URING
+  Maybe<Own<IoUring>> ioUring;
+  // Declared after `epollFd` so that it is torn down first: the ring polls the epoll FD.
+#endif
 
 #else
   class PollContext;
@@ -305,4 +376,113 @@ private:
   friend class UnixEventPort;
 };
 
+#if KJ_USE_IO_URING
+class UnixEventPort::IoUring {
+  // An io_uring instance owned by a UnixEventPort. Each method queues one operation and returns a
+  // promise for its result, which is what the equivalent system call would have returned, except
+  // that errors are reported as a negative errno value rather than throwing. Queued operations
+  // are submitted when the event loop next waits or polls for events.
+  //
+  // Buffers and address pointers passed to these methods must remain valid until the returned
+  // promise resolves or is destroyed. Destroying the promise of an operation the kernel has
+  // already picked up cancels it, so the kernel is guaranteed not to touch the buffer afterwards.
+  // This doesn't block unless the kernel is in the middle of carrying out the operation.
+  //
+  // Operations on a file descriptor in non-blocking mode (which includes every FD wrapped by KJ)
+  // may complete with -EAGAIN instead of waiting, depending on the operation and kernel version.
+  // Callers should then wait with `poll()` and retry. Don't fall back to an `FdObserver` here:
+  // its edge may already have been delivered, and dropped, by the time the -EAGAIN is seen.
+  //
+  // Most applications never need to touch this class directly: streams created by
+  // `setupAsyncIo()` use it automatically when it is enabled.
+
+public:
+  ~IoUring() noexcept(false);
+  KJ_DISALLOW_COPY(IoUring);
+
+  Promise<int> read(int fd, void* buffer, size_t size);
+  // Like read(2). If the buffer lies within a registered buffer (see `registerBuffers()`), the
+  // read uses the pre-mapped pages rather than pinning them on every call.
+
+  Promise<int> write(int fd, ArrayPtr<const ArrayPtr<const byte>> pieces);
+  // Like writev(2). The piece list itself is copied, but the bytes it points to are not.
+
+  Promise<int> accept(int fd, struct sockaddr* addr, uint* addrlen, int flags);
+  // Like accept4(2). Resolves to the new file descriptor.
+
+  Promise<int> connect(int fd, const struct sockaddr* addr, uint addrlen);
+  // Like connect(2). The address is copied.
+
+  Promise<int> poll(int fd, short events);
+  // Like poll(2) on a single FD, without a timeout: resolves to the FD's ready events as soon as
+  // any of `events` (POLLIN, POLLOUT, ...) is ready, which may be immediately.
+
+  void registerBuffers(ArrayPtr<ArrayPtr<byte>> buffers);
+  // Registers buffers with the kernel so that reads into them skip pinning the destination pages
+  // on every operation. Replaces any previously-registered set. The buffers must remain valid
+  // until they are replaced, `unregisterBuffers()` is called, or the port is destroyed. Useful
+  // when a server reads every connection into buffers drawn from one long-lived pool.
+
+  void unregisterBuffers();
+
+  struct Stats {
+    uint64_t operations = 0;
+    // Number of operations submitted to the kernel, including internal ones.
+
+    uint64_t systemCalls = 0;
+    // Number of io_uring_enter() calls made to submit those operations and wait for results.
+  };
+
+  Stats getStats() { return stats; }
+
+private:
+  class Operation;
+
+  UnixEventPort& eventPort;
+  AutoCloseFd ringFd;
+  void* ringMemory;
+  size_t ringMemorySize;
+  void* sqeMemory;
+  size_t sqeMemorySize;
+
+  uint* sqHead;
+  uint* sqTail;
+  uint sqMask;
+  uint sqEntries;
+  struct io_uring_sqe* sqes;
+
+  uint* cqHead;
+  uint* cqTail;
+  uint cqMask;
+  struct io_uring_cqe* cqes;
+
+  uint unsubmitted = 0;
+  // Number of SQEs queued since the last io_uring_enter().
+
+  bool epollArmed = false;
+  bool epollReady = false;
+  // The ring polls the port's epoll FD so that FdObservers, signals, and cross-thread wakeups
+  // still work while we block in io_uring_enter().
+
+  Array<ArrayPtr<byte>> registeredBuffers;
+  Stats stats;
+
+  IoUring(UnixEventPort& eventPort, int ringFd, const struct io_uring_params& params);
+  static Maybe<Own<IoUring>> tryCreate(UnixEventPort& eventPort);
+
+  struct io_uring_sqe& getSqe();
+  void pushSqe();
+  // getSqe() returns the next free submission queue entry, zeroed. Once it is filled in,
+  // pushSqe() queues it for submission. If filling it in fails, the entry is simply reused by
+  // the next getSqe().
+
+  bool enter(uint minComplete, int timeout);
+  void reapCompletions();
+  bool waitForCompletions(int timeout);
+  void cancel(Operation& op);
+
+  friend class UnixEventPort;
+};
+#endif
+
 }  // namespace kj
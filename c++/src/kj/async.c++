@@ -23,6 +23,7 @@
 #include "debug.h"
 #include "vector.h"
 #include "threadlocal.h"
+#include <atomic>
 
 #if KJ_USE_FUTEX
 #include <unistd.h>
@@ -64,12 +65,24 @@ public:
 
 class YieldPromiseNode final: public _::PromiseNode {
 public:
+  YieldPromiseNode() = default;
+  explicit YieldPromiseNode(EventPriority priority): priority(priority) {}
+
   void onReady(_::Event* event) noexcept override {
-    if (event) event->armBreadthFirst();
+    if (event) {
+      KJ_IF_MAYBE(p, priority) {
+        event->armBreadthFirst(*p);
+      } else {
+        event->armBreadthFirst();
+      }
+    }
   }
   void get(_::ExceptionOrValue& output) noexcept override {
     output.as<_::Void>() = _::Void();
   }
+
+private:
+  Maybe<EventPriority> priority;
 };
 
 class NeverDonePromiseNode final: public _::PromiseNode {
@@ -218,7 +231,7 @@ private:
 };
 
 void TaskSet::add(Promise<void>&& promise) {
-  auto task = heap<Task>(*this, kj::mv(promise.node));
+  auto task = _::allocPromise<Task>(*this, kj::mv(promise.node));
   KJ_IF_MAYBE(head, tasks) {
     head->get()->prev = &task->next;
     task->next = kj::mv(tasks);
@@ -291,6 +304,270 @@ NullEventPort NullEventPort::instance = NullEventPort();
 
 // =======================================================================================
 
+namespace _ {  // private
+
+XThreadWork::~XThreadWork() noexcept(false) {}
+
+}  // namespace _ (private)
+
+struct Executor::Impl {
+  EventLoop& loop;
+
+  mutable std::atomic<uint> state { 0 };
+  // The low bits count the number of post() calls currently in progress. CLOSED is set once the
+  // EventLoop begins destruction, after which no new posts are accepted. The loop waits for the
+  // in-progress count to drop to zero before it goes away, which is what makes it safe for
+  // posting threads to touch `loop.port`.
+
+  static constexpr uint CLOSED = 1u << 31;
+
+  mutable std::atomic<_::XThreadWork*> head { nullptr };
+  // Lock-free stack of posted work, most-recently-posted first. The consumer always takes the
+  // whole stack at once, so there is no ABA hazard.
+
+  Own<TaskSet> calls;
+  // executeAsync() / executeSync() calls currently running on this loop. Only touched by the loop's
+  // own thread.
+
+  mutable std::atomic<uint> blocked { 0 };
+  mutable MutexGuarded<uint> wakeups { 0u };
+  // While the loop's thread is blocked in `XThreadCall::cancel()`, `blocked` is nonzero, and
+  // posting work here, or finishing the canceled call, bumps `wakeups` so that the thread can run
+  // the work. The other thread may need it in order to finish canceling, e.g. if it must cancel a
+  // call of its own to this thread.
+
+  Impl(EventLoop& loop)
+      : loop(loop), calls(kj::heap<TaskSet>(_::LoggingErrorHandler::instance)) {}
+
+  _::XThreadWork* takeAll() {
+    // Take everything from the stack and return it in posting order.
+    _::XThreadWork* list = head.exchange(nullptr, std::memory_order_acquire);
+    _::XThreadWork* reversed = nullptr;
+    while (list != nullptr) {
+      _::XThreadWork* next = list->next;
+      list->next = reversed;
+      reversed = list;
+      list = next;
+    }
+    return reversed;
+  }
+};
+
+Executor::Executor(EventLoop& loop): impl(kj::heap<Impl>(loop)) {}
+Executor::~Executor() noexcept(false) {}
+
+Own<const Executor> Executor::addRef() const {
+  return kj::atomicAddRef(*this);
+}
+
+bool Executor::isLive() const {
+  return !(impl->state.load(std::memory_order_acquire) & Impl::CLOSED);
+}
+
+bool Executor::postImpl(_::XThreadWork* work) const {
+  uint prevState = impl->state.fetch_add(1, std::memory_order_acquire);
+  KJ_DEFER(impl->state.fetch_sub(1, std::memory_order_release));
+  if (prevState & Impl::CLOSED) {
+    return false;
+  }
+
+  _::XThreadWork* oldHead = impl->head.load(std::memory_order_relaxed);
+  do {
+    work->next = oldHead;
+  } while (!impl->head.compare_exchange_weak(oldHead, work,
+      std::memory_order_release, std::memory_order_relaxed));
+
+  if (oldHead == nullptr) {
+    // The queue was empty, so the loop may be asleep. (If the queue was not empty then whoever
+    // made it non-empty is responsible for the wakeup.)
+    impl->loop.port.wake();
+  }
+  if (impl->blocked.load() != 0) {
+    ++*impl->wakeups.lockExclusive();
+  }
+  return true;
+}
+
+bool Executor::isCurrentThread() const {
+  return threadLocalEventLoop == &impl->loop && isLive();
+}
+
+bool Executor::poll() {
+  if (impl->head.load(std::memory_order_relaxed) == nullptr) {
+    return false;
+  }
+
+  _::XThreadWork* work = impl->takeAll();
+  while (work != nullptr) {
+    _::XThreadWork* next = work->next;
+    KJ_IF_MAYBE(exception, kj::runCatchingExceptions([&]() {
+      Own<_::XThreadWork> owned(work, _::HeapDisposer<_::XThreadWork>::instance);
+      owned->run();
+    })) {
+      KJ_LOG(ERROR, "Uncaught exception in work posted to Executor.", *exception);
+    }
+    work = next;
+  }
+  return true;
+}
+
+void Executor::shutdown() {
+  impl->state.fetch_or(Impl::CLOSED, std::memory_order_acq_rel);
+  while (impl->state.load(std::memory_order_acquire) != Impl::CLOSED) {
+    // Some other thread is in the middle of post(). It will be done momentarily.
+  }
+
+  _::XThreadWork* work = impl->takeAll();
+  while (work != nullptr) {
+    _::XThreadWork* next = work->next;
+    kj::runCatchingExceptions([&]() { delete work; });
+    work = next;
+  }
+
+  // Cancel calls still in progress. Their callers will receive DISCONNECTED.
+  impl->calls = nullptr;
+}
+
+namespace _ {  // private
+
+XThreadCall::XThreadCall(Maybe<Own<const Executor>> replyTo): replyTo(kj::mv(replyTo)) {}
+XThreadCall::~XThreadCall() noexcept(false) {}
+
+void XThreadCall::start(const Executor& targetParam) {
+  target = targetParam.addRef();
+
+  class Starter {
+    // Work item which begins the call on the target thread, or finishes it if the target loop goes
+    // away before getting that far.
+  public:
+    explicit Starter(Own<XThreadCall> call): call(kj::mv(call)) {}
+    Starter(Starter&&) = default;
+    ~Starter() noexcept(false) {
+      if (call.get() != nullptr && !started) {
+        call->finish();
+      }
+    }
+
+    void operator()() {
+      started = true;
+      call->begin();
+    }
+
+  private:
+    Own<XThreadCall> call;
+    bool started = false;
+  };
+
+  target->post(Starter(atomicAddRef(*this)));
+}
+
+void XThreadCall::begin() {
+  {
+    auto lock = state.lockExclusive();
+    if (lock->canceled) {
+      // Canceled before we got to it. The caller isn't waiting.
+      lock->status = Status::DONE;
+      return;
+    }
+    lock->status = Status::RUNNING;
+  }
+
+  auto paf = newPromiseAndFulfiller<void>();
+  doneFulfiller = kj::mv(paf.fulfiller);
+  promise = evalNow([this]() { return run(); })
+      .then([this]() {
+    completed = true;
+    doneFulfiller->fulfill();
+  }).eagerlyEvaluate(nullptr);
+
+  threadLocalEventLoop->executor->impl->calls->add(kj::mv(paf.promise)
+      .attach(kj::defer([self = atomicAddRef(*this)]() mutable { self->finish(); })));
+}
+
+void XThreadCall::finish() {
+  // Called on the target thread when the call's promise has been destroyed, whether because it
+  // completed, was canceled, or the loop is shutting down. May also be called on a posting thread
+  // if the target loop was already gone. Called again, harmlessly, when the task set lets go of a
+  // call that was canceled.
+
+  if (finished) return;
+  finished = true;
+
+  promise = nullptr;
+  if (doneFulfiller.get() != nullptr && doneFulfiller->isWaiting()) {
+    doneFulfiller->fulfill();
+  }
+  doneFulfiller = nullptr;
+  if (!completed) {
+    getResult().addException(KJ_EXCEPTION(DISCONNECTED,
+        "Executor's event loop exited before the call completed"));
+  }
+
+  Maybe<Own<const Executor>> reply;
+  {
+    auto lock = state.lockExclusive();
+    lock->status = Status::DONE;
+    if (!lock->canceled) {
+      reply = kj::mv(replyTo);
+    }
+  }
+
+  KJ_IF_MAYBE(r, reply) {
+    // If the caller's loop is gone, its promise is gone too, so there's no one to tell.
+    (*r)->post([self = atomicAddRef(*this)]() mutable { self->deliver(); });
+  } else KJ_IF_MAYBE(r, replyTo) {
+    // Canceled, so the caller may be blocked in cancel() waiting for us.
+    ++*(*r)->impl->wakeups.lockExclusive();
+  }
+}
+
+void XThreadCall::cancel() {
+  Status status;
+  {
+    auto lock = state.lockExclusive();
+    lock->canceled = true;
+    status = lock->status;
+  }
+
+  if (status == Status::RUNNING) {
+    // Ask the target thread to drop the call's promise, and wait for it to do so, because `func`
+    // may refer to objects that the caller is about to destroy. If the target loop is shutting
+    // down, the post fails, but then the loop drops the promise anyway.
+    target->post([self = atomicAddRef(*this)]() mutable { self->finish(); });
+
+    // Dropping the promise may in turn cancel calls that the target thread made to this one, and
+    // those need this thread to run the work they post here. So keep doing that while waiting.
+    Executor& local = *threadLocalEventLoop->executor;
+    local.impl->blocked.fetch_add(1);
+    KJ_DEFER(local.impl->blocked.fetch_sub(1));
+    for (;;) {
+      uint seen = *local.impl->wakeups.lockShared();
+      if (state.lockShared()->status == Status::DONE) break;
+      local.poll();
+      local.impl->wakeups.when([seen](const uint& n) { return n != seen; }, [](uint&) {});
+    }
+  }
+}
+
+void XThreadCall::runSync(const Executor& targetParam) {
+  KJ_REQUIRE(!targetParam.isCurrentThread(),
+      "executeSync() called on the executor's own thread; this would deadlock");
+  start(targetParam);
+  waitDone();
+}
+
+void XThreadCall::waitDone() {
+  state.when([](const State& s) { return s.status == Status::DONE; }, [](State&) {});
+}
+
+}  // namespace _ (private)
+
+Own<const Executor> getCurrentThreadExecutor() {
+  return currentEventLoop().executor->addRef();
+}
+
+// =======================================================================================
+
 void EventPort::setRunnable(bool runnable) {}
 
 void EventPort::wake() const {
@@ -298,32 +575,46 @@ void EventPort::wake() const {
       "cross-thread wake() not implemented by this EventPort implementation"));
 }
 
+EventLoopObserver::~EventLoopObserver() noexcept(false) {}
+void EventLoopObserver::onTurn(Duration duration, size_t queueDepth) {}
+void EventLoopObserver::onWait(Duration duration) {}
+void EventLoopObserver::onSlowEvent(Duration duration, StringPtr trace) {}
+
 EventLoop::EventLoop()
     : port(_::NullEventPort::instance),
-      daemons(kj::heap<TaskSet>(_::LoggingErrorHandler::instance)) {}
+      daemons(kj::heap<TaskSet>(_::LoggingErrorHandler::instance)),
+      executor(kj::atomicRefcounted<Executor>(*this)) {}
 
 EventLoop::EventLoop(EventPort& port)
     : port(port),
-      daemons(kj::heap<TaskSet>(_::LoggingErrorHandler::instance)) {}
+      daemons(kj::heap<TaskSet>(_::LoggingErrorHandler::instance)),
+      executor(kj::atomicRefcounted<Executor>(*this)) {}
 
 EventLoop::~EventLoop() noexcept(false) {
+  // Stop accepting cross-thread work, and discard anything that never got to run.
+  executor->shutdown();
+
   // Destroy all "daemon" tasks, noting that their destructors might try to access the EventLoop
   // some more.
   daemons = nullptr;
 
   // The application _should_ destroy everything using the EventLoop before destroying the
   // EventLoop itself, so if there are events on the loop, this indicates a memory leak.
-  KJ_REQUIRE(head == nullptr, "EventLoop destroyed with events still in the queue.  Memory leak?",
-             head->trace()) {
-    // Unlink all the events and hope that no one ever fires them...
-    _::Event* event = head;
-    while (event != nullptr) {
-      _::Event* next = event->next;
-      event->next = nullptr;
-      event->prev = nullptr;
-      event = next;
+  for (auto& lane: lanes) {
+    KJ_REQUIRE(lane.head == nullptr,
+               "EventLoop destroyed with events still in the queue.  Memory leak?",
+               lane.head->trace()) {
+      // Unlink all the events and hope that no one ever fires them...
+      _::Event* event = lane.head;
+      while (event != nullptr) {
+        _::Event* next = event->next;
+        event->next = nullptr;
+        event->prev = nullptr;
+        event = next;
+      }
+      queueDepth = 0;
+      break;
     }
-    break;
   }
 
   KJ_REQUIRE(threadLocalEventLoop != this,
@@ -331,12 +622,22 @@ EventLoop::~EventLoop() noexcept(false) {
     threadLocalEventLoop = nullptr;
     break;
   }
+
+  for (void* block: freePromiseNodes) {
+    while (block != nullptr) {
+      void* next = *reinterpret_cast<void**>(block);
+      operator delete(block);
+      block = next;
+    }
+  }
 }
 
 void EventLoop::run(uint maxTurnCount) {
   running = true;
   KJ_DEFER(running = false);
 
+  executor->poll();
+
   for (uint i = 0; i < maxTurnCount; i++) {
     if (!turn()) {
       break;
@@ -347,39 +648,74 @@ void EventLoop::run(uint maxTurnCount) {
 }
 
 bool EventLoop::turn() {
-  _::Event* event = head;
-
-  if (event == nullptr) {
-    // No events in the queue.
-    return false;
-  } else {
-    head = event->next;
-    if (head != nullptr) {
-      head->prev = &head;
+  // Normally take from the highest-priority lane with events, but let a lower lane which has been
+  // passed over too many times in a row go first.
+  uint chosen = 0;
+  while (lanes[chosen].head == nullptr) {
+    if (++chosen == LANE_COUNT) {
+      // No events in the queue.
+      return false;
     }
-
-    depthFirstInsertPoint = &head;
-    if (tail == &event->next) {
-      tail = &head;
+  }
+  uint starved = chosen;
+  for (uint i = chosen + 1; i < LANE_COUNT; i++) {
+    if (lanes[i].head != nullptr && ++lanes[i].passedOver > MAX_PASSED_OVER && starved == chosen) {
+      starved = i;
     }
+  }
 
-    event->next = nullptr;
-    event->prev = nullptr;
+  Lane& lane = lanes[starved];
+  lane.passedOver = 0;
 
-    Maybe<Own<_::Event>> eventToDestroy;
-    {
-      event->firing = true;
-      KJ_DEFER(event->firing = false);
-      eventToDestroy = event->fire();
-    }
+  _::Event* event = lane.head;
+  lane.head = event->next;
+  if (lane.head != nullptr) {
+    lane.head->prev = &lane.head;
+  }
 
-    depthFirstInsertPoint = &head;
-    return true;
+  lane.depthFirstInsertPoint = &lane.head;
+  if (lane.tail == &event->next) {
+    lane.tail = &lane.head;
   }
+
+  event->next = nullptr;
+  event->prev = nullptr;
+
+  {
+    currentLane = starved;
+    KJ_DEFER(currentLane = uint(EventPriority::NORMAL));
+
+    if (observer != nullptr) {
+      fireObserved(*event);
+    } else {
+      Maybe<Own<_::Event>> eventToDestroy;
+      {
+        event->firing = true;
+        KJ_DEFER(event->firing = false);
+        eventToDestroy = event->fire();
+      }
+    }
+  }
+  --queueDepth;
+
+  lane.depthFirstInsertPoint = &lane.head;
+  return true;
+}
+
+void EventLoop::setObserver(EventLoopObserver& observerParam, Duration threshold) {
+  observer = &observerParam;
+  slowEventThreshold = threshold;
+}
+
+void EventLoop::clearObserver() {
+  observer = nullptr;
 }
 
 bool EventLoop::isRunnable() {
-  return head != nullptr;
+  for (auto& lane: lanes) {
+    if (lane.head != nullptr) return true;
+  }
+  return false;
 }
 
 void EventLoop::setRunnable(bool runnable) {
@@ -389,6 +725,32 @@ void EventLoop::setRunnable(bool runnable) {
   }
 }
 
+void EventLoop::wait() {
+  if (!executor->poll()) {
+    if (observer != nullptr) {
+      auto& clock = systemPreciseMonotonicClock();
+      TimePoint start = clock.now();
+      port.wait();
+      Duration duration = clock.now() - start;
+      KJ_IF_MAYBE(exception, kj::runCatchingExceptions([&]() {
+        observer->onWait(duration);
+      })) {
+        KJ_LOG(ERROR, "EventLoopObserver threw", *exception);
+      }
+    } else {
+      port.wait();
+    }
+    executor->poll();
+  }
+}
+
+void EventLoop::poll() {
+  executor->poll();
+  if (port.poll()) {
+    executor->poll();
+  }
+}
+
 void EventLoop::enterScope() {
   KJ_REQUIRE(threadLocalEventLoop == nullptr, "This thread already has an EventLoop.");
   threadLocalEventLoop = this;
@@ -412,7 +774,7 @@ void WaitScope::poll() {
   for (;;) {
     if (!loop.turn()) {
       // No events in the queue.  Poll for I/O.
-      loop.port.poll();
+      loop.poll();
 
       if (!loop.isRunnable()) {
         // Still no events in the queue. We're done.
@@ -439,7 +801,7 @@ void waitImpl(Own<_::PromiseNode>&& node, _::ExceptionOrValue& result, WaitScope
   while (!doneEvent.fired) {
     if (!loop.turn()) {
       // No events in the queue.  Wait for callback.
-      loop.port.wait();
+      loop.wait();
     }
   }
 
@@ -467,7 +829,7 @@ bool pollImpl(_::PromiseNode& node, WaitScope& waitScope) {
   while (!doneEvent.fired) {
     if (!loop.turn()) {
       // No events in the queue.  Poll for I/O.
-      loop.port.poll();
+      loop.poll();
 
       if (!doneEvent.fired && !loop.isRunnable()) {
         // No progress. Give up.
@@ -482,12 +844,60 @@ bool pollImpl(_::PromiseNode& node, WaitScope& waitScope) {
   return true;
 }
 
+static constexpr size_t PROMISE_NODE_SIZE_STEP = 16;
+static constexpr uint MAX_FREE_PROMISE_NODES = 128;
+// Free lists hold at most this many blocks of each size, so a burst of promises doesn't pin its
+// memory forever.
+
+void* allocPromiseNode(size_t size) {
+  // Nodes are allocated with operator new one block at a time, rounded up to a multiple of
+  // PROMISE_NODE_SIZE_STEP, and freed blocks are kept for reuse by whichever loop is current when
+  // they are freed.  Since each block stands alone, nodes may be destroyed in any order, after
+  // their loop is gone, or in another thread, and without a current loop (e.g. a
+  // `Promise<T>(value)` made before the WaitScope) we simply fall back to new and delete.
+
+  size_t sizeClass = (size - 1) / PROMISE_NODE_SIZE_STEP;
+  EventLoop* loop = threadLocalEventLoop;
+  if (loop != nullptr && sizeClass < EventLoop::PROMISE_NODE_SIZE_CLASSES) {
+    void*& head = loop->freePromiseNodes[sizeClass];
+    if (head != nullptr) {
+      void* result = head;
+      head = *reinterpret_cast<void**>(result);
+      --loop->freePromiseNodeCounts[sizeClass];
+      return result;
+    }
+  }
+
+  if (sizeClass < EventLoop::PROMISE_NODE_SIZE_CLASSES) {
+    size = (sizeClass + 1) * PROMISE_NODE_SIZE_STEP;
+  }
+  return operator new(size);
+}
+
+void freePromiseNode(void* pointer, size_t size) noexcept {
+  size_t sizeClass = (size - 1) / PROMISE_NODE_SIZE_STEP;
+  EventLoop* loop = threadLocalEventLoop;
+  if (loop != nullptr && sizeClass < EventLoop::PROMISE_NODE_SIZE_CLASSES &&
+      loop->freePromiseNodeCounts[sizeClass] < MAX_FREE_PROMISE_NODES) {
+    void*& head = loop->freePromiseNodes[sizeClass];
+    *reinterpret_cast<void**>(pointer) = head;
+    head = pointer;
+    ++loop->freePromiseNodeCounts[sizeClass];
+  } else {
+    operator delete(pointer);
+  }
+}
+
 Promise<void> yield() {
-  return Promise<void>(false, kj::heap<YieldPromiseNode>());
+  return Promise<void>(false, allocPromise<YieldPromiseNode>());
+}
+
+Promise<void> yield(EventPriority priority) {
+  return Promise<void>(false, allocPromise<YieldPromiseNode>(priority));
 }
 
 Own<PromiseNode> neverDone() {
-  return kj::heap<NeverDonePromiseNode>();
+  return allocPromise<NeverDonePromiseNode>();
 }
 
 void NeverDone::wait(WaitScope& waitScope) const {
@@ -506,23 +916,32 @@ Event::Event()
     : loop(currentEventLoop()), next(nullptr), prev(nullptr) {}
 
 Event::~Event() noexcept(false) {
+  disarm();
+
+  KJ_REQUIRE(!firing, "Promise callback destroyed itself.");
+  KJ_REQUIRE(threadLocalEventLoop == &loop || threadLocalEventLoop == nullptr,
+             "Promise destroyed from a different thread than it was created in.");
+}
+
+void Event::disarm() {
   if (prev != nullptr) {
-    if (loop.tail == &next) {
-      loop.tail = prev;
+    auto& queue = loop.lanes[lane];
+    if (queue.tail == &next) {
+      queue.tail = prev;
     }
-    if (loop.depthFirstInsertPoint == &next) {
-      loop.depthFirstInsertPoint = prev;
+    if (queue.depthFirstInsertPoint == &next) {
+      queue.depthFirstInsertPoint = prev;
     }
 
     *prev = next;
     if (next != nullptr) {
       next->prev = prev;
     }
-  }
+    --loop.queueDepth;
 
-  KJ_REQUIRE(!firing, "Promise callback destroyed itself.");
-  KJ_REQUIRE(threadLocalEventLoop == &loop || threadLocalEventLoop == nullptr,
-             "Promise destroyed from a different thread than it was created in.");
+    next = nullptr;
+    prev = nullptr;
+  }
 }
 
 void Event::armDepthFirst() {
@@ -531,38 +950,55 @@ void Event::armDepthFirst() {
              "the thread-safe work queue to queue events cross-thread.");
 
   if (prev == nullptr) {
-    next = *loop.depthFirstInsertPoint;
-    prev = loop.depthFirstInsertPoint;
+    lane = loop.currentLane;
+    auto& queue = loop.lanes[lane];
+
+    next = *queue.depthFirstInsertPoint;
+    prev = queue.depthFirstInsertPoint;
     *prev = this;
     if (next != nullptr) {
       next->prev = &next;
     }
 
-    loop.depthFirstInsertPoint = &next;
+    queue.depthFirstInsertPoint = &next;
 
-    if (loop.tail == prev) {
-      loop.tail = &next;
+    if (queue.tail == prev) {
+      queue.tail = &next;
     }
 
+    ++loop.queueDepth;
     loop.setRunnable(true);
   }
 }
 
 void Event::armBreadthFirst() {
+  armBreadthFirst(EventPriority(loop.currentLane));
+}
+
+void Event::armBreadthFirst(EventPriority priority) {
   KJ_REQUIRE(threadLocalEventLoop == &loop || threadLocalEventLoop == nullptr,
              "Event armed from different thread than it was created in.  You must use "
              "the thread-safe work queue to queue events cross-thread.");
 
+  if (prev != nullptr && lane != uint(priority)) {
+    // Already queued, but in another lane. Move it.
+    disarm();
+  }
+
   if (prev == nullptr) {
-    next = *loop.tail;
-    prev = loop.tail;
+    lane = uint(priority);
+    auto& queue = loop.lanes[lane];
+
+    next = *queue.tail;
+    prev = queue.tail;
     *prev = this;
     if (next != nullptr) {
       next->prev = &next;
     }
 
-    loop.tail = &next;
+    queue.tail = &next;
 
+    ++loop.queueDepth;
     loop.setRunnable(true);
   }
 }
@@ -612,6 +1048,54 @@ kj::String Event::trace() {
 
 }  // namespace _ (private)
 
+void EventLoop::fireObserved(_::Event& event) {
+  // Like the tail of turn(), but timed. Kept out of line so the common case doesn't pay for it.
+
+#if !KJ_NO_RTTI
+  // Firing may tear down the chain of promise nodes that the event was waiting on, so note their
+  // types beforehand in case the event turns out to be slow. Demangling can wait until then.
+  const std::type_info* types[16];
+  uint typeCount = 0;
+  types[typeCount++] = &typeid(event);
+  for (_::PromiseNode* node = event.getInnerForTrace();
+       node != nullptr && typeCount < kj::size(types); node = node->getInnerForTrace()) {
+    types[typeCount++] = &typeid(*node);
+  }
+#endif
+
+  auto& clock = systemPreciseMonotonicClock();
+  size_t depth = queueDepth;
+  TimePoint start = clock.now();
+
+  Maybe<Own<_::Event>> eventToDestroy;
+  {
+    event.firing = true;
+    KJ_DEFER(event.firing = false);
+    eventToDestroy = event.fire();
+  }
+
+  Duration duration = clock.now() - start;
+
+  // Don't let a misbehaving observer break the loop. Note that the observer may remove itself.
+  KJ_IF_MAYBE(exception, kj::runCatchingExceptions([&]() {
+    EventLoopObserver* o = observer;
+    if (duration >= slowEventThreshold) {
+#if KJ_NO_RTTI
+      o->onSlowEvent(duration, "Trace not available because RTTI is disabled.");
+#else
+      kj::Vector<kj::String> trace(typeCount);
+      for (auto type: arrayPtr(types, typeCount)) {
+        trace.add(_::demangleTypeName(type->name()));
+      }
+      o->onSlowEvent(duration, strArray(trace, "\n"));
+#endif
+    }
+    o->onTurn(duration, depth);
+  })) {
+    KJ_LOG(ERROR, "EventLoopObserver threw", *exception);
+  }
+}
+
 // =======================================================================================
 
 namespace _ {  // private
@@ -864,7 +1348,7 @@ Maybe<Own<Event>> ChainPromiseNode::fire() {
     // There is an exception.  If there is also a value, delete it.
     kj::runCatchingExceptions([&]() { intermediate.value = nullptr; });
     // Now set step2 to a rejected promise.
-    inner = heap<ImmediateBrokenPromiseNode>(kj::mv(*exception));
+    inner = allocPromise<ImmediateBrokenPromiseNode>(kj::mv(*exception));
   } else KJ_IF_MAYBE(value, intermediate.value) {
     // There is a value and no exception.  The value is itself a promise.  Adopt it as our
     // step2.
@@ -1035,7 +1519,7 @@ void ArrayJoinPromiseNode<void>::getNoError(ExceptionOrValue& output) noexcept {
 }  // namespace _ (private)
 
 Promise<void> joinPromises(Array<Promise<void>>&& promises) {
-  return Promise<void>(false, kj::heap<_::ArrayJoinPromiseNode<void>>(
+  return Promise<void>(false, _::allocPromise<_::ArrayJoinPromiseNode<void>>(
       KJ_MAP(p, promises) { return kj::mv(p.node); },
       heapArray<_::ExceptionOr<_::Void>>(promises.size())));
 }
@@ -1073,6 +1557,44 @@ Maybe<Own<Event>> EagerPromiseNodeBase::fire() {
 
 // -------------------------------------------------------------------
 
+PriorityPromiseNode::PriorityPromiseNode(Own<PromiseNode>&& dependencyParam,
+                                         EventPriority priority)
+    : dependency(kj::mv(dependencyParam)), priority(priority) {
+  dependency->setSelfPointer(&dependency);
+  dependency->onReady(this);
+
+  if (isArmed()) {
+    // The dependency was already ready, and has scheduled us breadth-first in the current lane.
+    // Don't wait behind that lane's backlog.
+    armBreadthFirst(priority);
+  }
+}
+
+void PriorityPromiseNode::onReady(Event* newEvent) noexcept {
+  event = newEvent;
+  if (ready && event != nullptr) {
+    event->armBreadthFirst(priority);
+  }
+}
+
+void PriorityPromiseNode::get(ExceptionOrValue& output) noexcept {
+  dependency->get(output);
+}
+
+PromiseNode* PriorityPromiseNode::getInnerForTrace() {
+  return dependency;
+}
+
+Maybe<Own<Event>> PriorityPromiseNode::fire() {
+  ready = true;
+  if (event != nullptr) {
+    event->armBreadthFirst(priority);
+  }
+  return nullptr;
+}
+
+// -------------------------------------------------------------------
+
 void AdapterPromiseNodeBase::onReady(Event* event) noexcept {
   onReadyEvent.init(event);
 }
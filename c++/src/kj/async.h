@@ -28,11 +28,14 @@
 #include "async-prelude.h"
 #include "exception.h"
 #include "refcount.h"
+#include "mutex.h"
+#include "time.h"
 
 namespace kj {
 
 class EventLoop;
 class WaitScope;
+class Executor;
 
 template <typename T>
 class Promise;
@@ -43,6 +46,27 @@ class PromiseFulfiller;
 template <typename T>
 struct PromiseFulfillerPair;
 
+enum class EventPriority {
+  // Lanes of the `EventLoop`'s ready queue.  The loop normally runs the first event in the
+  // highest-priority non-empty lane, but whenever a lower lane has been passed over for
+  // `EventLoop::MAX_PASSED_OVER` turns in a row, it runs that lane's first event instead, so
+  // that no lane is starved.
+  //
+  // Events are scheduled in the lane of the event that was running when they were armed (or
+  // NORMAL, outside of any event), so a chain of continuations keeps its priority.  Use
+  // `Promise::atPriority()` or `evalLater(func, priority)` to change lanes.
+
+  HIGH,
+  // Latency-sensitive work, such as health checks and control messages, which should not wait
+  // behind bulk work.
+
+  NORMAL,
+  // The default.
+
+  BACKGROUND
+  // Bulk work, such as large transfers, which should only use time left over by everything else.
+};
+
 template <typename Func, typename T>
 using PromiseForResult = _::ReducePromises<_::ReturnType<Func, T>>;
 // Evaluates to the type of Promise for the result of calling functor type Func with parameter type
@@ -103,6 +127,23 @@ class Promise: protected _::PromiseBase {
   //
   // To adapt a non-Promise-based asynchronous API to promises, use `newAdaptedPromise()`.
   //
+  // When compiled as C++20 (see KJ_HAS_COROUTINE), a function returning `Promise<T>` may instead
+  // be written as a coroutine, which `co_await`s other promises and `co_return`s its result:
+  //
+  //     Promise<uint> countLines(Own<File> file) {
+  //       String text = co_await file->readAll();
+  //       uint count = 0;
+  //       for (char c: text) count += (c == '\n');
+  //       co_return count;
+  //     }
+  //
+  // The coroutine runs immediately up to its first `co_await`, and resumes from the event loop.
+  // Its frame is the promise's only node, so however many steps it takes, it costs a single
+  // allocation, and state held in local variables is never copied or moved between steps.
+  // Exceptions thrown by the coroutine, or by a promise it awaits, break the returned promise as
+  // usual.  Destroying the returned promise cancels the coroutine by destroying its frame, along
+  // with whatever it was awaiting.  Only `Promise`s may be awaited.
+  //
   // Systems using promises should consider supporting the concept of "pipelining".  Pipelining
   // means allowing a caller to start issuing method calls against a promised object before the
   // promise has actually been fulfilled.  This is particularly useful if the promise is for a
@@ -286,6 +327,16 @@ public:
   // the error handler if you are sure that ignoring errors is fine, or if you know that you'll
   // eventually wait on the promise somewhere.
 
+  Promise<T> atPriority(EventPriority priority) KJ_WARN_UNUSED_RESULT;
+  // Returns a promise for the same result, except that once the result is ready, whatever is
+  // waiting on it (and, by default, the continuations that follow from that) is scheduled in the
+  // given lane of the event loop.  See `EventPriority`.
+  //
+  // For example, to keep health checks responsive while the loop is busy with bulk transfers:
+  //
+  //     return readRequest(stream).atPriority(EventPriority::HIGH)
+  //         .then([](Request request) { ... });
+
   template <typename ErrorFunc>
   void detach(ErrorFunc&& errorHandler);
   // Allows the promise to continue running in the background until it completes or the
@@ -316,8 +367,12 @@ private:
   friend PromiseFulfillerPair<U> newPromiseAndFulfiller();
   template <typename>
   friend class _::ForkHub;
+  template <typename>
+  friend class _::Coroutine;
+  friend class _::CoroutineBase;
   friend class TaskSet;
   friend Promise<void> _::yield();
+  friend Promise<void> _::yield(EventPriority priority);
   friend class _::NeverDone;
   template <typename U>
   friend Promise<Array<U>> joinPromises(Array<Promise<U>>&& promises);
@@ -371,6 +426,11 @@ PromiseForResult<Func, void> evalLater(Func&& func) KJ_WARN_UNUSED_RESULT;
 // If you schedule several evaluations with `evalLater` during the same callback, they are
 // guaranteed to be executed in order.
 
+template <typename Func>
+PromiseForResult<Func, void> evalLater(Func&& func, EventPriority priority) KJ_WARN_UNUSED_RESULT;
+// Like `evalLater(func)`, but schedules `func` in the given lane of the event loop, rather than in
+// the lane of the currently-running event.
+
 template <typename Func>
 PromiseForResult<Func, void> evalNow(Func&& func) KJ_WARN_UNUSED_RESULT;
 // Run `func()` and return a promise for its result. `func()` executes before `evalNow()` returns.
@@ -704,6 +764,207 @@ public:
   // The default implementation throws an UNIMPLEMENTED exception.
 };
 
+class EventLoopObserver {
+  // Receives measurements from an `EventLoop`, for finding out where its time goes and which
+  // callbacks stall it. Install one with `EventLoop::setObserver()`. All methods are called on the
+  // loop's thread, and the default implementations do nothing.
+  //
+  // While no observer is installed, the loop does not read the clock at all.
+
+public:
+  virtual ~EventLoopObserver() noexcept(false);
+
+  virtual void onTurn(Duration duration, size_t queueDepth);
+  // Called after every event the loop fires. `duration` is the time the event's callback took,
+  // and `queueDepth` is the number of events that were ready when it was dequeued (including
+  // itself). Note that a `then()` callback runs when its result is first needed, which is usually
+  // while firing whatever event waits on it, but for the promise passed to `wait()` is after the
+  // last turn.
+
+  virtual void onWait(Duration duration);
+  // Called after each time the loop blocked in `EventPort::wait()`, with the time spent there.
+
+  virtual void onSlowEvent(Duration duration, StringPtr trace);
+  // Called, in addition to `onTurn()`, when one event took longer than the threshold passed to
+  // `setObserver()`. `trace` names the event and the chain of promise nodes it was waiting on,
+  // as in `Promise::trace()`; for continuations, this includes the type name of the callback,
+  // which identifies the lambda and the function it was written in.
+};
+
+// =======================================================================================
+// Cross-thread execution
+
+namespace _ {  // private
+
+class XThreadWork {
+  // An item of work posted to an `Executor` from another thread. Not for direct use by
+  // applications.
+
+public:
+  virtual ~XThreadWork() noexcept(false);
+  virtual void run() = 0;
+
+private:
+  XThreadWork* next = nullptr;
+  friend class kj::Executor;
+};
+
+template <typename Func>
+class XThreadWorkImpl final: public XThreadWork {
+public:
+  template <typename F>
+  XThreadWorkImpl(F&& func): func(kj::fwd<F>(func)) {}
+  void run() override { func(); }
+
+private:
+  Func func;
+};
+
+class XThreadCall: public AtomicRefcounted {
+  // Shared state of one `Executor::executeAsync()` or `executeSync()` call. Both the calling thread
+  // and the executor's thread hold references. Not for direct use by applications.
+
+public:
+  ~XThreadCall() noexcept(false);
+
+  void start(const Executor& target);
+  // Queue the call on `target`. Called on the calling thread.
+
+  void cancel();
+  // Cancel the call. If it has already started, blocks until the executor's thread has destroyed
+  // the promise returned by the function, running work posted to the calling thread's own
+  // executor in the meantime. Called on the calling thread.
+
+  void runSync(const Executor& target);
+  // Queue the call on `target` and block until it has completed, or been abandoned by the target
+  // loop. For executeSync().
+
+protected:
+  explicit XThreadCall(Maybe<Own<const Executor>> replyTo);
+
+  virtual Promise<void> run() = 0;
+  // Called on the executor's thread to invoke the function. The returned promise resolves once
+  // the result has been stored in `getResult()`.
+
+  virtual ExceptionOrValue& getResult() = 0;
+
+  virtual void deliver() = 0;
+  // Called on the calling thread, via `replyTo`, once the call has completed.
+
+private:
+  enum class Status { QUEUED, RUNNING, DONE };
+  struct State {
+    Status status = Status::QUEUED;
+    bool canceled = false;
+  };
+  MutexGuarded<State> state;
+
+  Maybe<Own<const Executor>> replyTo;
+  // Executor of the calling thread, for executeAsync(). Null for executeSync().
+
+  Own<const Executor> target;
+
+  bool completed = false;
+  bool finished = false;
+  Promise<void> promise = nullptr;
+  Own<PromiseFulfiller<void>> doneFulfiller;
+  // Only touched by the executor's thread, while the call is running. The call's promise is held
+  // here rather than in the executor's task set, so that a cancellation can drop it immediately.
+
+  void begin();
+  void finish();
+  void waitDone();
+};
+
+}  // namespace _ (private)
+
+class Executor: public AtomicRefcounted {
+  // An object which allows work to be queued to a particular `EventLoop` from any thread. Use
+  // `getCurrentThreadExecutor()` to obtain the `Executor` for the current thread, then hand it to
+  // other threads.
+  //
+  // Posted work is pushed onto a lock-free multi-producer, single-consumer queue, and the target
+  // loop is woken via `EventPort::wake()` (so the loop's `EventPort` must implement `wake()`; the
+  // ones returned by `setupAsyncIo()` do). The loop drains the queue whenever it runs out of local
+  // events, so posting never requires a lock nor any allocation beyond the work item itself, and
+  // posting to a loop that already has work pending does not even make a syscall.
+  //
+  // All methods of `Executor` are thread-safe.
+
+public:
+  ~Executor() noexcept(false);
+  KJ_DISALLOW_COPY(Executor);
+
+  template <typename Func>
+  bool post(Func&& func) const;
+  // Arrange for `func()` to be invoked on the executor's thread, from within its event loop.
+  // Items posted by any one thread run in the order in which they were posted.
+  //
+  // Returns false if the executor's `EventLoop` has already been destroyed, in which case `func` is
+  // destroyed without being called. Otherwise, `func` is destroyed in the target thread. If the
+  // loop is destroyed before it gets around to running `func`, then `func` is destroyed (in the
+  // target thread) without being called.
+  //
+  // An exception thrown by `func()` is logged and otherwise ignored.
+
+  template <typename Func>
+  PromiseForResult<Func, void> executeAsync(Func&& func) const;
+  // Invoke `func()` on the executor's thread, from within its event loop, and return a promise on
+  // the calling thread's event loop for its result. If `func()` returns a promise, the executor's
+  // thread waits for it, and the returned promise resolves to its result. The calling thread must
+  // have an `EventLoop`.
+  //
+  // Canceling the returned promise cancels the call. If `func()` has already been invoked, the
+  // promise it returned is destroyed on the executor's thread, and the cancellation blocks until
+  // that has happened, so `func` may safely refer to objects owned by the caller. Hence, `func()`
+  // and whatever it returns must not block on the calling thread.
+  //
+  // Conversely, if the executor's `EventLoop` is destroyed before the call completes, the returned
+  // promise is rejected with a DISCONNECTED exception.
+  //
+  // When called on the executor's own thread, this is equivalent to `evalLater(func)`.
+
+  template <typename Func>
+  _::UnwrapPromise<PromiseForResult<Func, void>> executeSync(Func&& func) const;
+  // Invoke `func()` on the executor's thread and block the calling thread until it, and the
+  // promise it returns (if any), have completed. Returns the result, or rethrows the exception.
+  // The calling thread does not need an `EventLoop`, and if it has one, the loop does not run while
+  // blocked. Throws DISCONNECTED if the executor's `EventLoop` is destroyed before the call
+  // completes.
+  //
+  // Must not be called on the executor's own thread, as that would deadlock.
+
+  bool isLive() const;
+  // Returns true if the `EventLoop` still exists. Note that the answer may become false at any
+  // time if the loop's thread is concurrently shutting down.
+
+  Own<const Executor> addRef() const;
+
+private:
+  struct Impl;
+  Own<Impl> impl;
+
+  explicit Executor(EventLoop& loop);
+  bool postImpl(_::XThreadWork* work) const;
+
+  bool isCurrentThread() const;
+  // Returns true if called on the executor's own thread, while its loop is live.
+
+  bool poll();
+  // Called by the loop's own thread to run all queued work. Returns true if anything ran.
+
+  void shutdown();
+  // Called by the loop's own thread when the loop is being destroyed.
+
+  friend class EventLoop;
+  friend class _::XThreadCall;
+  template <typename T, typename... Params>
+  friend Own<T> atomicRefcounted(Params&&... params);
+};
+
+Own<const Executor> getCurrentThreadExecutor();
+// Get the `Executor` for the current thread's `EventLoop`. Throws if the thread has no loop.
+
 class EventLoop {
   // Represents a queue of events being executed in a loop.  Most code won't interact with
   // EventLoop directly, but instead use `Promise`s to interact with it indirectly.  See the
@@ -753,6 +1014,16 @@ public:
   bool isRunnable();
   // Returns true if run() would currently do anything, or false if the queue is empty.
 
+  static constexpr uint MAX_PASSED_OVER = 16;
+  // A lane with ready events gets at least one turn out of this many plus one.  See
+  // `EventPriority`.
+
+  void setObserver(EventLoopObserver& observer, Duration slowEventThreshold = 10 * MILLISECONDS);
+  void clearObserver();
+  // Install or remove an observer which is told how long each event and each wait took, and
+  // about any event slower than `slowEventThreshold`. The observer must outlive the loop, or be
+  // removed first.
+
 private:
   EventPort& port;
 
@@ -762,23 +1033,60 @@ private:
   bool lastRunnableState = false;
   // What did we last pass to port.setRunnable()?
 
-  _::Event* head = nullptr;
-  _::Event** tail = &head;
-  _::Event** depthFirstInsertPoint = &head;
+  struct Lane {
+    _::Event* head = nullptr;
+    _::Event** tail = &head;
+    _::Event** depthFirstInsertPoint = &head;
+
+    uint passedOver = 0;
+    // Consecutive turns for which this lane had events but a higher one was chosen.
+  };
+  static constexpr uint LANE_COUNT = 3;
+  Lane lanes[LANE_COUNT];
+  // Ready queue, one per EventPriority.
+
+  uint currentLane = uint(EventPriority::NORMAL);
+  // Lane of the event currently firing, in which newly-armed events are queued.
+
+  size_t queueDepth = 0;
+  // Number of events in all lanes.
+
+  EventLoopObserver* observer = nullptr;
+  Duration slowEventThreshold = 0 * SECONDS;
 
   Own<TaskSet> daemons;
 
+  Own<Executor> executor;
+  // Receives work queued from other threads.
+
+  static constexpr uint PROMISE_NODE_SIZE_CLASSES = 32;
+  void* freePromiseNodes[PROMISE_NODE_SIZE_CLASSES] = {};
+  uint freePromiseNodeCounts[PROMISE_NODE_SIZE_CLASSES] = {};
+  // Recycled promise node memory, as singly-linked lists by size in 16-byte steps.  See
+  // _::allocPromiseNode().
+
   bool turn();
+  void fireObserved(_::Event& event);
   void setRunnable(bool runnable);
   void enterScope();
   void leaveScope();
 
+  void wait();
+  void poll();
+  // Wait for, or check for, events from outside the thread, including work queued to the
+  // executor.
+
   friend void _::detach(kj::Promise<void>&& promise);
   friend void _::waitImpl(Own<_::PromiseNode>&& node, _::ExceptionOrValue& result,
                           WaitScope& waitScope);
   friend bool _::pollImpl(_::PromiseNode& node, WaitScope& waitScope);
+  friend void* _::allocPromiseNode(size_t size);
+  friend void _::freePromiseNode(void* pointer, size_t size) noexcept;
   friend class _::Event;
   friend class WaitScope;
+  friend class Executor;
+  friend class _::XThreadCall;
+  friend Own<const Executor> getCurrentThreadExecutor();
 };
 
 class WaitScope {
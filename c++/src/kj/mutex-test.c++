@@ -172,6 +172,73 @@ TEST(Mutex, When) {
 }
 #endif
 
+TEST(Mutex, ContendedStress) {
+  // Many threads hammering one lock, mixing shared and exclusive access, to exercise the spin and
+  // sleep paths against each other.
+  MutexGuarded<uint> value(0);
+
+  {
+    auto threads = kj::heapArrayBuilder<kj::Own<kj::Thread>>(4);
+    for (uint i = 0; i < 4; i++) {
+      threads.add(kj::heap<kj::Thread>([&value]() {
+        for (auto j: kj::zeroTo(10000)) {
+          if (j % 4 == 0) {
+            uint n = *value.lockShared();
+            KJ_ASSERT(n <= 30000);
+          } else {
+            ++*value.lockExclusive();
+          }
+        }
+      }));
+    }
+  }
+
+  KJ_EXPECT(*value.lockShared() == 30000);
+}
+
+TEST(Mutex, ContentionStats) {
+  MutexGuarded<uint> value(0);
+
+  // Disabled by default.
+  *value.lockExclusive() = 1;
+  KJ_EXPECT(value.getContentionStats().acquisitions == 0);
+
+  value.enableContentionStats();
+  value.enableContentionStats();  // no-op
+
+  *value.lockExclusive() = 2;
+  KJ_EXPECT(*value.lockShared() == 2);
+
+  {
+    auto stats = value.getContentionStats();
+    KJ_EXPECT(stats.acquisitions == 2);
+    KJ_EXPECT(stats.contendedAcquisitions == 0);
+    KJ_EXPECT(stats.totalWaitNanos == 0);
+  }
+
+  {
+    auto lock = value.lockExclusive();
+
+    kj::Thread thread([&]() {
+      *value.lockExclusive() = 3;
+    });
+
+    // Hold the lock long enough that the thread has to go to sleep.
+    delay();
+    auto earlyRelease = kj::mv(lock);
+  }
+
+  KJ_EXPECT(*value.lockShared() == 3);
+
+  auto stats = value.getContentionStats();
+  KJ_EXPECT(stats.acquisitions == 5);
+  KJ_EXPECT(stats.maxHoldNanos >= 5000000, stats.maxHoldNanos);  // delay() is 10ms
+#if !_WIN32  // Contention isn't detected on win32.
+  KJ_EXPECT(stats.contendedAcquisitions == 1);
+  KJ_EXPECT(stats.totalWaitNanos > 0);
+#endif
+}
+
 TEST(Mutex, Lazy) {
   Lazy<uint> lazy;
   volatile bool initStarted = false;
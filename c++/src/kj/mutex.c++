@@ -27,6 +27,8 @@
 
 #include "mutex.h"
 #include "debug.h"
+#include "time.h"
+#include <atomic>
 
 #if KJ_USE_FUTEX
 #include <unistd.h>
@@ -52,23 +54,190 @@
 namespace kj {
 namespace _ {  // private
 
+// =======================================================================================
+// Contention statistics (all platforms)
+
+struct Mutex::Stats {
+  // Fields are atomic since getContentionStats() may read them from any thread at any time. All
+  // accesses are relaxed; the counters are independent of each other.
+
+  std::atomic<uint64_t> acquisitions { 0 };
+  std::atomic<uint64_t> contendedAcquisitions { 0 };
+  std::atomic<uint64_t> totalWaitNs { 0 };
+  std::atomic<uint64_t> maxHoldNs { 0 };
+
+  std::atomic<uint64_t> lockedAt { 0 };
+  // Time at which the current exclusive holder acquired the lock, or zero if it acquired the lock
+  // before stats were enabled.
+};
+
+static uint64_t monotonicNanos() {
+  return (systemPreciseMonotonicClock().now() - origin<TimePoint>()) / NANOSECONDS;
+}
+
+template <typename T>
+static T* loadAcquire(T* const& pointer) {
+#if _MSC_VER
+  return reinterpret_cast<T*>(InterlockedCompareExchangePointer(
+      const_cast<void* volatile*>(reinterpret_cast<void* const volatile*>(&pointer)),
+      nullptr, nullptr));
+#else
+  return __atomic_load_n(&pointer, __ATOMIC_ACQUIRE);
+#endif
+}
+
+#if _MSC_VER
+bool Mutex::statsEnabled() {
+  return loadAcquire(stats) != nullptr;
+}
+#endif
+
+void Mutex::enableContentionStats() {
+  if (statsEnabled()) return;
+
+  Stats* newStats = new Stats;
+#if _MSC_VER
+  bool installed = InterlockedCompareExchangePointer(
+      reinterpret_cast<void* volatile*>(&stats), newStats, nullptr) == nullptr;
+#else
+  Stats* expected = nullptr;
+  bool installed = __atomic_compare_exchange_n(&stats, &expected, newStats, false,
+                                               __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+#endif
+  if (!installed) {
+    // Another thread enabled stats concurrently.
+    delete newStats;
+  }
+}
+
+MutexContentionStats Mutex::getContentionStats() {
+  MutexContentionStats result;
+  Stats* s = loadAcquire(stats);
+  if (s != nullptr) {
+    result.acquisitions = s->acquisitions.load(std::memory_order_relaxed);
+    result.contendedAcquisitions = s->contendedAcquisitions.load(std::memory_order_relaxed);
+    result.totalWaitNanos = s->totalWaitNs.load(std::memory_order_relaxed);
+    result.maxHoldNanos = s->maxHoldNs.load(std::memory_order_relaxed);
+  }
+  return result;
+}
+
+void Mutex::recordAcquire(Exclusivity exclusivity, uint64_t waitStart) {
+  Stats& s = *loadAcquire(stats);
+  s.acquisitions.fetch_add(1, std::memory_order_relaxed);
+
+  uint64_t now = 0;
+  if (waitStart != 0) {
+    now = monotonicNanos();
+    s.contendedAcquisitions.fetch_add(1, std::memory_order_relaxed);
+    s.totalWaitNs.fetch_add(now - waitStart, std::memory_order_relaxed);
+  }
+
+  if (exclusivity == EXCLUSIVE) {
+    // We hold the lock exclusively, so no one else is touching `lockedAt`.
+    s.lockedAt.store(now != 0 ? now : monotonicNanos(), std::memory_order_relaxed);
+  }
+}
+
+void Mutex::recordRelease() {
+  Stats& s = *loadAcquire(stats);
+  uint64_t lockedAt = s.lockedAt.exchange(0, std::memory_order_relaxed);
+  if (lockedAt == 0) return;
+
+  uint64_t held = monotonicNanos() - lockedAt;
+  uint64_t max = s.maxHoldNs.load(std::memory_order_relaxed);
+  while (held > max && !s.maxHoldNs.compare_exchange_weak(max, held, std::memory_order_relaxed)) {}
+}
+
 #if KJ_USE_FUTEX
 // =======================================================================================
 // Futex-based implementation (Linux-only)
 
 Mutex::Mutex(): futex(0) {}
 Mutex::~Mutex() {
+  delete stats;
+
   // This will crash anyway, might as well crash with a nice error message.
   KJ_ASSERT(futex == 0, "Mutex destroyed while locked.") { break; }
 }
 
+static constexpr uint MIN_SPINS = 16;
+static constexpr uint MAX_SPINS = 256;
+// Bounds on the number of pause iterations a contended lock() spins before sleeping. At roughly
+// 10-150 cycles per pause depending on the CPU, MAX_SPINS is on the order of the cost of a
+// FUTEX_WAIT / FUTEX_WAKE round trip.
+
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield" ::: "memory");
+#else
+  __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+static bool spinningUseful() {
+  // With only one CPU, the lock holder can't make progress while we spin, so go straight to
+  // sleep.
+  static const bool result = sysconf(_SC_NPROCESSORS_ONLN) > 1;
+  return result;
+}
+
+template <typename TryAcquire>
+bool Mutex::spin(TryAcquire&& tryAcquire) {
+  // Spins calling tryAcquire() until it returns true, or until the spin limit runs out, in which
+  // case returns false and the caller should sleep.
+  //
+  // The limit adapts the same way glibc's PTHREAD_MUTEX_ADAPTIVE_NP does: it is twice the
+  // running average of iterations that recently sufficed, plus a floor. Unlike glibc, a spin
+  // that runs out halves the average, so a mutex whose holders keep it for a long time quickly
+  // stops burning CPU before sleeping.
+
+  if (!spinningUseful()) return false;
+
+  uint estimate = __atomic_load_n(&spinEstimate, __ATOMIC_RELAXED);
+  uint limit = kj::min(estimate * 2 + MIN_SPINS, MAX_SPINS);
+  for (uint i = 0; i < limit; i++) {
+    cpuRelax();
+    if (tryAcquire()) {
+      __atomic_store_n(&spinEstimate, uint(int(estimate) + (int(i) - int(estimate)) / 8),
+                       __ATOMIC_RELAXED);
+      return true;
+    }
+  }
+
+  __atomic_store_n(&spinEstimate, estimate / 2, __ATOMIC_RELAXED);
+  return false;
+}
+
 void Mutex::lock(Exclusivity exclusivity) {
   switch (exclusivity) {
-    case EXCLUSIVE:
-      for (;;) {
-        uint state = 0;
-        if (KJ_LIKELY(__atomic_compare_exchange_n(&futex, &state, EXCLUSIVE_HELD, false,
-                                                  __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))) {
+    case EXCLUSIVE: {
+      uint state = 0;
+      if (KJ_LIKELY(__atomic_compare_exchange_n(&futex, &state, EXCLUSIVE_HELD, false,
+                                                __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))) {
+        // Acquired without contention.
+        if (KJ_UNLIKELY(statsEnabled())) recordAcquire(EXCLUSIVE, 0);
+        break;
+      }
+
+      uint64_t waitStart = KJ_UNLIKELY(statsEnabled()) ? monotonicNanos() : 0;
+
+      // The holder will likely release the lock soon, so spin for a bit before going to sleep.
+      // We only attempt the CAS when the mutex looks free, to avoid bouncing its cache line
+      // between cores.
+      bool acquired = spin([&]() {
+        uint expected = 0;
+        return __atomic_load_n(&futex, __ATOMIC_RELAXED) == 0 &&
+            __atomic_compare_exchange_n(&futex, &expected, EXCLUSIVE_HELD, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+      });
+
+      while (!acquired) {
+        state = 0;
+        if (__atomic_compare_exchange_n(&futex, &state, EXCLUSIVE_HELD, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
           // Acquired.
           break;
         }
@@ -86,20 +255,33 @@ void Mutex::lock(Exclusivity exclusivity) {
 
         syscall(SYS_futex, &futex, FUTEX_WAIT_PRIVATE, state, NULL, NULL, 0);
       }
+
+      if (waitStart != 0) recordAcquire(EXCLUSIVE, waitStart);
       break;
+    }
     case SHARED: {
       uint state = __atomic_add_fetch(&futex, 1, __ATOMIC_ACQUIRE);
-      for (;;) {
-        if (KJ_LIKELY((state & EXCLUSIVE_HELD) == 0)) {
-          // Acquired.
-          break;
-        }
+      if (KJ_LIKELY((state & EXCLUSIVE_HELD) == 0)) {
+        // Acquired without contention.
+        if (KJ_UNLIKELY(statsEnabled())) recordAcquire(SHARED, 0);
+        break;
+      }
+
+      uint64_t waitStart = KJ_UNLIKELY(statsEnabled()) ? monotonicNanos() : 0;
+
+      // The mutex is exclusively locked by another thread.  Since we incremented the counter
+      // already, we just have to wait for it to be unlocked.  As above, spin for a bit first.
+      bool acquired = spin([&]() {
+        state = __atomic_load_n(&futex, __ATOMIC_ACQUIRE);
+        return (state & EXCLUSIVE_HELD) == 0;
+      });
 
-        // The mutex is exclusively locked by another thread.  Since we incremented the counter
-        // already, we just have to wait for it to be unlocked.
+      while (!acquired && (state & EXCLUSIVE_HELD) != 0) {
         syscall(SYS_futex, &futex, FUTEX_WAIT_PRIVATE, state, NULL, NULL, 0);
         state = __atomic_load_n(&futex, __ATOMIC_ACQUIRE);
       }
+
+      if (waitStart != 0) recordAcquire(SHARED, waitStart);
       break;
     }
   }
@@ -117,6 +299,8 @@ void Mutex::unlock(Exclusivity exclusivity) {
     case EXCLUSIVE: {
       KJ_DASSERT(futex & EXCLUSIVE_HELD, "Unlocked a mutex that wasn't locked.");
 
+      if (KJ_UNLIKELY(statsEnabled())) recordRelease();
+
       // First check if there are any conditional waiters. Note we only do this when unlocking an
       // exclusive lock since under a shared lock the state couldn't have changed.
       auto nextWaiter = waitersHead;
@@ -205,6 +389,7 @@ void Mutex::lockWhen(Predicate& predicate) {
 
   if (!predicate.check()) {
     unlock(EXCLUSIVE);
+    uint64_t waitStart = KJ_UNLIKELY(statsEnabled()) ? monotonicNanos() : 0;
 
     // Wait for someone to set out futex to 1.
     while (__atomic_load_n(&waiter.futex, __ATOMIC_ACQUIRE) == 0) {
@@ -215,6 +400,7 @@ void Mutex::lockWhen(Predicate& predicate) {
 #ifdef KJ_DEBUG
     assertLockedByCaller(EXCLUSIVE);
 #endif
+    if (waitStart != 0) recordAcquire(EXCLUSIVE, waitStart);
   }
 }
 
@@ -288,7 +474,9 @@ Mutex::Mutex() {
   static_assert(sizeof(SRWLOCK) == sizeof(srwLock), "SRWLOCK is not a pointer?");
   InitializeSRWLock(&coercedSrwLock);
 }
-Mutex::~Mutex() {}
+Mutex::~Mutex() {
+  delete stats;
+}
 
 void Mutex::lock(Exclusivity exclusivity) {
   switch (exclusivity) {
@@ -299,11 +487,17 @@ void Mutex::lock(Exclusivity exclusivity) {
       AcquireSRWLockShared(&coercedSrwLock);
       break;
   }
+
+  // TryAcquireSRWLock*() would tell us whether the lock is contended, but it requires Windows 7
+  // and isn't implemented by older Wine (see assertLockedByCaller()), so we only count
+  // acquisitions and hold times here.
+  if (KJ_UNLIKELY(statsEnabled())) recordAcquire(exclusivity, 0);
 }
 
 void Mutex::unlock(Exclusivity exclusivity) {
   switch (exclusivity) {
     case EXCLUSIVE:
+      if (KJ_UNLIKELY(statsEnabled())) recordRelease();
       ReleaseSRWLockExclusive(&coercedSrwLock);
       break;
     case SHARED:
@@ -381,10 +575,23 @@ Mutex::Mutex() {
   KJ_PTHREAD_CALL(pthread_rwlock_init(&mutex, nullptr));
 }
 Mutex::~Mutex() {
+  delete stats;
   KJ_PTHREAD_CLEANUP(pthread_rwlock_destroy(&mutex));
 }
 
 void Mutex::lock(Exclusivity exclusivity) {
+  uint64_t waitStart = 0;
+  if (KJ_UNLIKELY(statsEnabled())) {
+    // Try without blocking first so that we can tell whether the lock is contended.
+    int error = exclusivity == EXCLUSIVE ? pthread_rwlock_trywrlock(&mutex)
+                                         : pthread_rwlock_tryrdlock(&mutex);
+    if (error == 0) {
+      recordAcquire(exclusivity, 0);
+      return;
+    }
+    waitStart = monotonicNanos();
+  }
+
   switch (exclusivity) {
     case EXCLUSIVE:
       KJ_PTHREAD_CALL(pthread_rwlock_wrlock(&mutex));
@@ -393,9 +600,12 @@ void Mutex::lock(Exclusivity exclusivity) {
       KJ_PTHREAD_CALL(pthread_rwlock_rdlock(&mutex));
       break;
   }
+
+  if (waitStart != 0) recordAcquire(exclusivity, waitStart);
 }
 
 void Mutex::unlock(Exclusivity exclusivity) {
+  if (exclusivity == EXCLUSIVE && KJ_UNLIKELY(statsEnabled())) recordRelease();
   KJ_PTHREAD_CALL(pthread_rwlock_unlock(&mutex));
 }
 
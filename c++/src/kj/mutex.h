@@ -40,6 +40,24 @@
 
 namespace kj {
 
+struct MutexContentionStats {
+  // Lock statistics for a single `MutexGuarded`. See `MutexGuarded::enableContentionStats()`.
+
+  uint64_t acquisitions = 0;
+  // Total number of times the lock was acquired, shared or exclusive.
+
+  uint64_t contendedAcquisitions = 0;
+  // Number of acquisitions that could not take the lock immediately, whether they ended up
+  // spinning or sleeping.
+
+  uint64_t totalWaitNanos = 0;
+  // Sum of the time spent waiting by all contended acquisitions, in nanoseconds.
+
+  uint64_t maxHoldNanos = 0;
+  // Longest time any exclusive lock was held, in nanoseconds. Shared locks may overlap each
+  // other, so their hold times are not tracked.
+};
+
 // =======================================================================================
 // Private details -- public interfaces follow below.
 
@@ -66,6 +84,9 @@ public:
   // non-trivial, assert that the mutex is locked (which should be good enough to catch problems
   // in unit tests).  In non-debug builds, do nothing.
 
+  void enableContentionStats();
+  MutexContentionStats getContentionStats();
+
 #if KJ_USE_FUTEX    // TODO(soon): Implement on pthread & win32
   class Predicate {
   public:
@@ -77,6 +98,23 @@ public:
 #endif
 
 private:
+  struct Stats;
+  Stats* stats = nullptr;
+  // Allocated by enableContentionStats(), null otherwise. Only ever transitions from null to
+  // non-null. lock() and unlock() check it with an acquire load, which on x86 compiles to a plain
+  // load, so that a non-null pointer is also guaranteed to point at initialized counters.
+
+#if _MSC_VER
+  bool statsEnabled();
+#else
+  inline bool statsEnabled() { return __atomic_load_n(&stats, __ATOMIC_ACQUIRE) != nullptr; }
+#endif
+  void recordAcquire(Exclusivity exclusivity, uint64_t waitStart);
+  void recordRelease();
+  // Update `stats`, which must be non-null. `waitStart` is the time at which a contended acquire
+  // started waiting, or zero if the lock was taken immediately. recordRelease() is only called
+  // for exclusive locks.
+
 #if KJ_USE_FUTEX
   uint futex;
   // bit 31 (msb) = set if exclusive lock held
@@ -89,6 +127,15 @@ private:
   static constexpr uint EXCLUSIVE_REQUESTED = 1u << 30;
   static constexpr uint SHARED_COUNT_MASK = EXCLUSIVE_REQUESTED - 1;
 
+  uint spinEstimate = 0;
+  // Running average of the number of spin iterations it took contended lock() calls to acquire
+  // the lock without sleeping. Bounds how long the next contended lock() spins before it falls
+  // back to FUTEX_WAIT. Read and written with relaxed atomics; it is only a heuristic. On 64-bit
+  // platforms it occupies what would otherwise be padding after `futex`.
+
+  template <typename TryAcquire>
+  bool spin(TryAcquire&& tryAcquire);
+
   struct Waiter;
   kj::Maybe<Waiter&> waitersHead = nullptr;
   kj::Maybe<Waiter&>* waitersTail = &waitersHead;
@@ -263,6 +310,20 @@ public:
   inline T& getAlreadyLockedExclusive() const;
   // Like `getWithoutLock()`, but asserts that the lock is already held by the calling thread.
 
+  inline void enableContentionStats() const { mutex.enableContentionStats(); }
+  // Start collecting contention statistics for this mutex. Statistics are off by default; while
+  // off, the only cost to lock and unlock is checking a pointer. Once on, every acquisition and
+  // every exclusive release reads the monotonic clock. Calling this again has no effect.
+  //
+  // Useful for finding out which of a program's mutexes are hot: enable it on suspects, run a
+  // load, and log getContentionStats().
+
+  inline MutexContentionStats getContentionStats() const { return mutex.getContentionStats(); }
+  // Returns a snapshot of the statistics collected since enableContentionStats() was called, or
+  // all zeros if it wasn't. May be called from any thread, whether or not the lock is held; the
+  // counters are read individually, so a snapshot taken under contention may be slightly
+  // inconsistent.
+
 #if KJ_USE_FUTEX    // TODO(soon): Implement on pthread & win32
   template <typename Cond, typename Func>
   auto when(Cond&& condition, Func&& callback) const -> decltype(callback(instance<T&>())) {
@@ -0,0 +1,178 @@
+// Copyright (c) 2018 Kenton Varda and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "thread-pool.h"
+#include "async-io.h"
+#include "debug.h"
+#include <kj/compat/gtest.h>
+
+namespace kj {
+namespace {
+
+KJ_TEST("ThreadPool run") {
+  auto io = setupAsyncIo();
+  ThreadPool pool(2);
+  KJ_EXPECT(pool.getThreadCount() == 2);
+
+  KJ_EXPECT(pool.run([]() { return 123; }).wait(io.waitScope) == 123);
+  KJ_EXPECT(pool.run([]() { return heapString("foo"); }).wait(io.waitScope) == "foo");
+
+  uint count = 0;
+  pool.run([&count]() { ++count; }).wait(io.waitScope);
+  KJ_EXPECT(count == 1);
+
+  KJ_EXPECT_THROW_MESSAGE("bar", pool.run([]() -> int {
+    KJ_FAIL_ASSERT("bar");
+  }).wait(io.waitScope));
+
+  // Many at once.
+  auto promises = heapArrayBuilder<Promise<uint>>(100);
+  for (uint i = 0; i < 100; i++) {
+    promises.add(pool.run([i]() { return i * i; }));
+  }
+  auto results = joinPromises(promises.finish()).wait(io.waitScope);
+  for (uint i = 0; i < 100; i++) {
+    KJ_EXPECT(results[i] == i * i);
+  }
+}
+
+KJ_TEST("ThreadPool cancel") {
+  auto io = setupAsyncIo();
+  ThreadPool pool(1);
+
+  MutexGuarded<bool> release(false);
+  MutexGuarded<bool> started(false);
+  auto blocker = pool.run([&]() {
+    *started.lockExclusive() = true;
+    release.when([](bool b) { return b; }, [](bool&) {});
+  });
+  started.when([](bool b) { return b; }, [](bool&) {});
+
+  bool ran = false;
+  {
+    // Queued behind the blocker, then canceled.
+    auto promise = pool.run([&ran]() { ran = true; });
+  }
+
+  *release.lockExclusive() = true;
+  blocker.wait(io.waitScope);
+  pool.run([]() {}).wait(io.waitScope);
+  KJ_EXPECT(!ran);
+
+  // Canceling a running task waits for it to finish.
+  *release.lockExclusive() = false;
+  *started.lockExclusive() = false;
+  bool finished = false;
+  {
+    auto promise = pool.run([&]() {
+      *started.lockExclusive() = true;
+      release.when([](bool b) { return b; }, [](bool&) {});
+      finished = true;
+    });
+    started.when([](bool b) { return b; }, [](bool&) {});
+    Thread thread([&]() {
+      *release.lockExclusive() = true;
+    });
+  }
+  KJ_EXPECT(finished);
+}
+
+KJ_TEST("ThreadPool work stealing") {
+  auto io = setupAsyncIo();
+  ThreadPool pool(2);
+
+  MutexGuarded<bool> release(false);
+  MutexGuarded<bool> started(false);
+
+  // Tasks are handed out round-robin, so the blocker and `stolen` land on the same worker. The
+  // other worker has to steal `stolen` for it to complete while the blocker is still running.
+  auto blocker = pool.run([&]() {
+    *started.lockExclusive() = true;
+    release.when([](bool b) { return b; }, [](bool&) {});
+  });
+  started.when([](bool b) { return b; }, [](bool&) {});
+  auto other = pool.run([]() { return 1; });
+  auto stolen = pool.run([]() { return 2; });
+
+  KJ_EXPECT(other.wait(io.waitScope) == 1);
+  KJ_EXPECT(stolen.wait(io.waitScope) == 2);
+
+  *release.lockExclusive() = true;
+  blocker.wait(io.waitScope);
+}
+
+KJ_TEST("ThreadPool parallelFor") {
+  auto io = setupAsyncIo();
+  ThreadPool pool(4);
+
+  auto array = heapArray<uint>(1000);
+  for (uint i = 0; i < array.size(); i++) array[i] = i;
+
+  pool.parallelFor(array.asPtr(), [](uint& value) { value *= 2; }).wait(io.waitScope);
+  for (uint i = 0; i < array.size(); i++) {
+    KJ_EXPECT(array[i] == i * 2);
+  }
+
+  pool.parallelFor(array.asPtr(), [](uint& value) { ++value; }, 7).wait(io.waitScope);
+  for (uint i = 0; i < array.size(); i++) {
+    KJ_EXPECT(array[i] == i * 2 + 1);
+  }
+
+  pool.parallelFor(array.slice(0, 0), [](uint& value) { value = 0; }).wait(io.waitScope);
+
+  KJ_EXPECT_THROW_MESSAGE("odd", pool.parallelFor(array.asPtr(), [](uint& value) {
+    KJ_ASSERT(value % 2 == 0, "odd");
+  }).wait(io.waitScope));
+}
+
+KJ_TEST("ThreadPool parallelReduce") {
+  auto io = setupAsyncIo();
+  ThreadPool pool(4);
+
+  auto array = heapArray<uint64_t>(10000);
+  for (uint i = 0; i < array.size(); i++) array[i] = i;
+
+  auto sum = pool.parallelReduce(array.asPtr(), uint64_t(0),
+      [](uint64_t value) { return value; },
+      [](uint64_t a, uint64_t b) { return a + b; }).wait(io.waitScope);
+  KJ_EXPECT(sum == 10000ull * 9999 / 2);
+
+  auto empty = pool.parallelReduce(array.slice(0, 0), uint64_t(5),
+      [](uint64_t value) { return value; },
+      [](uint64_t a, uint64_t b) { return a + b; }).wait(io.waitScope);
+  KJ_EXPECT(empty == 5);
+
+  // Chunk results are combined in order, so a non-commutative combine works.
+  struct Digits {
+    uint64_t value;
+    uint64_t scale;
+  };
+  auto digits = heapArray<uint>(9);
+  for (uint i = 0; i < digits.size(); i++) digits[i] = i + 1;
+  auto number = pool.parallelReduce(digits.asPtr(), Digits { 0, 1 },
+      [](uint digit) { return Digits { digit, 10 }; },
+      [](Digits a, Digits b) { return Digits { a.value * b.scale + b.value, a.scale * b.scale }; },
+      2).wait(io.waitScope);
+  KJ_EXPECT(number.value == 123456789);
+}
+
+}  // namespace
+}  // namespace kj
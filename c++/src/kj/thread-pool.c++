@@ -0,0 +1,187 @@
+// Copyright (c) 2018 Kenton Varda and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "thread-pool.h"
+#include "thread.h"
+#include "debug.h"
+#include <atomic>
+#include <deque>
+#include <thread>
+
+namespace kj {
+
+namespace _ {  // private
+
+ThreadPoolTask::ThreadPoolTask(Own<const Executor> replyTo)
+    : status(Status::QUEUED), replyTo(kj::mv(replyTo)) {}
+ThreadPoolTask::~ThreadPoolTask() noexcept(false) {}
+
+void ThreadPoolTask::execute() {
+  {
+    auto lock = status.lockExclusive();
+    if (*lock == Status::CANCELED) return;
+    *lock = Status::RUNNING;
+  }
+
+  run();
+
+  bool canceled;
+  {
+    auto lock = status.lockExclusive();
+    canceled = *lock == Status::CANCELED;
+    *lock = Status::DONE;
+  }
+
+  if (!canceled) {
+    // If the caller's loop is gone, its promise is gone too, so there's no one to tell.
+    replyTo->post([self = atomicAddRef(*this)]() mutable { self->deliver(); });
+  }
+}
+
+void ThreadPoolTask::cancel() {
+  Status previous;
+  {
+    auto lock = status.lockExclusive();
+    previous = *lock;
+    if (previous != Status::DONE) *lock = Status::CANCELED;
+  }
+
+  if (previous == Status::RUNNING) {
+    // `func` may refer to objects that the caller is about to destroy, so wait for it.
+    status.when([](Status s) { return s == Status::DONE; }, [](Status&) {});
+  }
+}
+
+}  // namespace _ (private)
+
+struct ThreadPool::Impl {
+  struct Worker {
+    MutexGuarded<std::deque<Own<_::ThreadPoolTask>>> queue;
+    Maybe<Own<Thread>> thread;
+  };
+  Array<Worker> workers;
+
+  mutable std::atomic<uint> nextWorker { 0 };
+  // Round-robin index for submit().
+
+  mutable std::atomic<size_t> pending { 0 };
+  // Number of tasks sitting in queues. Lets idle workers decide to sleep without scanning.
+
+  mutable std::atomic<uint> sleepers { 0 };
+  // Number of workers in (or about to enter) sleep(). Lets submit() skip the lock when all
+  // workers are busy.
+
+  MutexGuarded<bool> shuttingDown;
+  // Idle workers wait on this, with a condition that also checks `pending`. Locking it is thus
+  // enough to make them re-check.
+
+  explicit Impl(uint threadCount)
+      : workers(heapArray<Worker>(threadCount)), shuttingDown(false) {}
+
+  Maybe<Own<_::ThreadPoolTask>> take(uint index) {
+    {
+      auto lock = workers[index].queue.lockExclusive();
+      if (!lock->empty()) {
+        auto task = kj::mv(lock->front());
+        lock->pop_front();
+        pending.fetch_sub(1);
+        return kj::mv(task);
+      }
+    }
+
+    for (uint i = 1; i < workers.size(); i++) {
+      auto lock = workers[(index + i) % workers.size()].queue.lockExclusive();
+      if (!lock->empty()) {
+        auto task = kj::mv(lock->back());
+        lock->pop_back();
+        pending.fetch_sub(1);
+        return kj::mv(task);
+      }
+    }
+
+    return nullptr;
+  }
+
+  bool sleep() {
+    // Wait until there may be work or the pool is shutting down. Returns false if it is shutting
+    // down and there's no work left.
+
+    // The sequentially-consistent increment here, paired with the one of `pending` in submit(),
+    // ensures that either we see the new task below or submit() sees us and wakes us.
+    sleepers.fetch_add(1);
+    KJ_DEFER(sleepers.fetch_sub(1));
+    return shuttingDown.when([this](bool s) { return s || pending.load() > 0; },
+                             [this](bool&) { return pending.load() > 0; });
+  }
+
+  void workerLoop(uint index) {
+    for (;;) {
+      KJ_IF_MAYBE(task, take(index)) {
+        (*task)->execute();
+      } else if (!sleep()) {
+        return;
+      }
+    }
+  }
+};
+
+ThreadPool::ThreadPool(uint threadCount) {
+  if (threadCount == 0) {
+    threadCount = kj::max(std::thread::hardware_concurrency(), 1u);
+  }
+
+  impl = heap<Impl>(threadCount);
+  KJ_ON_SCOPE_FAILURE(*impl->shuttingDown.lockExclusive() = true);
+  for (uint i = 0; i < threadCount; i++) {
+    impl->workers[i].thread = heap<Thread>([this, i]() { impl->workerLoop(i); });
+  }
+}
+
+ThreadPool::~ThreadPool() noexcept(false) {
+  *impl->shuttingDown.lockExclusive() = true;
+
+  for (auto& worker: impl->workers) {
+    worker.thread = nullptr;
+  }
+}
+
+uint ThreadPool::getThreadCount() const {
+  return impl->workers.size();
+}
+
+void ThreadPool::submit(Own<_::ThreadPoolTask> task) const {
+  auto& worker = impl->workers[impl->nextWorker.fetch_add(1, std::memory_order_relaxed) %
+                               impl->workers.size()];
+  worker.queue.lockExclusive()->push_back(kj::mv(task));
+
+  impl->pending.fetch_add(1);
+  if (impl->sleepers.load() > 0) {
+    // Unlocking re-evaluates the sleepers' conditions.
+    impl->shuttingDown.lockExclusive();
+  }
+}
+
+size_t ThreadPool::defaultGrainSize(size_t size) const {
+  // A few chunks per worker lets the faster ones steal work from the slower.
+  return kj::max((size + impl->workers.size() * 4 - 1) / (impl->workers.size() * 4), size_t(1));
+}
+
+}  // namespace kj
@@ -0,0 +1,279 @@
+// Copyright (c) 2018 Kenton Varda and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#if defined(__GNUC__) && !KJ_HEADER_WARNINGS
+#pragma GCC system_header
+#endif
+
+#include "async.h"
+#include "mutex.h"
+
+namespace kj {
+
+class ThreadPool;
+
+namespace _ {  // private
+
+class ThreadPoolTask: public AtomicRefcounted {
+  // Shared state of one `ThreadPool::run()` call. Both the calling thread and the worker hold
+  // references. Not for direct use by applications.
+
+public:
+  ~ThreadPoolTask() noexcept(false);
+
+  void cancel();
+  // Cancel the task. If a worker has already started it, blocks until it has finished. Called on
+  // the calling thread.
+
+protected:
+  explicit ThreadPoolTask(Own<const Executor> replyTo);
+
+  virtual void run() = 0;
+  // Called on a worker thread to invoke the function and store its result. Must not throw.
+
+  virtual void deliver() = 0;
+  // Called on the calling thread, via `replyTo`, once the task has run.
+
+private:
+  enum class Status { QUEUED, RUNNING, DONE, CANCELED };
+  MutexGuarded<Status> status;
+
+  Own<const Executor> replyTo;
+
+  void execute();
+  // Called by a worker which has taken the task from a queue.
+
+  friend class kj::ThreadPool;
+};
+
+template <typename Func>
+class ThreadPoolTaskImpl;
+template <typename Task>
+class ThreadPoolTaskAdapter;
+
+}  // namespace _ (private)
+
+class ThreadPool {
+  // A fixed set of worker threads for running blocking or CPU-bound functions off of the event
+  // loop thread, e.g.:
+  //
+  //     kj::ThreadPool pool;
+  //     kj::Promise<String> hash = pool.run([&data]() { return sha256(data); });
+  //
+  // Each worker has its own deque of tasks. Tasks submitted from outside are spread over the
+  // workers round-robin; a worker takes tasks from the front of its own deque and, when that is
+  // empty, steals from the back of the others' before going to sleep. So a long-running task
+  // delays only the tasks queued behind it until some other worker goes idle, and workers never
+  // all contend on one queue.
+  //
+  // All methods of `ThreadPool` are thread-safe, but those returning promises must be called on a
+  // thread with an `EventLoop`, whose `EventPort` implements `wake()`. Results are delivered
+  // back to that loop through its `Executor`.
+
+public:
+  explicit ThreadPool(uint threadCount = 0);
+  // Starts `threadCount` workers, or one per hardware thread if zero.
+
+  ~ThreadPool() noexcept(false);
+  // Runs any tasks still queued (including those whose promises have already been destroyed,
+  // which are skipped), then joins all workers.
+
+  KJ_DISALLOW_COPY(ThreadPool);
+
+  uint getThreadCount() const;
+
+  template <typename Func>
+  Promise<_::ReturnType<Func, void>> run(Func&& func) const;
+  // Invoke `func()` on some worker, and return a promise on the calling thread's event loop for
+  // its result. `func()` runs on a plain thread with no `EventLoop`, so it may block but may not
+  // use promises; in particular, it must not return one. An exception thrown by `func()` rejects
+  // the returned promise.
+  //
+  // Canceling the returned promise removes the task if no worker has picked it up yet. Otherwise,
+  // the cancellation blocks until `func()` returns, so `func` may safely refer to objects owned by
+  // the caller.
+
+  template <typename T, typename Func>
+  Promise<void> parallelFor(ArrayPtr<T> array, Func&& func, size_t grainSize = 0) const;
+  // Call `func(element)` for each element of `array`, spread over the workers, and return a
+  // promise which resolves when all calls have returned. The array is split into chunks of
+  // `grainSize` elements (by default, enough to give each worker a few chunks), and each chunk is
+  // one task, so `func` may be called concurrently from several threads. The first exception
+  // thrown rejects the promise.
+  //
+  // As with `run()`, canceling the promise waits for chunks already in progress, so `array` and
+  // `func` only need to outlive the promise.
+
+  template <typename T, typename R, typename Map, typename Combine>
+  Promise<R> parallelReduce(ArrayPtr<T> array, R identity, Map&& map, Combine&& combine,
+                            size_t grainSize = 0) const;
+  // Compute `combine(...combine(combine(identity, map(array[0])), map(array[1]))...,
+  // map(array[n-1]))`, with the elements split into chunks as for `parallelFor()`. Each chunk is
+  // folded on a worker starting from a copy of `identity`, and the chunk results are then folded
+  // in order on the calling thread. Hence `combine` must be associative, and `identity` must be
+  // an identity for it, but `combine` need not be commutative. `R` must be copyable. `map` and
+  // `combine` may be called concurrently from several threads.
+
+private:
+  struct Impl;
+  Own<Impl> impl;
+
+  void submit(Own<_::ThreadPoolTask> task) const;
+
+  size_t defaultGrainSize(size_t size) const;
+
+  template <typename Task>
+  friend class _::ThreadPoolTaskAdapter;
+};
+
+// =======================================================================================
+// inline implementation details
+
+namespace _ {  // private
+
+template <typename Func>
+class ThreadPoolTaskImpl final: public ThreadPoolTask {
+public:
+  typedef FixVoid<ReturnType<Func, void>> T;
+
+  template <typename F>
+  ThreadPoolTaskImpl(Own<const Executor> replyTo, F&& func)
+      : ThreadPoolTask(kj::mv(replyTo)), func(kj::fwd<F>(func)) {}
+
+  PromiseFulfiller<UnfixVoid<T>>* fulfiller = nullptr;
+  // Fulfiller of the calling thread's promise. Only touched on that thread.
+
+protected:
+  void run() override {
+    KJ_IF_MAYBE(exception, kj::runCatchingExceptions([&]() {
+      result.value = MaybeVoidCaller<Void, T>::apply(func, Void());
+    })) {
+      result.exception = kj::mv(*exception);
+    }
+  }
+
+  void deliver() override {
+    if (fulfiller != nullptr) {
+      KJ_IF_MAYBE(exception, result.exception) {
+        fulfiller->reject(kj::mv(*exception));
+      } else KJ_IF_MAYBE(value, result.value) {
+        fulfiller->fulfill(kj::mv(*value));
+      }
+    }
+  }
+
+private:
+  Func func;
+  ExceptionOr<T> result;
+};
+
+template <typename Task>
+class ThreadPoolTaskAdapter {
+  // Ties a ThreadPool::run() call to the lifetime of the calling thread's promise.
+
+public:
+  ThreadPoolTaskAdapter(PromiseFulfiller<UnfixVoid<typename Task::T>>& fulfiller,
+                        Own<Task>&& task, const ThreadPool& pool)
+      : task(kj::mv(task)) {
+    this->task->fulfiller = &fulfiller;
+    pool.submit(atomicAddRef(*this->task));
+  }
+
+  ~ThreadPoolTaskAdapter() noexcept(false) {
+    task->fulfiller = nullptr;
+    task->cancel();
+  }
+
+private:
+  Own<Task> task;
+};
+
+}  // namespace _ (private)
+
+template <typename Func>
+Promise<_::ReturnType<Func, void>> ThreadPool::run(Func&& func) const {
+  typedef _::ReturnType<Func, void> Result;
+  static_assert(isSameType<PromiseForResult<Func, void>, Promise<Result>>(),
+      "ThreadPool::run() does not accept functions returning promises; the workers have no "
+      "EventLoop");
+
+  typedef _::ThreadPoolTaskImpl<Decay<Func>> Task;
+  return newAdaptedPromise<Result, _::ThreadPoolTaskAdapter<Task>>(
+      atomicRefcounted<Task>(getCurrentThreadExecutor(), kj::fwd<Func>(func)), *this);
+}
+
+template <typename T, typename Func>
+Promise<void> ThreadPool::parallelFor(ArrayPtr<T> array, Func&& func, size_t grainSize) const {
+  if (grainSize == 0) grainSize = defaultGrainSize(array.size());
+
+  auto ownFunc = heap<Decay<Func>>(kj::fwd<Func>(func));
+  auto& funcRef = *ownFunc;
+
+  auto chunks = heapArrayBuilder<Promise<void>>((array.size() + grainSize - 1) / grainSize);
+  for (size_t i = 0; i < array.size(); i += grainSize) {
+    auto chunk = array.slice(i, kj::min(i + grainSize, array.size()));
+    chunks.add(run([&funcRef, chunk]() mutable {
+      for (auto& element: chunk) {
+        funcRef(element);
+      }
+    }));
+  }
+
+  return joinPromises(chunks.finish()).attach(kj::mv(ownFunc));
+}
+
+template <typename T, typename R, typename Map, typename Combine>
+Promise<R> ThreadPool::parallelReduce(ArrayPtr<T> array, R identity, Map&& map,
+                                      Combine&& combine, size_t grainSize) const {
+  if (grainSize == 0) grainSize = defaultGrainSize(array.size());
+
+  struct Functions {
+    Decay<Map> map;
+    Decay<Combine> combine;
+  };
+  auto functions = heap<Functions>(Functions { kj::fwd<Map>(map), kj::fwd<Combine>(combine) });
+  auto& f = *functions;
+
+  auto chunks = heapArrayBuilder<Promise<R>>((array.size() + grainSize - 1) / grainSize);
+  for (size_t i = 0; i < array.size(); i += grainSize) {
+    auto chunk = array.slice(i, kj::min(i + grainSize, array.size()));
+    chunks.add(run([&f, chunk, identity]() mutable {
+      R acc = identity;
+      for (auto& element: chunk) {
+        acc = f.combine(kj::mv(acc), f.map(element));
+      }
+      return acc;
+    }));
+  }
+
+  return joinPromises(chunks.finish())
+      .then([&f, identity = kj::mv(identity)](Array<R>&& results) mutable {
+    R acc = kj::mv(identity);
+    for (auto& result: results) {
+      acc = f.combine(kj::mv(acc), kj::mv(result));
+    }
+    return acc;
+  }).attach(kj::mv(functions));
+}
+
+}  // namespace kj
@@ -23,6 +23,7 @@
 #include "time.h"
 #include "debug.h"
 #include <set>
+#include <chrono>
 
 namespace kj {
 
@@ -35,4 +36,16 @@ const Clock& nullClock() {
   return NULL_CLOCK;
 }
 
+const MonotonicClock& systemPreciseMonotonicClock() {
+  class SystemMonotonicClock final: public MonotonicClock {
+  public:
+    TimePoint now() const override {
+      return origin<TimePoint>() + std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()).count() * NANOSECONDS;
+    }
+  };
+  static KJ_CONSTEXPR(const) SystemMonotonicClock CLOCK = SystemMonotonicClock();
+  return CLOCK;
+}
+
 }  // namespace kj
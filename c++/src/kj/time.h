@@ -69,4 +69,15 @@ const Clock& nullClock();
 // A clock which always returns UNIX_EPOCH as the current time. Useful when you don't care about
 // time.
 
+class MonotonicClock {
+  // Interface to read time in a way that never goes backwards, for measuring intervals. The
+  // returned `TimePoint`s are comparable with those produced by the `Timer` of the current
+  // platform's event port, but not with the wall-clock `Date`.
+public:
+  virtual TimePoint now() const = 0;
+};
+
+const MonotonicClock& systemPreciseMonotonicClock();
+// A MonotonicClock reading the system's steady clock at its full precision.
+
 }  // namespace kj
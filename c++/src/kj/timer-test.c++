@@ -0,0 +1,163 @@
+// Copyright (c) 2013-2014 Sandstorm Development Group, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "timer.h"
+#include "debug.h"
+#include "vector.h"
+#include <kj/compat/gtest.h>
+#include <stdlib.h>
+
+namespace kj {
+namespace {
+
+KJ_TEST("TimerImpl fires events in order") {
+  EventLoop loop;
+  WaitScope waitScope(loop);
+  TimerImpl timer(origin<TimePoint>());
+
+  Vector<int> fired;
+  auto addTimer = [&](Duration delay, int id) {
+    return timer.afterDelay(delay).then([&fired,id]() { fired.add(id); }).eagerlyEvaluate(nullptr);
+  };
+  auto p1 = addTimer(30 * MILLISECONDS, 1);
+  auto p2 = addTimer(10 * MILLISECONDS, 2);
+  auto p3 = addTimer(20 * MILLISECONDS, 3);
+  auto p4 = addTimer(10 * MILLISECONDS, 4);
+
+  KJ_EXPECT(KJ_ASSERT_NONNULL(timer.nextEvent()) == origin<TimePoint>() + 10 * MILLISECONDS);
+  KJ_EXPECT(KJ_ASSERT_NONNULL(timer.timeoutToNextEvent(
+      origin<TimePoint>() + 3 * MILLISECONDS, MILLISECONDS, 1000)) == 7);
+
+  timer.advanceTo(origin<TimePoint>() + 25 * MILLISECONDS);
+  loop.run();
+  int expected[] = {2, 4, 3, 1};
+  KJ_EXPECT(fired.asPtr() == arrayPtr(expected, 3));
+
+  timer.advanceTo(origin<TimePoint>() + 30 * MILLISECONDS);
+  loop.run();
+  KJ_EXPECT(fired.asPtr() == arrayPtr(expected, 4));
+  KJ_EXPECT(timer.nextEvent() == nullptr);
+}
+
+KJ_TEST("TimerImpl timing wheel fires late but never early") {
+  EventLoop loop;
+  WaitScope waitScope(loop);
+  auto start = origin<TimePoint>() + 12345 * MICROSECONDS;
+  TimerImpl timer(start, MILLISECONDS);
+
+  auto promise = timer.atTime(start + 1500 * MICROSECONDS);
+  KJ_EXPECT(KJ_ASSERT_NONNULL(timer.nextEvent()) == start + 2 * MILLISECONDS);
+
+  timer.advanceTo(start + 1500 * MICROSECONDS);
+  KJ_EXPECT(!promise.poll(waitScope));
+  timer.advanceTo(start + 2 * MILLISECONDS);
+  KJ_EXPECT(promise.poll(waitScope));
+  promise.wait(waitScope);
+
+  // An event in the past fires on the next advance, even if time doesn't move.
+  auto past = timer.atTime(start);
+  KJ_EXPECT(KJ_ASSERT_NONNULL(timer.nextEvent()) == timer.now());
+  timer.advanceTo(timer.now());
+  KJ_EXPECT(past.poll(waitScope));
+  past.wait(waitScope);
+  KJ_EXPECT(timer.nextEvent() == nullptr);
+
+  // A far-future event survives a long jump that skips most of the wheel.
+  auto later = timer.afterDelay(30 * DAYS);
+  auto sooner = timer.afterDelay(5 * SECONDS);
+  timer.advanceTo(timer.now() + 10 * DAYS);
+  KJ_EXPECT(sooner.poll(waitScope));
+  KJ_EXPECT(!later.poll(waitScope));
+  timer.advanceTo(timer.now() + 20 * DAYS);
+  KJ_EXPECT(later.poll(waitScope));
+}
+
+KJ_TEST("TimerImpl timing wheel matches tree") {
+  // Schedule and cancel lots of random events on both implementations, and check that each event
+  // fires at the same advanceTo() call, give or take the tick.
+
+  EventLoop loop;
+  WaitScope waitScope(loop);
+  const Duration tick = 100 * MICROSECONDS;
+  TimerImpl tree(origin<TimePoint>());
+  TimerImpl wheel(origin<TimePoint>(), tick);
+
+  struct Event {
+    TimePoint time = origin<TimePoint>();
+    Promise<void> inTree = nullptr;
+    Promise<void> inWheel = nullptr;
+    bool treeFired = false;
+    bool wheelFired = false;
+    bool cancelled = false;
+    TimePoint wheelFiredAt = origin<TimePoint>();
+  };
+  Vector<Own<Event>> events;
+
+  srand(1234);
+  for (uint step = 0; step < 2000; step++) {
+    for (uint i = rand() % 8; i > 0; i--) {
+      Duration delay = (rand() % 5 == 0 ? rand() % 100000 : rand() % 100) * MILLISECONDS / 7;
+      auto event = heap<Event>();
+      auto& e = *event;
+      e.time = tree.now() + delay;
+      e.inTree = tree.atTime(e.time).then([&e]() { e.treeFired = true; })
+          .eagerlyEvaluate(nullptr);
+      e.inWheel = wheel.atTime(e.time).then([&e,&wheel]() {
+        e.wheelFired = true;
+        e.wheelFiredAt = wheel.now();
+      }).eagerlyEvaluate(nullptr);
+      events.add(kj::mv(event));
+    }
+
+    if (events.size() > 0 && rand() % 3 == 0) {
+      // Cancel one.
+      auto& e = *events[rand() % events.size()];
+      e.inTree = nullptr;
+      e.inWheel = nullptr;
+      e.cancelled = true;
+    }
+
+    KJ_IF_MAYBE(next, wheel.nextEvent()) {
+      KJ_IF_MAYBE(treeNext, tree.nextEvent()) {
+        KJ_EXPECT(*next <= *treeNext + tick);
+      }
+    }
+
+    Duration advance = (rand() % 1000) * MICROSECONDS * (rand() % 50 == 0 ? 10000 : 1);
+    tree.advanceTo(tree.now() + advance);
+    wheel.advanceTo(wheel.now() + advance);
+    loop.run();
+
+    for (auto& e: events) {
+      if (e->cancelled) continue;
+      if (e->treeFired) {
+        KJ_ASSERT(e->wheelFired || e->time > wheel.now() - tick);
+      }
+      if (e->wheelFired) {
+        KJ_ASSERT(e->treeFired);
+        KJ_ASSERT(e->wheelFiredAt >= e->time);
+      }
+    }
+  }
+}
+
+}  // namespace
+}  // namespace kj
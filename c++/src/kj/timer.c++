@@ -23,6 +23,9 @@
 #include "timer.h"
 #include "debug.h"
 #include <set>
+#if _MSC_VER
+#include <intrin.h>
+#endif
 
 namespace kj {
 
@@ -30,31 +33,132 @@ kj::Exception Timer::makeTimeoutException() {
   return KJ_EXCEPTION(OVERLOADED, "operation timed out");
 }
 
+namespace {
+
+inline uint lg64(uint64_t value) {
+  // Compute floor(log2(value)).
+  //
+  // Undefined for value = 0.
+#if _MSC_VER
+  unsigned long i;
+  auto found = _BitScanReverse64(&i, value);
+  KJ_DASSERT(found);  // !found means value = 0
+  return i;
+#else
+  return sizeof(uint64_t) * 8 - 1 - __builtin_clzll(value);
+#endif
+}
+
+inline uint lowestBit64(uint64_t value) {
+  // Compute the index of the lowest set bit.
+  //
+  // Undefined for value = 0.
+#if _MSC_VER
+  unsigned long i;
+  auto found = _BitScanForward64(&i, value);
+  KJ_DASSERT(found);  // !found means value = 0
+  return i;
+#else
+  return __builtin_ctzll(value);
+#endif
+}
+
+}  // namespace
+
 struct TimerImpl::Impl {
   struct TimerBefore {
     bool operator()(TimerPromiseAdapter* lhs, TimerPromiseAdapter* rhs) const;
   };
   using Timers = std::multiset<TimerPromiseAdapter*, TimerBefore>;
   Timers timers;
+  // Used when the timer was constructed without a wheel tick.
+
+  struct Slot {
+    // Intrusive FIFO list of timers.
+    TimerPromiseAdapter* head = nullptr;
+    TimerPromiseAdapter** tail = &head;
+  };
+
+  struct Wheel;
+  Maybe<Own<Wheel>> wheel;
+};
+
+struct TimerImpl::Impl::Wheel {
+  // Hierarchical timing wheel. Time is divided into ticks of `tickDuration`, counted from
+  // `origin`. A timer is filed under the first tick at or after its time. Level 0 has one slot
+  // per tick for the next few ticks; each level above has slots covering SLOTS times as many
+  // ticks as the one below. When time reaches a higher-level slot, its timers are refiled into
+  // the levels below ("cascaded"), so each timer is touched at most LEVELS times in its life.
+  //
+  // A timer is always filed at the level of the highest SLOT_BITS-bit digit in which its tick
+  // differs from `currentTick`. Hence, within a level, every occupied slot lies ahead of the
+  // current position, and the first occupied slot of the lowest non-empty level is always the
+  // next one that needs attention.
+
+  static constexpr uint SLOT_BITS = 6;
+  static constexpr uint SLOTS = 1u << SLOT_BITS;
+  static constexpr uint LEVELS = (64 + SLOT_BITS - 1) / SLOT_BITS;
+
+  Wheel(TimePoint origin, Duration tickDuration)
+      : origin(origin), tickDuration(tickDuration) {}
+
+  const TimePoint origin;
+  const Duration tickDuration;
+
+  uint64_t currentTick = 0;
+  // All timers filed under this tick or earlier are in `expired`.
+
+  uint64_t occupied[LEVELS] = {};
+  // Bit i of occupied[level] is set if slots[level][i] is non-empty.
+
+  Slot slots[LEVELS][SLOTS];
+
+  Slot expired;
+  // Timers which are due to fire at the next advanceTo().
+
+  void insert(TimerPromiseAdapter& timer);
+  void remove(TimerPromiseAdapter& timer);
+
+  bool nextSlot(uint& level, uint64_t& tick);
+  // Finds the next slot ahead of `currentTick` that needs attention, returning its level and the
+  // tick at which it begins. Returns false if there are no timers outside `expired`.
+
+  void advanceTo(uint64_t targetTick);
+  // Moves `currentTick` forward, moving every timer filed under a tick up to and including
+  // `targetTick` into `expired`.
+
+  Maybe<TimePoint> nextEvent(TimePoint now);
 };
 
 class TimerImpl::TimerPromiseAdapter {
 public:
   TimerPromiseAdapter(PromiseFulfiller<void>& fulfiller, TimerImpl::Impl& impl, TimePoint time)
       : time(time), fulfiller(fulfiller), impl(impl) {
-    pos = impl.timers.insert(this);
+    KJ_IF_MAYBE(wheel, impl.wheel) {
+      (*wheel)->insert(*this);
+    } else {
+      pos = impl.timers.insert(this);
+    }
   }
 
   ~TimerPromiseAdapter() {
-    if (pos != impl.timers.end()) {
+    KJ_IF_MAYBE(wheel, impl.wheel) {
+      if (slot != nullptr) {
+        (*wheel)->remove(*this);
+      }
+    } else if (pos != impl.timers.end()) {
       impl.timers.erase(pos);
     }
   }
 
   void fulfill() {
     fulfiller.fulfill();
-    impl.timers.erase(pos);
-    pos = impl.timers.end();
+    KJ_IF_MAYBE(wheel, impl.wheel) {
+      (*wheel)->remove(*this);
+    } else {
+      impl.timers.erase(pos);
+      pos = impl.timers.end();
+    }
   }
 
   const TimePoint time;
@@ -63,6 +167,14 @@ private:
   PromiseFulfiller<void>& fulfiller;
   TimerImpl::Impl& impl;
   Impl::Timers::const_iterator pos;
+
+  // Wheel bookkeeping.
+  uint64_t tick = 0;
+  Impl::Slot* slot = nullptr;
+  TimerPromiseAdapter* next = nullptr;
+  TimerPromiseAdapter** prev = nullptr;
+
+  friend struct Impl::Wheel;
 };
 
 inline bool TimerImpl::Impl::TimerBefore::operator()(
@@ -70,6 +182,104 @@ inline bool TimerImpl::Impl::TimerBefore::operator()(
   return lhs->time < rhs->time;
 }
 
+void TimerImpl::Impl::Wheel::insert(TimerPromiseAdapter& timer) {
+  Duration offset = timer.time - origin;
+  Slot* target;
+  if (offset <= int64_t(currentTick) * tickDuration) {
+    // Already due.
+    timer.tick = currentTick;
+    target = &expired;
+  } else {
+    // Round up, so that we never fire early.
+    timer.tick = offset / tickDuration + (offset % tickDuration > 0 * SECONDS);
+
+    uint level = lg64(timer.tick ^ currentTick) / SLOT_BITS;
+    uint index = (timer.tick >> (level * SLOT_BITS)) & (SLOTS - 1);
+    target = &slots[level][index];
+    occupied[level] |= uint64_t(1) << index;
+  }
+
+  timer.slot = target;
+  timer.next = nullptr;
+  timer.prev = target->tail;
+  *target->tail = &timer;
+  target->tail = &timer.next;
+}
+
+void TimerImpl::Impl::Wheel::remove(TimerPromiseAdapter& timer) {
+  Slot* slot = timer.slot;
+  *timer.prev = timer.next;
+  if (timer.next == nullptr) {
+    slot->tail = timer.prev;
+  } else {
+    timer.next->prev = timer.prev;
+  }
+  timer.slot = nullptr;
+  timer.next = nullptr;
+  timer.prev = nullptr;
+
+  if (slot->head == nullptr && slot != &expired) {
+    size_t n = slot - &slots[0][0];
+    occupied[n / SLOTS] &= ~(uint64_t(1) << (n % SLOTS));
+  }
+}
+
+bool TimerImpl::Impl::Wheel::nextSlot(uint& level, uint64_t& tick) {
+  for (level = 0; level < LEVELS; level++) {
+    uint64_t bits = occupied[level];
+    if (bits != 0) {
+      uint shift = level * SLOT_BITS;
+      uint upperShift = shift + SLOT_BITS;
+      uint64_t base = upperShift >= 64 ? 0 : currentTick >> upperShift << upperShift;
+      tick = base | (uint64_t(lowestBit64(bits)) << shift);
+      return true;
+    }
+  }
+  return false;
+}
+
+void TimerImpl::Impl::Wheel::advanceTo(uint64_t targetTick) {
+  uint level;
+  uint64_t tick;
+  while (nextSlot(level, tick) && tick <= targetTick) {
+    currentTick = tick;
+
+    // Detach the slot and refile everything in it relative to the new position. Timers at level 0
+    // are due exactly now; higher-level timers move down.
+    uint index = (tick >> (level * SLOT_BITS)) & (SLOTS - 1);
+    Slot& slot = slots[level][index];
+    TimerPromiseAdapter* timer = slot.head;
+    slot.head = nullptr;
+    slot.tail = &slot.head;
+    occupied[level] &= ~(uint64_t(1) << index);
+
+    while (timer != nullptr) {
+      TimerPromiseAdapter* next = timer->next;
+      insert(*timer);
+      timer = next;
+    }
+  }
+
+  if (targetTick > currentTick) {
+    currentTick = targetTick;
+  }
+}
+
+Maybe<TimePoint> TimerImpl::Impl::Wheel::nextEvent(TimePoint now) {
+  uint level;
+  uint64_t tick;
+  if (expired.head != nullptr) {
+    return now;
+  } else if (nextSlot(level, tick)) {
+    // For a higher-level slot this is only the time at which it must be cascaded, which may be
+    // earlier than any timer in it. That's fine: the caller will merely wake up and advance to
+    // find nothing to fire.
+    return origin + int64_t(tick) * tickDuration;
+  } else {
+    return nullptr;
+  }
+}
+
 Promise<void> TimerImpl::atTime(TimePoint time) {
   return newAdaptedPromise<void, TimerPromiseAdapter>(*impl, time);
 }
@@ -81,9 +291,19 @@ Promise<void> TimerImpl::afterDelay(Duration delay) {
 TimerImpl::TimerImpl(TimePoint startTime)
     : time(startTime), impl(heap<Impl>()) {}
 
+TimerImpl::TimerImpl(TimePoint startTime, Duration wheelTick)
+    : time(startTime), impl(heap<Impl>()) {
+  KJ_REQUIRE(wheelTick > 0 * SECONDS, "timing wheel tick must be positive");
+  impl->wheel = heap<Impl::Wheel>(startTime, wheelTick);
+}
+
 TimerImpl::~TimerImpl() noexcept(false) {}
 
 Maybe<TimePoint> TimerImpl::nextEvent() {
+  KJ_IF_MAYBE(wheel, impl->wheel) {
+    return (*wheel)->nextEvent(time);
+  }
+
   auto iter = impl->timers.begin();
   if (iter == impl->timers.end()) {
     return nullptr;
@@ -113,6 +333,16 @@ void TimerImpl::advanceTo(TimePoint newTime) {
   KJ_REQUIRE(newTime >= time, "can't advance backwards in time") { return; }
 
   time = newTime;
+
+  KJ_IF_MAYBE(wheel, impl->wheel) {
+    auto& w = **wheel;
+    w.advanceTo((newTime - w.origin) / w.tickDuration);
+    while (w.expired.head != nullptr) {
+      w.expired.head->fulfill();
+    }
+    return;
+  }
+
   for (;;) {
     auto front = impl->timers.begin();
     if (front == impl->timers.end() || (*front)->time > time) {
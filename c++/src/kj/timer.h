@@ -73,6 +73,18 @@ class TimerImpl final: public Timer {
 
 public:
   TimerImpl(TimePoint startTime);
+
+  TimerImpl(TimePoint startTime, Duration wheelTick);
+  // Like the above, but keeps pending timers in a hierarchical timing wheel with a resolution of
+  // `wheelTick` rather than in a sorted tree. Scheduling and cancelling a timer then take
+  // constant time no matter how many are pending, which matters for servers that set a timeout
+  // on every connection or call.
+  //
+  // In exchange, an event may fire up to one tick late (never early), and events falling within
+  // the same tick may fire in any order relative to each other. Events in different ticks still
+  // fire in time order. Also, nextEvent() may report a time earlier than the next event; waking
+  // up then and calling advanceTo() is harmless.
+
   ~TimerImpl() noexcept(false);
 
   Maybe<TimePoint> nextEvent();